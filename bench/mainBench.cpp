@@ -0,0 +1,788 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <experimental/memory_resource>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Arena.h"
+#include "BigInt.h"
+#include "Channel.h"
+#include "Fibonacci.h"
+#include "Log.h"
+#include "Scheduler.h"
+#include "Simulation.h"
+#include "Status.h"
+#include "TaskPool.h"
+#include "TestTask.h"
+#include "ThreadPool.h"
+#include "Trace.h"
+#include "Worker.h"
+#ifdef TASKLIB_COROUTINES
+#include "CoTask.h"
+#endif
+
+using namespace std::chrono_literals;
+
+/**
+ * Micro benchmarks, run with no arguments to execute all of them or pass
+ * a substring to run only the benchmarks whose name contains it:
+ *
+ *   ./program_bench           runs every benchmark
+ *   ./program_bench trace     runs trace benchmarks
+*/
+
+namespace {
+
+struct Benchmark {
+    std::string name;
+    std::function<void()> run;
+};
+
+std::vector<Benchmark>& benchmarks() {
+    static std::vector<Benchmark> instance;
+    return instance;
+}
+
+struct BenchmarkRegistration {
+    BenchmarkRegistration(const std::string& name, std::function<void()> run) {
+        benchmarks().push_back({name, std::move(run)});
+    }
+};
+
+#define BENCHMARK(name) \
+    static void bench_##name(); \
+    static BenchmarkRegistration registration_##name(#name, bench_##name); \
+    static void bench_##name()
+
+template<class F>
+double nsPerOp(const std::size_t iterations, F&& body) {
+    const auto begin = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+        body(i);
+    }
+    const auto end = std::chrono::steady_clock::now();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) / static_cast<double>(iterations);
+}
+
+void report(const std::string& name, const double value, const std::string& unit) {
+    std::cout << "  " << std::left << std::setw(40) << name << std::right << std::setw(12)
+              << std::fixed << std::setprecision(2) << value << " " << unit << std::endl;
+}
+
+}
+
+/* --- TRACE --- */
+
+/**
+ * Cost of recording one lifecycle event into the calling thread's ring
+*/
+BENCHMARK(trace_record)
+{
+    const std::size_t iterations = 5000000;
+    Trace::clear();
+    Trace::enable(true);
+    report("Trace::record (enabled)", nsPerOp(iterations, [](std::size_t i) {
+        Trace::record(TraceEvent::paused, static_cast<int>(i));
+    }), "ns/event");
+
+    Trace::enable(false);
+    report("Trace::record (runtime disabled)", nsPerOp(iterations, [](std::size_t i) {
+        Trace::record(TraceEvent::paused, static_cast<int>(i));
+    }), "ns/event");
+    Trace::enable(true);
+    Trace::clear();
+}
+
+/**
+ * Pause/resume round trip through the control path, includes TASK_TRACE hooks when built with TASKLIB_TRACE
+*/
+BENCHMARK(task_pause_resume)
+{
+    const std::size_t iterations = 2000;
+    Scheduler scheduler;
+    TestTask& task = scheduler.addTask<TestTask>(0ns);
+
+    report("Task::pause + Task::resume", nsPerOp(iterations, [&](std::size_t) {
+        task.pause();
+        task.resume();
+    }) / 1000.0, "us/round trip");
+}
+
+/* --- TASK CONTROL BLOCK LAYOUT --- */
+
+namespace {
+
+/* Former Task layout: control fields and the worker's progress share a line */
+struct PackedControl {
+    std::atomic<Task::StateType> state{Task::StateType::running};
+    std::atomic<Task::CommandType> command{Task::CommandType::run};
+    std::atomic<double> progress{0.0};
+};
+
+/* Current Task layout: worker-written and controller-written fields on separate lines */
+struct PaddedControl {
+    alignas(CACHE_LINE_SIZE) std::atomic<Task::CommandType> command{Task::CommandType::run};
+    alignas(CACHE_LINE_SIZE) std::atomic<Task::StateType> state{Task::StateType::running};
+    alignas(CACHE_LINE_SIZE) std::atomic<double> progress{0.0};
+};
+
+/**
+ * Worker polls command and stores progress, as checkCommand() plus a progress update do,
+ * while a controller thread keeps reading state. Returns ns per worker iteration.
+*/
+template<class Control>
+double controlTraffic(const std::size_t iterations) {
+    Control control;
+    std::atomic<bool> done{false};
+
+    std::thread controller([&]() {
+        std::size_t reads = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+            reads += control.state.load(std::memory_order_relaxed) == Task::StateType::running;
+        }
+        (void)reads;
+    });
+
+    const double result = nsPerOp(iterations, [&](std::size_t i) {
+        if (control.command.load(std::memory_order_relaxed) != Task::CommandType::run) {
+            return;
+        }
+        control.progress.store(static_cast<double>(i), std::memory_order_relaxed);
+    });
+
+    done = true;
+    controller.join();
+    return result;
+}
+
+/* Spins on checkCommand() and a per-iteration progress store */
+class SpinTask : public Task
+{
+public:
+    SpinTask(const int id, const long iterations)
+    : Task(id), iterations_(iterations), count_(0), progress_(0.0)
+    {}
+
+    double progress() override {
+        return progress_;
+    }
+
+private:
+    const long iterations_;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<long> count_;
+    std::atomic<double> progress_;
+
+    void execute() override {
+        while (++count_ < iterations_) {
+            checkCommand();
+            progress_ = static_cast<double>(count_);
+        }
+    }
+};
+
+}
+
+/**
+ * Cross-core traffic between a worker writing progress and a controller polling status.
+ * Needs at least two cores to show a difference.
+*/
+BENCHMARK(task_control_layout)
+{
+    const std::size_t iterations = 20000000;
+    if (std::thread::hardware_concurrency() < 2) {
+        std::cout << "  (single core, no cross-core traffic to measure)" << std::endl;
+    }
+    report("packed control block", controlTraffic<PackedControl>(iterations), "ns/iteration");
+    report("cache-line separated control block", controlTraffic<PaddedControl>(iterations), "ns/iteration");
+
+    const long task_iterations = 5000000;
+    Scheduler scheduler;
+    std::atomic<bool> done{false};
+
+    const auto begin = std::chrono::steady_clock::now();
+    SpinTask& task = scheduler.addTask<SpinTask>(task_iterations);
+    std::thread controller([&]() {
+        while (!done.load(std::memory_order_relaxed)) {
+            task.status();
+        }
+    });
+    task.joinTask();
+    const auto end = std::chrono::steady_clock::now();
+    done = true;
+    controller.join();
+    task.join();
+
+    report("Task loop under status polling", static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) / task_iterations, "ns/iteration");
+}
+
+/* --- CHANNELS --- */
+
+namespace {
+
+/* One pipeline stage: source if in is null, sink if out is null, otherwise forwards value + 1 */
+template<class C>
+class StageTask : public Task
+{
+public:
+    struct Input {
+        C* in;
+        C* out;
+        long count;
+        std::size_t batch;
+    };
+
+    StageTask(const int id, const Input& input)
+    : Task(id), input_(input)
+    {}
+
+    double progress() override { return 0.0; }
+
+private:
+    const Input input_;
+
+    void execute() override {
+        std::vector<long> values(input_.batch);
+        if (!input_.in) {
+            for (long sent = 0; sent < input_.count; sent += static_cast<long>(input_.batch)) {
+                for (std::size_t i = 0; i < input_.batch; ++i) {
+                    values[i] = sent + static_cast<long>(i);
+                }
+                input_.out->pushBatch(*this, values.data(), input_.batch);
+            }
+            input_.out->close();
+            return;
+        }
+
+        std::size_t n;
+        while ((n = input_.in->popBatch(*this, values.data(), input_.batch)) > 0) {
+            if (input_.out) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    values[i]++;
+                }
+                input_.out->pushBatch(*this, values.data(), n);
+            }
+        }
+        if (input_.out) {
+            input_.out->close();
+        }
+    }
+};
+
+/* Items per second through source -> transform -> sink */
+template<class C>
+double pipelineThroughput(const long count, const std::size_t batch) {
+    using Stage = StageTask<C>;
+    Scheduler scheduler;
+    C first(1024);
+    C second(1024);
+
+    const auto begin = std::chrono::steady_clock::now();
+    Stage& sink = scheduler.addTask<Stage>(typename Stage::Input{&second, nullptr, count, batch});
+    scheduler.addTask<Stage>(typename Stage::Input{&first, &second, count, batch});
+    scheduler.addTask<Stage>(typename Stage::Input{nullptr, &first, count, batch});
+    sink.joinTask();
+    const auto end = std::chrono::steady_clock::now();
+
+    for (Task& task : scheduler.getTasks()) {
+        task.joinTask();
+        task.join();
+    }
+    const double seconds = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) / 1e9;
+    return static_cast<double>(count) / seconds / 1e6;
+}
+
+}
+
+/**
+ * Three-stage task pipeline over bounded channels, single values against batches of 64
+*/
+BENCHMARK(channel_pipeline)
+{
+    const long count = 1 << 22;
+    report("spsc pipeline, batch 1", pipelineThroughput<SpscChannel<long>>(count, 1), "M items/s");
+    report("spsc pipeline, batch 64", pipelineThroughput<SpscChannel<long>>(count, 64), "M items/s");
+    report("mpmc pipeline, batch 1", pipelineThroughput<MpmcChannel<long>>(count, 1), "M items/s");
+    report("mpmc pipeline, batch 64", pipelineThroughput<MpmcChannel<long>>(count, 64), "M items/s");
+}
+
+/* --- STATUS --- */
+
+/**
+ * Status of 2000 paused tasks written to /dev/null: operator<< with std::endl against the status writer
+*/
+BENCHMARK(status_dump)
+{
+    const int tasks = 2000;
+    const std::size_t iterations = 200;
+    Scheduler scheduler;
+    for (int i = 0; i < tasks; ++i) {
+        scheduler.addTask<TestTask>(std::chrono::milliseconds(1)).pause();
+    }
+
+    const int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    std::ofstream stream("/dev/null");
+    report("operator<< + std::endl", nsPerOp(iterations, [&](std::size_t) {
+        for (auto task : scheduler.getTasks()) {
+            stream << " -> " << task.get() << " task_type: " << task.get().type() << std::endl;
+        }
+    }) / tasks, "ns/task");
+
+    StatusWriter text;
+    report("StatusWriter text", nsPerOp(iterations, [&](std::size_t) {
+        text.appendAll(scheduler);
+        text.writeTo(fd);
+    }) / tasks, "ns/task");
+
+    StatusWriter json(StatusFormat::ndjson);
+    report("StatusWriter ndjson", nsPerOp(iterations, [&](std::size_t) {
+        json.appendAll(scheduler);
+        json.writeTo(fd);
+    }) / tasks, "ns/task");
+
+    StatusWriter binary(StatusFormat::binary);
+    report("StatusWriter binary", nsPerOp(iterations, [&](std::size_t) {
+        binary.appendAll(scheduler);
+        binary.writeTo(fd);
+    }) / tasks, "ns/task");
+    close(fd);
+}
+
+/**
+ * 2000 paused and 10 running tasks: counting and listing the running ones by scanning every task
+ * against the scheduler's indexes
+*/
+BENCHMARK(task_query)
+{
+    const std::size_t iterations = 2000;
+    Scheduler scheduler;
+    for (int i = 0; i < 2000; ++i) {
+        scheduler.addTask<TestTask>(std::chrono::milliseconds(1)).pause();
+    }
+    for (int i = 0; i < 10; ++i) {
+        scheduler.addTask<TestTask>(std::chrono::milliseconds(1));
+    }
+
+    std::size_t found = 0;
+    report("count running, getTasks scan", nsPerOp(iterations, [&](std::size_t) {
+        for (Task& task : scheduler.getTasks()) {
+            found += task.status() == Task::StateType::running;
+        }
+    }), "ns/query");
+    report("count running, countTasks", nsPerOp(iterations, [&](std::size_t) {
+        found += scheduler.countTasks(StatusFilter::bit(Task::StateType::running));
+    }), "ns/query");
+
+    StatusFilter running;
+    running.states = StatusFilter::bit(Task::StateType::running);
+    StatusWriter writer;
+    report("status running, indexed", nsPerOp(iterations, [&](std::size_t) {
+        found += writer.appendAll(scheduler, running);
+        writer.clear();
+    }), "ns/query");
+    if (found == 0) {
+        std::cout << "no running task found" << std::endl;
+    }
+}
+
+/* --- RECURRING TASKS --- */
+
+/**
+ * Short recurring job (fibonacci of 10) run to its end: a new task per run against a task of a pool
+*/
+BENCHMARK(task_recurring)
+{
+    const std::size_t iterations = 5000;
+
+    Scheduler created;
+    report("addTask + joinTask", nsPerOp(iterations, [&](std::size_t) {
+        created.addTask<Fibonacci>(10).joinTask();
+    }), "ns/run");
+
+    Scheduler pooled;
+    TaskPool<Fibonacci> pool(pooled, 1, 10);
+    report("TaskPool::run + joinTask", nsPerOp(iterations, [&](std::size_t) {
+        pool.run()->joinTask();
+    }), "ns/run");
+}
+
+/* --- LOGGING --- */
+
+/**
+ * Failure lines logged by 4 threads to a file: a shared stream flushed per line behind a mutex,
+ * as std::cout was used, against the asynchronous log. Time per line as seen by the callers, the log's
+ * queue holds 4096 lines
+*/
+BENCHMARK(log_write)
+{
+    const std::size_t threads = 4;
+    const std::size_t lines = 25000;
+    const std::string line = "Task id: '42' failed: boom";
+    const char* path = "/tmp/program_bench.log";
+
+    auto perLine = [&](std::function<void()> write) {
+        const auto begin = std::chrono::steady_clock::now();
+        std::vector<std::thread> writers;
+        for (std::size_t t = 0; t < threads; ++t) {
+            writers.emplace_back([&]() {
+                for (std::size_t i = 0; i < lines; ++i) {
+                    write();
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        const auto end = std::chrono::steady_clock::now();
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count()) / static_cast<double>(threads * lines);
+    };
+
+    std::ofstream stream(path);
+    std::mutex mutex;
+    report("ofstream << std::endl", perLine([&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        stream << line << std::endl;
+    }), "ns/line");
+    stream.close();
+
+    const int fd = ::open(path, O_WRONLY | O_TRUNC | O_CLOEXEC);
+    {
+        Log log(fd);
+        // Retried when dropped, every line is written as with the stream
+        report("Log::write", perLine([&]() {
+            while (!log.write(line)) {
+                std::this_thread::yield();
+            }
+        }), "ns/line");
+        log.flush();
+    }
+    ::close(fd);
+    ::unlink(path);
+}
+
+/* --- WORKER PROCESSES --- */
+
+/**
+ * Tasks run in a worker process against in-process ones: short task run to its end, and
+ * a pause/resume round trip on a task polling in a tight loop
+*/
+BENCHMARK(worker_control)
+{
+    const std::size_t iterations = 2000;
+
+    WorkerPool pool(TaskRegistry<TestTask, Fibonacci>(), 1);
+    Scheduler scheduler;
+
+    report("local addTask + joinTask", nsPerOp(iterations, [&](std::size_t) {
+        scheduler.addTask<Fibonacci>(10).joinTask();
+    }), "ns/run");
+    report("worker addTask + joinTask", nsPerOp(iterations, [&](std::size_t) {
+        pool.addTask(scheduler, "fibonacci", "10").joinTask();
+    }), "ns/run");
+
+    Task& local = scheduler.addTask<TestTask>(std::chrono::nanoseconds(0));
+    report("local pause + resume", nsPerOp(iterations, [&](std::size_t) {
+        local.pause();
+        local.resume();
+    }), "ns/op");
+    local.stop();
+
+    Task& remote = pool.addTask(scheduler, "test", "0");
+    report("worker pause + resume", nsPerOp(iterations, [&](std::size_t) {
+        remote.pause();
+        remote.resume();
+    }), "ns/op");
+    remote.stop();
+}
+
+/* --- BIG-NUMBER FIBONACCI --- */
+
+/**
+ * Fast doubling against the iterative sum for F(10^5), F(10^6) end to end, a large product
+ * on 1 and 4 threads and the decimal conversion of F(10^6)
+*/
+BENCHMARK(fibonacci_bigint)
+{
+    using Ms = std::chrono::duration<double, std::milli>;
+    Scheduler scheduler;
+
+    report("iterative sum F(10^5)", nsPerOp(1, [&](std::size_t) {
+        BigInt previous(0);
+        BigInt current(1);
+        for (int i = 1; i < 100000; ++i) {
+            previous += current;
+            std::swap(previous, current);
+        }
+    }) / 1e6, "ms");
+    report("fast doubling F(10^5)", nsPerOp(10, [&](std::size_t) {
+        scheduler.addTask<Fibonacci>(100000).joinTask();
+    }) / 1e6, "ms");
+
+    Fibonacci& million = scheduler.addTask<Fibonacci>(1000000);
+    const auto begin = std::chrono::steady_clock::now();
+    million.joinTask();
+    report("fast doubling F(10^6)", Ms(std::chrono::steady_clock::now() - begin).count(), "ms");
+
+    const BigInt& value = million.getResult();
+    MultiplyOptions options;
+    report("multiply 21k limbs, 1 thread", nsPerOp(5, [&](std::size_t) {
+        BigInt::multiply(value, value, options);
+    }) / 1e6, "ms");
+    options.threads = 4;
+    report("multiply 21k limbs, 4 threads", nsPerOp(5, [&](std::size_t) {
+        BigInt::multiply(value, value, options);
+    }) / 1e6, "ms");
+
+    report("toDecimal F(10^6)", nsPerOp(1, [&](std::size_t) {
+        value.toDecimal();
+    }) / 1e6, "ms");
+}
+
+/* --- SIMULATION --- */
+
+/**
+ * 100k tasks of 1 to 20 steps arriving at random on 8 virtual workers, 50us quantum, under each
+ * dispatch policy: virtual throughput and latencies, and the wall time of the simulation
+*/
+BENCHMARK(simulation_policies)
+{
+    const int tasks = 100000;
+    const std::pair<DispatchPolicy, const char*> policies[] = {
+        {DispatchPolicy::fifo, "fifo"},
+        {DispatchPolicy::priority, "priority"},
+        {DispatchPolicy::workStealing, "work stealing"},
+    };
+
+    for (const auto& policy : policies) {
+        SimulationOptions options;
+        options.workers = 8;
+        options.policy = policy.first;
+        options.quantum = std::chrono::microseconds(50);
+        Simulation simulation(options);
+
+        std::uint64_t state = 42;
+        auto next = [&state]() {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            return static_cast<std::uint32_t>(state >> 33);
+        };
+        std::chrono::nanoseconds arrival(0);
+        for (int i = 0; i < tasks; ++i) {
+            arrival += std::chrono::microseconds(next() % 150);
+            const SimulatedWork work{1 + next() % 20, std::chrono::microseconds(10 + next() % 90)};
+            simulation.addTask<SimulatedTask>(arrival, static_cast<int>(next() % 4), work);
+        }
+
+        const auto begin = std::chrono::steady_clock::now();
+        const SimulationReport outcome = simulation.run();
+        const auto wall = std::chrono::steady_clock::now() - begin;
+
+        const std::string name = policy.second;
+        report(name + " throughput", outcome.throughput, "tasks/s");
+        report(name + " p50 latency", std::chrono::duration<double, std::micro>(outcome.p50_latency).count(), "us");
+        report(name + " p99 latency", std::chrono::duration<double, std::micro>(outcome.p99_latency).count(), "us");
+        report(name + " preemptions", static_cast<double>(outcome.preemptions), "");
+        report(name + " wall time", std::chrono::duration<double, std::milli>(wall).count(), "ms");
+    }
+}
+
+/* --- THREAD POOL --- */
+
+/**
+ * Burst of short tasks (fibonacci of 10) added then joined, a thread per task against the elastic pool,
+ * and the same burst of tasks sleeping 1ms in a blocking region: the pool grows to keep them going
+*/
+BENCHMARK(thread_pool)
+{
+    const std::size_t tasks = 5000;
+    auto burst = [&](Scheduler& scheduler) {
+        std::vector<Fibonacci*> started;
+        started.reserve(tasks);
+        const auto begin = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < tasks; ++i) {
+            started.push_back(&scheduler.addTask<Fibonacci>(10));
+        }
+        for (Fibonacci* task : started) {
+            task->joinTask();
+        }
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count()) / tasks;
+    };
+
+    {
+        Scheduler scheduler;
+        report("thread per task", burst(scheduler), "ns/task");
+    }
+    {
+        Scheduler scheduler;
+        scheduler.enableThreadPool();
+        report("pool", burst(scheduler), "ns/task");
+        report("pool peak threads", static_cast<double>(scheduler.threadPool()->stats().peak_threads), "");
+    }
+
+    ThreadPoolOptions options;
+    options.max_threads = 64;
+    ThreadPool pool(options);
+    std::atomic<std::size_t> done(0);
+    const auto begin = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < tasks; ++i) {
+        pool.submit([&]() {
+            BlockingRegion blocking;
+            std::this_thread::sleep_for(1ms);
+            done++;
+        });
+    }
+    while (done < tasks) {
+        std::this_thread::sleep_for(1ms);
+    }
+    report("pool, 1ms blocking jobs", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count(), "ms");
+    report("pool, 1ms blocking jobs peak threads", static_cast<double>(pool.stats().peak_threads), "");
+}
+
+/* --- TASK ARENA --- */
+
+/**
+ * Short-lived buffers of 64 to 512 bytes allocated and dropped by 8 threads at once, from the global heap
+ * against a TaskArena released every 1000 buffers
+*/
+BENCHMARK(arena_scratch)
+{
+    const std::size_t threads = 8;
+    const std::size_t iterations = 200000;
+
+    auto run = [&](const bool arena) {
+        std::vector<std::thread> workers;
+        const auto begin = std::chrono::steady_clock::now();
+        for (std::size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, arena]() {
+                TaskArena scratch;
+                std::experimental::pmr::memory_resource* resource = arena ? &scratch : std::experimental::pmr::new_delete_resource();
+                for (std::size_t i = 0; i < iterations; ++i) {
+                    const std::size_t size = 64 + (i * 37) % 448;
+                    char* buffer = static_cast<char*>(resource->allocate(size, alignof(std::max_align_t)));
+                    buffer[0] = buffer[size - 1] = 'x';
+                    resource->deallocate(buffer, size, alignof(std::max_align_t));
+                    if (arena && i % 1000 == 999) {
+                        scratch.release();
+                    }
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count()) / (threads * iterations);
+    };
+
+    report("global heap", run(false), "ns/buffer");
+    report("task arena", run(true), "ns/buffer");
+}
+
+#ifdef TASKLIB_COROUTINES
+
+/* --- COROUTINE TASKS --- */
+
+namespace {
+
+/* Resident memory of the process, from /proc/self/statm */
+double residentBytes() {
+    std::ifstream statm("/proc/self/statm");
+    double size = 0;
+    double resident = 0;
+    statm >> size >> resident;
+    return resident * static_cast<double>(sysconf(_SC_PAGESIZE));
+}
+
+CoTask idleReceiver(MpmcChannel<long>& input) {
+    long value;
+    while (co_await coReceive(input, value)) {
+    }
+}
+
+CoTask yielder(const std::size_t steps) {
+    for (std::size_t i = 0; i < steps; ++i) {
+        co_await coYield();
+    }
+}
+
+}
+
+/**
+ * Resident memory of 100000 coroutine tasks waiting on a channel against 1000 threads waiting on a
+ * condition, and the cost of a yield on one runtime thread
+*/
+BENCHMARK(coroutine_tasks)
+{
+    const std::size_t tasks = 100000;
+    {
+        CoRuntime runtime(1);
+        MpmcChannel<long> channel(16);
+        std::vector<CoHandle> receivers;
+        receivers.reserve(tasks);
+        const double before = residentBytes();
+        for (std::size_t i = 0; i < tasks; ++i) {
+            receivers.push_back(runtime.spawn(idleReceiver, std::ref(channel)));
+        }
+        report("idle coroutine task", (residentBytes() - before) / tasks, "bytes/task");
+        channel.close();
+        for (const CoHandle& receiver : receivers) {
+            receiver.join();
+        }
+    }
+    {
+        const std::size_t threads = 1000;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool done = false;
+        std::vector<std::thread> waiting;
+        const double before = residentBytes();
+        for (std::size_t i = 0; i < threads; ++i) {
+            waiting.emplace_back([&]() {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&]() { return done; });
+            });
+        }
+        report("idle thread", (residentBytes() - before) / threads, "bytes/thread");
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            done = true;
+            condition.notify_all();
+        }
+        for (std::thread& thread : waiting) {
+            thread.join();
+        }
+    }
+
+    const std::size_t steps = 1000000;
+    CoRuntime runtime(1);
+    const auto begin = std::chrono::steady_clock::now();
+    runtime.spawn(yielder, steps).join();
+    report("coroutine yield", static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count()) / steps, "ns/yield");
+}
+
+#endif
+
+int main(int argc, char* argv[])
+{
+    const char* filter = argc > 1 ? argv[1] : "";
+
+    for (auto& benchmark : benchmarks()) {
+        if (std::strstr(benchmark.name.c_str(), filter) == nullptr) {
+            continue;
+        }
+        std::cout << benchmark.name << std::endl;
+        benchmark.run();
+    }
+
+    return 0;
+}
@@ -0,0 +1,183 @@
+#include "ControlSocket.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+/* --- LINE READER --- */
+
+LineReader::LineReader(const int fd, const int interrupt_fd, const std::size_t buffer_size)
+: fd_(fd), interrupt_fd_(interrupt_fd), buffer_(buffer_size), begin_(0), end_(0)
+{}
+
+bool LineReader::buffered() const {
+    return std::memchr(buffer_.data() + begin_, '\n', end_ - begin_) != nullptr;
+}
+
+bool LineReader::next(std::string& line) {
+    line.clear();
+    for (;;) {
+        const char* begin = buffer_.data() + begin_;
+        const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end_ - begin_));
+        if (newline) {
+            line.append(begin, newline);
+            begin_ += static_cast<std::size_t>(newline - begin) + 1;
+            return true;
+        }
+        line.append(begin, end_ - begin_);
+        begin_ = end_ = 0;
+
+        if (interrupt_fd_ >= 0) {
+            pollfd fds[2] = {{fd_, POLLIN, 0}, {interrupt_fd_, POLLIN, 0}};
+            while (::poll(fds, 2, -1) < 0 && errno == EINTR) {
+            }
+            if (fds[1].revents) {
+                return false;
+            }
+        }
+
+        ssize_t n;
+        do {
+            n = ::read(fd_, buffer_.data(), buffer_.size());
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            return !line.empty();
+        }
+        end_ = static_cast<std::size_t>(n);
+    }
+}
+
+/* --- CONTROL SOCKET --- */
+
+namespace {
+
+bool sendAll(const int fd, const std::string& data) {
+    std::size_t sent = 0;
+    while (sent < data.size()) {
+        const ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        sent += static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+}
+
+ControlSocket::ControlSocket(const std::string& path, Handler handler)
+: path_(path), handler_(std::move(handler)), listen_fd_(-1), closing_(false)
+{
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path_.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Cannot listen on '" + path_ + "', path too long");
+    }
+    std::memcpy(address.sun_path, path_.c_str(), path_.size());
+
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    ::unlink(path_.c_str());
+    if (listen_fd_ < 0
+        || ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0
+        || ::listen(listen_fd_, SOMAXCONN) < 0) {
+        const std::string reason = std::strerror(errno);
+        if (listen_fd_ >= 0) {
+            ::close(listen_fd_);
+        }
+        throw std::runtime_error("Cannot listen on '" + path_ + "', " + reason);
+    }
+
+    thread_ = std::thread(&ControlSocket::accept, this);
+}
+
+ControlSocket::~ControlSocket() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closing_ = true;
+        // Wakes the blocked accept() and read() calls
+        ::shutdown(listen_fd_, SHUT_RDWR);
+        for (auto& client : clients_) {
+            if (client->fd >= 0) {
+                ::shutdown(client->fd, SHUT_RDWR);
+            }
+        }
+    }
+    thread_.join();
+    for (auto& client : clients_) {
+        client->thread.join();
+    }
+    ::close(listen_fd_);
+    ::unlink(path_.c_str());
+}
+
+void ControlSocket::accept() {
+    std::vector<std::unique_ptr<Client>> finished;
+    for (;;) {
+        const int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0 && errno == EINTR) {
+            continue;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (fd < 0 || closing_) {
+                if (fd >= 0) {
+                    ::close(fd);
+                }
+                return;
+            }
+            reap(finished);
+            clients_.push_back(std::unique_ptr<Client>(new Client{fd, std::thread()}));
+            Client& client = *clients_.back();
+            client.thread = std::thread(&ControlSocket::serve, this, std::ref(client));
+        }
+
+        // Their threads hold no lock anymore, only returning is left
+        for (auto& client : finished) {
+            client->thread.join();
+        }
+        finished.clear();
+    }
+}
+
+void ControlSocket::reap(std::vector<std::unique_ptr<Client>>& finished) {
+    auto end = std::partition(clients_.begin(), clients_.end(), [](const std::unique_ptr<Client>& client) {
+        return client->fd >= 0;
+    });
+    std::move(end, clients_.end(), std::back_inserter(finished));
+    clients_.erase(end, clients_.end());
+}
+
+void ControlSocket::serve(Client& client) {
+    LineReader reader(client.fd);
+    std::ostringstream out;
+    std::string line;
+    bool open = true;
+    while (open && reader.next(line)) {
+        open = handler_(line, out);
+
+        // Commands already received are run before replying
+        if (!open || !reader.buffered()) {
+            if (!sendAll(client.fd, out.str())) {
+                break;
+            }
+            out.str(std::string());
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    ::close(client.fd);
+    client.fd = -1;
+}
@@ -0,0 +1,83 @@
+#ifndef CONTROL_SOCKET
+#define CONTROL_SOCKET
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Splits what is read from a descriptor into lines, one read() per buffer
+ * Reading ends as well once interrupt_fd, when given, becomes readable
+*/
+class LineReader
+{
+public:
+    explicit LineReader(const int fd, const int interrupt_fd = -1, const std::size_t buffer_size = 64 << 10);
+
+    /* False at end of input or once interrupted, a last line without newline is returned first */
+    bool next(std::string& line);
+
+    /* True if lines are left without reading again, replies can wait for them */
+    bool buffered() const;
+
+private:
+    const int fd_;
+    const int interrupt_fd_;
+    std::vector<char> buffer_;
+    std::size_t begin_;
+    std::size_t end_;
+};
+
+/**
+ * Local control socket, every client gets a thread running its commands in order
+ *
+ * Replies are written once the lines received so far are handled, so a client sending commands
+ * back to back gets them in a single write. Handler returns false on quit, which ends the session.
+*/
+class ControlSocket
+{
+public:
+    using Handler = std::function<bool(const std::string& line, std::ostream& out)>;
+
+    /**
+     * Listens on path, replacing a stale socket file
+     *
+     * @throw runtime_error if the socket cannot be created
+    */
+    ControlSocket(const std::string& path, Handler handler);
+
+    /* Disconnects clients and waits for the commands they are running */
+    ~ControlSocket();
+
+    ControlSocket(const ControlSocket&) = delete;
+    ControlSocket& operator= (const ControlSocket&) = delete;
+
+private:
+    struct Client {
+        /* -1 once serve() is done, its thread is joined on the next accept */
+        int fd;
+        std::thread thread;
+    };
+
+    const std::string path_;
+    const Handler handler_;
+    int listen_fd_;
+    bool closing_;
+
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Client>> clients_;
+
+    std::thread thread_;
+
+    void accept();
+    void serve(Client& client);
+
+    /* Moves the clients whose session ended to finished, called with mutex_ held */
+    void reap(std::vector<std::unique_ptr<Client>>& finished);
+};
+
+#endif
@@ -2,82 +2,99 @@
 #include <boost/program_options.hpp>
 #include <functional>
 #include <algorithm>
+#include <condition_variable>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "Scheduler.h"
 #include "TestTask.h"
 #include "Counter.h"
 #include "Fibonacci.h"
+#include "Registry.h"
+#include "Worker.h"
+#include "Status.h"
+#include "Trace.h"
+#include "ControlSocket.h"
 
 #define INVALID_TASK_ID -1
 
 namespace po = boost::program_options;
 using namespace std::chrono_literals;
 
-enum class TaskType
-{
-    test,
-    counter,
-    fibonacci
-};
+/* Task types started by name (or numeric id, their index) from the command line */
+using CliTasks = TaskRegistry<TestTask, Counter, Fibonacci>;
 
 static Scheduler scheduler;
-static std::unordered_map<int, int> task_id_to_type;
-
-const static std::unordered_map<int, std::string> task_type_to_str = {
-    {0, "test"},
-    {1, "counter"},
-    {2, "fibonacci"}
-};
 
-class TaskFactory {
+/* With --workers, tasks started by name run in worker processes */
+static std::unique_ptr<WorkerPool> workers;
 
-public:
+/* Where a command prints, and whether pause/stop return before they are acknowledged */
+struct Session {
+    std::ostream& out;
+    bool pipelined;
+    int fd;         // written directly by status once out is flushed, -1 to go through out
+};
 
-    Task& createTask(const TaskType task_type) {
+namespace CliCommands {
 
-        // Values are predefined
-        switch(task_type) {
-        case TaskType::test:
-            return scheduler.addTask<TestTask>(10ms);
-        case TaskType::counter:
-            return scheduler.addTask<Counter>(1e5);
-        case TaskType::fibonacci:
-            return scheduler.addTask<Fibonacci>(20);
-        default:
-            throw std::invalid_argument("Task type id: '" + std::to_string(static_cast<int>(task_type)) + "' not supported");
-        }
+int taskId(const std::vector<std::string>& args) {
+    if (args.empty()) {
+        return INVALID_TASK_ID;
     }
-};
+    try {
+        return std::stoi(args[0]);
+    }
+    catch(const std::exception& e) {
+        throw std::invalid_argument("Argument '" + args[0] + "' not an exisiting <task_id>");
+    }
+}
 
-namespace CliCommands {
+void print(Session& session, Task& task) {
+    session.out << " -> " << task << " task_type: " << task.type() << '\n';
+}
 
-void start(const int task_type_id) {
+void start(const std::vector<std::string>& args, Session& session) {
 
-    if (task_type_id == INVALID_TASK_ID) {
-        throw std::invalid_argument("parameter <task_type_id> not found");
+    if (args.empty()) {
+        throw std::invalid_argument("parameter <task_type> not found");
+    }
+    if (args.size() > 2) {
+        throw std::invalid_argument("Please introduce a task type followed by at most one argument");
     }
 
-    TaskFactory task_factory;    
-    const TaskType task_type = static_cast<TaskType>(task_type_id);
-    auto& task = task_factory.createTask(task_type);
-
-    task_id_to_type[task.id()] = task_type_id; 
-    std::cout << " -> " << task << " task_type: " << task_type_to_str.at(task_type_id) << std::endl;
+    const std::string argument = args.size() > 1 ? args[1] : std::string();
+    if (workers) {
+        print(session, workers->addTask(scheduler, args[0], argument));
+    }
+    else {
+        print(session, CliTasks::create(scheduler, args[0], argument));
+    }
 }
 
-void pause(const int task_id) {
+void pause(const std::vector<std::string>& args, Session& session) {
+    const int task_id = taskId(args);
 
     if (task_id == INVALID_TASK_ID) {
         throw std::invalid_argument("parameter <task_id> not found");
     }
 
     auto& task = scheduler.getTask(task_id);
-    task.pause();
+    if (session.pipelined) {
+        task.requestPause();
+    }
+    else {
+        task.pause();
+    }
 
-    std::cout << " -> " << task << " task_type: " << task_type_to_str.at(task_id_to_type.at(task.id())) << std::endl;
+    print(session, task);
 }
 
-void resume(const int task_id) {
+void resume(const std::vector<std::string>& args, Session& session) {
+    const int task_id = taskId(args);
 
     if (task_id == INVALID_TASK_ID) {
         throw std::invalid_argument("parameter <task_id> not found");
@@ -86,42 +103,184 @@ void resume(const int task_id) {
     auto& task = scheduler.getTask(task_id);
     task.resume();
 
-    std::cout << " -> " << task << " task_type: " << task_type_to_str.at(task_id_to_type.at(task.id())) << std::endl;
+    print(session, task);
 }
 
-void stop(const int task_id) {
+void stop(const std::vector<std::string>& args, Session& session) {
+    const int task_id = taskId(args);
 
     if (task_id == INVALID_TASK_ID) {
         throw std::invalid_argument("parameter <task_id> not found");
     }
 
     auto& task = scheduler.getTask(task_id);
-    task.stop();
+    if (session.pipelined) {
+        task.requestStop();
+    }
+    else {
+        task.stop();
+    }
 
-    std::cout << " -> " << task << " task_type: " << task_type_to_str.at(task_id_to_type.at(task.id())) << std::endl;
+    print(session, task);
 }
 
-void status(const int task_id) {
+void restart(const std::vector<std::string>& args, Session& session) {
+    const int task_id = taskId(args);
+
     if (task_id == INVALID_TASK_ID) {
-        /*
-        for(int task_id : scheduler.getTaskIds()) {
-            auto& task = scheduler.getTask(task_id);
+        throw std::invalid_argument("parameter <task_id> not found");
+    }
 
-            std::cout << " -> " << task << " task_type: " << task_type_to_str.at(task_id_to_type.at(task.id())) << std::endl;
-        }
-        return;
-        */
+    auto& task = scheduler.getTask(task_id);
+    scheduler.restartTask(task);
 
-        for(auto task_ref_wrapper : scheduler.getTasks()) {
-            auto& task = task_ref_wrapper.get();
-            std::cout << " -> " << task << " task_type: " << task_type_to_str.at(task_id_to_type.at(task.id())) << std::endl;
+    print(session, task);
+}
+
+/* status [<task_id>] [text|json|binary|count] [<state>...] [type=<task_type>] */
+void status(const std::vector<std::string>& args, Session& session) {
+    static const std::unordered_map<std::string, StatusFormat> formats = {
+        {"text", StatusFormat::text},
+        {"json", StatusFormat::ndjson},
+        {"binary", StatusFormat::binary},
+    };
+    static const std::unordered_map<std::string, Task::StateType> states = {
+        {"running", Task::StateType::running},
+        {"paused", Task::StateType::paused},
+        {"stopped", Task::StateType::stopped},
+        {"completed", Task::StateType::completed},
+        {"queued", Task::StateType::queued},
+        {"idle", Task::StateType::idle},
+        {"failed", Task::StateType::failed},
+    };
+
+    int task_id = INVALID_TASK_ID;
+    StatusFormat format = StatusFormat::text;
+    StatusFilter filter;
+    std::string type;
+    unsigned selected = 0;
+    bool count = false;
+    for (const std::string& arg : args) {
+        if (arg == "count") {
+            count = true;
+        }
+        else if (formats.count(arg)) {
+            format = formats.at(arg);
         }
+        else if (states.count(arg)) {
+            selected |= StatusFilter::bit(states.at(arg));
+        }
+        else if (arg.compare(0, 5, "type=") == 0) {
+            type = CliTasks::get(arg.substr(5)).name;
+        }
+        else {
+            task_id = taskId(std::vector<std::string>{arg});
+        }
+    }
+    if (selected) {
+        filter.states = selected;
+    }
+    if (!type.empty()) {
+        filter.type = type.c_str();
+    }
+
+    if (count) {
+        // From the scheduler's indexes, no task is visited
+        session.out << " -> " << scheduler.countTasks(filter.states, filter.type) << " tasks" << '\n';
         return;
     }
 
-    auto& task = scheduler.getTask(task_id);
+    // One writer per session thread, its buffer is reused by every status command
+    thread_local StatusWriter writer;
+    writer.setFormat(format);
+    if (task_id == INVALID_TASK_ID) {
+        writer.appendAll(scheduler, filter);
+    }
+    else {
+        writer.append(scheduler.getTask(task_id), filter);
+    }
+
+    if (session.fd >= 0) {
+        session.out.flush();
+        writer.writeTo(session.fd);
+    }
+    else {
+        session.out.write(writer.data().data(), static_cast<std::streamsize>(writer.data().size()));
+        writer.clear();
+    }
+}
+
+/* Poll intervals per task type and unresponsive tasks, with --watchdog */
+void watchdog(const std::vector<std::string>& args, Session& session) {
+    if (!args.empty()) {
+        throw std::invalid_argument("watchdog takes no parameter");
+    }
+    Watchdog* watchdog = scheduler.watchdog();
+    if (!watchdog) {
+        throw std::runtime_error("Watchdog not enabled, start with --watchdog <ms>");
+    }
+
+    for (const auto& item : watchdog->histograms()) {
+        const PollHistogram& histogram = item.second;
+        session.out << " -> Task type: " << (item.first.empty() ? "-" : item.first) << " polls: " << histogram.total()
+                    << " p50 < " << std::chrono::duration_cast<std::chrono::microseconds>(histogram.percentile(0.5)).count() << " us"
+                    << " p99 < " << std::chrono::duration_cast<std::chrono::microseconds>(histogram.percentile(0.99)).count() << " us" << '\n';
+    }
+    for (const int task_id : watchdog->unresponsive()) {
+        session.out << " -> Task id: '" << task_id << "' unresponsive for more than " << watchdog->threshold().count() << " ms" << '\n';
+    }
+}
+
+using CommandTable = std::unordered_map<std::string, std::function<void(const std::vector<std::string>&, Session&)>>;
+
+const CommandTable commands = {
+    {"start", start},
+    {"pause", pause},
+    {"resume", resume},
+    {"stop", stop},
+    {"restart", restart},
+    {"status", status},
+    {"watchdog", watchdog},
+};
+
+/* Runs one command line, false on quit */
+bool run(const std::string& line, Session& session) {
+    std::vector<std::string> tokens;
+    std::size_t begin = line.find_first_not_of(" \t\r");
+    while (begin != std::string::npos) {
+        const std::size_t end = line.find_first_of(" \t\r", begin);
+        tokens.push_back(line.substr(begin, end - begin));
+        begin = line.find_first_not_of(" \t\r", end);
+    }
+
+    if (std::find(tokens.begin(), tokens.end(), "quit") != tokens.end()) {
+        return false;
+    }
+
+    if (tokens.empty()) {
+        return true;
+    }
+
+    const std::string& command = tokens[0];
+    auto it = commands.find(command);
+    if (it == commands.end()) {
+        session.out << "Option '" << command << "' not supported" << '\n';
+        return true;
+    }
+
+    const std::vector<std::string> arguments(tokens.begin() + 1, tokens.end());
+    if (command != "start" && command != "status" && arguments.size() > 1) {
+        session.out << "Please introduce a valid command followed by and existing <task_id>" << '\n';
+        return true;
+    }
 
-    std::cout << " -> " << task << " task_type: " << task_type_to_str.at(task_id_to_type.at(task.id())) << std::endl;
+    try {
+        it->second(arguments, session);
+    }
+    catch (const std::exception& e) {
+        session.out << e.what() << '\n';
+    }
+    return true;
 }
 
 }
@@ -129,26 +288,39 @@ void status(const int task_id) {
 std::string getHelpMessage() {
     std::ostringstream message;
     message << "Allowed actions: " << std::endl
-            << "  start <task_type_id>  starts a task of a given type and and prints its ID." << std::endl
+            << "  start <task_type> [<argument>]" << std::endl
+            << "                        starts a task of a given type (name or ID) and prints its ID." << std::endl
             << "  pause <task_id>       pause the task with the given id and print a confirmation message." << std::endl
             << "  resume <task_id>      resume task with the given id (if paused) and print a confirmation message." << std::endl
             << "  stop <task_id>        stop the task with the given id (if not stopped) and print a confirmation message." << std::endl
+            << "  restart <task_id>     runs the completed or stopped task with the given id again, keeping its id." << std::endl
             << "  status                prints the id, the status, progress and task type ID for each task." << std::endl
             << "  status <task_id>      prints the id, the status, progress and task type ID for the task with the given id." << std::endl
-            << "  quit                  gracefully shut down." << std::endl;
+            << "  status [<task_id>] [text|json|binary] [<state>...] [type=<task_type>]" << std::endl
+            << "                        as above, as NDJSON or binary records, only tasks in the given states or of the given type." << std::endl
+            << "  status count [<state>...] [type=<task_type>]" << std::endl
+            << "                        prints the number of tasks in the given states or of the given type." << std::endl
+            << "  watchdog              with --watchdog, prints poll intervals per task type and unresponsive tasks." << std::endl
+            << "  quit                  gracefully shut down." << std::endl
+            << std::endl
+            << "With --batch or from the control socket, pause and stop return without waiting for the task." << std::endl;
 
             return message.str();
 }
 
 std::string getTaskTypesMessage() {
     std::ostringstream message;
-    message << "Task type  ID  Description" << std::endl
-            << "test       0   starts a dummy task that runs in an infinite loop." << std::endl
-            << "counter    1   starts a counter, the task stops when the count reaches a threshold." << std::endl
-            << "fibonacci  2   calculates fibonacci sequence." << std::endl
-            << std::endl << "Task parameters are predefined." << std::endl;
+    message << "ID  Task type  Argument (default)  Description" << std::endl;
+    for (std::size_t i = 0; i < CliTasks::size(); ++i) {
+        const TaskTypeInfo& type = CliTasks::at(i);
+        std::ostringstream argument;
+        argument << type.argument.name << " (" << type.argument.default_value << ")";
+        message << std::left << std::setw(4) << i << std::setw(11) << type.name << std::setw(20) << argument.str()
+                << type.argument.description << std::endl;
+    }
+    message << std::endl << "e.g. 'start fibonacci 35' or 'start 2 35', the default argument is used when omitted." << std::endl;
 
-            return message.str();
+    return message.str();
 }
 
 int main(int argc, char* argv[]) 
@@ -156,7 +328,18 @@ int main(int argc, char* argv[])
     po::options_description desc("Allowed options");
     desc.add_options()
     ("help", "prints help message and instructions")
-    ("task types", "prints supported task typed");
+    ("task types", "prints supported task typed")
+    ("trace", po::value<std::string>(), "writes task lifecycle events as Chrome trace-event JSON to the given file on quit (tasklib built with TASKLIB_TRACE)")
+    ("affinity", po::value<std::string>()->default_value("none"), "task thread placement: none, node (pinned per NUMA node) or core (pinned per core)")
+    ("max-running", po::value<std::size_t>(), "maximum number of started tasks, further tasks are queued")
+    ("max-running-type", po::value<std::vector<std::string>>()->composing(), "maximum number of started tasks of a type, as <task_type>=<limit>")
+    ("queue", po::value<std::size_t>(), "maximum number of queued tasks")
+    ("when-full", po::value<std::string>()->default_value("reject"), "when the queue is full: block, reject or caller (runs the task in the command loop)")
+    ("batch", po::value<std::string>(), "runs the commands of the given file (- for stdin) without prompt, then quits")
+    ("socket", po::value<std::string>(), "also accepts commands from clients of a Unix-domain socket created at the given path")
+    ("drain-timeout", po::value<long>()->default_value(5000), "on quit, milliseconds given to the tasks to acknowledge stop before they are reported as stragglers")
+    ("watchdog", po::value<long>(), "flags tasks that do not poll for commands for the given milliseconds, pause/resume/stop on them fail instead of waiting")
+    ("workers", po::value<std::size_t>(), "runs started tasks in the given number of worker processes, a crashing task fails alone and its worker is forked again");
 
     po::variables_map vm;
 
@@ -173,6 +356,71 @@ int main(int argc, char* argv[])
             std::cout << getTaskTypesMessage() << std::endl;
             return 0;  
         }
+
+        const std::unordered_map<std::string, AffinityPolicy> affinity_policies = {
+            {"none", AffinityPolicy::none},
+            {"node", AffinityPolicy::node},
+            {"core", AffinityPolicy::core},
+        };
+        const std::string affinity = vm["affinity"].as<std::string>();
+        if (affinity_policies.count(affinity) == 0) {
+            throw po::invalid_option_value(affinity);
+        }
+        scheduler.executor().setAffinityPolicy(affinity_policies.at(affinity));
+
+        const std::unordered_map<std::string, AdmissionPolicy> admission_policies = {
+            {"block", AdmissionPolicy::block},
+            {"reject", AdmissionPolicy::reject},
+            {"caller", AdmissionPolicy::callerRuns},
+        };
+        const std::string when_full = vm["when-full"].as<std::string>();
+        if (admission_policies.count(when_full) == 0) {
+            throw po::invalid_option_value(when_full);
+        }
+        const std::size_t queue = vm.count("queue") ? vm["queue"].as<std::size_t>() : std::numeric_limits<std::size_t>::max();
+        scheduler.setAdmissionQueue(queue, admission_policies.at(when_full));
+
+        if (vm.count("watchdog")) {
+            const long threshold = vm["watchdog"].as<long>();
+            if (threshold <= 0) {
+                throw po::invalid_option_value(std::to_string(threshold));
+            }
+            scheduler.enableWatchdog(std::chrono::milliseconds(threshold), std::chrono::milliseconds(std::max(threshold / 4, 1l)));
+        }
+
+        if (vm.count("workers")) {
+            const std::size_t size = vm["workers"].as<std::size_t>();
+            if (size == 0) {
+                throw po::invalid_option_value(std::to_string(size));
+            }
+            try {
+                // Forked before the command threads start
+                workers.reset(new WorkerPool(CliTasks(), size));
+            }
+            catch (const std::runtime_error& e) {
+                std::cerr << e.what() << std::endl;
+                return 1;
+            }
+        }
+
+        if (vm.count("max-running")) {
+            scheduler.setConcurrencyLimit(vm["max-running"].as<std::size_t>());
+        }
+
+        if (vm.count("max-running-type")) {
+            for (auto& limit : vm["max-running-type"].as<std::vector<std::string>>()) {
+                const std::size_t separator = limit.find('=');
+                if (separator == std::string::npos) {
+                    throw po::invalid_option_value(limit);
+                }
+                try {
+                    CliTasks::get(limit.substr(0, separator)).setConcurrencyLimit(scheduler, std::stoul(limit.substr(separator + 1)));
+                }
+                catch (const std::exception&) {
+                    throw po::invalid_option_value(limit);
+                }
+            }
+        }
     }
     catch (po::error &e)
     {
@@ -181,74 +429,107 @@ int main(int argc, char* argv[])
         return 0;
     }
 
-    using CommandTable = std::unordered_map<std::string, std::function<void(int)>>;
-    CommandTable commands;
-    commands["start"] = CliCommands::start;
-    commands["pause"] = CliCommands::pause;
-    commands["resume"] = CliCommands::resume;
-    commands["stop"] = CliCommands::stop;
-    commands["status"] = CliCommands::status;
-    
-    while (true) {
+    // Set by a quit from stdin, the batch or a socket client, the pipe interrupts reading stdin
+    std::mutex quit_mutex;
+    std::condition_variable quit_condition;
+    bool quit = false;
+    int quit_pipe[2];
+    if (pipe2(quit_pipe, O_CLOEXEC) < 0) {
+        std::cerr << "Cannot create pipe" << std::endl;
+        return 1;
+    }
+    auto requestQuit = [&]() {
+        std::unique_lock<std::mutex> lock(quit_mutex);
+        if (!quit) {
+            quit = true;
+            quit_condition.notify_all();
+            const char byte = 0;
+            (void)!write(quit_pipe[1], &byte, 1);
+        }
+    };
 
+    std::unique_ptr<ControlSocket> control_socket;
+    if (vm.count("socket")) {
         try {
+            control_socket.reset(new ControlSocket(vm["socket"].as<std::string>(), [&](const std::string& line, std::ostream& out) {
+                Session session{out, true, -1};
+                if (!CliCommands::run(line, session)) {
+                    requestQuit();
+                    return false;
+                }
+                return true;
+            }));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
 
-            std::string input;
-            std::cout << "> ";
-            getline(std::cin, input);
-              
-            std::istringstream iss(input);
-            std::vector<std::string> tokens;
-            std::string token;
-            while (std::getline(iss, token, ' ')) {
-                tokens.push_back(token);
-            }
-
-            auto it = std::find(tokens.begin(), tokens.end(), "quit");
-            if (it != tokens.end()) {
-                return 0;
-            }
-
-            if (tokens.empty()) { 
-                continue; 
-            }
-
-            std::string command = tokens[0];
-            if (commands.count(command) == 0) {
-                std::cout << "Option '" << command << "' not supported" << std::endl;
-                continue;
-            }
+    if (vm.count("batch")) {
+        const std::string path = vm["batch"].as<std::string>();
+        const int fd = path == "-" ? STDIN_FILENO : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            std::cerr << "Cannot open batch file '" << path << "'" << std::endl;
+            return 1;
+        }
 
-            int cmd_argument = INVALID_TASK_ID;
-            if (tokens.size() > 1) {
-                try{
-                    cmd_argument = std::stoi(tokens[1]);
+        LineReader reader(fd, quit_pipe[0]);
+        Session session{std::cout, true, STDOUT_FILENO};
+        std::string line;
+        while (reader.next(line) && CliCommands::run(line, session)) {
+        }
+        std::cout.flush();
+        if (fd != STDIN_FILENO) {
+            close(fd);
+        }
+        requestQuit();
+    }
+    else {
+        LineReader reader(STDIN_FILENO, quit_pipe[0]);
+        Session session{std::cout, false, STDOUT_FILENO};
+        std::string line;
+        while (true) {
+            std::cout << "> " << std::flush;
+            if (!reader.next(line)) {
+                // End of input, the control socket may still be in use
+                if (!control_socket) {
+                    requestQuit();
                 }
-                catch(const std::exception& e) {
-                    std::cout << "Argument '" << tokens[1] << "' not an exisiting <task_id>/<task_type_id>" << std::endl;
-                    continue;
-                }              
+                break;
             }
-
-            if (tokens.size() > 2) {
-                auto it = std::find_if(tokens.begin()+2, tokens.end(), [](const std::string& token){
-                    return token != "";
-                });
-                if (it != tokens.end()) {
-                    std::cout << "Please introduce a valid command followed by and existing <task_id>/<task_type_id>" << std::endl;
-                    continue;                    
-                }
+            if (!CliCommands::run(line, session)) {
+                requestQuit();
+                break;
             }
-            
-            auto& func = commands[command];
-            func(cmd_argument);
-
-        }   
-        catch (const std::exception& e) {
-            std::cout << e.what() << std::endl;
+            std::cout.flush();
         }
     }
 
-    return 0;
+    {
+        std::unique_lock<std::mutex> lock(quit_mutex);
+        quit_condition.wait(lock, [&]() {
+            return quit;
+        });
+    }
+    control_socket.reset();
 
-}
\ No newline at end of file
+    const ShutdownReport report = scheduler.shutdown(std::chrono::milliseconds(vm["drain-timeout"].as<long>()));
+    if (report.stragglers.empty()) {
+        workers.reset();
+    }
+    std::cout << " -> " << report.stopped << " tasks stopped in "
+              << std::chrono::duration_cast<std::chrono::milliseconds>(report.elapsed).count() << " ms" << std::endl;
+    for (const int task_id : report.stragglers) {
+        std::cout << " -> Task id: '" << task_id << "' did not stop before the deadline" << std::endl;
+    }
+
+    if (vm.count("trace")) {
+        Trace::dump(vm["trace"].as<std::string>());
+    }
+    if (!report.stragglers.empty()) {
+        // The scheduler would wait for them on destruction
+        std::_Exit(EXIT_FAILURE);
+    }
+    return 0;
+}
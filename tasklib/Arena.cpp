@@ -0,0 +1,195 @@
+#include "Arena.h"
+#include "StopException.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+struct ArenaBlock {
+    ArenaBlock* next;
+    std::size_t size;       // bytes of data following the header
+};
+
+namespace {
+
+constexpr std::size_t header_size = (sizeof(ArenaBlock) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+/* Blocks a thread keeps, and the depot keeps for every thread, beyond them blocks are freed */
+constexpr std::size_t thread_blocks = 64;
+constexpr std::size_t depot_blocks = 256;
+
+char* dataOf(ArenaBlock* block) {
+    return reinterpret_cast<char*>(block) + header_size;
+}
+
+ArenaBlock* newBlock(const std::size_t size) {
+    ArenaBlock* block = static_cast<ArenaBlock*>(::operator new(header_size + size));
+    block->next = nullptr;
+    block->size = size;
+    return block;
+}
+
+/* Regular blocks given back by threads that exited or had too many */
+class BlockDepot
+{
+public:
+    ArenaBlock* take() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ArenaBlock* block = free_;
+        if (block) {
+            free_ = block->next;
+            count_--;
+        }
+        return block;
+    }
+
+    /* Takes the block, or frees it when full */
+    void give(ArenaBlock* block) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (count_ < depot_blocks) {
+                block->next = free_;
+                free_ = block;
+                count_++;
+                return;
+            }
+        }
+        ::operator delete(block);
+    }
+
+private:
+    std::mutex mutex_;
+    ArenaBlock* free_ = nullptr;
+    std::size_t count_ = 0;
+};
+
+BlockDepot& depot() {
+    // Never destroyed, threads exiting late still give their blocks back
+    static BlockDepot* instance = new BlockDepot();
+    return *instance;
+}
+
+/* Regular blocks of one thread, no lock */
+class BlockCache
+{
+public:
+    ~BlockCache() {
+        while (free_) {
+            ArenaBlock* block = free_;
+            free_ = block->next;
+            depot().give(block);
+        }
+    }
+
+    ArenaBlock* take() {
+        ArenaBlock* block = free_;
+        if (block) {
+            free_ = block->next;
+            count_--;
+            return block;
+        }
+        block = depot().take();
+        return block ? block : newBlock(TaskArena::block_size);
+    }
+
+    void give(ArenaBlock* block) {
+        if (count_ >= thread_blocks) {
+            depot().give(block);
+            return;
+        }
+        block->next = free_;
+        free_ = block;
+        count_++;
+    }
+
+    std::size_t count() const { return count_; }
+
+private:
+    ArenaBlock* free_ = nullptr;
+    std::size_t count_ = 0;
+};
+
+BlockCache& cache() {
+    thread_local BlockCache instance;
+    return instance;
+}
+
+}
+
+constexpr std::size_t TaskArena::block_size;
+
+TaskArena::TaskArena()
+: blocks_(nullptr), large_(nullptr), cursor_(nullptr), end_(nullptr), limit_(0), used_(0), peak_(0), exceeded_(false)
+{}
+
+TaskArena::~TaskArena() {
+    release();
+}
+
+std::size_t TaskArena::cachedBlocks() {
+    return cache().count();
+}
+
+void* TaskArena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    alignment = std::max<std::size_t>(alignment, 1);
+    const std::uintptr_t cursor = reinterpret_cast<std::uintptr_t>(cursor_);
+    const std::size_t padding = cursor_ ? (alignment - cursor % alignment) % alignment : 0;
+    const bool fits = cursor_ && padding + bytes <= static_cast<std::size_t>(end_ - cursor_);
+    const bool large = !fits && bytes > block_size / 4;
+
+    // Charged with what the allocation really takes
+    std::size_t cost = bytes + padding;
+    if (!fits) {
+        cost = bytes + alignment - 1;
+    }
+    const std::size_t used = used_.load(std::memory_order_relaxed) + cost;
+    if (limit_ && used > limit_) {
+        exceeded_.store(true, std::memory_order_relaxed);
+        throw StopException("memory limit exceeded");
+    }
+
+    char* result;
+    if (fits) {
+        result = cursor_ + padding;
+        cursor_ = result + bytes;
+    }
+    else if (large) {
+        ArenaBlock* block = newBlock(bytes + alignment - 1);
+        block->next = large_;
+        large_ = block;
+        const std::uintptr_t data = reinterpret_cast<std::uintptr_t>(dataOf(block));
+        result = dataOf(block) + (alignment - data % alignment) % alignment;
+    }
+    else {
+        ArenaBlock* block = cache().take();
+        block->next = blocks_;
+        blocks_ = block;
+        const std::uintptr_t data = reinterpret_cast<std::uintptr_t>(dataOf(block));
+        result = dataOf(block) + (alignment - data % alignment) % alignment;
+        cursor_ = result + bytes;
+        end_ = dataOf(block) + block->size;
+    }
+
+    used_.store(used, std::memory_order_relaxed);
+    if (used > peak_.load(std::memory_order_relaxed)) {
+        peak_.store(used, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+void TaskArena::release() {
+    BlockCache& blocks = cache();
+    while (blocks_) {
+        ArenaBlock* block = blocks_;
+        blocks_ = block->next;
+        blocks.give(block);
+    }
+    while (large_) {
+        ArenaBlock* block = large_;
+        large_ = block->next;
+        ::operator delete(block);
+    }
+    cursor_ = nullptr;
+    end_ = nullptr;
+    used_.store(0, std::memory_order_relaxed);
+}
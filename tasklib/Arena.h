@@ -0,0 +1,79 @@
+#ifndef ARENA
+#define ARENA
+
+#include <atomic>
+#include <cstddef>
+#include <experimental/memory_resource>
+
+struct ArenaBlock;
+
+/**
+ * Bump allocator for the scratch memory of a running task, see Task::arena()
+ *
+ * Memory is carved out of blocks of block_size taken from a cache of the calling thread, refilled from
+ * a process-wide depot; allocations larger than a quarter of a block get a block of their own.
+ * deallocate() does nothing: the whole arena is released when execute() returns, completed, stopped
+ * (StopException unwinding included) or failed, and its blocks go back to the cache of the thread, to
+ * be reused by the next task it runs. Memory from the arena must not outlive execute().
+ *
+ * Allocation and release belong to the inner thread, used() and peak() can be read from any thread.
+*/
+class TaskArena : public std::experimental::pmr::memory_resource
+{
+public:
+    static constexpr std::size_t block_size = 64 << 10;
+
+    TaskArena();
+
+    /* Releases what is left */
+    ~TaskArena();
+
+    TaskArena(const TaskArena&) = delete;
+    TaskArena& operator= (const TaskArena&) = delete;
+
+    /* Bytes handed out since the last release, alignment padding included */
+    std::size_t used() const { return used_.load(std::memory_order_relaxed); }
+
+    /* Highest used() over every run */
+    std::size_t peak() const { return peak_.load(std::memory_order_relaxed); }
+
+    /**
+     * Bytes used() may reach, 0 for no limit. An allocation over it throws StopException, which stops
+     * the task when it reaches callbackFuntion(). Set before start()
+    */
+    void setLimit(const std::size_t bytes) { limit_ = bytes; }
+    std::size_t limit() const { return limit_; }
+
+    /* Whether an allocation was ever refused for the limit */
+    bool limitExceeded() const { return exceeded_.load(std::memory_order_relaxed); }
+
+    /* Gives every block back to the calling thread's cache, used() drops to 0 */
+    void release();
+
+    /* Blocks cached by the calling thread */
+    static std::size_t cachedBlocks();
+
+protected:
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+
+    /* Released wholesale */
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+
+    bool do_is_equal(const std::experimental::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+private:
+    /* Regular blocks, current first, then the ones of large allocations */
+    ArenaBlock* blocks_;
+    ArenaBlock* large_;
+    char* cursor_;
+    char* end_;
+    std::size_t limit_;
+
+    std::atomic<std::size_t> used_;
+    std::atomic<std::size_t> peak_;
+    std::atomic<bool> exceeded_;
+};
+
+#endif
@@ -0,0 +1,522 @@
+#include "BigInt.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "ThreadPool.h"
+
+namespace {
+
+using Limb = BigInt::Limb;
+using Wide = std::uint64_t;
+
+/* Below this many limbs in the shorter operand, schoolbook is faster than Karatsuba */
+constexpr std::size_t karatsuba_limbs = 40;
+/* Products at least this large poll, or hold and check for cancellation on helpers */
+constexpr std::size_t poll_limbs = 1024;
+/* Products at least this large are split across threads */
+constexpr std::size_t parallel_limbs = 4096;
+/* Values below 10^(9 * 2^decimal_levels), about 60 limbs, are converted by repeated division by 10^9 */
+constexpr std::size_t decimal_levels = 6;
+/* Reciprocals of divisors up to this many limbs are computed by Newton steps at full precision */
+constexpr std::size_t reciprocal_limbs = 16;
+
+/* Thrown on helper threads once the product is abandoned */
+struct Cancelled {};
+
+struct Multiplication {
+    const MultiplyOptions& options;
+    std::atomic<bool> cancelled;
+};
+
+/* r[0, na + nb) = a * b */
+void multiplySchoolbook(const Limb* a, const std::size_t na, const Limb* b, const std::size_t nb, Limb* r) {
+    std::fill(r, r + na + nb, 0);
+    for (std::size_t i = 0; i < nb; ++i) {
+        const Wide digit = b[i];
+        if (!digit) {
+            continue;
+        }
+        Wide carry = 0;
+        for (std::size_t j = 0; j < na; ++j) {
+            const Wide t = static_cast<Wide>(a[j]) * digit + r[i + j] + carry;
+            r[i + j] = static_cast<Limb>(t);
+            carry = t >> 32;
+        }
+        r[i + na] = static_cast<Limb>(carry);
+    }
+}
+
+/* r[0, n) += b[0, nb), nb <= n, returns the carry out of r */
+Limb addInto(Limb* r, const std::size_t n, const Limb* b, const std::size_t nb) {
+    Wide carry = 0;
+    std::size_t i = 0;
+    for (; i < nb; ++i) {
+        const Wide t = static_cast<Wide>(r[i]) + b[i] + carry;
+        r[i] = static_cast<Limb>(t);
+        carry = t >> 32;
+    }
+    for (; carry && i < n; ++i) {
+        const Wide t = static_cast<Wide>(r[i]) + carry;
+        r[i] = static_cast<Limb>(t);
+        carry = t >> 32;
+    }
+    return static_cast<Limb>(carry);
+}
+
+/* r[0, n) -= b[0, nb), r >= b */
+void subtractInto(Limb* r, const std::size_t n, const Limb* b, const std::size_t nb) {
+    Wide borrow = 0;
+    std::size_t i = 0;
+    for (; i < nb; ++i) {
+        const Wide t = static_cast<Wide>(r[i]) - b[i] - borrow;
+        r[i] = static_cast<Limb>(t);
+        borrow = (t >> 32) & 1;
+    }
+    for (; borrow && i < n; ++i) {
+        const Wide t = static_cast<Wide>(r[i]) - borrow;
+        r[i] = static_cast<Limb>(t);
+        borrow = (t >> 32) & 1;
+    }
+}
+
+std::size_t significant(const Limb* a, std::size_t n) {
+    while (n && !a[n - 1]) {
+        --n;
+    }
+    return n;
+}
+
+void multiply(const Limb* a, std::size_t na, const Limb* b, std::size_t nb, Limb* r, Multiplication& product,
+              const bool caller, const unsigned threads);
+
+/* Runs body on the product's pool or a thread of its own, waited for (and abandoned if the caller throws) by the destructor */
+class Helper
+{
+public:
+    template<class Body>
+    Helper(Multiplication& product, Body body)
+    : product_(product), done_(false), joined_(false)
+    {
+        auto run = [this, body]() {
+            Executor::bind(product_.options.placement);
+            try {
+                body();
+            }
+            catch (const Cancelled&) {
+            }
+            catch (...) {
+                error_ = std::current_exception();
+            }
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_ = true;
+            condition_.notify_all();
+        };
+        if (product_.options.pool) {
+            product_.options.pool->submit(std::move(run));
+        }
+        else {
+            thread_ = std::thread(std::move(run));
+        }
+    }
+
+    ~Helper() {
+        if (!joined_) {
+            product_.cancelled = true;
+            wait();
+        }
+    }
+
+    /* Waits for body, rethrows what it threw */
+    void join() {
+        joined_ = true;
+        wait();
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+private:
+    Multiplication& product_;
+    std::exception_ptr error_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool done_;
+    bool joined_;
+    std::thread thread_;
+
+    void wait() {
+        {
+            // The caller may be a worker of the same pool
+            BlockingRegion blocking;
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [&]() {
+                return done_;
+            });
+        }
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+};
+
+void multiply(const Limb* a, std::size_t na, const Limb* b, std::size_t nb, Limb* r, Multiplication& product,
+              const bool caller, const unsigned threads) {
+    const std::size_t n = na + nb;
+    if (na < nb) {
+        std::swap(a, b);
+        std::swap(na, nb);
+    }
+    if (nb == 0) {
+        std::fill(r, r + n, 0);
+        return;
+    }
+    if (nb < karatsuba_limbs) {
+        multiplySchoolbook(a, na, b, nb, r);
+        return;
+    }
+
+    if (nb >= poll_limbs) {
+        if (!caller) {
+            if (product.cancelled.load(std::memory_order_relaxed)) {
+                throw Cancelled();
+            }
+            if (product.options.hold) {
+                product.options.hold();
+            }
+        }
+        else if (product.options.poll) {
+            product.options.poll();
+        }
+    }
+
+    if (na >= 2 * nb) {
+        // Unbalanced: slices of a as long as b
+        std::fill(r, r + n, 0);
+        std::vector<Limb> slice(2 * nb);
+        for (std::size_t offset = 0; offset < na; offset += nb) {
+            const std::size_t size = std::min(nb, na - offset);
+            multiply(a + offset, size, b, nb, slice.data(), product, caller, threads);
+            addInto(r + offset, n - offset, slice.data(), size + nb);
+        }
+        return;
+    }
+
+    // a = a1 B^m + a0, b = b1 B^m + b0, nb >= m
+    const std::size_t m = (na + 1) / 2;
+    const Limb* a0 = a;
+    const Limb* a1 = a + m;
+    const Limb* b0 = b;
+    const Limb* b1 = b + m;
+    const std::size_t na1 = na - m;
+    const std::size_t nb1 = nb - m;
+
+    std::vector<Limb> sums(2 * (m + 1));
+    Limb* sa = sums.data();
+    Limb* sb = sums.data() + m + 1;
+    std::copy(a0, a0 + m, sa);
+    sa[m] = addInto(sa, m, a1, na1);
+    std::copy(b0, b0 + m, sb);
+    sb[m] = addInto(sb, m, b1, nb1);
+    const std::size_t nsa = significant(sa, m + 1);
+    const std::size_t nsb = significant(sb, m + 1);
+
+    // z0 = a0 b0 and z2 = a1 b1 in place, z1 = (a0 + a1)(b0 + b1)
+    std::vector<Limb> z1(nsa + nsb);
+    if (threads > 1 && nb >= parallel_limbs) {
+        const unsigned share = std::max(1u, threads / 3);
+        Helper low(product, [&]() {
+            multiply(a0, m, b0, m, r, product, false, share);
+        });
+        std::unique_ptr<Helper> high;
+        if (threads > 2) {
+            high.reset(new Helper(product, [&]() {
+                multiply(a1, na1, b1, nb1, r + 2 * m, product, false, share);
+            }));
+        }
+        else {
+            multiply(a1, na1, b1, nb1, r + 2 * m, product, caller, 1);
+        }
+        multiply(sa, nsa, sb, nsb, z1.data(), product, caller, share);
+        low.join();
+        if (high) {
+            high->join();
+        }
+    }
+    else {
+        multiply(a0, m, b0, m, r, product, caller, threads);
+        multiply(a1, na1, b1, nb1, r + 2 * m, product, caller, threads);
+        multiply(sa, nsa, sb, nsb, z1.data(), product, caller, threads);
+    }
+
+    subtractInto(z1.data(), z1.size(), r, significant(r, 2 * m));
+    subtractInto(z1.data(), z1.size(), r + 2 * m, significant(r + 2 * m, n - 2 * m));
+    addInto(r + m, n - m, z1.data(), significant(z1.data(), z1.size()));
+}
+
+}
+
+BigInt::BigInt(const std::uint64_t value) {
+    if (value) {
+        limbs_.push_back(static_cast<Limb>(value));
+        if (value >> 32) {
+            limbs_.push_back(static_cast<Limb>(value >> 32));
+        }
+    }
+}
+
+void BigInt::trim() {
+    while (!limbs_.empty() && !limbs_.back()) {
+        limbs_.pop_back();
+    }
+}
+
+std::size_t BigInt::bits() const {
+    if (limbs_.empty()) {
+        return 0;
+    }
+    std::size_t bits = (limbs_.size() - 1) * 32;
+    for (Limb top = limbs_.back(); top; top >>= 1) {
+        ++bits;
+    }
+    return bits;
+}
+
+int BigInt::compare(const BigInt& lhs, const BigInt& rhs) {
+    if (lhs.limbs_.size() != rhs.limbs_.size()) {
+        return lhs.limbs_.size() < rhs.limbs_.size() ? -1 : 1;
+    }
+    for (std::size_t i = lhs.limbs_.size(); i-- > 0;) {
+        if (lhs.limbs_[i] != rhs.limbs_[i]) {
+            return lhs.limbs_[i] < rhs.limbs_[i] ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+BigInt& BigInt::operator+= (const BigInt& other) {
+    if (limbs_.size() < other.limbs_.size()) {
+        limbs_.resize(other.limbs_.size(), 0);
+    }
+    const Limb carry = addInto(limbs_.data(), limbs_.size(), other.limbs_.data(), other.limbs_.size());
+    if (carry) {
+        limbs_.push_back(carry);
+    }
+    return *this;
+}
+
+BigInt& BigInt::operator-= (const BigInt& other) {
+    if (compare(*this, other) < 0) {
+        throw std::invalid_argument("Cannot subtract, negative result");
+    }
+    subtractInto(limbs_.data(), limbs_.size(), other.limbs_.data(), other.limbs_.size());
+    trim();
+    return *this;
+}
+
+BigInt& BigInt::operator<<= (const std::size_t shift) {
+    if (limbs_.empty()) {
+        return *this;
+    }
+    const std::size_t whole = shift / 32;
+    const unsigned part = static_cast<unsigned>(shift % 32);
+    if (part) {
+        Limb carry = 0;
+        for (Limb& limb : limbs_) {
+            const Limb next = limb >> (32 - part);
+            limb = (limb << part) | carry;
+            carry = next;
+        }
+        if (carry) {
+            limbs_.push_back(carry);
+        }
+    }
+    limbs_.insert(limbs_.begin(), whole, 0);
+    return *this;
+}
+
+BigInt& BigInt::operator>>= (const std::size_t shift) {
+    const std::size_t whole = shift / 32;
+    if (whole >= limbs_.size()) {
+        limbs_.clear();
+        return *this;
+    }
+    limbs_.erase(limbs_.begin(), limbs_.begin() + static_cast<std::ptrdiff_t>(whole));
+    const unsigned part = static_cast<unsigned>(shift % 32);
+    if (part) {
+        for (std::size_t i = 0; i + 1 < limbs_.size(); ++i) {
+            limbs_[i] = (limbs_[i] >> part) | (limbs_[i + 1] << (32 - part));
+        }
+        limbs_.back() >>= part;
+        trim();
+    }
+    return *this;
+}
+
+BigInt BigInt::multiply(const BigInt& lhs, const BigInt& rhs, const MultiplyOptions& options) {
+    BigInt result;
+    if (lhs.isZero() || rhs.isZero()) {
+        return result;
+    }
+    result.limbs_.resize(lhs.limbs_.size() + rhs.limbs_.size());
+    Multiplication product{options, {false}};
+    ::multiply(lhs.limbs_.data(), lhs.limbs_.size(), rhs.limbs_.data(), rhs.limbs_.size(), result.limbs_.data(),
+               product, true, std::max(1u, options.threads));
+    result.trim();
+    return result;
+}
+
+namespace {
+
+/* floor(B^(2n) / d) for d of n >= 2 limbs, B = 2^32 */
+BigInt reciprocal(const BigInt& d) {
+    const std::size_t n = d.limbs().size();
+    BigInt scale(1);
+    scale <<= 64 * n;
+
+    // Every estimate stays at or below the reciprocal, Newton steps approach it from below
+    BigInt x;
+    if (n <= reciprocal_limbs) {
+        // 32 bits from the two top limbs, then steps at full precision till they stop moving
+        const Wide top = (static_cast<Wide>(d.limbs()[n - 1]) << 32) | d.limbs()[n - 2];
+        x = BigInt(top == ~Wide(0) ? 1 : ~Wide(0) / (top + 1));
+        x <<= 32 * n;
+        for (;;) {
+            BigInt step = x * (scale - d * x);
+            step >>= 64 * n;
+            if (step.isZero()) {
+                break;
+            }
+            x += step;
+        }
+    }
+    else {
+        // The reciprocal of the top h limbs, lowered by B^2 to stay below, is right to about h - 2 limbs,
+        // a single step doubles that past n
+        const std::size_t h = (n + 1) / 2 + 3;
+        BigInt top = d;
+        top >>= 32 * (n - h);
+        x = reciprocal(top);
+        BigInt slack(1);
+        slack <<= 64;
+        x -= slack;
+        x <<= 32 * (n - h);
+
+        BigInt step = x * (scale - d * x);
+        step >>= 64 * n;
+        x += step;
+    }
+
+    // A few units left
+    BigInt remainder = scale - d * x;
+    while (BigInt::compare(remainder, d) >= 0) {
+        remainder -= d;
+        x += BigInt(1);
+    }
+    return x;
+}
+
+/* Writes the value of limbs as width digits, zero padded, width a multiple of 9 large enough */
+void writeGroups(std::vector<Limb> quotient, char* out, const std::size_t width) {
+    constexpr Wide group = 1000000000;
+    char* end = out + width;
+    std::size_t size = significant(quotient.data(), quotient.size());
+    while (size) {
+        Wide remainder = 0;
+        for (std::size_t i = size; i-- > 0;) {
+            const Wide current = (remainder << 32) | quotient[i];
+            quotient[i] = static_cast<Limb>(current / group);
+            remainder = current % group;
+        }
+        for (int j = 0; j < 9; ++j) {
+            *--end = static_cast<char>('0' + remainder % 10);
+            remainder /= 10;
+        }
+        size = significant(quotient.data(), size);
+    }
+    std::fill(out, end, '0');
+}
+
+/* Powers 10^(9 * 2^k) by k, with their reciprocals from decimal_levels on */
+struct DecimalPowers {
+    std::vector<BigInt> values;
+    std::vector<BigInt> reciprocals;
+};
+
+/* Writes value, below 10^(9 * 2^level), as 9 * 2^level digits */
+void writeDecimal(const BigInt& value, const DecimalPowers& powers, const std::size_t level, char* out) {
+    const std::size_t width = static_cast<std::size_t>(9) << level;
+    if (level <= decimal_levels) {
+        writeGroups(value.limbs(), out, width);
+        return;
+    }
+
+    // value = high d + low, high estimated from the top m + 1 of the 2m limbs of value is at most 3 below
+    const BigInt& d = powers.values[level - 1];
+    const std::size_t m = d.limbs().size();
+    BigInt high = value;
+    high >>= 32 * (m - 1);
+    high = high * powers.reciprocals[level - 1];
+    high >>= 32 * (m + 1);
+    BigInt low = value - high * d;
+    while (BigInt::compare(low, d) >= 0) {
+        low -= d;
+        high += BigInt(1);
+    }
+
+    writeDecimal(high, powers, level - 1, out);
+    writeDecimal(low, powers, level - 1, out + width / 2);
+}
+
+}
+
+std::string BigInt::toDecimal() const {
+    if (limbs_.empty()) {
+        return "0";
+    }
+
+    // Smallest level whose power exceeds the value, a square surely larger than the value is not computed
+    DecimalPowers powers;
+    powers.values.push_back(BigInt(1000000000));
+    std::size_t level = 0;
+    while (compare(powers.values.back(), *this) <= 0) {
+        const BigInt& last = powers.values.back();
+        level = powers.values.size();
+        if (2 * last.bits() - 1 > bits()) {
+            break;
+        }
+        powers.values.push_back(last * last);
+    }
+    powers.reciprocals.resize(level);
+    for (std::size_t k = decimal_levels; k < level; ++k) {
+        powers.reciprocals[k] = reciprocal(powers.values[k]);
+    }
+
+    std::string digits(static_cast<std::size_t>(9) << level, '0');
+    writeDecimal(*this, powers, level, &digits[0]);
+    digits.erase(0, std::min(digits.find_first_not_of('0'), digits.size() - 1));
+    return digits;
+}
+
+std::string BigInt::toBinary() const {
+    if (limbs_.empty()) {
+        return std::string(1, '\0');
+    }
+    std::string bytes;
+    bytes.reserve(limbs_.size() * 4);
+    for (std::size_t i = limbs_.size(); i-- > 0;) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            const char byte = static_cast<char>((limbs_[i] >> shift) & 0xff);
+            if (!bytes.empty() || byte) {
+                bytes += byte;
+            }
+        }
+    }
+    return bytes;
+}
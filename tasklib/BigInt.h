@@ -0,0 +1,99 @@
+#ifndef BIG_INT
+#define BIG_INT
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Executor.h"
+
+class ThreadPool;
+
+/* How a long multiplication runs, see BigInt::multiply */
+struct MultiplyOptions {
+    /* Called on the calling thread between parts of a long product, may throw to abandon it */
+    std::function<void()> poll;
+    /* Called on the helpers between parts of a long product, may block while the caller is paused or throw to abandon it */
+    std::function<void()> hold;
+    /* Threads a long product is split across, the calling one included */
+    unsigned threads = 1;
+    /* Where the helpers run, as the calling task's thread */
+    Placement placement;
+    /* Pool the helpers run on as jobs, a thread each if nullptr */
+    ThreadPool* pool = nullptr;
+};
+
+/**
+ * Non-negative integer of arbitrary size, 32-bit limbs, least significant first.
+ *
+ * Products use Karatsuba above a few dozen limbs. Large enough products are split across threads:
+ * the three half-size products of the top Karatsuba levels run at the same time, so no work is added.
+ * The helpers computing them are jobs of MultiplyOptions::pool when given, threads of their own
+ * otherwise; at most options.threads - 1 run at once.
+*/
+class BigInt
+{
+public:
+    using Limb = std::uint32_t;
+
+    BigInt() = default;
+    BigInt(const std::uint64_t value);
+
+    bool isZero() const { return limbs_.empty(); }
+
+    /* Number of significant bits, 0 for zero */
+    std::size_t bits() const;
+
+    const std::vector<Limb>& limbs() const { return limbs_; }
+
+    BigInt& operator+= (const BigInt& other);
+
+    /**
+     * @throw invalid_argument if other is greater, the value is left unchanged
+    */
+    BigInt& operator-= (const BigInt& other);
+
+    BigInt& operator<<= (const std::size_t shift);
+    BigInt& operator>>= (const std::size_t shift);
+
+    friend BigInt operator+ (BigInt lhs, const BigInt& rhs) { return lhs += rhs; }
+    friend BigInt operator- (BigInt lhs, const BigInt& rhs) { return lhs -= rhs; }
+    friend BigInt operator* (const BigInt& lhs, const BigInt& rhs) { return multiply(lhs, rhs); }
+
+    friend bool operator== (const BigInt& lhs, const BigInt& rhs) { return lhs.limbs_ == rhs.limbs_; }
+    friend bool operator!= (const BigInt& lhs, const BigInt& rhs) { return lhs.limbs_ != rhs.limbs_; }
+    friend bool operator< (const BigInt& lhs, const BigInt& rhs) { return compare(lhs, rhs) < 0; }
+
+    /* -1, 0 or 1 as lhs is less than, equal to or greater than rhs */
+    static int compare(const BigInt& lhs, const BigInt& rhs);
+
+    /**
+     * lhs * rhs, split across options.threads above a size where it pays off
+     *
+     * @throw what options.poll or options.hold throws, once the helpers are done
+    */
+    static BigInt multiply(const BigInt& lhs, const BigInt& rhs, const MultiplyOptions& options = MultiplyOptions());
+
+    /**
+     * Base 10 digits
+     * Divide and conquer: the value is split in halves by 10^(9 * 2^k), dividing by a reciprocal computed
+     * once per k, so the cost is a few products of the size. Parts of a few dozen limbs are converted by
+     * repeated division by 10^9.
+    */
+    std::string toDecimal() const;
+
+    /* Big-endian bytes of the value without leading zero bytes, a single zero byte for zero */
+    std::string toBinary() const;
+
+    friend std::ostream& operator<< (std::ostream& os, const BigInt& value) { return os << value.toDecimal(); }
+
+private:
+    std::vector<Limb> limbs_;
+
+    void trim();
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "Budget.h"
+
+#include <algorithm>
+#include <time.h>
+
+/* --- TOKEN BUCKET --- */
+
+void TokenBucket::configure(const double rate, const double capacity, const Clock::time_point now) {
+    rate_ = rate;
+    capacity_ = capacity;
+    tokens_ = capacity;
+    last_ = now;
+}
+
+std::chrono::nanoseconds TokenBucket::take(const double amount, const Clock::time_point now) {
+    if (rate_ <= 0.0) {
+        return std::chrono::nanoseconds(0);
+    }
+
+    const double elapsed = std::chrono::duration<double>(now - last_).count();
+    last_ = now;
+    tokens_ = std::min(capacity_, tokens_ + rate_ * std::max(elapsed, 0.0)) - amount;
+    if (tokens_ >= 0.0) {
+        return std::chrono::nanoseconds(0);
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::duration<double>(-tokens_ / rate_));
+}
+
+/* --- BUDGET --- */
+
+void Budget::setLimits(const BudgetLimits& limits) {
+    const auto now = TokenBucket::Clock::now();
+    const double burst = std::chrono::duration<double>(limits.burst).count();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    limits_ = limits;
+    limited_ = limits.limited();
+    limits_cpu_.store(limits.cpu > 0.0, std::memory_order_relaxed);
+    // Cpu tokens are seconds of cpu time, at least one poll fits in the burst
+    cpu_.configure(std::max(limits.cpu, 0.0), std::max(limits.cpu, 0.0) * burst, now);
+    polls_.configure(std::max(limits.rate, 0.0), std::max(limits.rate * burst, 1.0), now);
+}
+
+BudgetLimits Budget::limits() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return limits_;
+}
+
+std::chrono::nanoseconds Budget::charge(const std::chrono::nanoseconds cpu, const unsigned polls) {
+    const auto now = TokenBucket::Clock::now();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!limited_) {
+        return std::chrono::nanoseconds(0);
+    }
+    return std::max(cpu_.take(std::chrono::duration<double>(cpu).count(), now), polls_.take(polls, now));
+}
+
+/* --- TASK BUDGET --- */
+
+std::chrono::nanoseconds TaskBudget::threadCpu() {
+    timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+void TaskBudget::begin() {
+    last_cpu_ = threadCpu();
+    armed_ = true;
+}
+
+std::chrono::nanoseconds TaskBudget::poll() {
+    Budget* type = this->type();
+    // The thread cpu clock is a system call, only read when a cpu limit needs it
+    const bool cpu_limited = own_.limitsCpu() || (type && type->limitsCpu());
+    std::chrono::nanoseconds used(0);
+    if (cpu_limited) {
+        const std::chrono::nanoseconds now = threadCpu();
+        if (armed_) {
+            used = now - last_cpu_;
+        }
+        last_cpu_ = now;
+        armed_ = true;
+    }
+    else {
+        // Counted again from the next poll once a cpu limit is set
+        armed_ = false;
+    }
+
+    std::chrono::nanoseconds wait = own_.charge(used, 1);
+    if (type) {
+        wait = std::max(wait, type->charge(used, 1));
+    }
+    return wait;
+}
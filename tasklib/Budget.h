@@ -0,0 +1,102 @@
+#ifndef BUDGET
+#define BUDGET
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+/* Limits of a task or of a task type, 0 for no limit */
+struct BudgetLimits {
+    /* Share of a core the cpu time may reach, 0.2 for 20% */
+    double cpu = 0.0;
+    /* checkCommand() per second */
+    double rate = 0.0;
+    /* Run at full speed allowed before the limits apply, sizes the buckets */
+    std::chrono::milliseconds burst{100};
+
+    bool limited() const { return cpu > 0.0 || rate > 0.0; }
+};
+
+/* Tokens refilled at rate per second up to capacity, taken into debt rather than refused */
+class TokenBucket
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /* rate 0 for a bucket that never runs dry. Starts full */
+    void configure(const double rate, const double capacity, const Clock::time_point now);
+
+    /* Takes amount tokens, returns how long till the bucket is out of debt, 0 if it is not in debt */
+    std::chrono::nanoseconds take(const double amount, const Clock::time_point now);
+
+    double tokens() const { return tokens_; }
+
+private:
+    double rate_ = 0.0;
+    double capacity_ = 0.0;
+    double tokens_ = 0.0;
+    Clock::time_point last_;
+};
+
+/* Cpu time and poll buckets of a task or of a task type, see Scheduler::setBudget */
+class Budget
+{
+public:
+    /* Replaces the limits, refills the buckets */
+    void setLimits(const BudgetLimits& limits);
+
+    BudgetLimits limits() const;
+
+    /* Whether charges need the cpu time, read by the inner threads at every poll */
+    bool limitsCpu() const { return limits_cpu_.load(std::memory_order_relaxed); }
+
+    /* Charges cpu time and polls, returns how long till both buckets are out of debt */
+    std::chrono::nanoseconds charge(const std::chrono::nanoseconds cpu, const unsigned polls);
+
+private:
+    mutable std::mutex mutex_;
+    BudgetLimits limits_;
+    bool limited_ = false;
+    std::atomic<bool> limits_cpu_{false};
+    TokenBucket cpu_;
+    TokenBucket polls_;
+};
+
+/**
+ * Budgets a task is charged against at every checkCommand(): its own and the one of its type, shared
+ * with the other tasks of the type. Cpu time is taken from the clock of the inner thread, so time spent
+ * blocked or preempted is free. Owned by the scheduler, which outlives the task
+*/
+class TaskBudget
+{
+public:
+    TaskBudget() : type_(nullptr), armed_(false), last_cpu_(0) {}
+
+    TaskBudget(const TaskBudget&) = delete;
+    TaskBudget& operator= (const TaskBudget&) = delete;
+
+    Budget& own() { return own_; }
+
+    /* Budget of the task type, nullptr for none */
+    void setType(Budget* type) { type_.store(type, std::memory_order_release); }
+    Budget* type() const { return type_.load(std::memory_order_acquire); }
+
+    /* Inner thread, when it starts executing: cpu time is counted from now */
+    void begin();
+
+    /* Inner thread, at every checkCommand(): charges what was used since the last poll, returns the wait */
+    std::chrono::nanoseconds poll();
+
+private:
+    Budget own_;
+    std::atomic<Budget*> type_;
+
+    /* inner thread only */
+    bool armed_;
+    std::chrono::nanoseconds last_cpu_;
+
+    /* Cpu time of the calling thread */
+    static std::chrono::nanoseconds threadCpu();
+};
+
+#endif
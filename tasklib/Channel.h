@@ -0,0 +1,534 @@
+#ifndef CHANNEL
+#define CHANNEL
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Task.h"
+
+/**
+ * Bounded queues and blocking channels to stream values between tasks.
+ *
+ * The queues are lock-free and never block. A Channel wraps one of them: a task blocked on a
+ * full or empty channel is parked like a paused task (Task::park), it does not spin and still
+ * honours pause/stop. Batch operations move several values per index update and wake the
+ * other side once.
+*/
+
+/* Smallest power of two not below capacity */
+inline std::size_t channelCapacity(const std::size_t capacity) {
+    std::size_t size = 1;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    return size;
+}
+
+/* Single producer, single consumer ring */
+template<class T>
+class SpscRing
+{
+public:
+    using value_type = T;
+
+    explicit SpscRing(const std::size_t capacity)
+    : mask_(channelCapacity(capacity) - 1), buffer_(new T[mask_ + 1]),
+      head_(0), cached_tail_(0), tail_(0), cached_head_(0)
+    {}
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+    bool empty() const {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    bool full() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire) > mask_;
+    }
+
+    /* Producer side */
+    bool tryPush(T& value) {
+        return tryPushBatch(&value, 1) == 1;
+    }
+
+    /* Producer side, moves up to count values, returns how many */
+    std::size_t tryPushBatch(T* values, const std::size_t count) {
+        const std::size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ + count > capacity()) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+        }
+        const std::size_t n = std::min(count, capacity() - (tail - cached_head_));
+        for (std::size_t i = 0; i < n; ++i) {
+            buffer_[(tail + i) & mask_] = std::move(values[i]);
+        }
+        if (n) {
+            tail_.store(tail + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+    /* Consumer side */
+    bool tryPop(T& value) {
+        return tryPopBatch(&value, 1) == 1;
+    }
+
+    /* Consumer side, moves up to max values, returns how many */
+    std::size_t tryPopBatch(T* values, const std::size_t max) {
+        const std::size_t head = head_.load(std::memory_order_relaxed);
+        if (cached_tail_ - head < max) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+        }
+        const std::size_t n = std::min(max, cached_tail_ - head);
+        for (std::size_t i = 0; i < n; ++i) {
+            values[i] = std::move(buffer_[(head + i) & mask_]);
+        }
+        if (n) {
+            head_.store(head + n, std::memory_order_release);
+        }
+        return n;
+    }
+
+private:
+    const std::size_t mask_;
+    std::unique_ptr<T[]> buffer_;
+
+    /* Consumer owned */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> head_;
+    std::size_t cached_tail_;
+
+    /* Producer owned */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> tail_;
+    std::size_t cached_head_;
+};
+
+/* Multiple producers, multiple consumers ring, one sequence number per cell */
+template<class T>
+class MpmcQueue
+{
+public:
+    using value_type = T;
+
+    explicit MpmcQueue(const std::size_t capacity)
+    : mask_(channelCapacity(capacity) - 1), cells_(new Cell[mask_ + 1]),
+      enqueue_pos_(0), dequeue_pos_(0)
+    {
+        for (std::size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+    /* Approximate while other threads push or pop */
+    bool empty() const {
+        const std::size_t pos = dequeue_pos_.load(std::memory_order_acquire);
+        return cells_[pos & mask_].sequence.load(std::memory_order_acquire) != pos + 1;
+    }
+
+    /* Approximate while other threads push or pop */
+    bool full() const {
+        const std::size_t pos = enqueue_pos_.load(std::memory_order_acquire);
+        return cells_[pos & mask_].sequence.load(std::memory_order_acquire) != pos;
+    }
+
+    bool tryPush(T& value) {
+        std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Reserves the free cells following enqueue_pos_, up to count, with a single update of it */
+    std::size_t tryPushBatch(T* values, const std::size_t count) {
+        if (count == 0) {
+            return 0;
+        }
+        std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        std::size_t n;
+        for (;;) {
+            const std::size_t sequence = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+            const std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos);
+            if (diff < 0) {
+                return 0;
+            }
+            if (diff > 0) {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+                continue;
+            }
+            n = 1;
+            while (n < count && cells_[(pos + n) & mask_].sequence.load(std::memory_order_acquire) == pos + n) {
+                n++;
+            }
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            Cell& cell = cells_[(pos + i) & mask_];
+            cell.value = std::move(values[i]);
+            cell.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        return n;
+    }
+
+    bool tryPop(T& value) {
+        std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            const std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            }
+            else if (diff < 0) {
+                return false;
+            }
+            else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Reserves the filled cells following dequeue_pos_, up to max, with a single update of it */
+    std::size_t tryPopBatch(T* values, const std::size_t max) {
+        if (max == 0) {
+            return 0;
+        }
+        std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        std::size_t n;
+        for (;;) {
+            const std::size_t sequence = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+            const std::intptr_t diff = static_cast<std::intptr_t>(sequence) - static_cast<std::intptr_t>(pos + 1);
+            if (diff < 0) {
+                return 0;
+            }
+            if (diff > 0) {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+                continue;
+            }
+            n = 1;
+            while (n < max && cells_[(pos + n) & mask_].sequence.load(std::memory_order_acquire) == pos + n + 1) {
+                n++;
+            }
+            if (dequeue_pos_.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            Cell& cell = cells_[(pos + i) & mask_];
+            values[i] = std::move(cell.value);
+            cell.sequence.store(pos + i + mask_ + 1, std::memory_order_release);
+        }
+        return n;
+    }
+
+private:
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    const std::size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> enqueue_pos_;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> dequeue_pos_;
+};
+
+/* Waiter woken through a callback instead of a blocked thread, see CoTask.h */
+class ChannelWaker
+{
+public:
+    /* Called by wakeAll() under the waiters lock, must not block */
+    virtual void wake() = 0;
+
+protected:
+    ~ChannelWaker() = default;
+
+private:
+    friend class ChannelWaiters;
+
+    /* Intrusive list of the waiters subscribed to, unsubscribing is constant time */
+    ChannelWaker* prev_ = nullptr;
+    ChannelWaker* next_ = nullptr;
+    bool subscribed_ = false;
+};
+
+/**
+ * Threads waiting for one side of a channel
+ * Tasks are parked on their own control condition, other threads on the shared one
+*/
+class ChannelWaiters
+{
+public:
+    ChannelWaiters()
+    : wakers_(nullptr), count_(0)
+    {}
+
+    /**
+     * Locks the calling thread till ready() holds
+     *
+     * @throw StopException if task is stopped meanwhile
+    */
+    template<class Ready>
+    void wait(Task* task, Ready&& ready) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (task) {
+                tasks_.push_back(task);
+            }
+            count_.fetch_add(1);
+        }
+        Registration registration(*this, task);
+
+        // Pairs with the fence in wakeAll(): either the waker sees the registration or we see its update
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (task) {
+            while (!ready()) {
+                task->park(ready);
+            }
+        }
+        else {
+            BlockingRegion blocking;
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, ready);
+        }
+    }
+
+    /**
+     * Registers waker till unsubscribe(), then the caller checks again what it waits for: either it
+     * sees the update or wakeAll() sees the registration. No wake() is running once unsubscribe() returns
+    */
+    void subscribe(ChannelWaker& waker) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            waker.prev_ = nullptr;
+            waker.next_ = wakers_;
+            if (wakers_) {
+                wakers_->prev_ = &waker;
+            }
+            wakers_ = &waker;
+            waker.subscribed_ = true;
+            count_.fetch_add(1);
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void unsubscribe(ChannelWaker& waker) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!waker.subscribed_) {
+            return;
+        }
+        if (waker.prev_) {
+            waker.prev_->next_ = waker.next_;
+        }
+        else {
+            wakers_ = waker.next_;
+        }
+        if (waker.next_) {
+            waker.next_->prev_ = waker.prev_;
+        }
+        waker.subscribed_ = false;
+        count_.fetch_sub(1);
+    }
+
+    /* Called after the update waiters may be waiting for */
+    void wakeAll() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (count_.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.notify_all();
+        for (Task* task : tasks_) {
+            task->wake();
+        }
+        for (ChannelWaker* waker = wakers_; waker; waker = waker->next_) {
+            waker->wake();
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::vector<Task*> tasks_;
+    ChannelWaker* wakers_;
+    std::atomic<int> count_;
+
+    /* Unregisters on return and on StopException */
+    struct Registration {
+        ChannelWaiters& waiters;
+        Task* task;
+
+        Registration(ChannelWaiters& w, Task* t) : waiters(w), task(t) {}
+
+        ~Registration() {
+            std::unique_lock<std::mutex> lock(waiters.mutex_);
+            if (task) {
+                waiters.tasks_.erase(std::find(waiters.tasks_.begin(), waiters.tasks_.end(), task));
+            }
+            waiters.count_.fetch_sub(1);
+        }
+    };
+};
+
+/**
+ * Blocking channel over a bounded queue, see SpscChannel and MpmcChannel
+ *
+ * Operations taking a Task must be called from that task's inner thread, the task is parked
+ * while blocked. Those without one block the calling thread.
+*/
+template<class Queue>
+class Channel
+{
+public:
+    using value_type = typename Queue::value_type;
+
+    explicit Channel(const std::size_t capacity)
+    : queue_(capacity), closed_(false)
+    {}
+
+    Channel(const Channel&) = delete;
+    Channel& operator= (const Channel&) = delete;
+
+    std::size_t capacity() const { return queue_.capacity(); }
+
+    /**
+     * Locks calling task till there is room for value
+     *
+     * @throw StopException if task is stopped meanwhile
+     * @throw runtime_error if the channel is closed
+    */
+    void push(Task& task, value_type value) { pushBatch(&task, &value, 1); }
+    void push(value_type value) { pushBatch(nullptr, &value, 1); }
+
+    /**
+     * Moves every value in, locking calling task while the channel is full
+     *
+     * @throw StopException if task is stopped meanwhile, some values may have been pushed
+     * @throw runtime_error if the channel is closed
+    */
+    void pushBatch(Task& task, value_type* values, const std::size_t count) { pushBatch(&task, values, count); }
+    void pushBatch(value_type* values, const std::size_t count) { pushBatch(nullptr, values, count); }
+
+    /**
+     * Locks calling task till a value is available
+     * Returns false once the channel is closed and drained
+     *
+     * @throw StopException if task is stopped meanwhile
+    */
+    bool pop(Task& task, value_type& value) { return popBatch(&task, &value, 1) == 1; }
+    bool pop(value_type& value) { return popBatch(nullptr, &value, 1) == 1; }
+
+    /**
+     * Locks calling task till at least one value is available, then moves up to max values
+     * Returns 0 once the channel is closed and drained
+     *
+     * @throw StopException if task is stopped meanwhile
+    */
+    std::size_t popBatch(Task& task, value_type* values, const std::size_t max) { return popBatch(&task, values, max); }
+    std::size_t popBatch(value_type* values, const std::size_t max) { return popBatch(nullptr, values, max); }
+
+    /* Takes a value if one is available, never blocks */
+    bool tryPop(value_type& value) {
+        if (queue_.tryPopBatch(&value, 1) == 0) {
+            return false;
+        }
+        not_full_.wakeAll();
+        return true;
+    }
+
+    /* Wakes waker whenever a value is pushed or the channel closes, see ChannelWaiters::subscribe */
+    void subscribeReceive(ChannelWaker& waker) { not_empty_.subscribe(waker); }
+    void unsubscribeReceive(ChannelWaker& waker) { not_empty_.unsubscribe(waker); }
+
+    /* No more values will be pushed, consumers drain what is left */
+    void close() {
+        closed_.store(true, std::memory_order_release);
+        not_empty_.wakeAll();
+        not_full_.wakeAll();
+    }
+
+    bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+private:
+    Queue queue_;
+    std::atomic<bool> closed_;
+
+    ChannelWaiters not_empty_;
+    ChannelWaiters not_full_;
+
+    void pushBatch(Task* task, value_type* values, const std::size_t count) {
+        std::size_t pushed = 0;
+        while (pushed < count) {
+            if (closed()) {
+                throw std::runtime_error("Cannot push to channel, closed");
+            }
+            const std::size_t n = queue_.tryPushBatch(values + pushed, count - pushed);
+            if (n) {
+                pushed += n;
+                not_empty_.wakeAll();
+                continue;
+            }
+            not_full_.wait(task, [&]() { return !queue_.full() || closed(); });
+        }
+    }
+
+    std::size_t popBatch(Task* task, value_type* values, const std::size_t max) {
+        for (;;) {
+            const std::size_t n = queue_.tryPopBatch(values, max);
+            if (n) {
+                not_full_.wakeAll();
+                return n;
+            }
+            if (closed()) {
+                // A push may have landed before close()
+                const std::size_t last = queue_.tryPopBatch(values, max);
+                if (last) {
+                    not_full_.wakeAll();
+                }
+                return last;
+            }
+            not_empty_.wait(task, [&]() { return !queue_.empty() || closed(); });
+        }
+    }
+};
+
+template<class T>
+using SpscChannel = Channel<SpscRing<T>>;
+
+template<class T>
+using MpmcChannel = Channel<MpmcQueue<T>>;
+
+#endif
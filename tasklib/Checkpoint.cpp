@@ -0,0 +1,146 @@
+#include "Checkpoint.h"
+
+CheckpointJournal::CheckpointJournal(const std::string& path, const std::size_t capacity)
+: log_(path, capacity), queued_(0), written_(0), closing_(false), interval_(0)
+{
+    log_.replay([this](const MappedLog::Record& record) {
+        if (record.kind == tombstone) {
+            latest_.erase(record.key);
+        }
+        else if (record.kind == checkpoint) {
+            latest_[record.key] = CheckpointRecord{record.label, record.data};
+        }
+    });
+    thread_ = std::thread(&CheckpointJournal::run, this);
+}
+
+CheckpointJournal::~CheckpointJournal() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closing_ = true;
+        condition_.notify_all();
+    }
+    thread_.join();
+}
+
+void CheckpointJournal::append(const int task_id, const std::string& type, const std::string& data) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending_.push_back(Pending{task_id, type, data, false});
+    queued_++;
+    condition_.notify_one();
+}
+
+void CheckpointJournal::forget(const int task_id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    pending_.push_back(Pending{task_id, std::string(), std::string(), true});
+    queued_++;
+    condition_.notify_one();
+}
+
+std::map<int, CheckpointRecord> CheckpointJournal::records() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return latest_;
+}
+
+void CheckpointJournal::flush() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const std::uint64_t target = queued_;
+    flushed_.wait(lock, [&]() {
+        return written_ >= target;
+    });
+}
+
+void CheckpointJournal::setTicker(const std::chrono::milliseconds interval, std::function<void()> tick) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    interval_ = interval;
+    tick_ = std::move(tick);
+    condition_.notify_one();
+}
+
+std::size_t CheckpointJournal::size() const {
+    std::unique_lock<std::mutex> lock(log_mutex_);
+    return log_.size();
+}
+
+std::size_t CheckpointJournal::compactions() const {
+    std::unique_lock<std::mutex> lock(log_mutex_);
+    return log_.rewrites();
+}
+
+void CheckpointJournal::run() {
+    std::vector<Pending> batch;
+    auto next_tick = std::chrono::steady_clock::now() + interval_;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        if (interval_.count() > 0) {
+            condition_.wait_until(lock, next_tick, [&]() {
+                return closing_ || !pending_.empty();
+            });
+        }
+        else {
+            condition_.wait(lock, [&]() {
+                return closing_ || !pending_.empty() || interval_.count() > 0;
+            });
+        }
+
+        batch.swap(pending_);
+        const bool closing = closing_;
+        std::function<void()> tick;
+        if (interval_.count() > 0 && std::chrono::steady_clock::now() >= next_tick) {
+            tick = tick_;
+            next_tick = std::chrono::steady_clock::now() + interval_;
+        }
+
+        lock.unlock();
+        if (!batch.empty()) {
+            for (const Pending& record : batch) {
+                write(record);
+            }
+            std::unique_lock<std::mutex> log_lock(log_mutex_);
+            log_.sync(false);
+        }
+        if (tick && !closing) {
+            tick();
+        }
+        lock.lock();
+
+        written_ += batch.size();
+        batch.clear();
+        flushed_.notify_all();
+
+        if (closing && pending_.empty()) {
+            return;
+        }
+    }
+}
+
+void CheckpointJournal::write(const Pending& record) {
+    std::vector<MappedLog::Record> live;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (record.tombstone) {
+            if (!latest_.erase(record.task_id)) {
+                // Never written, nothing to hide on recovery
+                return;
+            }
+        }
+        else {
+            latest_[record.task_id] = CheckpointRecord{record.type, record.data};
+        }
+    }
+
+    std::unique_lock<std::mutex> log_lock(log_mutex_);
+    if (!log_.fits(record.type.size(), record.data.size())) {
+        // Once full, the journal is rewritten with the last record of each live task, this one included
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (const auto& item : latest_) {
+                live.push_back(MappedLog::Record{checkpoint, item.first, item.second.type, item.second.data});
+            }
+        }
+        log_.rewrite(live, 0);
+        return;
+    }
+    log_.append(record.tombstone ? tombstone : checkpoint, record.task_id, record.type, record.data);
+}
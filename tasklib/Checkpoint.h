@@ -0,0 +1,191 @@
+#ifndef CHECKPOINT
+#define CHECKPOINT
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Journal.h"
+
+/**
+ * Checkpoint/restore of long-running tasks, see Scheduler::enableCheckpoints.
+ *
+ * A checkpointable task type declares:
+ *   static const char* typeName();                    stable name stored with its records
+ *   static I checkpointInput(CheckpointReader& r);    input to recreate the task, read first
+ * and overrides Task::saveCheckpoint, writing its input then its state, and Task::restoreCheckpoint,
+ * reading its state back before the task starts.
+*/
+
+/* Appends plain values to a binary record */
+class CheckpointWriter
+{
+public:
+    template<class T>
+    void put(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "Checkpoint values must be trivially copyable");
+        data_.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void putString(const std::string& value) {
+        put(static_cast<std::uint32_t>(value.size()));
+        data_.append(value);
+    }
+
+    const std::string& data() const { return data_; }
+
+    /* Keeps the capacity, the writer is reused by every checkpoint of a thread */
+    void clear() { data_.clear(); }
+
+private:
+    std::string data_;
+};
+
+/* Reads values back in the order they were written */
+class CheckpointReader
+{
+public:
+    CheckpointReader(const std::string& data)
+    : data_(data), offset_(0)
+    {}
+
+    /**
+     * @throw runtime_error if the record is shorter than expected
+    */
+    template<class T>
+    T get() {
+        static_assert(std::is_trivially_copyable<T>::value, "Checkpoint values must be trivially copyable");
+        T value;
+        std::memcpy(&value, take(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    std::string getString() {
+        const std::uint32_t size = get<std::uint32_t>();
+        return std::string(take(size), size);
+    }
+
+private:
+    const std::string& data_;
+    std::size_t offset_;
+
+    const char* take(const std::size_t size) {
+        if (offset_ + size > data_.size()) {
+            throw std::runtime_error("Cannot restore checkpoint, record truncated");
+        }
+        const char* ptr = data_.data() + offset_;
+        offset_ += size;
+        return ptr;
+    }
+};
+
+/* Last checkpoint of a task */
+struct CheckpointRecord {
+    std::string type;
+    std::string data;
+};
+
+/* Restores a recovered task from its last checkpoint, if T is checkpointable */
+template<class T>
+auto restoreRecord(T& task, const CheckpointRecord& record, int)
+    -> decltype(T::checkpointInput(std::declval<CheckpointReader&>()), void()) {
+    CheckpointReader reader(record.data);
+    T::checkpointInput(reader);
+    task.restoreCheckpoint(reader);
+}
+
+template<class T>
+void restoreRecord(T&, const CheckpointRecord&, long) {}
+
+/**
+ * Memory-mapped journal of task checkpoints
+ *
+ * Records are copied into a queue by the task threads and written by the journal thread, so a
+ * checkpoint costs the task one copy. Each record carries a checksum, a torn tail is ignored when
+ * the journal is opened again. Once the file is full it is rewritten with the last record of each
+ * live task, and grown if that is not enough.
+*/
+class CheckpointJournal
+{
+public:
+    /**
+     * Opens or creates the journal and reads the checkpoints it holds
+     *
+     * @throw runtime_error if the file cannot be opened or mapped
+    */
+    CheckpointJournal(const std::string& path, const std::size_t capacity = 16 << 20);
+
+    ~CheckpointJournal();
+
+    CheckpointJournal(const CheckpointJournal&) = delete;
+    CheckpointJournal& operator= (const CheckpointJournal&) = delete;
+
+    /* Queues a checkpoint of task_id, the previous one becomes obsolete */
+    void append(const int task_id, const std::string& type, const std::string& data);
+
+    /* Queues the removal of task_id's checkpoint, finished tasks are not restored */
+    void forget(const int task_id);
+
+    /* Last checkpoint of every live task, as written so far */
+    std::map<int, CheckpointRecord> records() const;
+
+    /* Locks calling thread till queued records are written */
+    void flush();
+
+    /* Calls tick from the journal thread every interval, a zero interval disables it */
+    void setTicker(const std::chrono::milliseconds interval, std::function<void()> tick);
+
+    /* Bytes of the file in use */
+    std::size_t size() const;
+
+    /* Number of rewrites since the journal was opened */
+    std::size_t compactions() const;
+
+private:
+    struct Pending {
+        int task_id;
+        std::string type;
+        std::string data;
+        bool tombstone;
+    };
+
+    enum Kind : std::uint32_t {
+        checkpoint = 1,
+        tombstone = 2,
+    };
+
+    /* Written by the journal thread, guarded by log_mutex_ so that appends never wait for it */
+    MappedLog log_;
+    mutable std::mutex log_mutex_;
+
+    /* Guarded by mutex_ */
+    std::map<int, CheckpointRecord> latest_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    std::condition_variable flushed_;
+    std::vector<Pending> pending_;
+    std::uint64_t queued_;
+    std::uint64_t written_;
+    bool closing_;
+
+    std::chrono::milliseconds interval_;
+    std::function<void()> tick_;
+
+    std::thread thread_;
+
+    /* Journal thread only */
+    void run();
+    void write(const Pending& record);
+};
+
+#endif
@@ -0,0 +1,325 @@
+#include "CoTask.h"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    thread_local CoRuntime* current_runtime = nullptr;
+    thread_local CoControl* current_control = nullptr;
+
+    bool later(const std::pair<std::chrono::steady_clock::time_point, std::shared_ptr<CoControl>>& a,
+               const std::pair<std::chrono::steady_clock::time_point, std::shared_ptr<CoControl>>& b) {
+        return a.first > b.first;
+    }
+
+    std::string refusal(const char* action, const int id, const char* reason) {
+        std::stringstream msg;
+        msg << "Cannot " << action << " task, '" << id << "', " << reason;
+        return msg.str();
+    }
+}
+
+CoControl::CoControl(CoRuntime& runtime, const int id, std::coroutine_handle<> frame)
+: runtime_(runtime), id_(id), frame_(frame), wait_(nullptr), started_(false),
+  state_(Task::StateType::running), command_(Task::CommandType::run), schedule_(Schedule::idle),
+  prev_(nullptr), next_(nullptr)
+{}
+
+bool CoControl::finished() const {
+    const Task::StateType state = status();
+    return state == Task::StateType::completed || state == Task::StateType::stopped || state == Task::StateType::failed;
+}
+
+CoControl& CoControl::current() {
+    return *current_control;
+}
+
+bool CoControl::claim() {
+    Schedule schedule = schedule_.load();
+    while (schedule == Schedule::idle || schedule == Schedule::running) {
+        const Schedule next = schedule == Schedule::idle ? Schedule::queued : Schedule::requeue;
+        if (schedule_.compare_exchange_weak(schedule, next)) {
+            return next == Schedule::queued;
+        }
+    }
+    return false;
+}
+
+void CoControl::wake() {
+    if (claim()) {
+        runtime_.enqueue(shared_from_this());
+    }
+}
+
+void CoControl::checkStop() const {
+    if (command_.load(std::memory_order_acquire) == Task::CommandType::stop) {
+        throw StopException();
+    }
+}
+
+void CoControl::sleepUntil(const std::chrono::steady_clock::time_point deadline) {
+    runtime_.addTimer(deadline, shared_from_this());
+}
+
+bool CoControl::addJoiner(CoControl& joiner) {
+    std::unique_lock<std::mutex> lock(runtime_.mutex_);
+    if (finished()) {
+        return false;
+    }
+    joiners_.push_back(joiner.shared_from_this());
+    return true;
+}
+
+void CoControl::removeJoiner(CoControl& joiner) {
+    std::unique_lock<std::mutex> lock(runtime_.mutex_);
+    auto found = std::find_if(joiners_.begin(), joiners_.end(), [&](const std::shared_ptr<CoControl>& waiting) {
+        return waiting.get() == &joiner;
+    });
+    if (found != joiners_.end()) {
+        joiners_.erase(found);
+    }
+}
+
+std::exception_ptr CoHandle::exception() const {
+    std::unique_lock<std::mutex> lock(control_->runtime_.mutex_);
+    return control_->exception_;
+}
+
+void CoHandle::pause() {
+    Task::CommandType expected = Task::CommandType::run;
+    if (control_->finished() || !control_->command_.compare_exchange_strong(expected, Task::CommandType::pause)) {
+        throw std::runtime_error(refusal("pause", id(), "not running"));
+    }
+    control_->wake();
+}
+
+void CoHandle::resume() {
+    Task::CommandType expected = Task::CommandType::pause;
+    if (!control_->command_.compare_exchange_strong(expected, Task::CommandType::run)) {
+        throw std::runtime_error(refusal("resume", id(), "not paused"));
+    }
+    control_->wake();
+}
+
+void CoHandle::stop() {
+    if (control_->finished() || control_->command_.exchange(Task::CommandType::stop) == Task::CommandType::stop) {
+        throw std::runtime_error(refusal("stop", id(), "not running"));
+    }
+    control_->wake();
+}
+
+void CoHandle::join() const {
+    BlockingRegion blocking;
+    std::unique_lock<std::mutex> lock(control_->runtime_.mutex_);
+    control_->runtime_.finished_.wait(lock, [&]() { return control_->finished(); });
+}
+
+bool CoHandle::joinUntil(const std::chrono::steady_clock::time_point deadline) const {
+    BlockingRegion blocking;
+    std::unique_lock<std::mutex> lock(control_->runtime_.mutex_);
+    return control_->runtime_.finished_.wait_until(lock, deadline, [&]() { return control_->finished(); });
+}
+
+CoRuntime::CoRuntime(std::size_t threads)
+: live_(nullptr), size_(0), next_id_(0), closing_(false)
+{
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers_.emplace_back(&CoRuntime::run, this);
+    }
+}
+
+CoRuntime::~CoRuntime() {
+    std::vector<std::shared_ptr<CoControl>> left;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closing_ = true;
+        for (CoControl* control = live_; control; control = control->next_) {
+            control->command_.store(Task::CommandType::stop);
+            left.push_back(control->shared_from_this());
+        }
+        work_.notify_all();
+    }
+    for (const std::shared_ptr<CoControl>& control : left) {
+        control->wake();
+    }
+    left.clear();
+
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+CoRuntime* CoRuntime::current() {
+    return current_runtime;
+}
+
+std::size_t CoRuntime::size() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return size_;
+}
+
+CoHandle CoRuntime::launch(CoTask task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (closing_) {
+        throw std::runtime_error("Cannot spawn task, runtime closing");
+    }
+    auto control = std::make_shared<CoControl>(*this, next_id_++, std::exchange(task.frame_, nullptr));
+    control->self_ = control;
+    control->next_ = live_;
+    if (live_) {
+        live_->prev_ = control.get();
+    }
+    live_ = control.get();
+    size_++;
+    lock.unlock();
+
+    control->wake();
+    return CoHandle(std::move(control));
+}
+
+void CoRuntime::enqueue(std::shared_ptr<CoControl> control) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.push_back(std::move(control));
+    work_.notify_one();
+}
+
+void CoRuntime::addTimer(const std::chrono::steady_clock::time_point deadline, std::shared_ptr<CoControl> control) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    timers_.emplace_back(deadline, std::move(control));
+    std::push_heap(timers_.begin(), timers_.end(), later);
+    // A worker waiting for a later deadline
+    work_.notify_one();
+}
+
+void CoRuntime::run() {
+    current_runtime = this;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        const auto now = std::chrono::steady_clock::now();
+        while (!timers_.empty() && timers_.front().first <= now) {
+            std::pop_heap(timers_.begin(), timers_.end(), later);
+            std::shared_ptr<CoControl> control = std::move(timers_.back().second);
+            timers_.pop_back();
+            if (control->claim()) {
+                ready_.push_back(std::move(control));
+            }
+        }
+
+        if (!ready_.empty()) {
+            std::shared_ptr<CoControl> control = std::move(ready_.front());
+            ready_.pop_front();
+            lock.unlock();
+            step(*control);
+            control.reset();
+            lock.lock();
+            continue;
+        }
+        if (closing_ && size_ == 0) {
+            break;
+        }
+
+        if (timers_.empty()) {
+            work_.wait(lock);
+        }
+        else {
+            // A copy, the heap may grow while waiting
+            const auto deadline = timers_.front().first;
+            work_.wait_until(lock, deadline);
+        }
+    }
+    // The others may be waiting for a timer of a task that is gone
+    work_.notify_all();
+}
+
+void CoRuntime::step(CoControl& control) {
+    // Wakes from now on queue the task again, after this step
+    control.schedule_.store(CoControl::Schedule::running);
+
+    if (control.frame_) {
+        const Task::CommandType command = control.command_.load();
+        if (command == Task::CommandType::pause) {
+            control.state_.store(Task::StateType::paused, std::memory_order_release);
+        }
+        else if (command == Task::CommandType::stop && !control.started_) {
+            finish(control);
+        }
+        else {
+            control.state_.store(Task::StateType::running, std::memory_order_release);
+            if (command == Task::CommandType::stop || !control.wait_ || control.wait_->ready()) {
+                if (control.wait_) {
+                    control.wait_->disarm();
+                    control.wait_ = nullptr;
+                }
+                control.started_ = true;
+                current_control = &control;
+                control.frame_.resume();
+                current_control = nullptr;
+                if (control.frame_.done()) {
+                    finish(control);
+                }
+            }
+        }
+    }
+
+    CoControl::Schedule running = CoControl::Schedule::running;
+    if (!control.schedule_.compare_exchange_strong(running, CoControl::Schedule::idle)) {
+        control.schedule_.store(CoControl::Schedule::queued);
+        enqueue(control.shared_from_this());
+    }
+}
+
+void CoRuntime::finish(CoControl& control) {
+    auto frame = std::coroutine_handle<CoTask::promise_type>::from_address(control.frame_.address());
+    const std::exception_ptr exception = frame.promise().exception;
+    frame.destroy();
+    control.frame_ = nullptr;
+
+    Task::StateType state = control.started_ ? Task::StateType::completed : Task::StateType::stopped;
+    if (exception) {
+        try {
+            std::rethrow_exception(exception);
+        }
+        catch (const StopException&) {
+            state = Task::StateType::stopped;
+        }
+        catch (...) {
+            state = Task::StateType::failed;
+        }
+    }
+
+    std::vector<std::shared_ptr<CoControl>> joiners;
+    std::shared_ptr<CoControl> self;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (control.prev_) {
+            control.prev_->next_ = control.next_;
+        }
+        else {
+            live_ = control.next_;
+        }
+        if (control.next_) {
+            control.next_->prev_ = control.prev_;
+        }
+        control.prev_ = control.next_ = nullptr;
+        size_--;
+
+        if (state == Task::StateType::failed) {
+            control.exception_ = exception;
+        }
+        control.state_.store(state, std::memory_order_release);
+        joiners.swap(control.joiners_);
+        self.swap(control.self_);
+        finished_.notify_all();
+        if (closing_ && size_ == 0) {
+            work_.notify_all();
+        }
+    }
+
+    for (const std::shared_ptr<CoControl>& joiner : joiners) {
+        joiner->wake();
+    }
+}
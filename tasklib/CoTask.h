@@ -0,0 +1,420 @@
+#ifndef CO_TASK
+#define CO_TASK
+
+#if __cplusplus < 202002L || !defined(__cpp_impl_coroutine)
+#error "CoTask.h needs C++20 coroutines, configure with -DTASKLIB_COROUTINES=ON"
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Channel.h"
+#include "Task.h"
+
+class CoRuntime;
+class CoHandle;
+
+/**
+ * Body of a coroutine task, a function returning CoTask started by CoRuntime::spawn():
+ *
+ *     CoTask sum(MpmcChannel<int>& input, std::atomic<long>& total) {
+ *         int value;
+ *         while (co_await coReceive(input, value)) {
+ *             total += value;
+ *         }
+ *     }
+ *
+ * Instead of blocking a thread the body co_awaits the runtime: coYield(), coSleep(), coReceive() from a
+ * Channel, or a CoHandle to join a child. Each of them is a safepoint, the counterpart of
+ * Task::checkCommand(): a paused task stays suspended there till resumed, a stopped one gets
+ * StopException thrown out of the co_await. A suspended task holds no thread, only its frame and a
+ * control block, a few hundred bytes together.
+ *
+ * Arguments are copied into the frame: pass them by value, or by reference to objects outliving the
+ * task. Lambda captures are not, so bodies are functions or lambdas without captures.
+*/
+class CoTask
+{
+public:
+    struct promise_type {
+        std::exception_ptr exception;
+
+        CoTask get_return_object() { return CoTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        /* Started by the runtime */
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        /* Destroyed by the runtime once it has taken the result */
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    CoTask(CoTask&& other) noexcept
+    : frame_(std::exchange(other.frame_, nullptr))
+    {}
+
+    /* Destroys the frame if it was never spawned */
+    ~CoTask() {
+        if (frame_) {
+            frame_.destroy();
+        }
+    }
+
+    CoTask& operator= (CoTask&&) = delete;
+
+private:
+    friend class CoRuntime;
+
+    explicit CoTask(std::coroutine_handle<promise_type> frame)
+    : frame_(frame)
+    {}
+
+    std::coroutine_handle<promise_type> frame_;
+};
+
+/* What a suspended coroutine task waits for, checked by its runtime before resuming it */
+class CoWait
+{
+public:
+    /* True once the task can go on; called on a runtime thread while the task is suspended */
+    virtual bool ready() = 0;
+
+    /* Stops the wake-ups, called before the task is resumed or destroyed */
+    virtual void disarm() {}
+
+protected:
+    ~CoWait() = default;
+};
+
+/**
+ * State of a coroutine task shared by its runtime, its handles and the awaiters of its frame
+ *
+ * Whatever may let the task go on calls wake(), from any thread: the runtime queues the task once and a
+ * single runtime thread steps it. The step applies the command, then resumes the task if what it waits
+ * for is ready(); spurious wakes are harmless.
+*/
+class CoControl : public std::enable_shared_from_this<CoControl>
+{
+public:
+    CoControl(CoRuntime& runtime, int id, std::coroutine_handle<> frame);
+
+    CoControl(const CoControl&) = delete;
+    CoControl& operator= (const CoControl&) = delete;
+
+    int id() const { return id_; }
+
+    Task::StateType status() const { return state_.load(std::memory_order_acquire); }
+
+    /* Completed, stopped or failed */
+    bool finished() const;
+
+    /* Task running on the calling runtime thread, only valid inside a coroutine body */
+    static CoControl& current();
+
+    /* Queues the task on its runtime unless already queued, thread safe */
+    void wake();
+
+    /* Throws StopException if stop was requested, at the end of every co_await */
+    void checkStop() const;
+
+    /* Set by an awaiter before suspending, nullptr when nothing but the command is waited for */
+    void suspendOn(CoWait* wait) { wait_ = wait; }
+
+    /* Wakes the task at deadline */
+    void sleepUntil(std::chrono::steady_clock::time_point deadline);
+
+    /* Wakes joiner once this task finishes; false if it already has */
+    bool addJoiner(CoControl& joiner);
+    void removeJoiner(CoControl& joiner);
+
+private:
+    friend class CoRuntime;
+    friend class CoHandle;
+
+    enum class Schedule : std::uint8_t {
+        idle,
+        queued,
+        running,
+        requeue,    // woken while running, queued again after the step
+    };
+
+    CoRuntime& runtime_;
+    const int id_;
+    /* runtime thread stepping the task, null once finished */
+    std::coroutine_handle<> frame_;
+    CoWait* wait_;
+    bool started_;
+
+    std::atomic<Task::StateType> state_;
+    std::atomic<Task::CommandType> command_;
+    std::atomic<Schedule> schedule_;
+    std::exception_ptr exception_;
+
+    /* guarded by the runtime mutex */
+    std::vector<std::shared_ptr<CoControl>> joiners_;
+    /* keeps the task alive till it finishes, the runtime lists it meanwhile */
+    std::shared_ptr<CoControl> self_;
+    CoControl* prev_;
+    CoControl* next_;
+
+    /* True if the caller must queue the task */
+    bool claim();
+};
+
+/* co_await coYield(): lets the other tasks run, then goes on */
+class CoYield
+{
+public:
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<>) const { CoControl::current().wake(); }
+    void await_resume() const { CoControl::current().checkStop(); }
+};
+
+inline CoYield coYield() { return CoYield(); }
+
+/* co_await coSleep(duration): suspends the task without holding a thread */
+class CoSleep : public CoWait
+{
+public:
+    explicit CoSleep(const std::chrono::steady_clock::time_point deadline)
+    : deadline_(deadline)
+    {}
+
+    bool await_ready() const { return std::chrono::steady_clock::now() >= deadline_; }
+
+    void await_suspend(std::coroutine_handle<>) {
+        CoControl& control = CoControl::current();
+        control.suspendOn(this);
+        control.sleepUntil(deadline_);
+    }
+
+    void await_resume() const { CoControl::current().checkStop(); }
+
+    bool ready() override { return std::chrono::steady_clock::now() >= deadline_; }
+
+private:
+    const std::chrono::steady_clock::time_point deadline_;
+};
+
+template<class Rep, class Period>
+CoSleep coSleep(const std::chrono::duration<Rep, Period> duration) {
+    return CoSleep(std::chrono::steady_clock::now() + std::chrono::ceil<std::chrono::steady_clock::duration>(duration));
+}
+
+inline CoSleep coSleepUntil(const std::chrono::steady_clock::time_point deadline) { return CoSleep(deadline); }
+
+/**
+ * co_await coReceive(channel, value): takes the next value of channel, suspending the task while it is
+ * empty. Yields false once the channel is closed and drained, like Channel::pop()
+*/
+template<class Queue>
+class CoReceive : public CoWait, public ChannelWaker
+{
+public:
+    using value_type = typename Queue::value_type;
+
+    CoReceive(Channel<Queue>& channel, value_type& value)
+    : channel_(channel), value_(value), control_(nullptr), done_(false), received_(false)
+    {}
+
+    bool await_ready() { return poll(); }
+
+    bool await_suspend(std::coroutine_handle<>) {
+        control_ = &CoControl::current();
+        control_->suspendOn(this);
+        channel_.subscribeReceive(*this);
+        // A push between the first poll and the subscription did not see it
+        if (poll()) {
+            channel_.unsubscribeReceive(*this);
+            control_->suspendOn(nullptr);
+            return false;
+        }
+        return true;
+    }
+
+    bool await_resume() const {
+        CoControl::current().checkStop();
+        return received_;
+    }
+
+    bool ready() override { return poll(); }
+    void disarm() override { channel_.unsubscribeReceive(*this); }
+    void wake() override { control_->wake(); }
+
+private:
+    Channel<Queue>& channel_;
+    value_type& value_;
+    CoControl* control_;
+    bool done_;
+    bool received_;
+
+    bool poll() {
+        if (!done_) {
+            if (channel_.tryPop(value_)) {
+                done_ = received_ = true;
+            }
+            else if (channel_.closed()) {
+                // Values pushed right before the close
+                received_ = channel_.tryPop(value_);
+                done_ = true;
+            }
+        }
+        return done_;
+    }
+};
+
+template<class Queue>
+CoReceive<Queue> coReceive(Channel<Queue>& channel, typename Queue::value_type& value) {
+    return CoReceive<Queue>(channel, value);
+}
+
+/* co_await handle: suspends the task till the task of handle finishes, see CoHandle::status() */
+class CoJoin : public CoWait
+{
+public:
+    explicit CoJoin(std::shared_ptr<CoControl> child)
+    : child_(std::move(child)), control_(nullptr)
+    {}
+
+    bool await_ready() const { return child_->finished(); }
+
+    bool await_suspend(std::coroutine_handle<>) {
+        control_ = &CoControl::current();
+        control_->suspendOn(this);
+        if (!child_->addJoiner(*control_)) {
+            control_->suspendOn(nullptr);
+            return false;
+        }
+        return true;
+    }
+
+    void await_resume() const { CoControl::current().checkStop(); }
+
+    bool ready() override { return child_->finished(); }
+    void disarm() override { child_->removeJoiner(*control_); }
+
+private:
+    std::shared_ptr<CoControl> child_;
+    CoControl* control_;
+};
+
+/**
+ * Controls a coroutine task from any thread, or from another coroutine task
+ *
+ * Commands are requests like Task's, but applied at the next suspension point of the task instead of
+ * being waited for: a task suspended in a co_await is paused, or stopped, at once.
+*/
+class CoHandle
+{
+public:
+    CoHandle() = default;
+
+    explicit operator bool() const { return control_ != nullptr; }
+
+    int id() const { return control_->id(); }
+
+    Task::StateType status() const { return control_->status(); }
+
+    /* Set when the task failed, see Task::exception() */
+    std::exception_ptr exception() const;
+
+    /* @throw runtime_error if the task is not running */
+    void pause();
+
+    /* @throw runtime_error if the task is not paused */
+    void resume();
+
+    /* @throw runtime_error if the task already finished or is stopping */
+    void stop();
+
+    /* Blocks the calling thread till the task finishes; coroutine tasks co_await the handle instead */
+    void join() const;
+
+    /* Same as join(), false if deadline passed first */
+    bool joinUntil(std::chrono::steady_clock::time_point deadline) const;
+
+    CoJoin operator co_await() const { return CoJoin(control_); }
+
+private:
+    friend class CoRuntime;
+
+    explicit CoHandle(std::shared_ptr<CoControl> control)
+    : control_(std::move(control))
+    {}
+
+    std::shared_ptr<CoControl> control_;
+};
+
+/**
+ * Runs coroutine tasks on a fixed set of threads
+ *
+ * Ready tasks are stepped in the order they were woken, sleeping ones are kept in a timer heap, and
+ * tasks waiting on a channel or a child are only queued again when woken by it. The destructor stops
+ * the tasks left and waits for them.
+*/
+class CoRuntime
+{
+public:
+    /* threads 0 for the number of cpus */
+    explicit CoRuntime(std::size_t threads = 1);
+    ~CoRuntime();
+
+    CoRuntime(const CoRuntime&) = delete;
+    CoRuntime& operator= (const CoRuntime&) = delete;
+
+    /**
+     * Calls body(args...), a function returning CoTask, and queues the task it creates
+     * @throw runtime_error if the runtime is being destroyed
+    */
+    template<class Function, class... Args>
+    CoHandle spawn(Function&& body, Args&&... args) {
+        return launch(std::invoke(std::forward<Function>(body), std::forward<Args>(args)...));
+    }
+
+    /* Tasks not finished yet */
+    std::size_t size() const;
+
+    std::size_t threads() const { return workers_.size(); }
+
+    /* Runtime of the calling thread, nullptr out of runtime threads */
+    static CoRuntime* current();
+
+private:
+    friend class CoControl;
+    friend class CoHandle;
+
+    using Timer = std::pair<std::chrono::steady_clock::time_point, std::shared_ptr<CoControl>>;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable finished_;
+    std::deque<std::shared_ptr<CoControl>> ready_;
+    /* min-heap on the deadline */
+    std::vector<Timer> timers_;
+    /* Tasks not finished, newest first */
+    CoControl* live_;
+    std::size_t size_;
+    int next_id_;
+    bool closing_;
+    std::vector<std::thread> workers_;
+
+    CoHandle launch(CoTask task);
+    void enqueue(std::shared_ptr<CoControl> control);
+    void addTimer(std::chrono::steady_clock::time_point deadline, std::shared_ptr<CoControl> control);
+    void run();
+    void step(CoControl& control);
+    void finish(CoControl& control);
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <math.h>
 
 #include "Task.h"
+#include "Checkpoint.h"
 
 using namespace std::chrono_literals;
 
@@ -20,21 +21,61 @@ public:
         return progress_;
     }
 
+    /* Journaled and checkpointable, see Journal.h and Checkpoint.h */
+    using InputType = int;
+
+    static constexpr const char* typeName() { return "counter"; }
+
+    static constexpr TaskArgument taskArgument() {
+        return {"threshold", "counts up to threshold, one step every 10ms", 100000, 1, std::numeric_limits<int>::max()};
+    }
+
+    static int checkpointInput(CheckpointReader& reader) {
+        return reader.get<int>();
+    }
+
+    bool saveCheckpoint(CheckpointWriter& writer) override {
+        writer.put(threshold_);
+        // Taken before the current step runs
+        writer.put(count_.load() - 1);
+        return true;
+    }
+
+    void restoreCheckpoint(CheckpointReader& reader) override {
+        count_ = reader.get<int>();
+        updateProgress();
+    }
+
+protected:
+    void onRearm() override {
+        count_ = 0;
+        progress_ = 0.0;
+    }
+
 private:
     const int threshold_;
-    std::atomic<int> count_;
+
+    /* written by inner thread every iteration */
+    alignas(CACHE_LINE_SIZE) std::atomic<int> count_;
     std::atomic<double> progress_;
 
     void execute() {
 
         while(++count_ < threshold_) {
             checkCommand();
-            std::this_thread::sleep_for(10ms);
-            progress_ = std::ceil(100.0 * static_cast<double>(count_) / threshold_ * 100.0) / 100.0;
+            {
+                BlockingRegion blocking;
+                std::this_thread::sleep_for(10ms);
+            }
+            updateProgress();
 
         }
     }
 
+    void updateProgress() {
+        progress_ = std::ceil(100.0 * static_cast<double>(count_) / threshold_ * 100.0) / 100.0;
+    }
+
 };
 
 #endif
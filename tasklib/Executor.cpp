@@ -0,0 +1,95 @@
+#include "Executor.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    thread_local Placement current_placement;
+}
+
+Placement Placement::current() {
+    return current_placement;
+}
+
+Executor::Executor(const Topology& topology, AffinityPolicy policy)
+: topology_(topology), policy_(policy), next_node_(0),
+  next_cpu_(new std::atomic<unsigned>[topology.nodeCount()])
+{
+    for (std::size_t node = 0; node < topology_.nodeCount(); ++node) {
+        next_cpu_[node] = 0;
+    }
+}
+
+int Executor::existingNode(const int node) const {
+    const int count = static_cast<int>(topology_.nodeCount());
+    for (int i = 0; i < count; ++i) {
+        const int candidate = (node + i) % count;
+        if (!topology_.cpus(candidate).empty()) {
+            return candidate;
+        }
+    }
+    return 0;
+}
+
+Placement Executor::place(const Placement& requested) {
+    Placement placement = requested;
+    placement.topology = &topology_;
+
+    if (placement.cpu >= 0) {
+        const int node = topology_.nodeOf(placement.cpu);
+        const auto& cpus = topology_.cpus(node);
+        if (std::find(cpus.begin(), cpus.end(), placement.cpu) == cpus.end()) {
+            std::ostringstream msg;
+            msg << "Cpu '" << placement.cpu << "' not available";
+            throw std::invalid_argument(msg.str());
+        }
+        placement.node = node;
+        return placement;
+    }
+
+    // Children stay with their parent task
+    if (placement.node < 0) {
+        placement.node = Placement::current().node;
+    }
+
+    const AffinityPolicy policy = policy_;
+    if (placement.node < 0) {
+        if (policy == AffinityPolicy::none) {
+            return placement;
+        }
+        placement.node = static_cast<int>(next_node_++ % topology_.nodeCount());
+    }
+    placement.node = existingNode(placement.node);
+
+    if (policy == AffinityPolicy::core) {
+        const auto& cpus = topology_.cpus(placement.node);
+        placement.cpu = cpus[next_cpu_[static_cast<std::size_t>(placement.node)]++ % cpus.size()];
+    }
+
+    return placement;
+}
+
+void Executor::bind(const Placement& placement) {
+    current_placement = placement;
+    NodeMemory::threadNode() = placement.node;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (placement.cpu >= 0) {
+        CPU_SET(placement.cpu, &set);
+    }
+    else if (placement.node >= 0) {
+        const Topology& topology = placement.topology ? *placement.topology : Topology::system();
+        for (int cpu : topology.cpus(placement.node)) {
+            CPU_SET(cpu, &set);
+        }
+    }
+
+    if (CPU_COUNT(&set) > 0) {
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+}
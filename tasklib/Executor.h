@@ -0,0 +1,69 @@
+#ifndef EXECUTOR
+#define EXECUTOR
+
+#include <atomic>
+#include <memory>
+
+#include "Topology.h"
+
+/* Where a task thread runs, -1 leaves the choice to the executor */
+struct Placement {
+    int node = -1;
+    int cpu = -1;
+    /* Topology the node refers to, set by Executor::place, the system one when null */
+    const Topology* topology = nullptr;
+
+    Placement() = default;
+    Placement(const int node_, const int cpu_ = -1) : node(node_), cpu(cpu_) {}
+
+    /* Placement of the calling task thread, default (-1, -1) outside of tasks */
+    static Placement current();
+};
+
+enum class AffinityPolicy {
+    none,   // threads float, only explicit placements are applied
+    node,   // threads are pinned to every cpu of their node, nodes are assigned round-robin
+    core,   // threads are pinned to a single cpu, cpus are assigned round-robin within the node
+};
+
+/**
+ * Decides placement of task threads and applies it when they start.
+ *
+ * Tasks spawned from a task thread stay on its node unless they request another one.
+ * Requests for nodes the machine does not have fall back to an existing node, so the same
+ * placement works on single-node machines.
+*/
+class Executor
+{
+public:
+    explicit Executor(const Topology& topology = Topology::system(), AffinityPolicy policy = AffinityPolicy::none);
+
+    Executor(const Executor&) = delete;
+    Executor& operator= (const Executor&) = delete;
+
+    void setAffinityPolicy(const AffinityPolicy policy) { policy_ = policy; }
+    AffinityPolicy affinityPolicy() const { return policy_; }
+
+    const Topology& topology() const { return topology_; }
+
+    /**
+     * Resolves a requested placement into the node/cpu a new task thread will use
+     *
+     * @throw invalid_argument if an explicit cpu is not available to the process
+    */
+    Placement place(const Placement& requested);
+
+    /* Pins the calling thread to the placement and records it as current, failures leave it floating */
+    static void bind(const Placement& placement);
+
+private:
+    const Topology& topology_;
+    std::atomic<AffinityPolicy> policy_;
+
+    std::atomic<unsigned> next_node_;
+    std::unique_ptr<std::atomic<unsigned>[]> next_cpu_;
+
+    int existingNode(const int node) const;
+};
+
+#endif
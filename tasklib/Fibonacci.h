@@ -1,45 +1,159 @@
 #ifndef FIBONACCI
 #define FIBONACCI
 
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "BigInt.h"
 #include "Task.h"
 
+/**
+ * n-th fibonacci number by fast doubling over BigInt:
+ *   F(2k) = F(k) (2 F(k+1) - F(k)),  F(2k+1) = F(k)^2 + F(k+1)^2
+ * one step per bit of n. Progress is weighted by the estimated cost of each step's products, which
+ * grows with the size of the operands. Long products poll for commands and are split across
+ * threads pinned as the task is
+*/
 class Fibonacci : public Task
 {
 
 public:
+    /* Memoizable, see Memo.h */
+    using ResultType = BigInt;
+
+    /* Journaled, see Journal.h */
+    using InputType = int;
+
+    static constexpr const char* typeName() { return "fibonacci"; }
+
+    /* Fibonacci of 10^8 has about 21 million digits */
+    static constexpr TaskArgument taskArgument() {
+        return {"n", "computes the n-th fibonacci number", 20, 0, 100000000};
+    }
+
+    static std::string memoKey(const int num) {
+        return std::to_string(num);
+    }
+
     Fibonacci(const int id, const int num) 
-    : Task(id), num_(num), res_(0), progress_(0.0)
+    : Task(id), num_(num), progress_(0.0)
     {}
 
     double progress() override {
         return progress_;
     }
 
-    int getResult() {
+    /**
+     * Result once finished, F(k) for the leading bits k of n already processed if stopped
+     *
+     * @throw runtime_error if the task is not finished, the exception it failed with if failed
+    */
+    const BigInt& getResult() {
         StateType state = status();
-        if (state == StateType::completed || state == StateType::stopped) {
+        if (state == StateType::failed) {
+            std::rethrow_exception(exception());
+        }
+        if (finished(state)) {
             return res_;
         }
 
         throw std::runtime_error("Result for fibonacci of '" + std::to_string(num_) + "' not available");
     }
 
+    /* Value computed by execute(), no state check */
+    const BigInt& result() const {
+        return res_;
+    }
+
 private:
     const int num_;
-    std::atomic<int> res_;
-    std::atomic<double> progress_;
+
+    /* written by inner thread, F(k) and F(k+1) */
+    BigInt res_;
+    BigInt next_;
+
+    /* written by inner thread at every step */
+    alignas(CACHE_LINE_SIZE) std::atomic<double> progress_;
+
+protected:
+    void onRearm() override {
+        res_ = BigInt();
+        next_ = BigInt();
+        progress_ = 0.0;
+    }
 
 private:
 
-    int fibonacci(int x) {
-        if (x < 2) { return x; }
-        checkCommand();
+    /* Karatsuba cost of the products of a step ending at k, F(k) has about 0.69 k bits */
+    static double stepCost(const unsigned k) {
+        return std::pow(static_cast<double>(k) + 1.0, 1.585);
+    }
 
-        return fibonacci(x-1) + fibonacci(x-2);
+    static unsigned threads() {
+        static const unsigned count = std::max(1u, std::thread::hardware_concurrency());
+        return count;
     }
 
     void execute() override {
-        res_ = fibonacci(num_);
+        if (num_ < 0) {
+            throw std::invalid_argument("Cannot compute fibonacci of '" + std::to_string(num_) + "', negative");
+        }
+        const unsigned n = static_cast<unsigned>(num_);
+        int bits = 0;
+        while (bits < 32 && (n >> bits)) {
+            ++bits;
+        }
+
+        MultiplyOptions options;
+        options.poll = [this]() { checkCommand(); };
+        options.hold = [this]() { holdWhilePaused(); };
+        options.threads = threads();
+        options.placement = Placement::current();
+        options.pool = pool();
+
+        double total = 0.0;
+        for (int i = bits - 1; i >= 0; --i) {
+            total += stepCost(n >> i);
+        }
+
+        res_ = BigInt(0);
+        next_ = BigInt(1);
+        double done = 0.0;
+        for (int i = bits - 1; i >= 0; --i) {
+            checkCommand();
+            const bool odd = (n >> i) & 1;
+
+            if (i == 0 && odd) {
+                // Last step, F(k+1) is not needed
+                res_ = BigInt::multiply(res_, res_, options) + BigInt::multiply(next_, next_, options);
+            }
+            else {
+                BigInt twice = next_;
+                twice <<= 1;
+                twice -= res_;
+                BigInt even = BigInt::multiply(res_, twice, options);
+                if (i == 0) {
+                    res_ = std::move(even);
+                }
+                else {
+                    BigInt sum = BigInt::multiply(res_, res_, options) + BigInt::multiply(next_, next_, options);
+                    if (odd) {
+                        next_ = even + sum;
+                        res_ = std::move(sum);
+                    }
+                    else {
+                        res_ = std::move(even);
+                        next_ = std::move(sum);
+                    }
+                }
+            }
+
+            done += stepCost(n >> i);
+            progress_ = 100.0 * done / total;
+        }
         progress_ = 100.0;
     }
 
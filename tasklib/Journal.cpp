@@ -0,0 +1,406 @@
+#include "Journal.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+constexpr std::uint32_t record_magic = 0x474f4c4d;   // "MLOG"
+
+struct RecordHeader {
+    std::uint32_t magic;
+    std::uint32_t kind;
+    std::uint32_t label_size;
+    std::uint32_t data_size;
+    std::uint32_t checksum;
+    std::int32_t key;
+};
+
+/* FNV-1a */
+std::uint32_t checksum(const RecordHeader& header, const char* payload, const std::size_t size) {
+    std::uint32_t hash = 2166136261u;
+    auto mix = [&](const void* ptr, const std::size_t count) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(ptr);
+        for (std::size_t i = 0; i < count; ++i) {
+            hash = (hash ^ bytes[i]) * 16777619u;
+        }
+    };
+    mix(&header.kind, sizeof(header.kind));
+    mix(&header.key, sizeof(header.key));
+    mix(payload, size);
+    return hash;
+}
+
+std::runtime_error logError(const std::string& path, const char* action) {
+    std::ostringstream msg;
+    msg << "Cannot " << action << " journal '" << path << "', " << strerror(errno);
+    return std::runtime_error(msg.str());
+}
+
+/* Resizes the file to capacity and maps it, nullptr with errno set on failure */
+char* mapFile(const int fd, const std::size_t capacity) {
+    if (ftruncate(fd, static_cast<off_t>(capacity)) < 0) {
+        return nullptr;
+    }
+    void* ptr = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return ptr == MAP_FAILED ? nullptr : static_cast<char*>(ptr);
+}
+
+/* Makes a rename in the directory of path durable */
+bool syncDirectory(const std::string& path) {
+    const std::size_t slash = path.find_last_of('/');
+    const std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+    const int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool synced = fsync(fd) == 0;
+    const int error = errno;
+    close(fd);
+    errno = error;
+    return synced;
+}
+
+}
+
+/* --- MAPPED LOG --- */
+
+MappedLog::MappedLog(const std::string& path, const std::size_t capacity)
+: path_(path), fd_(-1), map_(nullptr), capacity_(std::max(capacity, sizeof(RecordHeader) * 64)),
+  end_(0), synced_(0), rewrites_(0)
+{
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        throw logError(path_, "open");
+    }
+    struct stat st;
+    if (fstat(fd_, &st) == 0 && static_cast<std::size_t>(st.st_size) > capacity_) {
+        capacity_ = static_cast<std::size_t>(st.st_size);
+    }
+    map(capacity_);
+}
+
+MappedLog::~MappedLog() {
+    sync(true);
+    unmap();
+}
+
+void MappedLog::map(const std::size_t capacity) {
+    char* const map = mapFile(fd_, capacity);
+    if (!map) {
+        throw logError(path_, "map");
+    }
+    map_ = map;
+    capacity_ = capacity;
+}
+
+void MappedLog::unmap() {
+    munmap(map_, capacity_);
+    close(fd_);
+}
+
+std::size_t MappedLog::recordSize(const std::size_t label_size, const std::size_t data_size) {
+    return sizeof(RecordHeader) + label_size + data_size;
+}
+
+void MappedLog::replay(const std::function<void(const Record&)>& visit) {
+    std::size_t offset = 0;
+    while (offset + sizeof(RecordHeader) <= capacity_) {
+        RecordHeader header;
+        std::memcpy(&header, map_ + offset, sizeof(header));
+        if (header.magic != record_magic) {
+            break;
+        }
+        const std::size_t payload = static_cast<std::size_t>(header.label_size) + header.data_size;
+        if (offset + sizeof(RecordHeader) + payload > capacity_) {
+            break;
+        }
+        const char* bytes = map_ + offset + sizeof(RecordHeader);
+        if (checksum(header, bytes, payload) != header.checksum) {
+            // Torn tail of an interrupted write
+            break;
+        }
+
+        visit(Record{header.kind, header.key, std::string(bytes, header.label_size),
+                     std::string(bytes + header.label_size, header.data_size)});
+        offset += sizeof(RecordHeader) + payload;
+    }
+    end_ = synced_ = offset;
+
+    // Anything after the last valid record is garbage, make sure it cannot be parsed later
+    if (end_ + sizeof(RecordHeader) <= capacity_) {
+        std::memset(map_ + end_, 0, sizeof(RecordHeader));
+    }
+}
+
+bool MappedLog::fits(const std::size_t label_size, const std::size_t data_size) const {
+    // Keep room for the zeroed header marking the end
+    return end_ + recordSize(label_size, data_size) + sizeof(RecordHeader) <= capacity_;
+}
+
+void MappedLog::append(const std::uint32_t kind, const std::int32_t key, const std::string& label, const std::string& data) {
+    end_ += write(map_ + end_, kind, key, label, data);
+}
+
+std::size_t MappedLog::write(char* const out, const std::uint32_t kind, const std::int32_t key,
+                             const std::string& label, const std::string& data) {
+    RecordHeader header;
+    header.magic = record_magic;
+    header.kind = kind;
+    header.label_size = static_cast<std::uint32_t>(label.size());
+    header.data_size = static_cast<std::uint32_t>(data.size());
+    header.key = key;
+
+    const std::size_t size = recordSize(label.size(), data.size());
+    std::memcpy(out + sizeof(RecordHeader), label.data(), label.size());
+    std::memcpy(out + sizeof(RecordHeader) + label.size(), data.data(), data.size());
+    header.checksum = checksum(header, out + sizeof(RecordHeader), label.size() + data.size());
+    std::memset(out + size, 0, sizeof(RecordHeader));
+    // Header last, a record is not visible to replay() before its payload
+    std::memcpy(out, &header, sizeof(header));
+    return size;
+}
+
+void MappedLog::rewrite(const std::vector<Record>& records, const std::size_t needed) {
+    std::size_t live_size = needed + sizeof(RecordHeader);
+    for (const Record& record : records) {
+        live_size += recordSize(record.label.size(), record.data.size());
+    }
+    std::size_t capacity = capacity_;
+    while (live_size > capacity / 2) {
+        capacity *= 2;
+    }
+
+    // Built aside, the members keep the old log till the new one is in place
+    const std::string tmp_path = path_ + ".compact";
+    const int fd = ::open(tmp_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw logError(tmp_path, "create");
+    }
+    char* const map = mapFile(fd, capacity);
+    auto discard = [&](const char* action) {
+        const std::runtime_error error = logError(tmp_path, action);
+        if (map) {
+            munmap(map, capacity);
+        }
+        close(fd);
+        unlink(tmp_path.c_str());
+        return error;
+    };
+    if (!map) {
+        throw discard("map");
+    }
+
+    std::size_t end = 0;
+    for (const Record& record : records) {
+        end += write(map + end, record.kind, record.key, record.label, record.data);
+    }
+    if (msync(map, end + sizeof(RecordHeader), MS_SYNC) < 0 || fsync(fd) < 0) {
+        throw discard("sync");
+    }
+    if (rename(tmp_path.c_str(), path_.c_str()) < 0) {
+        throw discard("replace");
+    }
+    // The path names the new log now, switch to it even if the rename cannot be made durable
+    unmap();
+    fd_ = fd;
+    map_ = map;
+    capacity_ = capacity;
+    end_ = synced_ = end;
+    rewrites_++;
+
+    if (!syncDirectory(path_)) {
+        throw logError(path_, "sync directory of");
+    }
+}
+
+void MappedLog::sync(const bool durable) {
+    char* begin;
+    std::size_t length;
+    if (takeUnsynced(begin, length)) {
+        msync(begin, length, durable ? MS_SYNC : MS_ASYNC);
+    }
+}
+
+bool MappedLog::takeUnsynced(char*& begin, std::size_t& length) {
+    if (end_ == synced_) {
+        return false;
+    }
+    // msync needs a page aligned address
+    const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    const std::size_t offset = synced_ / page * page;
+    begin = map_ + offset;
+    length = end_ - offset;
+    synced_ = end_;
+    return true;
+}
+
+/* --- SCHEDULER JOURNAL --- */
+
+SchedulerJournal::SchedulerJournal(const std::string& path, const std::chrono::milliseconds commit_interval,
+                                   const std::size_t capacity)
+: log_(path, capacity), records_(0), last_id_(0), frozen_(false),
+  appended_(0), requested_(0), durable_(0), syncing_(false), closing_(false), commit_interval_(commit_interval)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    log_.replay([this](const MappedLog::Record& record) {
+        apply(record);
+        records_++;
+    });
+    if (records_ > 2 * live_.size()) {
+        compact(lock, 0);
+    }
+    lock.unlock();
+
+    thread_ = std::thread(&SchedulerJournal::run, this);
+}
+
+SchedulerJournal::~SchedulerJournal() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closing_ = true;
+        commit_condition_.notify_all();
+    }
+    thread_.join();
+}
+
+void SchedulerJournal::apply(const MappedLog::Record& record) {
+    last_id_ = std::max(last_id_, static_cast<int>(record.key));
+    switch (record.kind) {
+        case submission:
+        {
+            live_[record.key] = JournalEntry{record.label, record.data, Task::StateType::running};
+            break;
+        }
+        case stateChange:
+        {
+            auto it = live_.find(record.key);
+            if (it == live_.end() || record.data.size() != 1) {
+                break;
+            }
+            const auto state = static_cast<Task::StateType>(record.data[0]);
+            if (Task::finished(state)) {
+                live_.erase(it);
+            }
+            else {
+                it->second.state = state;
+            }
+            break;
+        }
+    }
+}
+
+void SchedulerJournal::submitted(const int task_id, const std::string& type, const std::string& input) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    append(lock, submission, task_id, type, input);
+}
+
+void SchedulerJournal::transition(const int task_id, const Task::StateType state) {
+    if (frozen_) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!live_.count(task_id)) {
+        return;
+    }
+    append(lock, stateChange, task_id, std::string(), std::string(1, static_cast<char>(state)));
+}
+
+void SchedulerJournal::append(std::unique_lock<std::mutex>& lock, const std::uint32_t kind, const int task_id,
+                              const std::string& label, const std::string& data) {
+    if (!log_.fits(label.size(), data.size()) || records_ > 2 * live_.size() + 1024) {
+        compact(lock, MappedLog::recordSize(label.size(), data.size()));
+    }
+    log_.append(kind, task_id, label, data);
+    apply(MappedLog::Record{kind, task_id, label, data});
+    records_++;
+    appended_++;
+}
+
+void SchedulerJournal::compact(std::unique_lock<std::mutex>& lock, const std::size_t needed) {
+    // The commit thread may be syncing the current mapping
+    committed_.wait(lock, [&]() {
+        return !syncing_;
+    });
+
+    std::vector<MappedLog::Record> records;
+    records.reserve(live_.size() * 2);
+    for (const auto& item : live_) {
+        records.push_back(MappedLog::Record{submission, item.first, item.second.type, item.second.input});
+        if (item.second.state != Task::StateType::running) {
+            records.push_back(MappedLog::Record{stateChange, item.first, std::string(),
+                                                std::string(1, static_cast<char>(item.second.state))});
+        }
+    }
+    log_.rewrite(records, needed);
+    records_ = records.size();
+    // Rewritten records are durable already
+    durable_ = appended_;
+}
+
+void SchedulerJournal::commit() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const std::uint64_t target = appended_;
+    requested_ = std::max(requested_, target);
+    commit_condition_.notify_all();
+    committed_.wait(lock, [&]() {
+        return durable_ >= target;
+    });
+}
+
+void SchedulerJournal::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        commit_condition_.wait_for(lock, commit_interval_, [&]() {
+            return closing_ || requested_ > durable_;
+        });
+
+        const std::uint64_t target = appended_;
+        char* begin;
+        std::size_t length;
+        if (durable_ < target && log_.takeUnsynced(begin, length)) {
+            // One sync for every event appended since the previous commit, appends go on meanwhile
+            syncing_ = true;
+            lock.unlock();
+            msync(begin, length, MS_SYNC);
+            lock.lock();
+            syncing_ = false;
+        }
+        if (durable_ < target) {
+            durable_ = target;
+            committed_.notify_all();
+        }
+        if (closing_) {
+            return;
+        }
+    }
+}
+
+std::unordered_map<int, JournalEntry> SchedulerJournal::live() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return live_;
+}
+
+int SchedulerJournal::lastId() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return last_id_;
+}
+
+std::size_t SchedulerJournal::size() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return log_.size();
+}
+
+std::size_t SchedulerJournal::compactions() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return log_.rewrites();
+}
@@ -0,0 +1,206 @@
+#ifndef JOURNAL
+#define JOURNAL
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Task.h"
+
+/**
+ * Append-only log of checksummed records in a memory-mapped file
+ *
+ * Appending is a copy into the mapping, sync() makes the bytes written since the previous call
+ * durable. A torn tail is ignored by replay(). Once full, the owner rewrites the log with its
+ * live records, the file is grown if they would fill more than half of it.
+ * Not thread safe, owners serialize the calls.
+*/
+class MappedLog
+{
+public:
+    struct Record {
+        std::uint32_t kind;
+        std::int32_t key;
+        std::string label;
+        std::string data;
+    };
+
+    /**
+     * Opens or creates the log
+     *
+     * @throw runtime_error if the file cannot be opened or mapped
+    */
+    MappedLog(const std::string& path, const std::size_t capacity);
+
+    ~MappedLog();
+
+    MappedLog(const MappedLog&) = delete;
+    MappedLog& operator= (const MappedLog&) = delete;
+
+    /* Calls visit for every intact record in order, appends continue after the last one */
+    void replay(const std::function<void(const Record&)>& visit);
+
+    /* False if the record does not fit in the remaining space */
+    bool fits(const std::size_t label_size, const std::size_t data_size) const;
+
+    /* The record must fit */
+    void append(const std::uint32_t kind, const std::int32_t key, const std::string& label, const std::string& data);
+
+    /**
+     * Replaces the log by records, keeping room for needed more bytes
+     * Written aside and renamed, a crash or a failure meanwhile leaves the old log intact
+     *
+     * @throw runtime_error if the new file cannot be written or renamed, the log is unchanged,
+     *        or if the rename cannot be made durable, the log is replaced then
+    */
+    void rewrite(const std::vector<Record>& records, const std::size_t needed);
+
+    /* Flushes the bytes appended since the previous call, waiting for the disk if durable */
+    void sync(const bool durable);
+
+    /**
+     * Hands the bytes appended since the previous call to a caller syncing them without the owner's lock
+     * Returns false if there are none. The mapping must not be rewritten till msync returns
+    */
+    bool takeUnsynced(char*& begin, std::size_t& length);
+
+    static std::size_t recordSize(const std::size_t label_size, const std::size_t data_size);
+
+    /* Bytes in use */
+    std::size_t size() const { return end_; }
+
+    std::size_t rewrites() const { return rewrites_; }
+
+private:
+    const std::string path_;
+    int fd_;
+    char* map_;
+    std::size_t capacity_;
+    std::size_t end_;
+    std::size_t synced_;
+    std::size_t rewrites_;
+
+    void map(const std::size_t capacity);
+    void unmap();
+
+    /* Writes a record at out, followed by a zeroed header marking the end, returns its size */
+    static std::size_t write(char* const out, const std::uint32_t kind, const std::int32_t key,
+                             const std::string& label, const std::string& data);
+};
+
+/* T::typeName() for task types with a stable name (journaled, checkpointable), nullptr otherwise */
+template<class T>
+auto typeNameOf(int) -> decltype(T::typeName()) { return T::typeName(); }
+
+template<class T>
+const char* typeNameOf(long) { return nullptr; }
+
+/* Input of a journaled task type, stored as is, empty for other types */
+template<class T, class I>
+auto journalInput(const I& input, int) -> decltype(static_cast<typename T::InputType>(input), std::string()) {
+    static_assert(std::is_trivially_copyable<typename T::InputType>::value, "Journaled inputs must be trivially copyable");
+    const auto value = static_cast<typename T::InputType>(input);
+    return std::string(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template<class T, class I>
+std::string journalInput(const I&, long) { return std::string(); }
+
+/* Submitted task still to finish, as recovered from the journal */
+struct JournalEntry {
+    std::string type;
+    std::string input;
+    Task::StateType state;
+};
+
+/**
+ * Journal of task submissions and state transitions, see Scheduler::enableJournal
+ *
+ * A journaled task type declares:
+ *   static const char* typeName();   stable name stored with its submissions
+ *   using InputType = ...;           trivially copyable input, stored as is
+ *
+ * Events are copied into the mapped log by the calling thread, no syscall per event. A commit
+ * thread syncs everything appended since the previous commit in one call (group commit), commit()
+ * waits for it. Finished tasks are dropped by compaction, run once their records outnumber those
+ * of live tasks, so opening the journal costs time proportional to the live tasks.
+*/
+class SchedulerJournal
+{
+public:
+    /**
+     * Opens or creates the journal and recovers the tasks not finished yet
+     *
+     * @throw runtime_error if the file cannot be opened or mapped
+    */
+    SchedulerJournal(const std::string& path, const std::chrono::milliseconds commit_interval = std::chrono::milliseconds(2),
+                     const std::size_t capacity = 4 << 20);
+
+    ~SchedulerJournal();
+
+    SchedulerJournal(const SchedulerJournal&) = delete;
+    SchedulerJournal& operator= (const SchedulerJournal&) = delete;
+
+    void submitted(const int task_id, const std::string& type, const std::string& input);
+
+    void transition(const int task_id, const Task::StateType state);
+
+    /* Later transitions are ignored, tasks stopped by a shutdown stay live for the next start */
+    void freeze() { frozen_ = true; }
+
+    /* Locks calling thread till every event recorded so far is durable */
+    void commit();
+
+    /* Tasks submitted and not finished yet */
+    std::unordered_map<int, JournalEntry> live() const;
+
+    /* Highest task id ever recorded */
+    int lastId() const;
+
+    /* Bytes of the log in use */
+    std::size_t size() const;
+
+    std::size_t compactions() const;
+
+private:
+    enum Kind : std::uint32_t {
+        submission = 1,
+        stateChange = 2,
+    };
+
+    MappedLog log_;
+    std::unordered_map<int, JournalEntry> live_;
+    std::size_t records_;
+    int last_id_;
+    std::atomic<bool> frozen_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable commit_condition_;
+    std::condition_variable committed_;
+    std::uint64_t appended_;
+    std::uint64_t requested_;
+    std::uint64_t durable_;
+    bool syncing_;
+    bool closing_;
+    const std::chrono::milliseconds commit_interval_;
+
+    std::thread thread_;
+
+    /* Under mutex_ */
+    void apply(const MappedLog::Record& record);
+    void append(std::unique_lock<std::mutex>& lock, const std::uint32_t kind, const int task_id,
+                const std::string& label, const std::string& data);
+    void compact(std::unique_lock<std::mutex>& lock, const std::size_t needed);
+
+    void run();
+};
+
+#endif
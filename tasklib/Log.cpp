@@ -0,0 +1,151 @@
+#include "Log.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+namespace {
+    /* Records drained per write() */
+    constexpr std::size_t batch_size = 64;
+
+    /* Global log, constructed in place: plain new does not honour the queue's alignment before C++17 */
+    alignas(Log) char global_storage[sizeof(Log)];
+    /* Set by discardGlobal(), a global log constructed afterwards discards too */
+    bool global_discarding = false;
+}
+
+Log::Log(const int fd, const std::size_t capacity)
+: queue_(capacity), fd_(fd), queued_(0), dropped_(0), sleeping_(false), written_(0), flushing_(0), closing_(false),
+  discarding_(false)
+{
+    thread_ = std::thread(&Log::run, this);
+}
+
+Log::Log()
+: queue_(1), fd_(-1), queued_(0), dropped_(0), sleeping_(false), written_(0), flushing_(0), closing_(false),
+  discarding_(true)
+{}
+
+Log::~Log() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closing_ = true;
+        condition_.notify_all();
+    }
+    thread_.join();
+}
+
+Log& Log::global() {
+    // Never destroyed: tasks failing while static objects are torn down still have a sink
+    static Log* log = []() {
+        if (global_discarding) {
+            return new (global_storage) Log();
+        }
+        Log* instance = new (global_storage) Log(STDERR_FILENO);
+        std::atexit([]() {
+            global().flush();
+        });
+        return instance;
+    }();
+    return *log;
+}
+
+void Log::discardGlobal() {
+    global_discarding = true;
+    global().discarding_.store(true, std::memory_order_relaxed);
+}
+
+bool Log::write(const char* text, const std::size_t size) {
+    if (discarding_.load(std::memory_order_relaxed)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Record record;
+    record.size = static_cast<std::uint16_t>(std::min(size, sizeof(record.text) - 1));
+    std::memcpy(record.text, text, record.size);
+    record.text[record.size++] = '\n';
+
+    if (!queue_.tryPush(record)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    queued_.fetch_add(1, std::memory_order_release);
+
+    if (sleeping_.load(std::memory_order_acquire) && sleeping_.exchange(false)) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.notify_one();
+    }
+    return true;
+}
+
+void Log::flush() {
+    if (discarding_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    const std::uint64_t target = queued_.load(std::memory_order_acquire);
+    flushing_.fetch_add(1);
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        condition_.notify_one();
+        written_condition_.wait(lock, [&]() {
+            return written_.load() >= target;
+        });
+    }
+    flushing_.fetch_sub(1);
+}
+
+void Log::run() {
+    Record records[batch_size];
+    std::vector<char> buffer;
+    buffer.reserve(batch_size * sizeof(Record));
+
+    for (;;) {
+        const std::size_t n = queue_.tryPopBatch(records, batch_size);
+        if (n) {
+            buffer.clear();
+            for (std::size_t i = 0; i < n; ++i) {
+                buffer.insert(buffer.end(), records[i].text, records[i].text + records[i].size);
+            }
+            const int fd = fd_.load(std::memory_order_relaxed);
+            std::size_t offset = 0;
+            while (offset < buffer.size()) {
+                const ssize_t result = ::write(fd, buffer.data() + offset, buffer.size() - offset);
+                if (result < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (result <= 0) {
+                    // Nowhere to write, the lines are lost
+                    break;
+                }
+                offset += static_cast<std::size_t>(result);
+            }
+
+            written_.fetch_add(n);
+            if (flushing_.load()) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                written_condition_.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (closing_) {
+            return;
+        }
+        // A producer seeing the flag notifies, the timeout covers a push racing the announcement
+        sleeping_.store(true, std::memory_order_release);
+        if (queue_.empty()) {
+            condition_.wait_for(lock, std::chrono::milliseconds(50));
+        }
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+}
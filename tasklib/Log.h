@@ -0,0 +1,86 @@
+#ifndef LOG
+#define LOG
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Channel.h"
+
+/**
+ * Asynchronous log sink
+ *
+ * Threads copy a line into a fixed-size record of a lock-free queue (MpmcQueue) and return, no
+ * allocation, lock or system call on their side. One writer thread drains the queue in batches
+ * and writes each batch with a single write(). When the queue is full, lines are dropped and
+ * counted rather than making the caller wait. Lines longer than a record are truncated.
+*/
+class Log
+{
+public:
+    struct Record {
+        std::uint16_t size;
+        char text[254];
+    };
+
+    explicit Log(const int fd, const std::size_t capacity = 4096);
+
+    /* Writes what is queued, then stops the writer thread */
+    ~Log();
+
+    Log(const Log&) = delete;
+    Log& operator= (const Log&) = delete;
+
+    /* Sink of the library (task failures), writes to stderr and is flushed at exit */
+    static Log& global();
+
+    /**
+     * Makes the global log of a forked child drop every line, without a writer thread
+     * The child's copy of the log has no writer and may hold a locked mutex, it is not used anymore.
+     * Called first thing in the child, before anything may use global()
+    */
+    static void discardGlobal();
+
+    /* Queues text as one line, the newline is appended, false if it was dropped */
+    bool write(const char* text, const std::size_t size);
+    bool write(const std::string& text) { return write(text.data(), text.size()); }
+
+    /* Locks calling thread till the lines queued so far are written */
+    void flush();
+
+    /* Descriptor lines are written to from the next batch on, -1 discards them */
+    void setOutput(const int fd) { fd_.store(fd, std::memory_order_relaxed); }
+
+    /* Lines dropped on a full queue */
+    std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    MpmcQueue<Record> queue_;
+    std::atomic<int> fd_;
+    std::atomic<std::uint64_t> queued_;
+    std::atomic<std::uint64_t> dropped_;
+
+    /* The writer sleeps only after announcing it, producers notify only then */
+    std::atomic<bool> sleeping_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::condition_variable written_condition_;
+    std::atomic<std::uint64_t> written_;
+    /* Threads in flush(), the writer takes the lock to wake them only if there are any */
+    std::atomic<int> flushing_;
+    bool closing_;
+    /* Lines are dropped on the caller's side, there is no writer thread */
+    std::atomic<bool> discarding_;
+
+    std::thread thread_;
+
+    /* Discarding log, see discardGlobal() */
+    Log();
+
+    void run();
+};
+
+#endif
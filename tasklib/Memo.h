@@ -0,0 +1,218 @@
+#ifndef MEMO
+#define MEMO
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "Task.h"
+
+/**
+ * Memoization of pure tasks, see Scheduler::submitShared.
+ *
+ * A memoizable task type declares:
+ *   using ResultType = ...;                     result of the computation
+ *   static std::string memoKey(const I& input); identifies the computation from its input
+ *   ResultType result() const;                  read once execute() has returned
+*/
+
+/* Least recently used cache of results, values are type-erased and cast back by the caller */
+class ResultCache
+{
+public:
+    explicit ResultCache(const std::size_t capacity)
+    : capacity_(capacity)
+    {}
+
+    void setCapacity(const std::size_t capacity) {
+        capacity_ = capacity;
+        evict();
+    }
+
+    std::size_t size() const { return entries_.size(); }
+
+    /* nullptr if missing, a hit becomes the most recently used entry */
+    std::shared_ptr<const void> find(const std::string& key) {
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return nullptr;
+        }
+        entries_.splice(entries_.begin(), entries_, it->second);
+        return it->second->second;
+    }
+
+    void insert(const std::string& key, std::shared_ptr<const void> value) {
+        auto it = index_.find(key);
+        if (it != index_.end()) {
+            entries_.erase(it->second);
+            index_.erase(it);
+        }
+        entries_.emplace_front(key, std::move(value));
+        index_[key] = entries_.begin();
+        evict();
+    }
+
+    void clear() {
+        entries_.clear();
+        index_.clear();
+    }
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const void>>;
+
+    std::size_t capacity_;
+    std::list<Entry> entries_;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+
+    void evict() {
+        while (entries_.size() > capacity_) {
+            index_.erase(entries_.back().first);
+            entries_.pop_back();
+        }
+    }
+};
+
+/* One computation shared by every subscriber that submitted the same key */
+template<class R>
+struct SharedFlight {
+    std::mutex mutex;
+    std::condition_variable done_condition;
+
+    Task* task = nullptr;
+    Task::StateType state = Task::StateType::running;
+    std::shared_ptr<const R> result;
+    std::string error;
+    std::exception_ptr exception;
+
+    /* The submitter creating the task counts as the first one */
+    int subscribers = 1;
+    /* The last subscriber left, no one attaches anymore and the task is stopped once known */
+    bool stopping = false;
+
+    /* Removes the flight from the scheduler's in-flight table, set by the scheduler */
+    std::function<void()> forget;
+
+    void finish(const Task::StateType final_state, std::shared_ptr<const R> value, const std::string& message = "",
+                std::exception_ptr failure = nullptr) {
+        std::unique_lock<std::mutex> lock(mutex);
+        state = final_state;
+        result = std::move(value);
+        error = message;
+        exception = std::move(failure);
+        done_condition.notify_all();
+    }
+};
+
+/**
+ * Subscription to a shared computation
+ * Stopping a subscription only stops the computation when no other subscriber remains
+*/
+template<class R>
+class SharedResult
+{
+public:
+    SharedResult(std::shared_ptr<SharedFlight<R>> flight, const bool cached)
+    : flight_(std::move(flight)), cached_(cached), subscribed_(!cached)
+    {}
+
+    SharedResult(SharedResult&& other) noexcept
+    : flight_(std::move(other.flight_)), cached_(other.cached_), subscribed_(other.subscribed_)
+    {
+        other.subscribed_ = false;
+    }
+
+    SharedResult(const SharedResult&) = delete;
+    SharedResult& operator= (const SharedResult&) = delete;
+
+    /* Dropping a subscription leaves the computation running for the cache */
+    ~SharedResult() {
+        if (subscribed_ && flight_) {
+            std::unique_lock<std::mutex> lock(flight_->mutex);
+            flight_->subscribers--;
+        }
+    }
+
+    /* True if the result came from the cache without running anything */
+    bool cached() const { return cached_; }
+
+    /* Id of the task computing the result, 0 if served from the cache or not created yet */
+    int taskId() const {
+        std::unique_lock<std::mutex> lock(flight_->mutex);
+        return flight_->task ? flight_->task->id() : 0;
+    }
+
+    bool ready() const {
+        std::unique_lock<std::mutex> lock(flight_->mutex);
+        return flight_->state != Task::StateType::running;
+    }
+
+    /**
+     * Locks calling thread till the shared computation finishes
+     *
+     * @throw runtime_error if the computation was stopped or could not be submitted, the exception
+     * the task failed with if it failed
+    */
+    R get() const {
+        BlockingRegion blocking;
+        std::unique_lock<std::mutex> lock(flight_->mutex);
+        flight_->done_condition.wait(lock, [&]() {
+            return flight_->state != Task::StateType::running;
+        });
+
+        if (flight_->exception) {
+            std::rethrow_exception(flight_->exception);
+        }
+        if (flight_->state != Task::StateType::completed) {
+            throw std::runtime_error(flight_->error.empty() ? "Shared computation stopped" : flight_->error);
+        }
+        return *flight_->result;
+    }
+
+    /**
+     * Leaves the computation, the task is stopped if this was its last subscriber
+     *
+     * @throw runtime_error if already unsubscribed
+    */
+    void stop() {
+        if (!subscribed_) {
+            throw std::runtime_error("Cannot stop shared result, not subscribed");
+        }
+        subscribed_ = false;
+
+        Task* task = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(flight_->mutex);
+            if (--flight_->subscribers > 0 || flight_->state != Task::StateType::running) {
+                return;
+            }
+            // New submissions must not attach to a computation about to be stopped; if the task is not
+            // created yet, the submitter stops it
+            flight_->stopping = true;
+            task = flight_->task;
+        }
+
+        flight_->forget();
+        if (task) {
+            try {
+                task->stop();
+            }
+            catch (const std::runtime_error&) {
+                // finished meanwhile
+            }
+        }
+    }
+
+private:
+    std::shared_ptr<SharedFlight<R>> flight_;
+    const bool cached_;
+    bool subscribed_;
+};
+
+#endif
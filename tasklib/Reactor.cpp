@@ -0,0 +1,523 @@
+#include "Reactor.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#ifdef TASKLIB_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "StopException.h"
+
+namespace {
+
+/* Token reserved for the reactor's own wake-ups */
+constexpr std::uint64_t internal_token = 0;
+
+std::runtime_error ioError(const char* action, const int fd, const int error) {
+    std::ostringstream msg;
+    msg << "Cannot " << action << " fd '" << fd << "', " << strerror(error);
+    return std::runtime_error(msg.str());
+}
+
+std::runtime_error reactorError(const int fd, const std::string& failure) {
+    std::ostringstream msg;
+    msg << "Cannot wait on fd '" << fd << "', reactor failed: " << failure;
+    return std::runtime_error(msg.str());
+}
+
+}
+
+/* Kernel side of the reactor, submission calls are serialized by the reactor mutex */
+class Poller
+{
+public:
+    virtual ~Poller() = default;
+
+    /* Returns false if op completed immediately, result is set then */
+    virtual bool submit(const std::uint64_t token, const IoOp& op, int& result) = 0;
+
+    /* Returns true if the kernel may still use the operation's buffer, its completion must be awaited */
+    virtual bool cancel(const std::uint64_t token, const IoOp& op) = 0;
+
+    /* Token completed or was cancelled */
+    virtual void retire(const std::uint64_t) {}
+
+    /* Locks the reactor thread till completions are available or interrupt() is called */
+    virtual void wait(std::vector<IoCompletion>& completions) = 0;
+
+    virtual void interrupt() = 0;
+};
+
+/* One-shot readiness through epoll, an eventfd interrupts the wait */
+class EpollPoller : public Poller
+{
+public:
+    EpollPoller()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)), event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    {
+        if (epoll_fd_ < 0 || event_fd_ < 0) {
+            throw std::runtime_error(std::string("Cannot create reactor, ") + strerror(errno));
+        }
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = internal_token;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &event);
+    }
+
+    ~EpollPoller() override {
+        close(event_fd_);
+        close(epoll_fd_);
+    }
+
+    bool submit(const std::uint64_t token, const IoOp& op, int& result) override {
+        if (armed_.count(op.fd)) {
+            std::ostringstream msg;
+            msg << "Cannot wait on fd '" << op.fd << "', already waited on";
+            throw std::runtime_error(msg.str());
+        }
+
+        epoll_event event{};
+        event.events = EPOLLONESHOT | ((op.events & POLLIN) ? EPOLLIN : 0u) | ((op.events & POLLOUT) ? EPOLLOUT : 0u);
+        event.data.u64 = token;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, op.fd, &event) < 0) {
+            if (errno == EPERM) {
+                // Regular files are always ready
+                result = op.events;
+                return false;
+            }
+            throw ioError("wait on", op.fd, errno);
+        }
+        armed_[op.fd] = token;
+        fds_[token] = op.fd;
+        return true;
+    }
+
+    bool cancel(const std::uint64_t, const IoOp&) override {
+        return false;
+    }
+
+    void retire(const std::uint64_t token) override {
+        auto it = fds_.find(token);
+        if (it == fds_.end()) {
+            return;
+        }
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, it->second, nullptr);
+        armed_.erase(it->second);
+        fds_.erase(it);
+    }
+
+    void wait(std::vector<IoCompletion>& completions) override {
+        epoll_event events[64];
+        const int count = epoll_wait(epoll_fd_, events, 64, -1);
+        if (count < 0 && errno != EINTR) {
+            throw std::runtime_error(std::string("Cannot wait for epoll events, ") + strerror(errno));
+        }
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.u64 == internal_token) {
+                std::uint64_t value;
+                while (::read(event_fd_, &value, sizeof(value)) > 0) {}
+                continue;
+            }
+            // EPOLLIN/OUT/ERR/HUP share their values with poll()
+            completions.push_back({events[i].data.u64, static_cast<int>(events[i].events & ~EPOLLONESHOT)});
+        }
+    }
+
+    void interrupt() override {
+        const std::uint64_t value = 1;
+        if (::write(event_fd_, &value, sizeof(value)) < 0) {
+            // counter saturated, the reactor is awake anyway
+        }
+    }
+
+private:
+    const int epoll_fd_;
+    const int event_fd_;
+
+    /* One waiter per descriptor, epoll keeps a single registration per fd */
+    std::unordered_map<int, std::uint64_t> armed_;
+    std::unordered_map<std::uint64_t, int> fds_;
+};
+
+#ifdef TASKLIB_HAVE_IO_URING
+
+/* io_uring through raw syscalls, rings are mapped once and every submission is entered at once */
+class UringPoller : public Poller
+{
+public:
+    /* nullptr if the kernel does not provide io_uring */
+    static std::unique_ptr<UringPoller> create(const unsigned entries) {
+        std::unique_ptr<UringPoller> poller(new UringPoller());
+        return poller->setup(entries) ? std::move(poller) : nullptr;
+    }
+
+    ~UringPoller() override {
+        if (sqes_) {
+            munmap(sqes_, sqes_size_);
+        }
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) {
+            munmap(cq_ptr_, cq_size_);
+        }
+        if (sq_ptr_) {
+            munmap(sq_ptr_, sq_size_);
+        }
+        if (ring_fd_ >= 0) {
+            close(ring_fd_);
+        }
+    }
+
+    bool submit(const std::uint64_t token, const IoOp& op, int&) override {
+        io_uring_sqe* sqe = next();
+        sqe->fd = op.fd;
+        sqe->user_data = token;
+        switch (op.kind) {
+            case IoOp::Kind::poll:
+                sqe->opcode = IORING_OP_POLL_ADD;
+                sqe->poll32_events = static_cast<std::uint16_t>(op.events);
+                break;
+            case IoOp::Kind::read:
+            case IoOp::Kind::write:
+                sqe->opcode = op.kind == IoOp::Kind::read ? IORING_OP_READ : IORING_OP_WRITE;
+                sqe->addr = reinterpret_cast<std::uint64_t>(op.buffer);
+                sqe->len = static_cast<std::uint32_t>(op.size);
+                // Current file position, ignored by pipes and sockets
+                sqe->off = static_cast<std::uint64_t>(-1);
+                break;
+        }
+        enter();
+        return true;
+    }
+
+    bool cancel(const std::uint64_t token, const IoOp& op) override {
+        io_uring_sqe* sqe = next();
+        sqe->opcode = op.kind == IoOp::Kind::poll ? IORING_OP_POLL_REMOVE : IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = token;
+        sqe->user_data = internal_token;
+        enter();
+        return op.kind != IoOp::Kind::poll;
+    }
+
+    void wait(std::vector<IoCompletion>& completions) override {
+        if (syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR) {
+            throw std::runtime_error(std::string("Cannot wait for io_uring completions, ") + strerror(errno));
+        }
+
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+            if (cqe.user_data != internal_token) {
+                completions.push_back({cqe.user_data, cqe.res});
+            }
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    }
+
+    void interrupt() override {
+        next()->opcode = IORING_OP_NOP;
+        enter();
+    }
+
+private:
+    int ring_fd_ = -1;
+    unsigned entries_ = 0;
+
+    void* sq_ptr_ = nullptr;
+    std::size_t sq_size_ = 0;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned* sq_mask_ = nullptr;
+    unsigned* sq_array_ = nullptr;
+    io_uring_sqe* sqes_ = nullptr;
+    std::size_t sqes_size_ = 0;
+
+    void* cq_ptr_ = nullptr;
+    std::size_t cq_size_ = 0;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned* cq_mask_ = nullptr;
+    io_uring_cqe* cqes_ = nullptr;
+
+    UringPoller() = default;
+
+    bool setup(const unsigned entries) {
+        io_uring_params params{};
+        ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring_fd_ < 0) {
+            return false;
+        }
+        entries_ = params.sq_entries;
+
+        sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) {
+            sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+        }
+
+        sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED) {
+            sq_ptr_ = nullptr;
+            return false;
+        }
+        cq_ptr_ = single_mmap ? sq_ptr_
+                : mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED) {
+            cq_ptr_ = nullptr;
+            return false;
+        }
+        sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(sq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        char* cq = static_cast<char*>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return true;
+    }
+
+    /* Cleared entry at the submission tail, published by enter() */
+    io_uring_sqe* next() {
+        const unsigned tail = *sq_tail_;
+        if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= entries_) {
+            throw std::runtime_error("Cannot submit to io_uring, submission queue full");
+        }
+        const unsigned index = tail & *sq_mask_;
+        io_uring_sqe* sqe = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        return sqe;
+    }
+
+    void enter() {
+        __atomic_store_n(sq_tail_, *sq_tail_ + 1, __ATOMIC_RELEASE);
+        while (syscall(__NR_io_uring_enter, ring_fd_, 1, 0, 0, nullptr, 0) < 0) {
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                throw std::runtime_error(std::string("Cannot submit to io_uring, ") + strerror(errno));
+            }
+        }
+    }
+};
+
+#endif
+
+Reactor::Reactor(const ReactorBackend preferred)
+: backend_(ReactorBackend::epoll), next_token_(internal_token), stopping_(false)
+{
+#ifdef TASKLIB_HAVE_IO_URING
+    if (preferred == ReactorBackend::ioUring) {
+        poller_ = UringPoller::create(256);
+        if (poller_) {
+            backend_ = ReactorBackend::ioUring;
+        }
+    }
+#else
+    (void)preferred;
+#endif
+    if (!poller_) {
+        poller_ = std::make_unique<EpollPoller>();
+    }
+    thread_ = std::thread(&Reactor::run, this);
+}
+
+Reactor::~Reactor() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stopping_ = true;
+        // The thread is gone already when failed
+        if (failure_.empty()) {
+            poller_->interrupt();
+        }
+    }
+    thread_.join();
+}
+
+std::size_t Reactor::pending() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return waits_.size();
+}
+
+void Reactor::waitReadable(Task& task, const int fd) {
+    submit(task, IoOp{IoOp::Kind::poll, fd, POLLIN, nullptr, 0});
+}
+
+void Reactor::waitWritable(Task& task, const int fd) {
+    submit(task, IoOp{IoOp::Kind::poll, fd, POLLOUT, nullptr, 0});
+}
+
+std::size_t Reactor::read(Task& task, const int fd, void* buffer, const std::size_t size) {
+    if (backend_ == ReactorBackend::ioUring) {
+        const int result = submit(task, IoOp{IoOp::Kind::read, fd, 0, buffer, size});
+        if (result < 0) {
+            throw ioError("read", fd, -result);
+        }
+        return static_cast<std::size_t>(result);
+    }
+
+    for (;;) {
+        waitReadable(task, fd);
+        const ssize_t result = ::read(fd, buffer, size);
+        if (result >= 0) {
+            return static_cast<std::size_t>(result);
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            throw ioError("read", fd, errno);
+        }
+    }
+}
+
+void Reactor::write(Task& task, const int fd, const void* buffer, const std::size_t size) {
+    const char* data = static_cast<const char*>(buffer);
+    std::size_t written = 0;
+    while (written < size) {
+        if (backend_ == ReactorBackend::ioUring) {
+            const int result = submit(task, IoOp{IoOp::Kind::write, fd, 0, const_cast<char*>(data + written), size - written});
+            if (result < 0) {
+                throw ioError("write", fd, -result);
+            }
+            written += static_cast<std::size_t>(result);
+            continue;
+        }
+
+        waitWritable(task, fd);
+        const ssize_t result = ::write(fd, data + written, size - written);
+        if (result >= 0) {
+            written += static_cast<std::size_t>(result);
+        }
+        else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            throw ioError("write", fd, errno);
+        }
+    }
+}
+
+int Reactor::submit(Task& task, const IoOp& op) {
+    Wait wait;
+    wait.task = &task;
+    wait.done = false;
+    wait.cancelled = false;
+    wait.failed = false;
+    wait.result = 0;
+
+    std::uint64_t token;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!failure_.empty()) {
+            throw reactorError(op.fd, failure_);
+        }
+        token = ++next_token_;
+        int result = 0;
+        if (!poller_->submit(token, op, result)) {
+            return result;
+        }
+        waits_[token] = &wait;
+    }
+
+    auto done = [&]() {
+        return wait.done.load(std::memory_order_acquire);
+    };
+    try {
+        while (!done()) {
+            task.park(done);
+        }
+    }
+    catch (const StopException&) {
+        cancel(token, wait, op);
+        throw;
+    }
+    if (wait.failed) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        throw reactorError(op.fd, failure_);
+    }
+    return wait.result;
+}
+
+void Reactor::cancel(const std::uint64_t token, Wait& wait, const IoOp& op) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!waits_.count(token)) {
+        return;
+    }
+    if (poller_->cancel(token, op)) {
+        // The kernel owns the buffer till the operation completes
+        wait.cancelled = true;
+        cancel_condition_.wait(lock, [&]() {
+            return wait.done.load(std::memory_order_acquire);
+        });
+        return;
+    }
+    waits_.erase(token);
+    poller_->retire(token);
+}
+
+void Reactor::run() {
+    std::vector<IoCompletion> completions;
+    while (!stopping_) {
+        completions.clear();
+        try {
+            poller_->wait(completions);
+        }
+        catch (const std::exception& e) {
+            fail(e.what());
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (const IoCompletion& completion : completions) {
+            auto it = waits_.find(completion.token);
+            if (it == waits_.end()) {
+                continue;
+            }
+            Wait* wait = it->second;
+            waits_.erase(it);
+            poller_->retire(completion.token);
+            complete(*wait, completion.result);
+        }
+    }
+}
+
+void Reactor::complete(Wait& wait, const int result) {
+    // The waiting task may return as soon as done is set, wait must not be used afterwards
+    Task* task = wait.task;
+    const bool cancelled = wait.cancelled;
+    wait.result = result;
+    wait.done.store(true, std::memory_order_release);
+    if (cancelled) {
+        cancel_condition_.notify_all();
+    }
+    else {
+        task->wake();
+    }
+}
+
+void Reactor::fail(const std::string& message) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    failure_ = message;
+    for (auto& entry : waits_) {
+        entry.second->failed = true;
+        complete(*entry.second, -EIO);
+    }
+    waits_.clear();
+}
@@ -0,0 +1,133 @@
+#ifndef REACTOR
+#define REACTOR
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "Task.h"
+
+/* Kernel interface used to wait for descriptors */
+enum class ReactorBackend {
+    epoll,      // readiness only, reads and writes are issued by the task once ready
+    ioUring,    // readiness, reads and writes submitted to the kernel
+};
+
+/* One operation on a descriptor, see Reactor */
+struct IoOp {
+    enum class Kind { poll, read, write };
+
+    Kind kind;
+    int fd;
+    short events;       // poll: POLLIN/POLLOUT
+    void* buffer;       // read/write
+    std::size_t size;   // read/write
+};
+
+/* Completion reported by a Poller, result is revents for poll, bytes or -errno for read/write */
+struct IoCompletion {
+    std::uint64_t token;
+    int result;
+};
+
+class Poller;
+
+/**
+ * Lets tasks wait for file descriptors without blocking in a syscall.
+ *
+ * A waiting task is parked on its control condition (Task::park) while a single reactor thread
+ * waits for every pending operation, the task is woken on completion. Pause/stop are honoured while
+ * waiting, a stopped task cancels its operation before unwinding. io_uring is used when the kernel
+ * and the build support it, epoll otherwise. Regular files are always ready under epoll, so their
+ * reads are synchronous there.
+ *
+ * If the kernel wait itself fails the reactor thread ends: the parked tasks are woken with
+ * runtime_error, and so is every later call.
+ *
+ * Every method taking a Task must be called from that task's inner thread.
+*/
+class Reactor
+{
+public:
+    explicit Reactor(const ReactorBackend preferred = ReactorBackend::ioUring);
+
+    ~Reactor();
+
+    Reactor(const Reactor&) = delete;
+    Reactor& operator= (const Reactor&) = delete;
+
+    ReactorBackend backend() const { return backend_; }
+
+    /**
+     * Locks calling task till fd is readable / writable, or hung up
+     *
+     * @throw StopException if task is stopped meanwhile
+     * @throw runtime_error if fd cannot be waited on
+    */
+    void waitReadable(Task& task, const int fd);
+    void waitWritable(Task& task, const int fd);
+
+    /**
+     * Reads up to size bytes, locking calling task till some are available
+     * Returns 0 at end of file
+     *
+     * @throw StopException if task is stopped meanwhile
+     * @throw runtime_error if the read fails
+    */
+    std::size_t read(Task& task, const int fd, void* buffer, const std::size_t size);
+
+    /**
+     * Writes size bytes, locking calling task while fd is full
+     *
+     * @throw StopException if task is stopped meanwhile, part of the data may have been written
+     * @throw runtime_error if the write fails
+    */
+    void write(Task& task, const int fd, const void* buffer, const std::size_t size);
+
+    /* Operations in flight */
+    std::size_t pending() const;
+
+private:
+    struct Wait {
+        Task* task;
+        std::atomic<bool> done;
+        bool cancelled;
+        bool failed;
+        int result;
+    };
+
+    ReactorBackend backend_;
+    std::unique_ptr<Poller> poller_;
+
+    /* Guards waits_ and the poller's submission side */
+    mutable std::mutex mutex_;
+    std::condition_variable cancel_condition_;
+    std::unordered_map<std::uint64_t, Wait*> waits_;
+    std::uint64_t next_token_;
+    /* Why the reactor thread ended, empty while it runs */
+    std::string failure_;
+
+    std::atomic<bool> stopping_;
+    std::thread thread_;
+
+    /* Submits op and parks task till it completes, returns the completion result */
+    int submit(Task& task, const IoOp& op);
+
+    void cancel(const std::uint64_t token, Wait& wait, const IoOp& op);
+
+    /* Sets the result of wait and wakes its task, called with mutex_ held */
+    void complete(Wait& wait, const int result);
+
+    /* Fails every pending wait and the later ones with message */
+    void fail(const std::string& message);
+
+    void run();
+};
+
+#endif
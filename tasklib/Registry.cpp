@@ -0,0 +1,24 @@
+#include "Registry.h"
+
+long long parseTaskArgument(const TaskTypeInfo& type, const std::string& text) {
+    const TaskArgument& argument = type.argument;
+    if (text.empty()) {
+        return argument.default_value;
+    }
+
+    long long value = 0;
+    std::size_t parsed = 0;
+    try {
+        value = std::stoll(text, &parsed);
+    }
+    catch (const std::logic_error&) {
+        parsed = 0;
+    }
+    if (parsed != text.size() || value < argument.min || value > argument.max) {
+        std::ostringstream msg;
+        msg << "Cannot start task, '" << type.name << "', " << argument.name << " must be an integer in ["
+            << argument.min << ", " << argument.max << "]";
+        throw std::runtime_error(msg.str());
+    }
+    return value;
+}
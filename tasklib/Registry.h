@@ -0,0 +1,148 @@
+#ifndef REGISTRY
+#define REGISTRY
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "Scheduler.h"
+
+/**
+ * Compile-time registry of task types started by name, see TaskRegistry.
+ *
+ * A registered task type declares:
+ *   static constexpr const char* typeName();            name it is started with
+ *   static constexpr TaskArgument taskArgument();       argument schema, bounds and default
+ *   using InputType = ...;                              arithmetic, or a duration taken in milliseconds
+*/
+
+/* Entry of the registry table, built at compile time */
+struct TaskTypeInfo {
+    const char* name;
+    TaskArgument argument;
+    Task& (*create)(Scheduler& scheduler, long long argument);
+    void (*setConcurrencyLimit)(Scheduler& scheduler, std::size_t limit);
+    /* Task not started nor owned by any scheduler, see WorkerPool */
+    std::unique_ptr<Task> (*construct)(int id, long long argument);
+};
+
+constexpr bool sameTypeName(const char* lhs, const char* rhs) {
+    while (*lhs && *lhs == *rhs) {
+        ++lhs;
+        ++rhs;
+    }
+    return *lhs == *rhs;
+}
+
+/**
+ * Parses text as the argument of type, its default if text is empty
+ *
+ * @throw runtime_error if text is not an integer within the argument bounds
+*/
+long long parseTaskArgument(const TaskTypeInfo& type, const std::string& text);
+
+/**
+ * Table of the task types Types, in order. The index of a type is its numeric id
+ * Lookups scan the table, no hashing: registries hold a handful of types
+*/
+template<class... Types>
+class TaskRegistry
+{
+    static_assert(sizeof...(Types) > 0, "A registry holds at least one task type");
+
+    template<class I>
+    static I makeInput(const long long value, std::true_type /* arithmetic */) {
+        return static_cast<I>(value);
+    }
+
+    template<class I>
+    static I makeInput(const long long value, std::false_type /* duration */) {
+        return std::chrono::duration_cast<I>(std::chrono::milliseconds(value));
+    }
+
+    template<class T>
+    static Task& start(Scheduler& scheduler, const long long argument) {
+        using I = typename T::InputType;
+        return scheduler.addTask<T>(makeInput<I>(argument, std::is_arithmetic<I>()));
+    }
+
+    template<class T>
+    static std::unique_ptr<Task> construct(const int id, const long long argument) {
+        using I = typename T::InputType;
+        return std::make_unique<T>(id, makeInput<I>(argument, std::is_arithmetic<I>()));
+    }
+
+    template<class T>
+    static void setLimit(Scheduler& scheduler, const std::size_t limit) {
+        scheduler.setConcurrencyLimit<T>(limit);
+    }
+
+    static constexpr TaskTypeInfo table_[] = {
+        TaskTypeInfo{Types::typeName(), Types::taskArgument(), &start<Types>, &setLimit<Types>, &construct<Types>}...
+    };
+
+public:
+    static constexpr std::size_t size() { return sizeof...(Types); }
+
+    static constexpr const TaskTypeInfo& at(const std::size_t index) { return table_[index]; }
+
+    /* nullptr if no type has this name */
+    static constexpr const TaskTypeInfo* find(const char* name) {
+        for (std::size_t i = 0; i < size(); ++i) {
+            if (sameTypeName(table_[i].name, name)) {
+                return &table_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    /* Numeric id of T, fails to compile if T is not registered */
+    template<class T>
+    static constexpr std::size_t indexOf() {
+        std::size_t i = 0;
+        while (!sameTypeName(table_[i].name, T::typeName())) {
+            ++i;
+        }
+        return i;
+    }
+
+    /**
+     * Type named name, or with the numeric id name
+     *
+     * @throw runtime_error if there is none
+    */
+    static const TaskTypeInfo& get(const std::string& name) {
+        if (const TaskTypeInfo* type = find(name.c_str())) {
+            return *type;
+        }
+        std::size_t index = 0;
+        for (const char digit : name) {
+            index = digit >= '0' && digit <= '9' && index < size() ? index * 10 + static_cast<std::size_t>(digit - '0') : size();
+        }
+        if (!name.empty() && index < size()) {
+            return at(index);
+        }
+        std::ostringstream msg;
+        msg << "Cannot find task type, '" << name << "', not registered";
+        throw std::runtime_error(msg.str());
+    }
+
+    /**
+     * Starts a task of the type named name with argument, its default if empty
+     *
+     * @throw runtime_error if the type is unknown or the argument invalid, or as Scheduler::addTask
+    */
+    static Task& create(Scheduler& scheduler, const std::string& name, const std::string& argument = std::string()) {
+        const TaskTypeInfo& type = get(name);
+        return type.create(scheduler, parseTaskArgument(type, argument));
+    }
+};
+
+template<class... Types>
+constexpr TaskTypeInfo TaskRegistry<Types...>::table_[];
+
+#endif
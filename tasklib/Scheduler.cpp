@@ -1,6 +1,9 @@
 #include "Scheduler.h"
 
+#include <algorithm>
+
 const std::set<int> Scheduler::getTaskIds() const {
+    std::unique_lock<std::mutex> lock(mutex_);
     std::set<int> task_ids;
     for (auto& item : tasks_) {
         task_ids.insert(item.first);
@@ -10,6 +13,7 @@ const std::set<int> Scheduler::getTaskIds() const {
 }
 
 Task& Scheduler::getTask(const int id) {
+    std::unique_lock<std::mutex> lock(mutex_);
     if (tasks_.count(id)) {
         return *tasks_[id];   
     }
@@ -17,4 +21,449 @@ Task& Scheduler::getTask(const int id) {
     std::ostringstream msg;
     msg << "Task with id '" << id << "' not found";
     throw std::runtime_error(msg.str());
-}
\ No newline at end of file
+}
+
+Scheduler::~Scheduler() {
+    shutdown();
+
+    // Tasks call back into the scheduler when they finish, destroy them while it is still whole
+    tasks_ref_.clear();
+    tasks_.clear();
+}
+
+ShutdownReport Scheduler::shutdown(const std::chrono::milliseconds drain) {
+    const auto begin = std::chrono::steady_clock::now();
+    const auto deadline = drain == std::chrono::milliseconds::max() || drain > std::chrono::hours(24 * 365)
+        ? std::chrono::steady_clock::time_point::max() : begin + drain;
+
+    std::vector<std::reference_wrapper<Task>> tasks;
+    std::deque<Task*> queued;
+    std::unique_ptr<Watchdog> watchdog;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closing_ = true;
+        // Stopped outside the lock, it visits the tasks till then
+        watchdog = std::move(watchdog_);
+        // Blocked submitters give up
+        queue_space_.notify_all();
+        if (checkpoints_) {
+            checkpoints_->setTicker(std::chrono::milliseconds(0), nullptr);
+        }
+        if (journal_) {
+            journal_->freeze();
+        }
+        tasks = tasks_ref_;
+        queued = queue_;
+    }
+    watchdog.reset();
+
+    ShutdownReport report{0, {}, std::chrono::nanoseconds(0)};
+    auto requestStop = [&](Task& task) {
+        try {
+            task.requestStop();
+            report.stopped++;
+        }
+        catch (const std::runtime_error&) {
+            // Stopped meanwhile by someone else
+        }
+    };
+
+    // Queued tasks first, nothing is admitted once closing, then every running task at once
+    for (Task* task : queued) {
+        requestStop(*task);
+    }
+    for (Task& task : tasks) {
+        const Task::StateType state = task.status();
+        if (state == Task::StateType::running || state == Task::StateType::paused) {
+            requestStop(task);
+        }
+    }
+
+    for (Task& task : tasks) {
+        // Idle tasks have no thread to wait for
+        if (task.status() == Task::StateType::idle) {
+            continue;
+        }
+        if (task.joinTaskUntil(deadline)) {
+            task.join();
+        }
+        else {
+            report.stragglers.push_back(task.id());
+        }
+    }
+    report.elapsed = std::chrono::steady_clock::now() - begin;
+    return report;
+}
+
+void Scheduler::enableCheckpoints(const std::string& path, const std::chrono::milliseconds interval) {
+    auto journal = std::make_unique<CheckpointJournal>(path);
+    journal->setTicker(interval, [this]() {
+        checkpoint();
+    });
+
+    const auto records = journal->records();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    // New ids must not collide with those of checkpoints still to restore
+    if (!records.empty()) {
+        count_ = std::max(count_, records.rbegin()->first);
+    }
+    checkpoints_ = std::move(journal);
+}
+
+void Scheduler::checkpoint() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (Task& task : tasks_ref_) {
+        if (task.status() == Task::StateType::running) {
+            task.requestCheckpoint();
+        }
+    }
+}
+
+void Scheduler::enableJournal(const std::string& path) {
+    auto journal = std::make_unique<SchedulerJournal>(path);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    count_ = std::max(count_, journal->lastId());
+    journal_ = std::move(journal);
+}
+
+void Scheduler::enableWatchdog(const std::chrono::milliseconds threshold, const std::chrono::milliseconds interval) {
+    auto watchdog = std::make_unique<Watchdog>([this](const std::function<void(Task&)>& visit) {
+        index_.forEach(1u << static_cast<unsigned>(Task::StateType::running), nullptr, visit);
+    }, threshold, interval);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::swap(watchdog_, watchdog);
+    lock.unlock();
+}
+
+void Scheduler::enableThreadPool(const ThreadPoolOptions& options) {
+    auto pool = std::make_unique<ThreadPool>(options);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (pool_) {
+        throw std::runtime_error("Cannot enable thread pool, already enabled");
+    }
+    pool_ = std::move(pool);
+}
+
+ThreadPool* Scheduler::threadPool() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return pool_.get();
+}
+
+Watchdog* Scheduler::watchdog() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return watchdog_.get();
+}
+
+SchedulerJournal* Scheduler::schedulerJournal() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return journal_.get();
+}
+
+CheckpointJournal* Scheduler::checkpointJournal() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return checkpoints_.get();
+}
+
+Reactor& Scheduler::reactor() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!reactor_) {
+        reactor_ = std::make_unique<Reactor>();
+    }
+    return *reactor_;
+}
+
+TaskGroup& Scheduler::createGroup(TaskGroup* parent) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    groups_.push_back(std::make_unique<TaskGroup>(static_cast<int>(groups_.size()) + 1, parent));
+    return *groups_.back();
+}
+
+void Scheduler::setConcurrencyLimit(const std::size_t limit) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    limit_ = limit;
+    dispatch();
+}
+
+void Scheduler::setAdmissionQueue(const std::size_t capacity, const AdmissionPolicy policy) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_capacity_ = capacity;
+    admission_policy_ = policy;
+    queue_space_.notify_all();
+}
+
+void Scheduler::setBudget(Task& task, const BudgetLimits& limits) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto owned = tasks_.find(task.id());
+    if (owned == tasks_.end() || owned->second.get() != &task) {
+        std::ostringstream msg;
+        msg << "Cannot budget task, '" << task.id() << "', not owned by this scheduler";
+        throw std::runtime_error(msg.str());
+    }
+    budgetOf(task).own().setLimits(limits);
+}
+
+void Scheduler::setTypeBudget(const std::type_index& type, const BudgetLimits& limits) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::unique_ptr<Budget>& budget = type_budgets_[type];
+    if (budget) {
+        budget->setLimits(limits);
+        return;
+    }
+
+    budget = std::make_unique<Budget>();
+    budget->setLimits(limits);
+    for (Task& task : tasks_ref_) {
+        if (std::type_index(typeid(task)) == type) {
+            budgetOf(task).setType(budget.get());
+        }
+    }
+}
+
+TaskBudget& Scheduler::budgetOf(Task& task) {
+    std::unique_ptr<TaskBudget>& budget = budgets_[task.id()];
+    if (!budget) {
+        budget = std::make_unique<TaskBudget>();
+        task.setBudget(budget.get());
+    }
+    return *budget;
+}
+
+std::size_t Scheduler::runningCount() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return running_;
+}
+
+std::size_t Scheduler::queuedCount() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return queue_.size();
+}
+
+bool Scheduler::hasCapacity(const std::type_index& type) const {
+    if (running_ >= limit_) {
+        return false;
+    }
+
+    auto limit = type_limits_.find(type);
+    if (limit == type_limits_.end()) {
+        return true;
+    }
+
+    auto running = type_running_.find(type);
+    return running == type_running_.end() || running->second < limit->second;
+}
+
+Scheduler::AdmissionDecision Scheduler::reserve(const std::type_index& type, std::unique_lock<std::mutex>& lock) {
+    while (true) {
+        if (closing_) {
+            throw std::runtime_error("Cannot add task, scheduler shutting down");
+        }
+        if (hasCapacity(type)) {
+            running_++;
+            type_running_[type]++;
+            return AdmissionDecision::run;
+        }
+
+        if (queue_.size() < queue_capacity_) {
+            return AdmissionDecision::wait;
+        }
+
+        switch(admission_policy_) {
+            case AdmissionPolicy::reject:
+            {
+                std::ostringstream msg;
+                msg << "Cannot admit task, admission queue full (" << queue_.size() << " waiting)";
+                throw std::runtime_error(msg.str());
+            }
+            case AdmissionPolicy::callerRuns:
+            {
+                return AdmissionDecision::callerRuns;
+            }
+            case AdmissionPolicy::block:
+            {
+                BlockingRegion blocking;
+                queue_space_.wait(lock);
+                break;
+            }
+        }
+    }
+}
+
+void Scheduler::submit(std::unique_ptr<Task> task, const std::type_index& type, AdmissionDecision decision,
+                       FinishCallback on_finish, std::unique_lock<std::mutex>& lock) {
+    Task& ref = *task;
+    const int id = ref.id();
+
+    ref.setFinishHook([this](Task& finished, Task::StateType final_state) {
+        onTaskFinished(finished, final_state);
+    });
+
+    tasks_[id] = std::move(task);
+    tasks_ref_.push_back(ref);
+    index_.add(ref);
+
+    auto type_budget = type_budgets_.find(type);
+    if (type_budget != type_budgets_.end()) {
+        budgetOf(ref).setType(type_budget->second.get());
+    }
+
+    if (decision != AdmissionDecision::idle) {
+        launch(ref, type, decision, std::move(on_finish), lock);
+    }
+}
+
+void Scheduler::restartTask(Task& task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto owned = tasks_.find(task.id());
+    if (owned == tasks_.end() || owned->second.get() != &task) {
+        std::ostringstream msg;
+        msg << "Cannot restart task, '" << task.id() << "', not owned by this scheduler";
+        throw std::runtime_error(msg.str());
+    }
+    if (admissions_.count(task.id())) {
+        std::ostringstream msg;
+        msg << "Cannot restart task, '" << task.id() << "', not finished";
+        throw std::runtime_error(msg.str());
+    }
+
+    task.rearm();
+
+    // Claimed while reserve() may wait for a slot, a concurrent restart of the task fails above
+    const std::type_index type(typeid(task));
+    admissions_.emplace(task.id(), Admission{type, false, nullptr});
+    AdmissionDecision decision;
+    try {
+        decision = reserve(type, lock);
+    }
+    catch (...) {
+        admissions_.erase(task.id());
+        throw;
+    }
+    launch(task, type, decision, nullptr, lock);
+}
+
+void Scheduler::launch(Task& ref, const std::type_index& type, AdmissionDecision decision,
+                       FinishCallback on_finish, std::unique_lock<std::mutex>& lock) {
+    Admission admission{type, decision == AdmissionDecision::run, std::move(on_finish)};
+    auto claimed = admissions_.find(ref.id());
+    if (claimed != admissions_.end()) {
+        claimed->second = std::move(admission);
+    }
+    else {
+        admissions_.emplace(ref.id(), std::move(admission));
+    }
+
+    switch(decision) {
+        case AdmissionDecision::run:
+        {
+            ref.start();
+            break;
+        }
+        case AdmissionDecision::wait:
+        {
+            ref.queue();
+            queue_.push_back(&ref);
+            break;
+        }
+        case AdmissionDecision::callerRuns:
+        {
+            // Backpressure: the submitter does the work itself
+            lock.unlock();
+            ref.runInline();
+            break;
+        }
+        case AdmissionDecision::idle:
+        {
+            break;
+        }
+    }
+}
+
+void Scheduler::onTaskFinished(Task& task, const Task::StateType final_state) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto admission = admissions_.find(task.id());
+    if (admission == admissions_.end()) {
+        return;
+    }
+
+    if (admission->second.holds_slot) {
+        running_--;
+        type_running_[admission->second.type]--;
+        // Blocked submitters wait for a slot as well as for queue space
+        queue_space_.notify_all();
+    }
+    else {
+        // Stopped while waiting for admission
+        auto queued = std::find(queue_.begin(), queue_.end(), &task);
+        if (queued != queue_.end()) {
+            queue_.erase(queued);
+            queue_space_.notify_all();
+        }
+    }
+    FinishCallback on_finish = std::move(admission->second.on_finish);
+    admissions_.erase(admission);
+
+    // Tasks stopped by the scheduler's destruction keep their checkpoint for the next start
+    if (checkpoints_ && (final_state != Task::StateType::stopped || !closing_)) {
+        checkpoints_->forget(task.id());
+    }
+
+    if (!closing_) {
+        dispatch();
+    }
+
+    lock.unlock();
+    if (on_finish) {
+        on_finish(task, final_state);
+    }
+}
+
+void Scheduler::setResultCacheCapacity(const std::size_t capacity) {
+    std::unique_lock<std::mutex> lock(memo_mutex_);
+    results_.setCapacity(capacity);
+}
+
+void Scheduler::clearResultCache() {
+    std::unique_lock<std::mutex> lock(memo_mutex_);
+    results_.clear();
+}
+
+void Scheduler::forgetFlight(const std::string& key, const void* flight) {
+    std::unique_lock<std::mutex> lock(memo_mutex_);
+    auto it = flights_.find(key);
+    if (it != flights_.end() && it->second.get() == flight) {
+        flights_.erase(it);
+    }
+}
+
+void Scheduler::dispatch() {
+    if (closing_) {
+        return;
+    }
+
+    bool dequeued = false;
+    for (auto it = queue_.begin(); it != queue_.end() && running_ < limit_; ) {
+        Task& task = **it;
+        auto& admission = admissions_.at(task.id());
+        if (!hasCapacity(admission.type)) {
+            ++it;
+            continue;
+        }
+
+        it = queue_.erase(it);
+        dequeued = true;
+        // A task stopped while queued reports through onTaskFinished, which waits for this lock
+        if (task.admit()) {
+            running_++;
+            type_running_[admission.type]++;
+            admission.holds_slot = true;
+        }
+    }
+
+    if (dequeued) {
+        queue_space_.notify_all();
+    }
+}
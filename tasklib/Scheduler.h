@@ -2,49 +2,541 @@
 #define SCHEDULER
 
 #include <set>
+#include <deque>
 #include <functional>
+#include <limits>
+#include <mutex>
+#include <typeindex>
 #include <vector>
 
 #include "Task.h"
+#include "Budget.h"
+#include "Executor.h"
+#include "Checkpoint.h"
+#include "Memo.h"
+#include "Reactor.h"
+#include "TaskGroup.h"
+#include "TaskIndex.h"
+#include "ThreadPool.h"
+#include "Watchdog.h"
+
+/* Outcome of Scheduler::shutdown */
+struct ShutdownReport {
+    std::size_t stopped;                // running, paused or queued tasks stopped by the shutdown
+    std::vector<int> stragglers;        // tasks still running at the deadline
+    std::chrono::nanoseconds elapsed;
+};
+
+/* What addTask does when the concurrency limit is reached and the admission queue is full */
+enum class AdmissionPolicy {
+    block,          // caller waits until the queue has room
+    reject,         // addTask throws
+    callerRuns,     // task runs to its end on the caller's thread
+};
 
 class Scheduler
 { 
 
  private:
 
+    /* Outlives the tasks, which update it until they are destroyed */
+    TaskIndex index_;
+
     std::unordered_map<int, std::unique_ptr<Task>> tasks_;
     int count_;
 
     std::vector<std::reference_wrapper<Task>> tasks_ref_;
 
+    /* Guards the registry, tasks may add children from their own threads */
+    mutable std::mutex mutex_;
+
+    Executor executor_;
+
+    /* Admission control, guarded by mutex_ */
+    enum class AdmissionDecision { run, wait, callerRuns, idle };
+
+    using FinishCallback = std::function<void(Task&, Task::StateType)>;
+
+    struct Admission {
+        std::type_index type;
+        bool holds_slot;
+        FinishCallback on_finish;
+    };
+
+    static constexpr std::size_t unlimited = std::numeric_limits<std::size_t>::max();
+
+    std::size_t limit_;
+    std::unordered_map<std::type_index, std::size_t> type_limits_;
+    std::size_t running_;
+    std::unordered_map<std::type_index, std::size_t> type_running_;
+
+    std::size_t queue_capacity_;
+    AdmissionPolicy admission_policy_;
+    std::deque<Task*> queue_;
+    std::condition_variable queue_space_;
+    std::unordered_map<int, Admission> admissions_;
+    bool closing_;
+
+    /* Groups outlive their member tasks, guarded by mutex_ */
+    std::vector<std::unique_ptr<TaskGroup>> groups_;
+
+    /* Created on first use, guarded by mutex_ */
+    std::unique_ptr<Reactor> reactor_;
+
+    /* Set by enableCheckpoints, guarded by mutex_ */
+    std::unique_ptr<CheckpointJournal> checkpoints_;
+
+    /* Set by enableJournal, guarded by mutex_ */
+    std::unique_ptr<SchedulerJournal> journal_;
+
+    /* Set by enableWatchdog, guarded by mutex_ */
+    std::unique_ptr<Watchdog> watchdog_;
+
+    /* Set by enableThreadPool, guarded by mutex_. Outlives the tasks run on it */
+    std::unique_ptr<ThreadPool> pool_;
+
+    /* Cpu and rate budgets, guarded by mutex_. Kept as long as the scheduler, tasks point to them */
+    std::unordered_map<int, std::unique_ptr<TaskBudget>> budgets_;
+    std::unordered_map<std::type_index, std::unique_ptr<Budget>> type_budgets_;
+
+    /* Memoization, guarded by memo_mutex_ */
+    std::mutex memo_mutex_;
+    std::unordered_map<std::string, std::shared_ptr<void>> flights_;
+    ResultCache results_;
+
+    bool hasCapacity(const std::type_index& type) const;
+    AdmissionDecision reserve(const std::type_index& type, std::unique_lock<std::mutex>& lock);
+    void submit(std::unique_ptr<Task> task, const std::type_index& type, AdmissionDecision decision,
+                FinishCallback on_finish, std::unique_lock<std::mutex>& lock);
+    void launch(Task& task, const std::type_index& type, AdmissionDecision decision,
+                FinishCallback on_finish, std::unique_lock<std::mutex>& lock);
+    void onTaskFinished(Task& task, const Task::StateType final_state);
+    void dispatch();
+    void forgetFlight(const std::string& key, const void* flight);
+    /* Budget of task, attached on first use */
+    TaskBudget& budgetOf(Task& task);
+    void setTypeBudget(const std::type_index& type, const BudgetLimits& limits);
+
+    template<class T, class I>
+    T& createTask(const I& input, const Placement& requested, TaskGroup* group, FinishCallback on_finish,
+                  const std::function<void(T&)>& prepare = nullptr, const int recovered_id = 0, const bool idle = false) {
+        const Placement placement = executor_.place(requested);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        const std::type_index type(typeid(T));
+        if (recovered_id && tasks_.count(recovered_id)) {
+            std::ostringstream msg;
+            msg << "Cannot recover task, '" << recovered_id << "', id in use";
+            throw std::runtime_error(msg.str());
+        }
+        const AdmissionDecision decision = idle ? AdmissionDecision::idle : reserve(type, lock);
+        const int id = recovered_id ? recovered_id : ++count_;
+        count_ = std::max(count_, id);
+
+        std::unique_ptr<T> task;
+        {
+            int& node = NodeMemory::threadNode();
+            const int previous = node;
+            node = placement.node;
+            try {
+                task = std::make_unique<T>(id, input);
+            }
+            catch (...) {
+                node = previous;
+                throw;
+            }
+            node = previous;
+        }
+
+        T& taskRef = *task;
+        task->setPlacement(placement);
+        if (pool_) {
+            task->setPool(pool_.get());
+        }
+        if (group) {
+            task->setGroup(group);
+            group->add(taskRef);
+        }
+        const char* type_name = typeNameOf<T>(0);
+        if (type_name) {
+            task->setType(type_name);
+        }
+        if (idle) {
+            // Before the hooks, the task is journaled when it runs
+            task->rearm();
+        }
+        if (checkpoints_ && type_name) {
+            CheckpointJournal* journal = checkpoints_.get();
+            task->setCheckpointHook([journal, type_name](Task& source, const std::string& record) {
+                journal->append(source.id(), type_name, record);
+            });
+        }
+        if (journal_ && type_name) {
+            SchedulerJournal* journal = journal_.get();
+            const std::string record = journalInput<T>(input, 0);
+            if (!idle) {
+                journal->submitted(id, type_name, record);
+            }
+            task->setStateHook([journal, type_name, record](Task& source, Task::StateType state) {
+                // The previous run was dropped from the journal when it finished, the next one is a new submission
+                if (state == Task::StateType::idle) {
+                    journal->submitted(source.id(), type_name, record);
+                }
+                else {
+                    journal->transition(source.id(), state);
+                }
+            });
+        }
+        if (prepare) {
+            prepare(taskRef);
+        }
+        submit(std::move(task), type, decision, std::move(on_finish), lock);
+
+        return taskRef;
+    }
+
 public:
 
-    Scheduler()
-    : count_(0) 
+    Scheduler(const AffinityPolicy policy = AffinityPolicy::none)
+    : count_(0), executor_(Topology::system(), policy),
+      limit_(unlimited), running_(0), queue_capacity_(unlimited),
+      admission_policy_(AdmissionPolicy::block), closing_(false),
+      results_(1024)
     {}
 
-    ~Scheduler() {
+    /* Shuts down without deadline, see shutdown() */
+    ~Scheduler();
+
+    /**
+     * Stops accepting tasks, stops the queued ones, sends stop to every running or paused task at once,
+     * then waits for them till drain has elapsed. Tasks acknowledge at their next checkCommand(), so the
+     * wait is bounded by the slowest poll interval rather than by the number of tasks
+     * Tasks stopped this way keep their checkpoints and journal entries for the next start
+     * Stragglers are reported, not abandoned: the destructor still waits for them
+    */
+    ShutdownReport shutdown(const std::chrono::milliseconds drain = std::chrono::milliseconds::max());
+
+    /**
+     * Creates a task, allocated on its NUMA node, and starts it
+     * Without an explicit placement the task inherits the node of the calling task
+     *
+     * Over the concurrency limits the task is queued (status queued) and started when a slot frees,
+     * with a full queue the admission policy applies
+     *
+     * @throw invalid_argument if the placement names an unavailable cpu
+     * @throw runtime_error if the task is rejected by admission control
+    */
+    template<class T, class I>
+    T& addTask(const I& input, const Placement& requested = Placement()) {
+        return createTask<T>(input, requested, nullptr, nullptr);
     }
 
+    /* As above, the task is a member of group and follows its commands */
     template<class T, class I>
-    T& addTask(const I& input) {
-        count_++;
-        auto task = std::make_unique<T>(count_, input);
-        T& taskRef = *task;
-        task->start();
-        tasks_[count_] = std::move(task);
-        tasks_ref_.push_back(*tasks_[count_]);
+    T& addTask(TaskGroup& group, const I& input, const Placement& requested = Placement()) {
+        return createTask<T>(input, requested, &group, nullptr);
+    }
 
-        return taskRef;
+    /**
+     * Creates a task as addTask does without starting it, status idle, see restartTask
+     * No slot is taken till it runs
+     *
+     * @throw invalid_argument if the placement names an unavailable cpu
+    */
+    template<class T, class I>
+    T& prepareTask(const I& input, const Placement& requested = Placement()) {
+        return createTask<T>(input, requested, nullptr, nullptr, nullptr, 0, true);
     }
 
+    /**
+     * Runs a completed, stopped or idle task of this scheduler again, in place: same id, allocation
+     * and accumulated metrics (see Task::rearm), through admission control as addTask
+     *
+     * @throw runtime_error if the task is not finished, belongs to another scheduler or is rejected
+     * by admission control, it is left idle then
+    */
+    void restartTask(Task& task);
+
+    /* Creates a task group, nested in parent if given. Groups live as long as the scheduler */
+    TaskGroup& createGroup(TaskGroup* parent = nullptr);
+
+    /**
+     * Submits a memoizable task (see Memo.h) under single-flight deduplication:
+     * - a cached result for the key is returned without creating a task
+     * - a computation in flight for the key gets a new subscriber
+     * - otherwise a task is created as in addTask, its result is cached on completion
+     *
+     * @throw runtime_error if the task is rejected by admission control
+    */
+    template<class T, class I>
+    SharedResult<typename T::ResultType> submitShared(const I& input, const Placement& requested = Placement()) {
+        using R = typename T::ResultType;
+        const std::string key = std::string(typeid(T).name()) + '\n' + T::memoKey(input);
+
+        std::shared_ptr<SharedFlight<R>> flight;
+        {
+            std::unique_lock<std::mutex> lock(memo_mutex_);
+            if (auto value = results_.find(key)) {
+                auto cached = std::make_shared<SharedFlight<R>>();
+                cached->finish(Task::StateType::completed, std::static_pointer_cast<const R>(value));
+                return SharedResult<R>(cached, true);
+            }
+
+            auto in_flight = flights_.find(key);
+            if (in_flight != flights_.end()) {
+                auto existing = std::static_pointer_cast<SharedFlight<R>>(in_flight->second);
+                std::unique_lock<std::mutex> flight_lock(existing->mutex);
+                // Running without subscribers still computes for the cache
+                if (!existing->stopping && existing->state == Task::StateType::running) {
+                    existing->subscribers++;
+                    return SharedResult<R>(existing, false);
+                }
+            }
+
+            flight = std::make_shared<SharedFlight<R>>();
+            const SharedFlight<R>* raw = flight.get();
+            flight->forget = [this, key, raw]() {
+                forgetFlight(key, raw);
+            };
+            flights_[key] = flight;
+        }
+
+        try {
+            T& task = createTask<T>(input, requested, nullptr, [this, key, flight](Task& finished, Task::StateType state) {
+                std::shared_ptr<const R> value;
+                if (state == Task::StateType::completed) {
+                    value = std::make_shared<const R>(static_cast<T&>(finished).result());
+                    std::unique_lock<std::mutex> lock(memo_mutex_);
+                    results_.insert(key, value);
+                }
+                flight->forget();
+                flight->finish(state, std::move(value), "", finished.exception());
+            });
+
+            std::unique_lock<std::mutex> lock(flight->mutex);
+            flight->task = &task;
+            if (flight->stopping) {
+                // The only subscription was stopped before the task existed
+                lock.unlock();
+                try {
+                    task.stop();
+                }
+                catch (const std::runtime_error&) {
+                    // finished meanwhile
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            flight->forget();
+            flight->finish(Task::StateType::stopped, nullptr, e.what());
+            throw;
+        }
+
+        return SharedResult<R>(flight, false);
+    }
+
+    /**
+     * Journals checkpoints of checkpointable tasks (see Checkpoint.h) created from now on into path,
+     * a checkpoint is requested from every running task each interval
+     * Checkpoints of completed tasks, and of tasks stopped before the scheduler is destroyed, are dropped
+     *
+     * @throw runtime_error if the journal cannot be opened
+    */
+    void enableCheckpoints(const std::string& path, const std::chrono::milliseconds interval);
+
+    /* Requests a checkpoint from every running task, taken at their next checkCommand() */
+    void checkpoint();
+
+    /* nullptr unless checkpoints are enabled */
+    CheckpointJournal* checkpointJournal();
+
+    /**
+     * Recreates the tasks of type T found in the journal and starts them from their last checkpoint
+     * Restored tasks get new ids, their records move to them
+     *
+     * @throw runtime_error if checkpoints are not enabled or a record is truncated
+    */
+    template<class T>
+    std::vector<std::reference_wrapper<T>> restoreCheckpoints() {
+        CheckpointJournal* journal = checkpointJournal();
+        if (!journal) {
+            throw std::runtime_error("Cannot restore checkpoints, not enabled");
+        }
+
+        SchedulerJournal* recovery = schedulerJournal();
+        const auto live = recovery ? recovery->live() : std::unordered_map<int, JournalEntry>();
+
+        std::vector<std::reference_wrapper<T>> restored;
+        for (const auto& item : journal->records()) {
+            // Tasks in the scheduler journal keep their id and are restored by recoverTasks
+            if (item.second.type != T::typeName() || live.count(item.first)) {
+                continue;
+            }
+            CheckpointReader reader(item.second.data);
+            const auto input = T::checkpointInput(reader);
+            T& task = createTask<T>(input, Placement(), nullptr, nullptr, [&](T& fresh) {
+                fresh.restoreCheckpoint(reader);
+                journal->append(fresh.id(), item.second.type, item.second.data);
+            });
+            journal->forget(item.first);
+            restored.push_back(task);
+        }
+        return restored;
+    }
+
+    /**
+     * Journals submissions and state transitions of journaled tasks (see Journal.h) created from now on
+     * into path, task ids continue after the last one in the journal
+     * Tasks still running or paused when the scheduler is destroyed stay in the journal
+     *
+     * @throw runtime_error if the journal cannot be opened
+    */
+    void enableJournal(const std::string& path);
+
+    /* nullptr unless the journal is enabled */
+    SchedulerJournal* schedulerJournal();
+
+    /**
+     * Recreates the unfinished tasks of type T found in the journal, with their ids, and starts
+     * them from their last checkpoint if checkpoints are enabled. Tasks paused at the time are paused
+     *
+     * @throw runtime_error if the journal is not enabled or an id is already in use
+    */
+    template<class T>
+    std::vector<std::reference_wrapper<T>> recoverTasks() {
+        using I = typename T::InputType;
+        SchedulerJournal* journal = schedulerJournal();
+        if (!journal) {
+            throw std::runtime_error("Cannot recover tasks, journal not enabled");
+        }
+        CheckpointJournal* checkpoints = checkpointJournal();
+        const auto records = checkpoints ? checkpoints->records() : std::map<int, CheckpointRecord>();
+
+        // Submission order
+        const auto live = journal->live();
+        std::map<int, const JournalEntry*> entries;
+        for (const auto& item : live) {
+            if (item.second.type == T::typeName() && item.second.input.size() == sizeof(I)) {
+                entries[item.first] = &item.second;
+            }
+        }
+
+        std::vector<std::reference_wrapper<T>> recovered;
+        for (const auto& item : entries) {
+            I input;
+            std::memcpy(&input, item.second->input.data(), sizeof(I));
+            auto checkpoint = records.find(item.first);
+            T& task = createTask<T>(input, Placement(), nullptr, nullptr, [&](T& fresh) {
+                if (checkpoint != records.end() && checkpoint->second.type == T::typeName()) {
+                    restoreRecord(fresh, checkpoint->second, 0);
+                }
+            }, item.first);
+            if (item.second->state == Task::StateType::paused) {
+                task.pause();
+            }
+            recovered.push_back(task);
+        }
+        return recovered;
+    }
+
+    /**
+     * Starts a watchdog (see Watchdog.h) visiting the running tasks every interval: tasks that have not
+     * reached checkCommand() for threshold are flagged unresponsive, and pause/resume/stop on them fail
+     * with "task unresponsive" instead of blocking. Poll intervals are recorded per task type
+     * Replaces the previous watchdog, if any
+    */
+    void enableWatchdog(const std::chrono::milliseconds threshold, const std::chrono::milliseconds interval);
+
+    /* nullptr unless the watchdog is enabled */
+    Watchdog* watchdog();
+
+    /**
+     * Runs the tasks created from now on on an elastic pool of threads (see ThreadPool.h) instead of a
+     * thread each: as many run at once as the pool's parallelism, and workers blocked in joinTask(),
+     * pause, park() and the other waits of tasklib are made up for up to max_threads
+     *
+     * @throw runtime_error if a pool is already enabled
+     * @throw invalid_argument as ThreadPool
+    */
+    void enableThreadPool(const ThreadPoolOptions& options = ThreadPoolOptions());
+
+    /* nullptr unless the thread pool is enabled */
+    ThreadPool* threadPool();
+
+    /* Maximum number of results kept for submitShared, least recently used ones are evicted */
+    void setResultCacheCapacity(const std::size_t capacity);
+
+    void clearResultCache();
+
+    /* Maximum number of started and unfinished tasks, paused ones included */
+    void setConcurrencyLimit(const std::size_t limit);
+
+    /* Maximum number of started and unfinished tasks of type T */
+    template<class T>
+    void setConcurrencyLimit(const std::size_t limit) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        type_limits_[std::type_index(typeid(T))] = limit;
+        dispatch();
+    }
+
+    /**
+     * Limits the cpu time and the poll rate of task (see Budget.h), replacing its previous limits, default
+     * limits remove them. Enforced at its checkCommand(): a task over budget waits there, off cpu and still
+     * answering commands, till its buckets have refilled, see Task::throttledTime()
+     *
+     * @throw runtime_error if the task is not owned by this scheduler
+    */
+    void setBudget(Task& task, const BudgetLimits& limits);
+
+    /* As above for a budget shared by every task of type T, current and future ones, on top of their own */
+    template<class T>
+    void setBudget(const BudgetLimits& limits) {
+        setTypeBudget(std::type_index(typeid(T)), limits);
+    }
+
+    /* Bounds the number of tasks waiting for a slot, policy applies once it is full */
+    void setAdmissionQueue(const std::size_t capacity, const AdmissionPolicy policy);
+
+    std::size_t runningCount() const;
+
+    std::size_t queuedCount() const;
+
     const std::set<int> getTaskIds() const;
 
     Task& getTask(const int id);
 
     const std::vector<std::reference_wrapper<Task>> getTasks() const {
+        std::unique_lock<std::mutex> lock(mutex_);
         return tasks_ref_;
     }
+
+    /* Calls visit for every task in creation order without copying the list, under the scheduler lock */
+    template<class F>
+    void forEachTask(F&& visit) const {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (Task& task : tasks_ref_) {
+            visit(task);
+        }
+    }
+
+    /**
+     * Number of tasks in one of states (mask of 1 << StateType, see StatusFilter) and of type, any type
+     * if nullptr. Read from the indexes, no task is visited
+    */
+    std::size_t countTasks(const unsigned states, const char* type = nullptr) const {
+        return index_.count(states, type);
+    }
+
+    /* Calls visit for the tasks in one of states and of type only, from the indexes, see TaskIndex::forEach */
+    template<class F>
+    void forEachTask(const unsigned states, const char* type, F&& visit) const {
+        index_.forEach(states, type, std::forward<F>(visit));
+    }
+
+    Executor& executor() { return executor_; }
+
+    /* I/O reactor shared by the tasks of this scheduler, started on first use */
+    Reactor& reactor();
 };
 
 #endif
@@ -0,0 +1,712 @@
+#include "Simulation.h"
+
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <map>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+using std::chrono::nanoseconds;
+
+namespace {
+    constexpr nanoseconds never = nanoseconds::max();
+}
+
+struct SimulationRunner {
+    ucontext_t context;
+    char* stack = nullptr;
+    std::size_t stack_size = 0;
+    SimulationEntry* entry = nullptr;
+
+    ~SimulationRunner() {
+        if (stack) {
+            ::munmap(stack, stack_size);
+        }
+    }
+};
+
+struct SimulationEntry {
+    std::unique_ptr<Task> task;
+    nanoseconds arrival;
+    int priority;
+
+    /* Queued in the policy, the copies with an older ticket are stale */
+    bool ready = false;
+    std::uint64_t ticket = 0;
+
+    bool started = false;
+    bool paused = false;
+    bool done = false;
+    /* Charged what it spends rather than options.step per poll */
+    bool spends = false;
+    int worker = -1;
+    SimulationRunner* runner = nullptr;
+
+    /* Virtual time reached by the task, and charged since its last poll */
+    nanoseconds clock{0};
+    nanoseconds pending{0};
+    /* The task hands the turn back at its first poll reaching horizon */
+    nanoseconds slice_end = never;
+    nanoseconds horizon = never;
+    nanoseconds dispatched = never;
+    nanoseconds finish = never;
+};
+
+struct SimulationCommand {
+    nanoseconds when;
+    SimulationEntry* entry;
+    Task::CommandType command;
+};
+
+namespace {
+
+/* Entry of the running context, nullptr in the simulation's */
+thread_local SimulationEntry* running_entry = nullptr;
+/* Simulation switching to a new runner */
+thread_local Simulation* entering = nullptr;
+
+}
+
+/**
+ * Ready tasks of a DispatchPolicy. Entries are pushed with a new ticket, copies whose ticket is not the
+ * entry's latest, or of entries no longer ready, are skipped
+*/
+class DispatchQueue
+{
+public:
+    using Entry = SimulationEntry;
+
+    struct Item {
+        Entry* entry;
+        std::uint64_t ticket;
+
+        bool valid() const { return entry->ready && entry->ticket == ticket; }
+    };
+
+    virtual ~DispatchQueue() = default;
+
+    /* Entry arriving, resumed, or preempted on worker */
+    void push(Entry& entry, const std::size_t worker, const bool preempted) {
+        entry.ready = true;
+        entry.ticket = ++tickets_;
+        insert(Item{&entry, entry.ticket}, worker, preempted);
+    }
+
+    /* Next entry for worker, nullptr if none */
+    Entry* next(const std::size_t worker) {
+        Entry* entry = take(worker);
+        if (entry) {
+            entry->ready = false;
+        }
+        return entry;
+    }
+
+    /* Whether running, at the end of its quantum on worker, hands the worker over */
+    virtual bool preempts(const std::size_t worker, const Entry& running) = 0;
+
+    std::size_t steals() const { return steals_; }
+
+protected:
+    std::size_t steals_ = 0;
+
+    virtual void insert(const Item& item, const std::size_t worker, const bool preempted) = 0;
+    virtual Entry* take(const std::size_t worker) = 0;
+
+    /* Drops the stale items at both ends */
+    static void clean(std::deque<Item>& items) {
+        while (!items.empty() && !items.front().valid()) {
+            items.pop_front();
+        }
+        while (!items.empty() && !items.back().valid()) {
+            items.pop_back();
+        }
+    }
+
+private:
+    std::uint64_t tickets_ = 0;
+};
+
+namespace {
+
+class FifoQueue : public DispatchQueue
+{
+public:
+    bool preempts(const std::size_t, const SimulationEntry&) override {
+        clean(items_);
+        return !items_.empty();
+    }
+
+protected:
+    void insert(const Item& item, const std::size_t, const bool) override {
+        items_.push_back(item);
+    }
+
+    SimulationEntry* take(const std::size_t) override {
+        clean(items_);
+        if (items_.empty()) {
+            return nullptr;
+        }
+        SimulationEntry* entry = items_.front().entry;
+        items_.pop_front();
+        return entry;
+    }
+
+private:
+    std::deque<Item> items_;
+};
+
+class PriorityQueue : public DispatchQueue
+{
+public:
+    bool preempts(const std::size_t, const SimulationEntry& running) override {
+        clean();
+        return !items_.empty() && items_.top().entry->priority > running.priority;
+    }
+
+protected:
+    void insert(const Item& item, const std::size_t, const bool) override {
+        items_.push(item);
+    }
+
+    SimulationEntry* take(const std::size_t) override {
+        clean();
+        if (items_.empty()) {
+            return nullptr;
+        }
+        SimulationEntry* entry = items_.top().entry;
+        items_.pop();
+        return entry;
+    }
+
+private:
+    /* Highest priority first, then lowest ticket */
+    struct Order {
+        bool operator() (const Item& lhs, const Item& rhs) const {
+            if (lhs.entry->priority != rhs.entry->priority) {
+                return lhs.entry->priority < rhs.entry->priority;
+            }
+            return lhs.ticket > rhs.ticket;
+        }
+    };
+
+    std::priority_queue<Item, std::vector<Item>, Order> items_;
+
+    void clean() {
+        while (!items_.empty() && !items_.top().valid()) {
+            items_.pop();
+        }
+    }
+};
+
+class StealingQueue : public DispatchQueue
+{
+public:
+    StealingQueue(const std::size_t workers, const std::uint64_t seed)
+    : deques_(workers), next_(0), random_(seed)
+    {}
+
+    bool preempts(const std::size_t worker, const SimulationEntry&) override {
+        clean(deques_[worker]);
+        return !deques_[worker].empty();
+    }
+
+protected:
+    void insert(const Item& item, const std::size_t worker, const bool preempted) override {
+        if (preempted) {
+            // Oldest end, the first one stolen
+            deques_[worker].push_front(item);
+        }
+        else {
+            deques_[next_++ % deques_.size()].push_back(item);
+        }
+    }
+
+    SimulationEntry* take(const std::size_t worker) override {
+        std::deque<Item>& own = deques_[worker];
+        clean(own);
+        if (!own.empty()) {
+            SimulationEntry* entry = own.back().entry;
+            own.pop_back();
+            return entry;
+        }
+
+        const std::size_t count = deques_.size();
+        const std::size_t first = static_cast<std::size_t>(random_() % count);
+        for (std::size_t i = 0; i < count; ++i) {
+            std::deque<Item>& victim = deques_[(first + i) % count];
+            clean(victim);
+            if (&victim == &own || victim.empty()) {
+                continue;
+            }
+            SimulationEntry* entry = victim.front().entry;
+            victim.pop_front();
+            ++steals_;
+            return entry;
+        }
+        return nullptr;
+    }
+
+private:
+    std::vector<std::deque<Item>> deques_;
+    std::size_t next_;
+    std::mt19937_64 random_;
+};
+
+}
+
+Simulation::Simulation(const SimulationOptions& options)
+: options_(options), ran_(false), now_(0), next_command_(0), preemptions_(0), home_(new Runner()), current_(nullptr)
+{
+    if (options.workers == 0 || options.step <= nanoseconds(0)) {
+        throw std::invalid_argument("Cannot create simulation, it needs a worker and a positive step");
+    }
+
+    switch (options.policy) {
+        case DispatchPolicy::fifo:          queue_.reset(new FifoQueue()); break;
+        case DispatchPolicy::priority:      queue_.reset(new PriorityQueue()); break;
+        case DispatchPolicy::workStealing:  queue_.reset(new StealingQueue(options.workers, options.seed)); break;
+    }
+    workers_.assign(options.workers, nullptr);
+    busy_.assign(options.workers, nanoseconds(0));
+}
+
+Simulation::~Simulation() {
+    // Tasks left paused, or suspended by a failed run, unwind on their runner
+    for (auto& entry : entries_) {
+        if (entry->started && !entry->done) {
+            entry->task->requestStop();
+            entry->paused = false;
+            transfer(*entry->runner);
+        }
+    }
+
+    // Idle runners return from serve()
+    for (auto& runner : runners_) {
+        runner->entry = nullptr;
+        transfer(*runner);
+    }
+}
+
+void Simulation::add(std::unique_ptr<Task> task, const nanoseconds arrival, const int priority) {
+    if (ran_) {
+        std::ostringstream msg;
+        msg << "Cannot add task, '" << task->id() << "', simulation already run";
+        throw std::runtime_error(msg.str());
+    }
+
+    std::unique_ptr<Entry> entry(new Entry());
+    Entry* raw = entry.get();
+    entry->arrival = arrival;
+    entry->priority = priority;
+    // Idle: stopped right away if stopped before its dispatch, started inline by its runner
+    task->rearm();
+    task->setPollHook([this, raw](Task&) { onPoll(*raw); });
+    task->setWaitHook([this, raw](Task&) { onWait(*raw); });
+    task->setStateHook([this, raw](Task&, Task::StateType state) { onState(*raw, state); });
+    entry->task = std::move(task);
+    entries_.push_back(std::move(entry));
+}
+
+std::size_t Simulation::addTrace(const std::vector<TraceRecord>& records) {
+    struct Replayed {
+        std::uint64_t arrival = std::numeric_limits<std::uint64_t>::max();
+        std::uint64_t active = 0;
+        std::uint64_t since = 0;
+        bool running = false;
+    };
+
+    std::map<int, Replayed> tasks;
+    for (const TraceRecord& record : records) {
+        Replayed& task = tasks[record.task_id];
+        switch (record.event) {
+            case TraceEvent::start:
+            {
+                task.arrival = std::min(task.arrival, record.timestamp);
+                break;
+            }
+            case TraceEvent::run:
+            case TraceEvent::resumed:
+            {
+                task.arrival = std::min(task.arrival, record.timestamp);
+                task.since = record.timestamp;
+                task.running = true;
+                break;
+            }
+            case TraceEvent::paused:
+            case TraceEvent::completed:
+            case TraceEvent::stopped:
+            case TraceEvent::failed:
+            {
+                if (task.running) {
+                    task.active += record.timestamp - task.since;
+                    task.running = false;
+                }
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    std::uint64_t first = std::numeric_limits<std::uint64_t>::max();
+    for (const auto& task : tasks) {
+        first = std::min(first, task.second.arrival);
+    }
+
+    const std::uint64_t step = static_cast<std::uint64_t>(options_.step.count());
+    std::size_t added = 0;
+    for (const auto& task : tasks) {
+        if (task.second.arrival == std::numeric_limits<std::uint64_t>::max()) {
+            continue;
+        }
+        const std::uint64_t steps = std::max<std::uint64_t>(1, (task.second.active + step - 1) / step);
+        const SimulatedWork work{static_cast<std::uint32_t>(std::min<std::uint64_t>(steps, std::numeric_limits<std::uint32_t>::max())),
+                                 options_.step};
+        addTask<SimulatedTask>(nanoseconds(task.second.arrival - first), 0, work);
+        ++added;
+    }
+    return added;
+}
+
+SimulationEntry& Simulation::entryOf(const Task& task) const {
+    const std::size_t index = static_cast<std::size_t>(task.id()) - 1;
+    if (task.id() < 1 || index >= entries_.size() || entries_[index]->task.get() != &task) {
+        std::ostringstream msg;
+        msg << "Cannot find task, '" << task.id() << "', not part of the simulation";
+        throw std::invalid_argument(msg.str());
+    }
+    return *entries_[index];
+}
+
+void Simulation::command(const nanoseconds when, Task& task, const Task::CommandType command) {
+    commands_.push_back(Command{when, &entryOf(task), command});
+}
+
+nanoseconds Simulation::now() const {
+    return running_entry ? running_entry->clock : now_;
+}
+
+nanoseconds Simulation::finishTime(const Task& task) const {
+    return entryOf(task).finish;
+}
+
+void Simulation::spend(const nanoseconds duration) {
+    if (running_entry) {
+        running_entry->pending += duration;
+        running_entry->spends = true;
+    }
+}
+
+Simulation::Runner& Simulation::createRunner() {
+    const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    const std::size_t size = (options_.stack_size + page - 1) / page * page + page;
+    void* stack = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (stack == MAP_FAILED) {
+        throw std::runtime_error("Cannot create simulation runner, stack not mapped");
+    }
+
+    std::unique_ptr<Runner> runner(new Runner());
+    runner->stack = static_cast<char*>(stack);
+    runner->stack_size = size;
+    // Guard page below the stack
+    ::mprotect(stack, page, PROT_NONE);
+    ::getcontext(&runner->context);
+    runner->context.uc_stack.ss_sp = runner->stack + page;
+    runner->context.uc_stack.ss_size = size - page;
+    runner->context.uc_link = &home_->context;
+    ::makecontext(&runner->context, &Simulation::enter, 0);
+
+    runners_.push_back(std::move(runner));
+    return *runners_.back();
+}
+
+void Simulation::transfer(Runner& runner) {
+    current_ = &runner;
+    entering = this;
+    running_entry = runner.entry;
+    ::swapcontext(&home_->context, &runner.context);
+    running_entry = nullptr;
+    current_ = nullptr;
+}
+
+void Simulation::enter() {
+    Simulation* simulation = entering;
+    simulation->serve(*simulation->current_);
+}
+
+void Simulation::serve(Runner& runner) {
+    while (runner.entry) {
+        Entry& entry = *runner.entry;
+        entry.task->runInline();
+        // Work after the last poll
+        entry.clock += entry.pending;
+        entry.pending = nanoseconds(0);
+        entry.finish = entry.clock;
+        entry.done = true;
+        entry.runner = nullptr;
+        runner.entry = nullptr;
+
+        idle_runners_.push_back(&runner);
+        ::swapcontext(&runner.context, &home_->context);
+    }
+}
+
+void Simulation::onPoll(Entry& entry) {
+    entry.clock += entry.spends ? entry.pending : options_.step;
+    entry.pending = nanoseconds(0);
+    if (entry.clock >= entry.horizon) {
+        ::swapcontext(&entry.runner->context, &home_->context);
+    }
+}
+
+void Simulation::onWait(Entry& entry) {
+    // Paused: gives the worker back till resumed or stopped
+    entry.paused = true;
+    ::swapcontext(&entry.runner->context, &home_->context);
+}
+
+void Simulation::onState(Entry& entry, const Task::StateType state) {
+    if (running_entry != &entry && Task::finished(state)) {
+        // Stopped before its dispatch, by a command
+        entry.ready = false;
+        entry.done = true;
+        entry.finish = now_;
+    }
+}
+
+SimulationReport Simulation::run() {
+    if (ran_) {
+        throw std::runtime_error("Cannot run simulation, already run");
+    }
+    ran_ = true;
+
+    std::vector<Entry*> arrivals;
+    for (auto& entry : entries_) {
+        arrivals.push_back(entry.get());
+    }
+    std::stable_sort(arrivals.begin(), arrivals.end(), [](const Entry* lhs, const Entry* rhs) {
+        return lhs->arrival < rhs->arrival;
+    });
+    std::stable_sort(commands_.begin(), commands_.end(), [](const Command& lhs, const Command& rhs) {
+        return lhs.when < rhs.when;
+    });
+
+    std::size_t next_arrival = 0;
+    while (true) {
+        const nanoseconds arrival = next_arrival < arrivals.size() ? arrivals[next_arrival]->arrival : never;
+        const nanoseconds command = next_command_ < commands_.size() ? commands_[next_command_].when : never;
+        const nanoseconds worker = events_.empty() ? never : events_.top().first;
+        if (arrival == never && command == never && worker == never) {
+            break;
+        }
+
+        // Ties: arrivals, then commands, then workers in index order
+        if (arrival <= command && arrival <= worker) {
+            now_ = arrival;
+            Entry& entry = *arrivals[next_arrival++];
+            if (!entry.done) {
+                queue_->push(entry, 0, false);
+            }
+            dispatchIdle();
+        }
+        else if (command <= worker) {
+            now_ = command;
+            apply(commands_[next_command_++]);
+            dispatchIdle();
+        }
+        else {
+            now_ = worker;
+            const std::size_t index = events_.top().second;
+            events_.pop();
+            onWorker(index);
+        }
+    }
+
+    return report();
+}
+
+void Simulation::apply(const Command& command) {
+    Entry& entry = *command.entry;
+    if (entry.done) {
+        return;
+    }
+
+    switch (command.command) {
+        case Task::CommandType::pause:
+        {
+            entry.task->requestPause();
+            if (entry.started && entry.worker < 0 && !entry.paused) {
+                // Waiting for a worker: pauses at the poll it is suspended in
+                entry.ready = false;
+                transfer(*entry.runner);
+            }
+            break;
+        }
+        case Task::CommandType::run:
+        {
+            entry.task->requestResume();
+            if (entry.paused) {
+                entry.paused = false;
+                entry.clock = now_;
+                queue_->push(entry, 0, false);
+            }
+            break;
+        }
+        case Task::CommandType::stop:
+        {
+            entry.task->requestStop();
+            if (entry.started && entry.worker < 0) {
+                // Paused or waiting for a worker: unwinds now, costing no virtual time
+                entry.ready = false;
+                entry.paused = false;
+                entry.clock = now_;
+                transfer(*entry.runner);
+            }
+            break;
+        }
+    }
+}
+
+void Simulation::dispatchIdle() {
+    for (std::size_t worker = 0; worker < workers_.size(); ++worker) {
+        if (!workers_[worker]) {
+            dispatch(worker);
+        }
+    }
+}
+
+void Simulation::dispatch(const std::size_t worker) {
+    Entry* entry = queue_->next(worker);
+    if (!entry) {
+        return;
+    }
+
+    workers_[worker] = entry;
+    entry->worker = static_cast<int>(worker);
+    entry->clock = now_;
+    entry->slice_end = options_.quantum > nanoseconds(0) ? now_ + options_.quantum : never;
+    if (!entry->started) {
+        entry->started = true;
+        entry->dispatched = now_;
+        if (idle_runners_.empty()) {
+            idle_runners_.push_back(&createRunner());
+        }
+        entry->runner = idle_runners_.back();
+        idle_runners_.pop_back();
+        entry->runner->entry = entry;
+    }
+    resumeWorker(worker);
+}
+
+void Simulation::resumeWorker(const std::size_t worker) {
+    Entry& entry = *workers_[worker];
+    const nanoseconds begin = entry.clock;
+    const nanoseconds command = next_command_ < commands_.size() ? commands_[next_command_].when : never;
+    entry.horizon = std::min(entry.slice_end, command);
+    transfer(*entry.runner);
+    busy_[worker] += entry.clock - begin;
+    events_.push(Event(entry.clock, worker));
+}
+
+void Simulation::onWorker(const std::size_t worker) {
+    Entry& entry = *workers_[worker];
+    if (entry.done || entry.paused) {
+        workers_[worker] = nullptr;
+        entry.worker = -1;
+        dispatch(worker);
+        return;
+    }
+
+    if (entry.clock >= entry.slice_end) {
+        if (queue_->preempts(worker, entry)) {
+            workers_[worker] = nullptr;
+            entry.worker = -1;
+            ++preemptions_;
+            queue_->push(entry, worker, true);
+            dispatch(worker);
+            return;
+        }
+        entry.slice_end = now_ + options_.quantum;
+    }
+    resumeWorker(worker);
+}
+
+SimulationReport Simulation::report() const {
+    SimulationReport report{};
+    report.tasks = entries_.size();
+
+    nanoseconds first = never;
+    nanoseconds last(0);
+    nanoseconds waited(0);
+    std::size_t dispatched = 0;
+    std::vector<nanoseconds> latencies;
+    for (const auto& entry : entries_) {
+        first = std::min(first, entry->arrival);
+        if (entry->dispatched != never) {
+            waited += entry->dispatched - entry->arrival;
+            ++dispatched;
+        }
+        if (!entry->done) {
+            ++report.unfinished;
+            continue;
+        }
+        last = std::max(last, entry->finish);
+        switch (entry->task->status()) {
+            case Task::StateType::completed:
+            {
+                ++report.completed;
+                latencies.push_back(entry->finish - entry->arrival);
+                break;
+            }
+            case Task::StateType::failed:
+            {
+                ++report.failed;
+                break;
+            }
+            default:
+            {
+                ++report.stopped;
+                break;
+            }
+        }
+    }
+
+    report.makespan = first == never || last < first ? nanoseconds(0) : last - first;
+    report.preemptions = preemptions_;
+    report.steals = queue_->steals();
+    if (dispatched) {
+        report.mean_wait = waited / static_cast<long long>(dispatched);
+    }
+    if (report.makespan > nanoseconds(0)) {
+        const double seconds = std::chrono::duration<double>(report.makespan).count();
+        report.throughput = static_cast<double>(report.completed) / seconds;
+        nanoseconds busy(0);
+        for (const nanoseconds worker : busy_) {
+            busy += worker;
+        }
+        report.utilization = static_cast<double>(busy.count())
+                             / (static_cast<double>(report.makespan.count()) * static_cast<double>(workers_.size()));
+    }
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        nanoseconds total(0);
+        for (const nanoseconds latency : latencies) {
+            total += latency;
+        }
+        report.mean_latency = total / static_cast<long long>(latencies.size());
+        report.p50_latency = latencies[(latencies.size() - 1) / 2];
+        report.p99_latency = latencies[(latencies.size() - 1) * 99 / 100];
+        report.max_latency = latencies.back();
+    }
+    return report;
+}
@@ -0,0 +1,246 @@
+#ifndef SIMULATION
+#define SIMULATION
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include "Journal.h"
+#include "Task.h"
+#include "Trace.h"
+
+struct SimulationEntry;
+struct SimulationRunner;
+struct SimulationCommand;
+class DispatchQueue;
+
+/* Order in which a Simulation hands ready tasks to its virtual workers */
+enum class DispatchPolicy {
+    fifo,           // one queue, in order of arrival
+    priority,       // one queue, highest priority first, in order of arrival among equals
+    workStealing,   // a deque per worker fed round-robin: a worker takes its newest task, an idle one steals
+                    // the oldest task of a random victim
+};
+
+struct SimulationOptions {
+    std::size_t workers = 4;
+    DispatchPolicy policy = DispatchPolicy::fifo;
+    /* Virtual time a worker runs a task before handing it back to the policy, 0 to run tasks to their end */
+    std::chrono::nanoseconds quantum{0};
+    /* Virtual time of a step, between two checkCommand(), for tasks not calling Simulation::spend() */
+    std::chrono::nanoseconds step{std::chrono::microseconds(100)};
+    /* Seeds the random choices, the victims of work stealing */
+    std::uint64_t seed = 1;
+    /* Stack of the context each running task gets */
+    std::size_t stack_size = 256 << 10;
+};
+
+/* Outcome of Simulation::run, in virtual time */
+struct SimulationReport {
+    std::size_t tasks;
+    std::size_t completed;
+    std::size_t stopped;
+    std::size_t failed;
+    std::size_t unfinished;                 // left paused
+    std::chrono::nanoseconds makespan;      // first arrival to last finish
+    double throughput;                      // completed tasks per virtual second
+    double utilization;                     // share of the makespan the workers spent running tasks
+    std::chrono::nanoseconds mean_wait;     // arrival to first dispatch
+    std::chrono::nanoseconds mean_latency;  // arrival to finish of completed tasks
+    std::chrono::nanoseconds p50_latency;
+    std::chrono::nanoseconds p99_latency;
+    std::chrono::nanoseconds max_latency;
+    std::size_t preemptions;                // quanta ended by handing the worker to another task
+    std::size_t steals;
+};
+
+/**
+ * Deterministic scheduler simulation in virtual time, to compare dispatch policies on many tasks
+ * in seconds of wall time, with the same results on every run.
+ *
+ * Tasks are regular Tasks with arrival times and priorities, run by a number of virtual workers
+ * under a DispatchPolicy. Each started task runs on a context (ucontext) of its own, all of them on
+ * the thread calling run(): the simulation switches to a task and gets back at a checkCommand() of
+ * the task, so the interleaving does not depend on the operating system and costs no thread handoff.
+ * A step, from one checkCommand() to the next, costs the virtual time the task charged with spend()
+ * (SimulatedTask), or options.step. A task runs ahead of the clock of the other workers up to the end
+ * of its quantum or the next command, tasks being independent of each other otherwise.
+ *
+ * Commands are scheduled in virtual time with command() and apply at the task's first checkCommand()
+ * from then on, a paused task gives its worker back. Tasks must not park(), wait for each other nor
+ * call the blocking pause()/resume()/stop(). Real sleeps in execute() still take wall time. run() and
+ * the destructor must be called from the same thread.
+*/
+class Simulation
+{
+public:
+    /**
+     * @throw invalid_argument if there is no worker or the step is not positive
+    */
+    explicit Simulation(const SimulationOptions& options = SimulationOptions());
+
+    /* Stops the tasks left paused */
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator= (const Simulation&) = delete;
+
+    /**
+     * Adds a task of type T arriving at virtual time arrival, constructed as T(id, args...)
+     *
+     * @throw runtime_error if the simulation already ran
+    */
+    template<class T, class... Args>
+    T& addTask(const std::chrono::nanoseconds arrival, const int priority, Args&&... args) {
+        std::unique_ptr<T> task = std::make_unique<T>(static_cast<int>(entries_.size()) + 1, std::forward<Args>(args)...);
+        T& taskRef = *task;
+        const char* type_name = typeNameOf<T>(0);
+        if (type_name) {
+            task->setType(type_name);
+        }
+        add(std::move(task), arrival, priority);
+        return taskRef;
+    }
+
+    /**
+     * Adds a SimulatedTask per task of a lifecycle trace (Trace::collect()), arriving at its start
+     * relative to the first one and running, in steps of options.step, as long as it ran between its
+     * run/resumed events and its paused/finished ones. Returns the number of tasks added
+     *
+     * @throw runtime_error if the simulation already ran
+    */
+    std::size_t addTrace(const std::vector<TraceRecord>& records);
+
+    /**
+     * Sends command to task at virtual time when, as requestPause(), requestResume() or requestStop()
+     *
+     * @throw invalid_argument if the task is not part of the simulation
+    */
+    void command(const std::chrono::nanoseconds when, Task& task, const Task::CommandType command);
+
+    /**
+     * Runs every task to its end, or till it is left paused
+     *
+     * @throw runtime_error if the simulation already ran, or as a command failing (pause of a task not
+     * dispatched yet, resume of a task not paused)
+    */
+    SimulationReport run();
+
+    /* Virtual time: the calling task's clock in a task, the simulation's otherwise */
+    std::chrono::nanoseconds now() const;
+
+    /* Virtual time task finished at, nanoseconds::max() if it did not */
+    std::chrono::nanoseconds finishTime(const Task& task) const;
+
+    /* Charges duration of virtual time to the calling task's current step, no-op out of a simulation */
+    static void spend(const std::chrono::nanoseconds duration);
+
+private:
+    using Entry = SimulationEntry;
+    using Runner = SimulationRunner;
+    using Command = SimulationCommand;
+    /* Virtual time a worker handed the turn back at, and the worker */
+    using Event = std::pair<std::chrono::nanoseconds, std::size_t>;
+
+    const SimulationOptions options_;
+    std::vector<std::unique_ptr<Entry>> entries_;
+    std::vector<Command> commands_;
+    std::unique_ptr<DispatchQueue> queue_;
+    bool ran_;
+
+    /* Virtual time of the event being processed */
+    std::chrono::nanoseconds now_;
+    std::size_t next_command_;
+    std::size_t preemptions_;
+    /* Task on each worker, one event at most per worker */
+    std::vector<Entry*> workers_;
+    std::vector<std::chrono::nanoseconds> busy_;
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+
+    /* Context of the thread calling run(), runner switched to, contexts of tasks started */
+    std::unique_ptr<Runner> home_;
+    Runner* current_;
+    std::vector<std::unique_ptr<Runner>> runners_;
+    std::vector<Runner*> idle_runners_;
+
+    void add(std::unique_ptr<Task> task, const std::chrono::nanoseconds arrival, const int priority);
+
+    Entry& entryOf(const Task& task) const;
+
+    /**
+     * Context of a new runner
+     *
+     * @throw runtime_error if its stack cannot be mapped
+    */
+    Runner& createRunner();
+
+    /* Switches to runner till it switches back */
+    void transfer(Runner& runner);
+
+    /* Entry point of runners: runs the entries they are given */
+    static void enter();
+    void serve(Runner& runner);
+
+    /* Task hooks, in the task's context or the simulation's for a task stopped before its dispatch */
+    void onPoll(Entry& entry);
+    void onWait(Entry& entry);
+    void onState(Entry& entry, const Task::StateType state);
+
+    void apply(const Command& command);
+    void dispatchIdle();
+    void dispatch(const std::size_t worker);
+    /* Runs the task of worker till it hands the turn back, and queues the worker's next event */
+    void resumeWorker(const std::size_t worker);
+    void onWorker(const std::size_t worker);
+
+    SimulationReport report() const;
+};
+
+/* Input of a SimulatedTask */
+struct SimulatedWork {
+    std::uint32_t steps;
+    std::chrono::nanoseconds step;
+};
+
+/* Task of steps costing a fixed virtual time each, see Simulation */
+class SimulatedTask : public Task
+{
+public:
+    using InputType = SimulatedWork;
+
+    static constexpr const char* typeName() { return "simulated"; }
+
+    SimulatedTask(const int id, const SimulatedWork work)
+    : Task(id), work_(work), done_(0)
+    {}
+
+    double progress() override {
+        return work_.steps ? 100.0 * done_ / work_.steps : 100.0;
+    }
+
+protected:
+    void onRearm() override {
+        done_ = 0;
+    }
+
+private:
+    const SimulatedWork work_;
+
+    /* written by inner thread every step */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> done_;
+
+    void execute() override {
+        for (std::uint32_t i = 0; i < work_.steps; ++i) {
+            Simulation::spend(work_.step);
+            checkCommand();
+            done_ = i + 1;
+        }
+    }
+};
+
+#endif
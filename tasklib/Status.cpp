@@ -0,0 +1,168 @@
+#include "Status.h"
+#include "Scheduler.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+constexpr std::uint32_t StatusWriter::binary_magic;
+
+bool StatusFilter::matches(Task& task) const {
+    if (!(states & bit(task.status()))) {
+        return false;
+    }
+    return !type || std::strcmp(type, task.type()) == 0;
+}
+
+StatusWriter::StatusWriter(const StatusFormat format, const std::size_t capacity)
+: format_(format), count_(0)
+{
+    buffer_.reserve(capacity);
+    clear();
+}
+
+void StatusWriter::clear() {
+    buffer_.clear();
+    count_ = 0;
+    if (format_ == StatusFormat::binary) {
+        const StatusHeader header{binary_magic, 0};
+        buffer_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+}
+
+void StatusWriter::appendInt(long long value) {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* begin = end;
+    const bool negative = value < 0;
+    unsigned long long magnitude = negative ? 0ull - static_cast<unsigned long long>(value) : static_cast<unsigned long long>(value);
+    do {
+        *--begin = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    if (negative) {
+        *--begin = '-';
+    }
+    buffer_.append(begin, end);
+}
+
+void StatusWriter::appendProgress(const double progress) {
+    // Two decimals without trailing zeros, as tasks round their progress
+    const long long hundredths = std::llround(progress * 100.0);
+    appendInt(hundredths / 100);
+    const long long decimals = hundredths % 100;
+    if (decimals) {
+        buffer_ += '.';
+        buffer_ += static_cast<char>('0' + decimals / 10);
+        if (decimals % 10) {
+            buffer_ += static_cast<char>('0' + decimals % 10);
+        }
+    }
+}
+
+void StatusWriter::appendEscaped(const char* text) {
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\') {
+            buffer_ += '\\';
+        }
+        buffer_ += *text;
+    }
+}
+
+bool StatusWriter::append(Task& task, const StatusFilter& filter) {
+    if (!filter.matches(task)) {
+        return false;
+    }
+
+    // Read once, the task may move on meanwhile
+    const Task::StateType state = task.status();
+    const double progress = task.progress();
+    const char* type = task.type();
+    const std::size_t memory = task.arena().used();
+    const std::size_t memory_peak = task.arena().peak();
+
+    switch (format_) {
+        case StatusFormat::text:
+        {
+            buffer_.append(" -> Task id: '");
+            appendInt(task.id());
+            buffer_.append("' status: '");
+            buffer_.append(Task::stateName(state));
+            buffer_.append("' progress: ");
+            appendProgress(progress);
+            buffer_.append("% task_type: ");
+            buffer_.append(type);
+            buffer_ += '\n';
+            break;
+        }
+        case StatusFormat::ndjson:
+        {
+            buffer_.append("{\"id\":");
+            appendInt(task.id());
+            buffer_.append(",\"state\":\"");
+            buffer_.append(Task::stateName(state));
+            buffer_.append("\",\"progress\":");
+            appendProgress(progress);
+            buffer_.append(",\"memory\":");
+            appendInt(static_cast<long long>(memory));
+            buffer_.append(",\"memory_peak\":");
+            appendInt(static_cast<long long>(memory_peak));
+            buffer_.append(",\"type\":\"");
+            appendEscaped(type);
+            buffer_.append("\"}\n");
+            break;
+        }
+        case StatusFormat::binary:
+        {
+            const std::size_t type_size = std::min<std::size_t>(std::strlen(type), 255);
+            const StatusRecord record{task.id(), static_cast<std::uint16_t>(std::llround(std::min(std::max(progress, 0.0), 100.0) * 100.0)),
+                                      static_cast<std::uint8_t>(state), static_cast<std::uint8_t>(type_size),
+                                      static_cast<std::uint64_t>(0), memory, memory_peak};
+            buffer_.append(reinterpret_cast<const char*>(&record), sizeof(record));
+            buffer_.append(type, type_size);
+
+            // Count kept up to date in the header
+            count_++;
+            std::memcpy(&buffer_[offsetof(StatusHeader, count)], &count_, sizeof(count_));
+            break;
+        }
+    }
+    return true;
+}
+
+std::size_t StatusWriter::appendAll(Scheduler& scheduler, const StatusFilter& filter) {
+    std::size_t count = 0;
+    if ((filter.states & TaskIndex::all_states) == TaskIndex::all_states && !filter.type) {
+        // Creation order
+        scheduler.forEachTask([&](Task& task) {
+            count += append(task, filter);
+        });
+        return count;
+    }
+
+    // Matching tasks only, a task changing state meanwhile is checked again by append
+    scheduler.forEachTask(filter.states, filter.type, [&](Task& task) {
+        count += append(task, filter);
+    });
+    return count;
+}
+
+void StatusWriter::writeTo(const int fd) {
+    std::size_t written = 0;
+    while (written < buffer_.size()) {
+        const ssize_t n = ::write(fd, buffer_.data() + written, buffer_.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            throw std::runtime_error(std::string("Cannot write status, ") + std::strerror(errno));
+        }
+        written += static_cast<std::size_t>(n);
+    }
+    clear();
+}
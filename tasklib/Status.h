@@ -0,0 +1,94 @@
+#ifndef STATUS
+#define STATUS
+
+#include <cstdint>
+#include <string>
+
+#include "Task.h"
+
+class Scheduler;
+
+enum class StatusFormat {
+    text,       // " -> Task id: '1' status: 'running' progress: 0% task_type: test", as operator<<
+    ndjson,     // one JSON object per line
+    binary,     // StatusHeader then one StatusRecord followed by the type name per task
+};
+
+/* Tasks reported by a StatusWriter */
+struct StatusFilter {
+    /* Bit 1 << StateType of every state reported */
+    unsigned states = ~0u;
+    /* Type name reported, nullptr for any */
+    const char* type = nullptr;
+
+    static constexpr unsigned bit(const Task::StateType state) { return 1u << static_cast<unsigned>(state); }
+
+    bool matches(Task& task) const;
+};
+
+/* Binary format, native byte order */
+struct StatusHeader {
+    std::uint32_t magic;        // 'TSTS'
+    std::uint32_t count;
+};
+
+struct StatusRecord {
+    std::int32_t id;
+    std::uint16_t progress;     // hundredths of percent
+    std::uint8_t state;         // Task::StateType
+    std::uint8_t type_size;     // bytes of the type name that follows
+    std::uint64_t reserved;     // zero, keeps memory aligned without implicit padding
+    std::uint64_t memory;       // bytes used from the task's arena, see TaskArena
+    std::uint64_t memory_peak;
+};
+static_assert(sizeof(StatusRecord) == 32, "StatusRecord has no implicit padding");
+
+/**
+ * Formats the status of many tasks into a buffer reused from one call to the next and writes it with
+ * a single write(), no allocation per task once the buffer has grown to its working size
+*/
+class StatusWriter
+{
+public:
+    static constexpr std::uint32_t binary_magic = 0x53545354;
+
+    explicit StatusWriter(const StatusFormat format = StatusFormat::text, const std::size_t capacity = 64 << 10);
+
+    /* Clears the output */
+    void setFormat(const StatusFormat format) {
+        format_ = format;
+        clear();
+    }
+
+    /* Starts a new output, the buffer keeps its capacity */
+    void clear();
+
+    /* Appends task if it matches filter, returns whether it did */
+    bool append(Task& task, const StatusFilter& filter = StatusFilter());
+
+    /**
+     * Appends every task of scheduler matching filter, returns their number
+     * All tasks are appended in creation order, filtered ones are taken from the scheduler's indexes
+    */
+    std::size_t appendAll(Scheduler& scheduler, const StatusFilter& filter = StatusFilter());
+
+    const std::string& data() const { return buffer_; }
+
+    /**
+     * Writes the output to fd and clears it
+     *
+     * @throw runtime_error if the write fails
+    */
+    void writeTo(const int fd);
+
+private:
+    StatusFormat format_;
+    std::string buffer_;
+    std::uint32_t count_;
+
+    void appendInt(long long value);
+    void appendProgress(const double progress);
+    void appendEscaped(const char* text);
+};
+
+#endif
@@ -1,67 +1,216 @@
 #include "Task.h"
+#include "Budget.h"
+#include "Trace.h"
+#include "TaskGroup.h"
+#include "Checkpoint.h"
+#include "TaskIndex.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstdio>
 
 namespace {
-    std::unordered_map<int, std::string> statusToStr = {
-        {0, "running"},
-        {1, "paused"},
-        {2, "stopped"},
-        {3, "completed"},
+    constexpr const char* statusToStr[] = {
+        "running",
+        "paused",
+        "stopped",
+        "completed",
+        "queued",
+        "idle",
+        "failed",
     };
 }
 
+const char* Task::stateName(const StateType state) {
+    return statusToStr[static_cast<int>(state)];
+}
+
 std::ostream& operator<<(std::ostream& os, Task& task) {
     os << "Task id: '" << task.id() << "' status: '" << statusToStr[static_cast<int>(task.status())]  << "' progress: " << task.progress() << "%";
     return os;
 }
 
+void* Task::operator new(std::size_t size) {
+    static_assert(CACHE_LINE_SIZE <= 64, "NodeMemory aligns to 64 bytes");
+    return NodeMemory::allocate(size, NodeMemory::threadNode());
+}
+
+void Task::operator delete(void* ptr) {
+    NodeMemory::release(ptr);
+}
+
 void Task::start() {
     // If there is no thread associated, default constructed std::thread::id is returned
-    if (thread_.get_id() !=  std::thread::id()) {
+    if (hasThread()) {
         std::ostringstream msg;
         msg << "Cannot start task, '" << id() << "', it's running or completed";
         throw std::runtime_error(msg.str());
     }
+
+    if (state_ == StateType::queued) {
+        std::ostringstream msg;
+        msg << "Cannot start task, '" << id() << "', it's queued";
+        throw std::runtime_error(msg.str());
+    }
         
-    thread_ = std::thread(&Task::callbackFuntion, this);
+    TASK_TRACE(start, id());
+    if (state_ == StateType::idle) {
+        setState(StateType::running);
+    }
+    if (!pool_) {
+        thread_ = std::thread(&Task::callbackFuntion, this, true);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_state_);
+        pool_returned_ = false;
+    }
+    pool_started_ = true;
+    pool_->submit([this]() {
+        callbackFuntion(true);
+        // Last access to the task, join() lets it be destroyed from then on
+        std::unique_lock<std::mutex> lock(mutex_state_);
+        pool_returned_ = true;
+        condition_state_.notify_all();
+    });
+}
+
+void Task::runInline() {
+    if (hasThread() || (state_ != StateType::running && state_ != StateType::idle)) {
+        std::ostringstream msg;
+        msg << "Cannot start task, '" << id() << "', it's running or completed";
+        throw std::runtime_error(msg.str());
+    }
+
+    TASK_TRACE(start, id());
+    if (state_ == StateType::idle) {
+        setState(StateType::running);
+    }
+    // Caller keeps its own placement
+    callbackFuntion(false);
+}
+
+void Task::rearm() {
+    const StateType state = state_;
+    const bool started = hasThread() || command_ != CommandType::run;
+    if (!finished(state) && state != StateType::idle && (state != StateType::running || started)) {
+        std::ostringstream msg;
+        msg << "Cannot rearm task, '" << id() << "', not finished";
+        throw std::runtime_error(msg.str());
+    }
+
+    // The finished thread may still be returning from callbackFuntion
+    join();
+    command_ = CommandType::run;
+    unresponsive_ = false;
+    setException(nullptr);
+    checkpoint_requested_.store(false, std::memory_order_relaxed);
+    onRearm();
+    setState(StateType::idle);
+}
+
+void Task::queue() {
+    StateType expected = StateType::running;
+    if (state_.compare_exchange_strong(expected, StateType::queued)
+        || (expected == StateType::idle && state_.compare_exchange_strong(expected, StateType::queued))) {
+        updateIndex();
+        if (group_) {
+            group_->account(*this);
+        }
+    }
+}
+
+bool Task::admit() {
+    StateType expected = StateType::queued;
+    if (!state_.compare_exchange_strong(expected, StateType::running)) {
+        return false;
+    }
+    updateIndex();
+    if (group_) {
+        group_->account(*this);
+    }
+
+    start();
+    return true;
 }
 
 void Task::pause() {
-    if (command_ != CommandType::run || state_ == StateType::completed) {
+    requestPause();
+
+    {
+        BlockingRegion blocking;
+        std::unique_lock<std::mutex> lock(mutex_state_);
+        condition_state_.wait(lock, [&]() {
+            return state_ != StateType::running || unresponsive_;
+        });
+        if (state_ == StateType::running) {
+            checkResponsive("pause");
+        }
+    }
+}
+
+void Task::requestPause() {
+    if (command_ != CommandType::run || finished(state_) || state_ == StateType::idle) {
         std::ostringstream msg;
         msg << "Cannot pause task, '" << id() << "', not running";
         throw std::runtime_error(msg.str());
     }
 
+    TASK_TRACE(pauseRequest, id());
     command_ = CommandType::pause;
-
-    std::unique_lock<std::mutex> lock(mutex_state_);
-    condition_state_.wait(lock, [&]() {
-        return state_ != StateType::running;
-    });
+    // Parked tasks acknowledge it without waiting for their condition
+    wake();
 }
 
 void Task::resume() {
+    requestResume();
+
+    {
+        // Wait till thread changes status to running, a queued task resumes once admitted.
+        // A paused group keeps the task paused, it runs again with the group
+        BlockingRegion blocking;
+        std::unique_lock<std::mutex> lock(mutex_state_);
+        condition_state_.wait(lock, [&]() {
+            return state_ == StateType::running || state_ == StateType::queued || finished(state_) ||
+                   unresponsive_ || (group_ && group_->effectiveCommand() == CommandType::pause);
+        });
+        if (state_ == StateType::paused) {
+            checkResponsive("resume");
+        }
+    }
+}
+
+void Task::requestResume() {
     if (command_ != CommandType::pause) {
         std::ostringstream msg;
         msg << "Cannot resume task, '" << id() << "', not paused";
         throw std::runtime_error(msg.str());
     }
-    {
-        std::unique_lock<std::mutex> lock(mutex_control_);
-        command_ = CommandType::run;
-        condition_control_.notify_one();
-    }
+
+    std::unique_lock<std::mutex> lock(controlMutex());
+    TASK_TRACE(resumeRequest, id());
+    command_ = CommandType::run;
+    controlCondition().notify_all();
+}
+
+void Task::stop() {
+    requestStop();
 
     {
-        // Wait till thread changes status to running
+        // Wait till thread changes status to completed/stopped
+        BlockingRegion blocking;
         std::unique_lock<std::mutex> lock(mutex_state_);
         condition_state_.wait(lock, [&]() {
-            return state_ == StateType::running;
+            return finished(state_) || unresponsive_;
         });
+        if (!finished(state_)) {
+            checkResponsive("stop");
+        }
     }
 }
 
-void Task::stop() {
+void Task::requestStop() {
     if (command_ != CommandType::run && command_ != CommandType::pause) {
         std::ostringstream msg;
         msg << "Cannot stop task, '" << id() << "', not running";
@@ -69,61 +218,251 @@ void Task::stop() {
     }
 
     {
-        std::unique_lock<std::mutex> lock(mutex_control_);
+        std::unique_lock<std::mutex> lock(controlMutex());
+        TASK_TRACE(stopRequest, id());
         command_ = CommandType::stop;
-        condition_control_.notify_one();
+        controlCondition().notify_all();
     }
 
-    {
-        // Wait till thread changes status to completed/stopped
-        std::unique_lock<std::mutex> lock(mutex_state_);
-        condition_state_.wait(lock, [&]() {
-            return (state_ == StateType::completed || state_ == StateType::stopped);
-        });
+    // Never admitted or idle, there is no inner thread to acknowledge
+    StateType expected = StateType::queued;
+    if (state_.compare_exchange_strong(expected, StateType::stopped)
+        || (expected == StateType::idle && state_.compare_exchange_strong(expected, StateType::stopped))) {
+        if (finish_hook_) {
+            finish_hook_(*this, StateType::stopped);
+        }
+        setState(StateType::stopped);
     }
 }
 
 void Task::joinTask() {
+    BlockingRegion blocking;
     std::unique_lock<std::mutex> lock(mutex_state_);
     condition_state_.wait(lock, [&]() {
-        return (state_ == StateType::completed || state_ == StateType::stopped);
+        return finished(state_);
     });
 }
 
+bool Task::joinTaskUntil(const std::chrono::steady_clock::time_point deadline) {
+    auto done = [&]() {
+        return finished(state_);
+    };
+
+    BlockingRegion blocking;
+    std::unique_lock<std::mutex> lock(mutex_state_);
+    if (deadline == std::chrono::steady_clock::time_point::max()) {
+        condition_state_.wait(lock, done);
+        return true;
+    }
+    return condition_state_.wait_until(lock, deadline, done);
+}
+
 void Task::join() {
+    BlockingRegion blocking;
     if (thread_.joinable()) {
         thread_.join();
     }
+    if (pool_started_) {
+        std::unique_lock<std::mutex> lock(mutex_state_);
+        condition_state_.wait(lock, [&]() {
+            return pool_returned_;
+        });
+        pool_started_ = false;
+    }
+}
+
+std::exception_ptr Task::exception() {
+    std::unique_lock<std::mutex> lock(mutex_state_);
+    return exception_;
+}
+
+void Task::setException(std::exception_ptr exception) {
+    std::unique_lock<std::mutex> lock(mutex_state_);
+    exception_ = std::move(exception);
+}
+
+void Task::setUnresponsive() {
+    std::unique_lock<std::mutex> lock(mutex_state_);
+    unresponsive_ = true;
+    condition_state_.notify_all();
+}
+
+void Task::checkResponsive(const char* action) {
+    if (unresponsive_) {
+        std::ostringstream msg;
+        msg << "Cannot " << action << " task, '" << id() << "', task unresponsive";
+        throw std::runtime_error(msg.str());
+    }
+}
+
+bool Task::waitApplied(const CommandType command) {
+    std::unique_lock<std::mutex> lock(controlMutex());
+    if (commandApplied(command)) {
+        return true;
+    }
+    lock.unlock();
+
+    parked_.store(true, std::memory_order_relaxed);
+    BlockingRegion blocking;
+    lock.lock();
+    controlCondition().wait(lock, [&]() {
+        return effectiveCommand() != command || commandApplied(command);
+    });
+    parked_.store(false, std::memory_order_relaxed);
+    return effectiveCommand() == command;
+}
+
+void Task::holdWhilePaused() {
+    if (effectiveCommand() == CommandType::pause) {
+        BlockingRegion blocking;
+        std::unique_lock<std::mutex> lock(controlMutex());
+        controlCondition().wait(lock, [&]() {
+            return effectiveCommand() != CommandType::pause;
+        });
+    }
+    if (effectiveCommand() == CommandType::stop) {
+        throw StopException();
+    }
+}
+
+void Task::wake() {
+    std::unique_lock<std::mutex> lock(controlMutex());
+    controlCondition().notify_all();
+}
+
+Task::CommandType Task::effectiveCommand() const {
+    const CommandType command = command_;
+    if (!group_) {
+        return command;
+    }
+    return std::max(command, group_->effectiveCommand());
+}
+
+std::mutex& Task::controlMutex() {
+    return group_ ? group_->controlMutex() : mutex_control_;
+}
+
+std::condition_variable& Task::controlCondition() {
+    return group_ ? group_->controlCondition() : condition_control_;
+}
+
+void Task::setState(const StateType state) {
+    // Recorded before it is visible, like the finish hook
+    if (state_hook_) {
+        state_hook_(*this, state);
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_state_);
+        state_ = state;
+        // Indexed before waiters see the state
+        updateIndex();
+        condition_state_.notify_all();
+    }
+
+    if (group_) {
+        group_->account(*this);
+    }
+}
+
+void Task::updateIndex() {
+    if (index_) {
+        index_->update(*this);
+    }
+}
+
+void Task::takeCheckpoint() {
+    checkpoint_requested_.store(false, std::memory_order_relaxed);
+    if (!checkpoint_hook_) {
+        return;
+    }
+
+    thread_local CheckpointWriter writer;
+    writer.clear();
+    if (saveCheckpoint(writer)) {
+        checkpoint_hook_(*this, writer.data());
+    }
+}
+
+void Task::throttle(const std::chrono::nanoseconds wait) {
+    // Not polling while it waits, the watchdog leaves it alone as if parked
+    parked_.store(true, std::memory_order_relaxed);
+    const auto begin = std::chrono::steady_clock::now();
+    {
+        BlockingRegion blocking;
+        std::unique_lock<std::mutex> lock(controlMutex());
+        controlCondition().wait_until(lock, begin + wait, [&]() {
+            return effectiveCommand() != CommandType::run;
+        });
+    }
+    parked_.store(false, std::memory_order_relaxed);
+    throttled_time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
 }
 
 void Task::checkCommand() {
-    switch(command_) {
+    // Single writer, no read-modify-write needed
+    heartbeat_.store(heartbeat_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    if (unresponsive_.load(std::memory_order_relaxed)) {
+        unresponsive_ = false;
+    }
+
+    if (poll_hook_) {
+        poll_hook_(*this);
+    }
+
+    TaskBudget* budget = budget_.load(std::memory_order_acquire);
+    if (budget) {
+        const std::chrono::nanoseconds wait = budget->poll();
+        if (wait.count() > 0) {
+            throttle(wait);
+        }
+    }
+
+    if (checkpoint_requested_.load(std::memory_order_relaxed)) {
+        takeCheckpoint();
+    }
+
+    switch(effectiveCommand()) {
         case CommandType::pause:
         {
-            {
-                std::unique_lock<std::mutex> lock(mutex_state_);
-                state_ = StateType::paused;
-                condition_state_.notify_one();
+            if (!waitApplied(CommandType::pause)) {
+                // Changed before it could be applied, a stop is not left for the next poll
+                if (effectiveCommand() == CommandType::stop) {
+                    TASK_TRACE(stopping, id());
+                    throw StopException();
+                }
+                return;
             }
-            {
-                // Wait till top thread changes command to pause
-                std::unique_lock<std::mutex> lock(mutex_control_);
-                condition_control_.wait(lock, [&]() {
-                    return command_ != CommandType::pause;
-                });
 
-                if (command_ == CommandType::run) {
-                    std::unique_lock<std::mutex> lock(mutex_state_);
-                    state_ = StateType::running;
-                    condition_state_.notify_one();
-                    return;
-                }
+            TASK_TRACE(paused, id());
+            setState(StateType::paused);
 
-                if (command_ == CommandType::stop) {
-                    throw StopException();
+            CommandType command;
+            if (wait_hook_) {
+                while ((command = effectiveCommand()) == CommandType::pause) {
+                    wait_hook_(*this);
                 }
             }
-            break;
+            else {
+                // Wait till top thread (or a group) changes command from pause
+                BlockingRegion blocking;
+                std::unique_lock<std::mutex> lock(controlMutex());
+                controlCondition().wait(lock, [&]() {
+                    return effectiveCommand() != CommandType::pause;
+                });
+                command = effectiveCommand();
+            }
+
+            TASK_TRACE(resumed, id());
+            if (command == CommandType::stop) {
+                TASK_TRACE(stopping, id());
+                throw StopException();
+            }
+
+            // A new command arriving meanwhile is applied at the next poll
+            waitApplied(CommandType::run);
+            setState(StateType::running);
+            return;
         }
         case CommandType::run:
         {
@@ -131,27 +470,68 @@ void Task::checkCommand() {
         }
         case CommandType::stop:
         {
+            TASK_TRACE(stopping, id());
             throw StopException();
         }
     }
 }
 
-void Task::callbackFuntion() {
-    bool completed;
+namespace {
+
+/* Formatted on the stack, failing threads do not allocate nor wait for the console */
+void logFailure(const int id, const char* what) {
+    char line[256];
+    const int size = std::snprintf(line, sizeof(line), "Task id: '%d' failed: %s", id, what);
+    Log::global().write(line, std::min(static_cast<std::size_t>(std::max(size, 0)), sizeof(line) - 1));
+}
+
+}
+
+void Task::callbackFuntion(const bool bind) {
+    StateType final_state;
+    if (bind) {
+        Executor::bind(placement_);
+    }
+    TaskBudget* budget = budget_.load(std::memory_order_acquire);
+    if (budget) {
+        budget->begin();
+    }
+    TASK_TRACE(run, id());
+    const auto begin = std::chrono::steady_clock::now();
     try {
         execute();
-        completed = true;
+        final_state = StateType::completed;
     } 
     catch (const StopException& e) {
-        completed = false;
+        TASK_TRACE(unwound, id());
+        final_state = StateType::stopped;
     }
     catch (const std::exception& e) {
-        std::cout << "exception thrown: " << e.what() << std::endl;
-        completed = true;
+        setException(std::current_exception());
+        logFailure(id(), e.what());
+        final_state = StateType::failed;
+    }
+    catch (...) {
+        setException(std::current_exception());
+        logFailure(id(), "unknown exception");
+        final_state = StateType::failed;
     }
-        
-    std::unique_lock<std::mutex> lock(mutex_state_);
-    state_ = completed ? StateType::completed : StateType::stopped;
 
-    condition_state_.notify_one();
+    // Nothing allocated from the arena is left: execute() returned or unwound
+    arena_.release();
+
+    // Visible along with the final state
+    runs_++;
+    run_time_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+
+    if (finish_hook_) {
+        finish_hook_(*this, final_state);
+    }
+        
+    switch (final_state) {
+        case StateType::completed:  TASK_TRACE(completed, id()); break;
+        case StateType::failed:     TASK_TRACE(failed, id());    break;
+        default:                    TASK_TRACE(stopped, id());   break;
+    }
+    setState(final_state);
 }
\ No newline at end of file
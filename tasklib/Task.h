@@ -5,6 +5,11 @@
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <exception>
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <functional>
 
 #include <iostream>
 #include <sstream>
@@ -13,10 +18,31 @@
 #include <unordered_map>
 
 #include "StopException.h"
+#include "Arena.h"
+#include "Executor.h"
+#include "ThreadPool.h"
+
+/* Fields written by different threads are kept this far apart to avoid false sharing */
+constexpr std::size_t CACHE_LINE_SIZE = 64;
 
 class Task;
+class TaskGroup;
+class CheckpointWriter;
+class CheckpointReader;
+class TaskIndex;
+struct TaskIndexBucket;
+class TaskBudget;
 std::ostream& operator<<(std::ostream& os, Task& task);
 
+/* Numeric argument a registered task type is started with, see Registry.h */
+struct TaskArgument {
+    const char* name;
+    const char* description;
+    long long default_value;
+    long long min;
+    long long max;
+};
+
 class Task
 {
 
@@ -28,9 +54,12 @@ public:
         paused,
         stopped,
         completed,
+        queued,     // waiting for admission, set by the scheduler before start
+        idle,       // re-armed or created by the scheduler without starting, see rearm()
+        failed,     // execute() threw, see exception()
     };
 
-    /* Commands are modified by main thread */
+    /* Commands are modified by main thread, ordered by strength */
     enum class CommandType {
         run,
         pause,
@@ -38,23 +67,89 @@ public:
     };
 
 private:
+    /**
+     * Control block layout, one group per cache line so that stores of one side
+     * do not invalidate the line the other side is polling:
+     * - cold: written once at construction/start
+     * - command: written by main thread, read by inner thread at every checkCommand()
+     * - state: written by inner thread, read by main thread (status, waits)
+     * - heartbeat: written by inner thread at every checkCommand(), read by the watchdog
+     * - watch: written by the watchdog at every visit
+     * - index: rewritten by the index whenever this task or a neighbour in its list changes state
+     * Derived classes must start their own per-iteration fields (progress, counters) on a new line.
+    */
+
+    /* cold */
     const int id_;
+    const char* type_;
     std::thread thread_;
-    
-    /* state transitions */
-    std::atomic<StateType> state_;
-    std::condition_variable condition_state_;
-    std::mutex mutex_state_;
+    Placement placement_;
+    std::function<void(Task&, StateType)> finish_hook_;
+    std::function<void(Task&, StateType)> state_hook_;
+    std::function<void(Task&, const std::string&)> checkpoint_hook_;
+    std::function<void(Task&)> poll_hook_;
+    std::function<void(Task&)> wait_hook_;
+    TaskGroup* group_;
+    ThreadPool* pool_;
+    /* owned by the scheduler, read by inner thread at every checkCommand(), see Budget */
+    std::atomic<TaskBudget*> budget_;
+    /* set once added to an index, see TaskIndex */
+    friend class TaskIndex;
+    TaskIndex* index_;
+    TaskIndexBucket* index_bucket_;
 
     /* command transitions */
-    std::atomic<CommandType> command_;
+    alignas(CACHE_LINE_SIZE) std::atomic<CommandType> command_;
+    std::atomic<bool> checkpoint_requested_;
     std::condition_variable condition_control_;
     std::mutex mutex_control_;
 
+    /* state transitions */
+    alignas(CACHE_LINE_SIZE) std::atomic<StateType> state_;
+    std::condition_variable condition_state_;
+    std::mutex mutex_state_;
+    /* last state counted by the group, guarded by the group lock, see TaskGroup::account */
+    friend class TaskGroup;
+    StateType group_state_;
+    /* accumulated over every run, kept by rearm() */
+    std::atomic<unsigned> runs_;
+    std::atomic<long long> run_time_;
+    std::atomic<long long> throttled_time_;
+    /* set by the watchdog, see Watchdog */
+    std::atomic<bool> unresponsive_;
+    /* guarded by mutex_state_, set by inner thread before its finish hook runs */
+    std::exception_ptr exception_;
+    /* started on pool_ and not joined yet, guarded by mutex_state_ once returned from the pool */
+    std::atomic<bool> pool_started_;
+    bool pool_returned_;
+
+    /* heartbeat: bumped by inner thread at every checkCommand(), read by the watchdog */
+    friend class Watchdog;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> heartbeat_;
+    std::atomic<bool> parked_;
+
+    /* watchdog bookkeeping, monitor thread only */
+    alignas(CACHE_LINE_SIZE) std::uint64_t watch_heartbeat_;
+    std::uint64_t watch_generation_;
+    std::chrono::steady_clock::time_point watch_since_;
+
+    /* secondary index links, guarded by the lock of index_bucket_ */
+    alignas(CACHE_LINE_SIZE) Task* index_prev_;
+    Task* index_next_;
+    std::size_t index_state_;
+
+    /* scratch memory: allocated from by inner thread, usage read by status */
+    alignas(CACHE_LINE_SIZE) TaskArena arena_;
+
 public:
 
     Task(const int id) 
-    : id_(id), thread_(), state_(StateType::running), command_(CommandType::run)
+    : id_(id), type_(""), thread_(), group_(nullptr), pool_(nullptr), budget_(nullptr), index_(nullptr), index_bucket_(nullptr),
+      command_(CommandType::run), checkpoint_requested_(false),
+      state_(StateType::running), group_state_(StateType::running), runs_(0), run_time_(0), throttled_time_(0), unresponsive_(false),
+      pool_started_(false), pool_returned_(false),
+      heartbeat_(0), parked_(false), watch_heartbeat_(0), watch_generation_(0),
+      index_prev_(nullptr), index_next_(nullptr), index_state_(0)
     {}
 
     virtual ~Task() = default;
@@ -62,53 +157,244 @@ public:
     Task (const Task&) = delete;
     Task& operator= (const Task&) = delete;
 
+    /**
+     * Tasks are over-aligned to CACHE_LINE_SIZE, which plain new does not honour before C++17
+     * Memory comes from the NUMA node set in NodeMemory::threadNode() when there is one
+    */
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr);
+
     const int id() const { return id_; }
 
+    /* Name of the task type, set by the scheduler for types declaring typeName(), empty otherwise */
+    void setType(const char* type) { type_ = type; }
+    const char* type() const { return type_; }
+
+    /* Node/cpu the inner thread is bound to when started, must be set before start() */
+    void setPlacement(const Placement& placement) { placement_ = placement; }
+    const Placement& placement() const { return placement_; }
 
     /**
-     * Calls to std::thread constructor which associates thread_ with a thread of execution.
-     * Runs task
+     * Called with the final state from the inner thread right before the task switches to
+     * completed/stopped, or from stop() if the task is stopped while queued. Must be set before start()
+    */
+    void setFinishHook(std::function<void(Task&, StateType)> hook) { finish_hook_ = std::move(hook); }
+
+    /* Called on every state change the inner thread publishes, before it is visible to status() */
+    void setStateHook(std::function<void(Task&, StateType)> hook) { state_hook_ = std::move(hook); }
+
+    /* Receives the records taken by saveCheckpoint(), called from the inner thread */
+    void setCheckpointHook(std::function<void(Task&, const std::string&)> hook) { checkpoint_hook_ = std::move(hook); }
+
+    /* Called from the inner thread at every checkCommand() before the command is applied, see Simulation */
+    void setPollHook(std::function<void(Task&)> hook) { poll_hook_ = std::move(hook); }
+
+    /* Called from the inner thread instead of blocking while paused, again till the command changes, see Simulation */
+    void setWaitHook(std::function<void(Task&)> hook) { wait_hook_ = std::move(hook); }
+
+    /* Budgets charged at every checkCommand(), the task waits there while over them, see Scheduler::setBudget */
+    void setBudget(TaskBudget* budget) { budget_.store(budget, std::memory_order_release); }
+    TaskBudget* budget() const { return budget_.load(std::memory_order_acquire); }
+
+    /* Asks the inner thread to take a checkpoint at its next checkCommand() */
+    void requestCheckpoint() { checkpoint_requested_.store(true, std::memory_order_relaxed); }
+
+    /**
+     * Serializes the task's input and state, see Checkpoint.h
+     * Returns false if the task type is not checkpointable
+    */
+    virtual bool saveCheckpoint(CheckpointWriter&) { return false; }
+
+    /**
+     * Restores the state written by saveCheckpoint() after the input, called before start()
+     *
+     * @throw runtime_error if the record is truncated
+    */
+    virtual void restoreCheckpoint(CheckpointReader&) {}
+
+    /* Pool the task runs on instead of a thread of its own, see ThreadPool. Must be set before start() */
+    void setPool(ThreadPool* pool) { pool_ = pool; }
+    ThreadPool* pool() const { return pool_; }
+
+    /* Group whose commands apply to the task as well, must be set before start() */
+    void setGroup(TaskGroup* group) { group_ = group; }
+    TaskGroup* group() const { return group_; }
+
+    /* Strongest of the task command and the commands of its enclosing groups */
+    CommandType effectiveCommand() const;
+
+    /**
+     * Calls to std::thread constructor which associates thread_ with a thread of execution,
+     * or submits the task to its pool. Runs task
      * 
      * @throw runtime_error if thread_ has no thread associated
     */
     void start();
 
+    /**
+     * Runs the task to its end on the calling thread instead of a thread of its own
+     * 
+     * @throw runtime_error if the task was already started
+    */
+    void runInline();
+
+    /**
+     * Makes a completed, stopped, failed or never started task idle, ready to be started again in place:
+     * joins its finished thread, clears its command and calls onRearm(). Id, type, placement, group,
+     * hooks and the accumulated runs() and runTime() are kept
+     *
+     * @throw runtime_error if the task is running, paused or queued
+    */
+    void rearm();
+
+    /** 
+     * Marks a task that has not been started, or an idle one, as waiting for admission
+     * start() is refused while queued, stop() finishes the task without running it
+    */
+    void queue();
+
+    /**
+     * Starts a queued task
+     * 
+     * @return false if the task was stopped while queued
+    */
+    bool admit();
+
     /**
      * Switches command to pause
      * Locks main thread till status is switched to paused
      * 
-     * @throw runtime_error if thread cannot pause
+     * @throw runtime_error if thread cannot pause, or if it is unresponsive (see Watchdog): the
+     * command stays and is applied at the task's next checkCommand()
     */
     void pause();
 
+    /**
+     * As pause() without waiting, the task pauses at its next checkCommand()
+     *
+     * @throw runtime_error if thread cannot pause
+    */
+    void requestPause();
+
     /**
      * Switches command to run and notifies
-     * Locks main thread till status is switched to running
+     * Locks main thread till status is switched to running, or till the task finishes.
+     * Returns without waiting while its group is paused, the task then runs again with the group
      * 
-     * @throw runtime_error if thread cannot resume
+     * @throw runtime_error if thread cannot resume, or if it is unresponsive as for pause()
     */
     void resume();
 
+    /**
+     * As resume() without waiting for the task to run again
+     *
+     * @throw runtime_error if thread cannot resume
+    */
+    void requestResume();
+
     /**
      * Switches command to stop and notifies
      * Locks main thread till status is switched to stopped/completed
      * 
-     * @throw runtime_error if thread cannot stop
+     * @throw runtime_error if thread cannot stop, or if it is unresponsive as for pause()
     */
     void stop();
 
+    /**
+     * As stop() without waiting, the task stops at its next checkCommand(), a queued or idle task right away
+     *
+     * @throw runtime_error if thread cannot stop
+    */
+    void requestStop();
+
     /* Locks main thread till inner thread finishes its execution */
     void joinTask();
 
-    /* std::thread builtin */
+    /* As joinTask() till deadline, false if the task is still running by then */
+    bool joinTaskUntil(const std::chrono::steady_clock::time_point deadline);
+
+    /* std::thread builtin, for a pooled task waits till the pool is done with it */
     void join();
 
     const StateType status() { return state_; }
 
+    /* True for the states a task ends in: completed, stopped and failed */
+    static constexpr bool finished(const StateType state) {
+        return state == StateType::completed || state == StateType::stopped || state == StateType::failed;
+    }
+
+    /* Exception thrown by execute() in the last run, nullptr unless it failed. Set before the finish hook runs */
+    std::exception_ptr exception();
+
+    /* Runs finished, completed or stopped */
+    unsigned runs() const { return runs_; }
+
+    /* Time spent executing over every run */
+    std::chrono::nanoseconds runTime() const { return std::chrono::nanoseconds(run_time_.load()); }
+
+    /**
+     * Allocator for the scratch memory of execute(), as a memory_resource for pmr containers (see Arena.h).
+     * Released as a whole when execute() returns or throws, usage and limit are read and set through it
+    */
+    TaskArena& arena() { return arena_; }
+    const TaskArena& arena() const { return arena_; }
+
+    /* Time spent waiting in checkCommand() for the budgets to refill over every run */
+    std::chrono::nanoseconds throttledTime() const { return std::chrono::nanoseconds(throttled_time_.load()); }
+
+    /* Flagged by the watchdog for not reaching checkCommand() in time, cleared at its next poll */
+    bool unresponsive() const { return unresponsive_; }
+
+    /* "running", "paused", ... as printed by operator<< */
+    static const char* stateName(const StateType state);
+
     virtual double progress() = 0;
 
+    /**
+     * Blocks the inner thread, without spinning, till ready() holds or a command other than run
+     * arrives, then applies it as checkCommand() does. ready() is evaluated under the control mutex,
+     * whoever makes it true must call wake() afterwards. Inner thread only
+     *
+     * @throw StopException if stop command is detected
+    */
+    template<class Ready>
+    void park(Ready&& ready) {
+        {
+            // Not polling on purpose, the watchdog leaves it alone
+            parked_.store(true, std::memory_order_relaxed);
+            BlockingRegion blocking;
+            std::unique_lock<std::mutex> lock(controlMutex());
+            controlCondition().wait(lock, [&]() {
+                return ready() || effectiveCommand() != CommandType::run;
+            });
+            parked_.store(false, std::memory_order_relaxed);
+        }
+        checkCommand();
+    }
+
+    /* Wakes the inner thread if parked */
+    void wake();
+
+    /**
+     * Blocks the calling thread while the task is paused, for threads helping the inner thread with its
+     * work (see MultiplyOptions::hold). Any thread, the state of the task is left alone
+     *
+     * @throw StopException if stop command is detected
+    */
+    void holdWhilePaused();
+
 protected:
 
+    /* Resets what a run accumulates (progress, results) before the task runs again, see rearm() */
+    virtual void onRearm() {}
+
+    /**
+     * True once what the task stands for follows command, pause or run (see RemoteTask): checkCommand()
+     * only switches to paused, and back to running, once it holds. Evaluated under the control mutex by
+     * the inner thread, whoever may make it true must call wake() afterwards
+    */
+    virtual bool commandApplied(const CommandType) { return true; }
+
     /** 
      * Updates state and notifies to main thread
      * Must be added in execute's body of derived class 
@@ -122,10 +408,41 @@ private:
     /**
      * Callable function, it is a wrapper of execute()
      * Updates state to running when called
-     * Updates state to completed/stopped (if StopException thrown)
+     * Updates state to completed/stopped (if StopException thrown)/failed (any other exception, which is
+     * kept and logged to Log::global())
      * User must re-throw StopException if captured
     */
-    void callbackFuntion();
+    void callbackFuntion(const bool bind = true);
+
+    /* Control channel paused tasks wait on, shared with the group tree for grouped tasks */
+    std::mutex& controlMutex();
+    std::condition_variable& controlCondition();
+
+    /* Started on a thread or a pool and not joined yet */
+    bool hasThread() const { return thread_.get_id() != std::thread::id() || pool_started_; }
+
+    /* Waits off cpu till wait has elapsed or a command other than run arrives */
+    void throttle(const std::chrono::nanoseconds wait);
+
+    /* Waits till commandApplied(command) holds, false if the command changed first */
+    bool waitApplied(const CommandType command);
+
+    /* Serializes the task into a reused buffer and hands it to the checkpoint hook */
+    void takeCheckpoint();
+
+    /* Publishes a state change to main thread and to the group */
+    void setState(const StateType state);
+
+    void setException(std::exception_ptr exception);
+
+    /* Flags the task and wakes the control calls waiting for it, watchdog only */
+    void setUnresponsive();
+
+    /* Throws if the task is flagged, a control call waiting for it gives up */
+    void checkResponsive(const char* action);
+
+    /* Moves the task to its new state in the scheduler's indexes, after every change of state_ */
+    void updateIndex();
 
     /**
      * Derived class must implement execute's function that will be called in the thread context
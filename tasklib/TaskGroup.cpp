@@ -0,0 +1,230 @@
+#include "TaskGroup.h"
+
+#include <algorithm>
+
+TaskGroup::TaskGroup(const int id, TaskGroup* parent)
+: id_(id), parent_(parent), command_(Task::CommandType::run),
+  running_(0), paused_(0), unfinished_(0), waiters_(0), resume_target_(0)
+{
+    if (parent_) {
+        std::unique_lock<std::mutex> lock(parent_->control_mutex_);
+        parent_->children_.push_back(this);
+    }
+}
+
+Task::CommandType TaskGroup::effectiveCommand() const {
+    Task::CommandType command = Task::CommandType::run;
+    for (const TaskGroup* group = this; group; group = group->parent_) {
+        command = std::max(command, group->command());
+    }
+    return command;
+}
+
+template<class F>
+void TaskGroup::forEachMember(F&& f) {
+    std::vector<TaskGroup*> children;
+    {
+        std::unique_lock<std::mutex> lock(control_mutex_);
+        for (Task* task : members_) {
+            f(*task);
+        }
+        children = children_;
+    }
+    for (TaskGroup* child : children) {
+        child->forEachMember(f);
+    }
+}
+
+template<class P>
+void TaskGroup::waitCounters(P&& satisfied) {
+    BlockingRegion blocking;
+    std::unique_lock<std::mutex> lock(control_mutex_);
+    waiters_++;
+    control_condition_.wait(lock, satisfied);
+    waiters_--;
+}
+
+void TaskGroup::broadcast() {
+    std::vector<TaskGroup*> children;
+    {
+        std::unique_lock<std::mutex> lock(control_mutex_);
+        control_condition_.notify_all();
+        children = children_;
+    }
+    for (TaskGroup* child : children) {
+        child->broadcast();
+    }
+}
+
+void TaskGroup::pause() {
+    {
+        std::unique_lock<std::mutex> lock(control_mutex_);
+        if (command_ != Task::CommandType::run) {
+            std::ostringstream msg;
+            msg << "Cannot pause group, '" << id() << "', not running";
+            throw std::runtime_error(msg.str());
+        }
+        command_ = Task::CommandType::pause;
+    }
+    broadcast();
+
+    waitCounters([&]() {
+        return running_.load() == 0;
+    });
+}
+
+void TaskGroup::resume() {
+    {
+        std::unique_lock<std::mutex> lock(control_mutex_);
+        if (command_ != Task::CommandType::pause) {
+            std::ostringstream msg;
+            msg << "Cannot resume group, '" << id() << "', not paused";
+            throw std::runtime_error(msg.str());
+        }
+        command_ = Task::CommandType::run;
+    }
+
+    // Members paused on their own, or by an enclosing group, stay paused
+    std::size_t held = 0;
+    forEachMember([&](Task& task) {
+        if (task.status() == Task::StateType::paused && task.effectiveCommand() != Task::CommandType::run) {
+            held++;
+        }
+    });
+    resume_target_ = held;
+    broadcast();
+
+    waitCounters([&]() {
+        return paused_.load() <= resume_target_.load();
+    });
+}
+
+void TaskGroup::stop() {
+    {
+        std::unique_lock<std::mutex> lock(control_mutex_);
+        if (command_ == Task::CommandType::stop) {
+            std::ostringstream msg;
+            msg << "Cannot stop group, '" << id() << "', not running";
+            throw std::runtime_error(msg.str());
+        }
+        command_ = Task::CommandType::stop;
+    }
+    broadcast();
+
+    // Queued members never reach checkCommand()
+    std::vector<Task*> queued;
+    forEachMember([&](Task& task) {
+        if (task.status() == Task::StateType::queued) {
+            queued.push_back(&task);
+        }
+    });
+    for (Task* task : queued) {
+        try {
+            task->stop();
+        }
+        catch (const std::runtime_error&) {
+            // stopped on its own meanwhile
+        }
+    }
+
+    joinGroup();
+}
+
+void TaskGroup::joinGroup() {
+    waitCounters([&]() {
+        return unfinished_.load() == 0;
+    });
+}
+
+double TaskGroup::progress() {
+    double total = 0.0;
+    std::size_t count = 0;
+    forEachMember([&](Task& task) {
+        total += task.progress();
+        count++;
+    });
+    return count ? total / static_cast<double>(count) : 0.0;
+}
+
+GroupStatus TaskGroup::status() {
+    GroupStatus status;
+    forEachMember([&](Task& task) {
+        switch(task.status()) {
+            case Task::StateType::running:   status.running++;   break;
+            case Task::StateType::paused:    status.paused++;    break;
+            case Task::StateType::stopped:   status.stopped++;   break;
+            case Task::StateType::completed: status.completed++; break;
+            case Task::StateType::queued:    status.queued++;    break;
+            case Task::StateType::idle:      status.idle++;      break;
+            case Task::StateType::failed:    status.failed++;    break;
+        }
+    });
+    return status;
+}
+
+std::size_t TaskGroup::size() {
+    std::size_t count = 0;
+    forEachMember([&](Task&) {
+        count++;
+    });
+    return count;
+}
+
+void TaskGroup::add(Task& task) {
+    std::unique_lock<std::mutex> lock(control_mutex_);
+    members_.push_back(&task);
+    for (TaskGroup* group = this; group; group = group->parent_) {
+        group->enter(task.group_state_);
+    }
+}
+
+void TaskGroup::account(Task& task) {
+    std::unique_lock<std::mutex> lock(control_mutex_);
+    const Task::StateType previous = task.group_state_;
+    const Task::StateType state = task.status();
+    if (state == previous) {
+        return;
+    }
+    task.group_state_ = state;
+
+    for (TaskGroup* group = this; group; group = group->parent_) {
+        group->enter(state);
+        if (!group->leave(previous) || group->waiters_.load() == 0) {
+            continue;
+        }
+        // Lock order is member group first, then its ancestors
+        if (group == this) {
+            control_condition_.notify_all();
+        }
+        else {
+            std::unique_lock<std::mutex> ancestor(group->control_mutex_);
+            group->control_condition_.notify_all();
+        }
+    }
+}
+
+void TaskGroup::enter(const Task::StateType state) {
+    if (state == Task::StateType::running) {
+        running_++;
+    }
+    else if (state == Task::StateType::paused) {
+        paused_++;
+    }
+    if (!Task::finished(state)) {
+        unfinished_++;
+    }
+}
+
+bool TaskGroup::leave(const Task::StateType state) {
+    bool reached = false;
+    if (state == Task::StateType::running) {
+        reached = --running_ == 0;
+    }
+    else if (state == Task::StateType::paused) {
+        reached = --paused_ <= resume_target_.load();
+    }
+    if (!Task::finished(state)) {
+        reached = --unfinished_ == 0 || reached;
+    }
+    return reached;
+}
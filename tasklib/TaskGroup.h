@@ -0,0 +1,131 @@
+#ifndef TASK_GROUP
+#define TASK_GROUP
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "Task.h"
+
+/* Number of tasks per state in a group, nested groups included */
+struct GroupStatus {
+    std::size_t running = 0;
+    std::size_t paused = 0;
+    std::size_t stopped = 0;
+    std::size_t completed = 0;
+    std::size_t queued = 0;
+    std::size_t idle = 0;
+    std::size_t failed = 0;
+
+    std::size_t total() const { return running + paused + stopped + completed + queued + idle + failed; }
+};
+
+/**
+ * Cancellation scope for related tasks, created through Scheduler::createGroup.
+ *
+ * A group holds one command word. Member tasks combine it with their own command and those of
+ * the enclosing groups at every checkCommand(), the strongest wins (stop > pause > run), so a
+ * group-wide pause/resume/stop is a single store plus one broadcast per nested group.
+ * Every group has its own lock and condition variable. Members keep per-state counters of their
+ * group and its ancestors up to date at every transition, group waits are woken once the counter
+ * they wait on reaches its target instead of rescanning the members.
+*/
+class TaskGroup
+{
+public:
+    TaskGroup(const int id, TaskGroup* parent = nullptr);
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator= (const TaskGroup&) = delete;
+
+    int id() const { return id_; }
+
+    TaskGroup* parent() const { return parent_; }
+
+    Task::CommandType command() const { return command_.load(std::memory_order_acquire); }
+
+    /* Strongest command of this group and its ancestors */
+    Task::CommandType effectiveCommand() const;
+
+    /**
+     * Switches the group command to pause
+     * Locks main thread till no member is running
+     *
+     * @throw runtime_error if the group is not running
+    */
+    void pause();
+
+    /**
+     * Switches the group command to run
+     * Locks main thread till members not paused on their own, or by an enclosing group, are running
+     *
+     * @throw runtime_error if the group is not paused
+    */
+    void resume();
+
+    /**
+     * Switches the group command to stop
+     * Locks main thread till every member is stopped/completed
+     *
+     * @throw runtime_error if the group is already stopped
+    */
+    void stop();
+
+    /* Locks main thread till every member is stopped/completed */
+    void joinGroup();
+
+    /* Mean progress of member tasks, 0 for an empty group */
+    double progress();
+
+    GroupStatus status();
+
+    /* Number of member tasks, nested groups included */
+    std::size_t size();
+
+    /* Registers a task before it starts */
+    void add(Task& task);
+
+    /* Members of this group wait on them while paused */
+    std::mutex& controlMutex() { return control_mutex_; }
+    std::condition_variable& controlCondition() { return control_condition_; }
+
+    /* Counts the current state of task, a member, in this group and its ancestors; after every change of state */
+    void account(Task& task);
+
+private:
+    const int id_;
+    TaskGroup* const parent_;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<Task::CommandType> command_;
+
+    /* Guards members and children as well */
+    std::mutex control_mutex_;
+    std::condition_variable control_condition_;
+
+    std::vector<Task*> members_;
+    std::vector<TaskGroup*> children_;
+
+    /* Members per state, nested groups included, updated by account() of every member */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::size_t> running_;
+    std::atomic<std::size_t> paused_;
+    std::atomic<std::size_t> unfinished_;
+    /* Threads in waitCounters(), and the paused members resume() waits for */
+    std::atomic<int> waiters_;
+    std::atomic<std::size_t> resume_target_;
+
+    template<class F>
+    void forEachMember(F&& f);
+
+    /* Locks main thread till satisfied() holds, rechecked when a counter reaches its target */
+    template<class P>
+    void waitCounters(P&& satisfied);
+
+    /* Wakes the members of this group and of its nested groups after a command change */
+    void broadcast();
+
+    void enter(Task::StateType state);
+    /* True if a counter reached the target of a wait */
+    bool leave(Task::StateType state);
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "TaskIndex.h"
+
+constexpr std::size_t TaskIndexBucket::state_count;
+constexpr std::size_t TaskIndex::state_count;
+constexpr unsigned TaskIndex::all_states;
+
+void TaskIndex::add(Task& task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    TaskIndexBucket* bucket = nullptr;
+    for (const auto& candidate : buckets_) {
+        if (std::strcmp(candidate->type, task.type()) == 0) {
+            bucket = candidate.get();
+            break;
+        }
+    }
+    if (!bucket) {
+        buckets_.push_back(std::unique_ptr<TaskIndexBucket>(new TaskIndexBucket(task.type())));
+        bucket = buckets_.back().get();
+    }
+
+    std::unique_lock<std::mutex> bucket_lock(bucket->mutex);
+    task.index_ = this;
+    task.index_bucket_ = bucket;
+    link(task, static_cast<std::size_t>(task.status()));
+}
+
+void TaskIndex::update(Task& task) {
+    // The bucket of a task is set once, before it starts
+    std::unique_lock<std::mutex> lock(task.index_bucket_->mutex);
+    // Read under the lock: concurrent transitions of a task leave it in the list of the last one
+    const std::size_t state = static_cast<std::size_t>(task.status());
+    if (state == task.index_state_) {
+        return;
+    }
+    unlink(task);
+    link(task, state);
+}
+
+std::size_t TaskIndex::count(const unsigned states, const char* type) const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::size_t count = 0;
+    for (const auto& bucket : buckets_) {
+        if (type && std::strcmp(type, bucket->type) != 0) {
+            continue;
+        }
+        std::unique_lock<std::mutex> bucket_lock(bucket->mutex);
+        for (std::size_t state = 0; state < state_count; ++state) {
+            if (states & (1u << state)) {
+                count += bucket->size[state];
+            }
+        }
+    }
+    return count;
+}
+
+void TaskIndex::link(Task& task, const std::size_t state) {
+    TaskIndexBucket& bucket = *task.index_bucket_;
+    task.index_state_ = state;
+    task.index_prev_ = bucket.tail[state];
+    task.index_next_ = nullptr;
+    if (bucket.tail[state]) {
+        bucket.tail[state]->index_next_ = &task;
+    }
+    else {
+        bucket.head[state] = &task;
+    }
+    bucket.tail[state] = &task;
+    bucket.size[state]++;
+}
+
+void TaskIndex::unlink(Task& task) {
+    TaskIndexBucket& bucket = *task.index_bucket_;
+    const std::size_t state = task.index_state_;
+    if (task.index_prev_) {
+        task.index_prev_->index_next_ = task.index_next_;
+    }
+    else {
+        bucket.head[state] = task.index_next_;
+    }
+    if (task.index_next_) {
+        task.index_next_->index_prev_ = task.index_prev_;
+    }
+    else {
+        bucket.tail[state] = task.index_prev_;
+    }
+    bucket.size[state]--;
+}
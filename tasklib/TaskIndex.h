@@ -0,0 +1,94 @@
+#ifndef TASK_INDEX
+#define TASK_INDEX
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Task.h"
+
+/* Tasks of one type, one list per state linked through the tasks themselves, guarded by mutex */
+struct TaskIndexBucket {
+    static constexpr std::size_t state_count = static_cast<std::size_t>(Task::StateType::failed) + 1;
+
+    explicit TaskIndexBucket(const char* type)
+    : type(type), head(), tail(), size()
+    {}
+
+    const char* type;
+    std::mutex mutex;
+    Task* head[state_count];
+    Task* tail[state_count];
+    std::size_t size[state_count];
+};
+
+/**
+ * Secondary indexes of the tasks of a scheduler by type and state
+ *
+ * Tasks are kept in intrusive lists, one per type and state, and move from one list to another on
+ * every state change (Task calls update()). Counts are read from the lists' sizes and filtered
+ * iteration walks only the matching lists, without allocating.
+ *
+ * Each type has its own lock, so transitions of tasks of different types do not serialize; those of
+ * one type still do, one short critical section per state change. Counts and iteration over several
+ * types lock them one after the other and are not a snapshot across types.
+*/
+class TaskIndex
+{
+public:
+    static constexpr std::size_t state_count = TaskIndexBucket::state_count;
+
+    /* Mask of every state, states are selected with 1 << StateType as in StatusFilter */
+    static constexpr unsigned all_states = (1u << state_count) - 1;
+
+    TaskIndex() = default;
+
+    TaskIndex(const TaskIndex&) = delete;
+    TaskIndex& operator= (const TaskIndex&) = delete;
+
+    /* Indexes task under its type and current state, before it starts. It is kept up to date from then on */
+    void add(Task& task);
+
+    /* Moves task to the list of the state it is in now, called by Task after every state change */
+    void update(Task& task);
+
+    /* Number of tasks in one of states and of type, any type if nullptr. Costs one step per type */
+    std::size_t count(const unsigned states, const char* type = nullptr) const;
+
+    /**
+     * Calls visit for every task in one of states and of type, any type if nullptr, visiting only those:
+     * grouped by type then state, in the order they entered their state
+     * Runs under the lock of the type visited, visit must not change the state of a task
+    */
+    template<class F>
+    void forEach(const unsigned states, const char* type, F&& visit) const {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (const auto& bucket : buckets_) {
+            if (type && std::strcmp(type, bucket->type) != 0) {
+                continue;
+            }
+            std::unique_lock<std::mutex> bucket_lock(bucket->mutex);
+            for (std::size_t state = 0; state < state_count; ++state) {
+                if (!(states & (1u << state))) {
+                    continue;
+                }
+                for (Task* task = bucket->head[state]; task; task = task->index_next_) {
+                    visit(*task);
+                }
+            }
+        }
+    }
+
+private:
+    /* Guards buckets_ only, taken before a bucket lock */
+    mutable std::mutex mutex_;
+    /* Few types, looked up by name when a task is added */
+    std::vector<std::unique_ptr<TaskIndexBucket>> buckets_;
+
+    void link(Task& task, const std::size_t state);
+    void unlink(Task& task);
+};
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef TASK_POOL
+#define TASK_POOL
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "Scheduler.h"
+
+/**
+ * Fixed set of tasks of type T created idle up front and run again in place, see Scheduler::restartTask
+ *
+ * A recurring job runs on a task of the pool instead of a new one: no task allocation, no new id and
+ * no registry entry per run, and the pool's tasks keep their runs() and runTime() from run to run
+*/
+template<class T>
+class TaskPool
+{
+public:
+    /**
+     * Creates size idle tasks of type T with input through scheduler
+     *
+     * @throw invalid_argument if the placement names an unavailable cpu
+    */
+    template<class I>
+    TaskPool(Scheduler& scheduler, const std::size_t size, const I& input, const Placement& placement = Placement())
+    : scheduler_(scheduler), next_(0)
+    {
+        tasks_.reserve(size);
+        for (std::size_t i = 0; i < size; ++i) {
+            tasks_.push_back(scheduler_.prepareTask<T>(input, placement));
+        }
+    }
+
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator= (const TaskPool&) = delete;
+
+    /**
+     * Runs a task of the pool that is idle or finished (completed, stopped or failed), starting the search after the last one run
+     * so that tasks take turns
+     *
+     * @return nullptr if every task of the pool is running, paused or queued
+     * @throw runtime_error as Scheduler::restartTask
+    */
+    T* run() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (std::size_t i = 0; i < tasks_.size(); ++i) {
+            T& task = tasks_[(next_ + i) % tasks_.size()];
+            if (!ready(task)) {
+                continue;
+            }
+            next_ = (next_ + i + 1) % tasks_.size();
+            scheduler_.restartTask(task);
+            return &task;
+        }
+        return nullptr;
+    }
+
+    /* Tasks that run() can start right away */
+    std::size_t available() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::size_t count = 0;
+        for (T& task : tasks_) {
+            count += ready(task);
+        }
+        return count;
+    }
+
+    std::size_t size() const { return tasks_.size(); }
+
+    const std::vector<std::reference_wrapper<T>>& tasks() const { return tasks_; }
+
+private:
+    Scheduler& scheduler_;
+    std::vector<std::reference_wrapper<T>> tasks_;
+    std::size_t next_;
+    std::mutex mutex_;
+
+    static bool ready(T& task) {
+        const Task::StateType state = task.status();
+        return state == Task::StateType::idle || Task::finished(state);
+    }
+};
+
+#endif
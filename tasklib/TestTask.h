@@ -7,25 +7,40 @@ class TestTask : public Task
 {
 
 public:
+    /* Journaled, see Journal.h */
+    using InputType = std::chrono::nanoseconds;
+
+    static constexpr const char* typeName() { return "test"; }
+
+    static constexpr TaskArgument taskArgument() {
+        return {"sleep_ms", "dummy task looping forever, sleeping sleep_ms per iteration", 10, 0, 60000};
+    }
+
     TestTask(const int id, std::chrono::nanoseconds sleep_duration) 
     : Task(id), run_(true), sleep_duration_(sleep_duration)
     {
     }
 
     ~TestTask() {
+        // Infinite loop: a task still alive must be stopped before joining
+        StateType state = status();
+        if (state == StateType::running || state == StateType::paused) {
+            stop();
+        }
         join();
     }
 
     double progress() override {
         StateType state = status();
-        if (state == StateType::completed || state == StateType::stopped) {
+        if (finished(state)) {
             return 100.0;
         }
 
         return 0.0;
     }
 
-    std::atomic<bool> run_;
+    /* written by main thread, polled by inner thread every iteration */
+    alignas(CACHE_LINE_SIZE) std::atomic<bool> run_;
 private:
     std::chrono::nanoseconds sleep_duration_;
 
@@ -33,6 +48,7 @@ private:
 
         while(run_) {
             checkCommand();
+            BlockingRegion blocking;
             std::this_thread::sleep_for(sleep_duration_);
         }
     }
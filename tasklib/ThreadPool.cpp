@@ -0,0 +1,166 @@
+#include "ThreadPool.h"
+#include "Executor.h"
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    thread_local ThreadPool* current_pool = nullptr;
+    thread_local unsigned blocking_depth = 0;
+}
+
+ThreadPool::ThreadPool(const ThreadPoolOptions& options)
+: parallelism_(options.parallelism ? options.parallelism : std::max(1u, std::thread::hardware_concurrency())),
+  max_threads_(options.max_threads), keep_alive_(options.keep_alive), closing_(false),
+  threads_(0), idle_(0), busy_(0), blocked_(0), peak_threads_(0), spawned_(0), retired_(0)
+{
+    if (max_threads_ < parallelism_) {
+        throw std::invalid_argument("Cannot create thread pool, max_threads lower than parallelism");
+    }
+    if (pthread_getaffinity_np(pthread_self(), sizeof(affinity_), &affinity_) != 0) {
+        CPU_ZERO(&affinity_);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    closing_ = true;
+    work_.notify_all();
+    exited_.wait(lock, [&]() {
+        return threads_ == 0;
+    });
+    lock.unlock();
+
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+ThreadPool* ThreadPool::current() {
+    return current_pool;
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+    grow();
+}
+
+ThreadPoolStats ThreadPool::stats() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return ThreadPoolStats{threads_, busy_, blocked_, jobs_.size(), peak_threads_, spawned_, retired_};
+}
+
+void ThreadPool::grow() {
+    if (!runnable()) {
+        return;
+    }
+    if (idle_) {
+        work_.notify_one();
+        return;
+    }
+    if (threads_ >= max_threads_) {
+        return;
+    }
+
+    reap();
+    threads_++;
+    // Counted idle till it looks for work, a burst of submissions spawns one worker per job it can run
+    idle_++;
+    spawned_++;
+    peak_threads_ = std::max(peak_threads_, threads_);
+    workers_.emplace_back(&ThreadPool::run, this);
+}
+
+void ThreadPool::reap() {
+    for (const std::thread::id id : finished_) {
+        auto worker = std::find_if(workers_.begin(), workers_.end(), [&](const std::thread& thread) {
+            return thread.get_id() == id;
+        });
+        if (worker != workers_.end()) {
+            worker->join();
+            workers_.erase(worker);
+        }
+    }
+    finished_.clear();
+}
+
+void ThreadPool::run() {
+    current_pool = this;
+    if (CPU_COUNT(&affinity_) > 0) {
+        pthread_setaffinity_np(pthread_self(), sizeof(affinity_), &affinity_);
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (runnable()) {
+            idle_--;
+            busy_++;
+            std::function<void()> job = std::move(jobs_.front());
+            jobs_.pop_front();
+            // Another worker may take the next job if this one was not the last runnable slot
+            grow();
+            lock.unlock();
+
+            job();
+            job = nullptr;
+            // Jobs binding the worker (tasks with a placement) do not leave it bound
+            const Placement placement = Placement::current();
+            if (placement.node >= 0 || placement.cpu >= 0) {
+                Executor::bind(Placement());
+                if (CPU_COUNT(&affinity_) > 0) {
+                    pthread_setaffinity_np(pthread_self(), sizeof(affinity_), &affinity_);
+                }
+            }
+
+            lock.lock();
+            busy_--;
+            idle_++;
+            continue;
+        }
+        if (closing_ && jobs_.empty()) {
+            break;
+        }
+
+        if (threads_ <= parallelism_) {
+            work_.wait(lock);
+        }
+        else if (work_.wait_for(lock, keep_alive_) == std::cv_status::timeout && !runnable() && threads_ > parallelism_) {
+            retired_++;
+            break;
+        }
+    }
+
+    idle_--;
+    threads_--;
+    finished_.push_back(std::this_thread::get_id());
+    exited_.notify_all();
+}
+
+void ThreadPool::enterBlocking() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    blocked_++;
+    grow();
+}
+
+void ThreadPool::leaveBlocking() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    blocked_--;
+}
+
+BlockingRegion::BlockingRegion()
+: pool_(blocking_depth++ == 0 ? current_pool : nullptr)
+{
+    if (pool_) {
+        pool_->enterBlocking();
+    }
+}
+
+BlockingRegion::~BlockingRegion() {
+    blocking_depth--;
+    if (pool_) {
+        pool_->leaveBlocking();
+    }
+}
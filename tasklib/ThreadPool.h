@@ -0,0 +1,124 @@
+#ifndef THREAD_POOL
+#define THREAD_POOL
+
+#include <sched.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ThreadPoolOptions {
+    /* Workers kept running jobs, those blocked in a BlockingRegion not counted; 0 for the number of cpus */
+    std::size_t parallelism = 0;
+    /* Workers at most, the ones spawned to make up for blocked workers included */
+    std::size_t max_threads = 256;
+    /* Workers beyond parallelism exit after being idle this long */
+    std::chrono::milliseconds keep_alive{1000};
+};
+
+/* Snapshot of a ThreadPool */
+struct ThreadPoolStats {
+    std::size_t threads;
+    std::size_t busy;           // running a job, blocked ones included
+    std::size_t blocked;        // in a BlockingRegion
+    std::size_t queued;         // jobs waiting for a worker
+    std::size_t peak_threads;
+    std::uint64_t spawned;
+    std::uint64_t retired;      // exited after keep_alive
+};
+
+/**
+ * Elastic pool of threads tasks run on instead of a thread each, see Scheduler::enableThreadPool
+ *
+ * The pool aims at parallelism runnable workers. A job that blocks, in tasklib's own waits (joinTask(),
+ * pause/resume/stop, park(), paused in checkCommand(), throttled, SharedResult::get(), admission) or in a
+ * BlockingRegion of its own, stops counting: while jobs are queued an idle worker is woken, or a new one
+ * spawned up to max_threads, so blocking neither shrinks the parallelism nor deadlocks the pool on jobs
+ * waiting for queued ones. Workers above parallelism exit once idle for keep_alive. Workers are created
+ * on demand.
+*/
+class ThreadPool
+{
+public:
+    /* @throw invalid_argument if max_threads is lower than the parallelism */
+    explicit ThreadPool(const ThreadPoolOptions& options = ThreadPoolOptions());
+
+    /* Runs the jobs left, then waits for the workers */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator= (const ThreadPool&) = delete;
+
+    /* Queues job, run in order of submission by the first worker able to */
+    void submit(std::function<void()> job);
+
+    ThreadPoolStats stats() const;
+
+    std::size_t parallelism() const { return parallelism_; }
+
+    /* Pool of the calling worker thread, nullptr out of pool workers */
+    static ThreadPool* current();
+
+private:
+    friend class BlockingRegion;
+
+    const std::size_t parallelism_;
+    const std::size_t max_threads_;
+    const std::chrono::milliseconds keep_alive_;
+    /* Affinity of the constructing thread, restored on workers after a job bound them elsewhere */
+    cpu_set_t affinity_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable work_;
+    std::condition_variable exited_;
+    std::deque<std::function<void()>> jobs_;
+    bool closing_;
+
+    /* guarded by mutex_ */
+    std::size_t threads_;
+    std::size_t idle_;
+    std::size_t busy_;
+    std::size_t blocked_;
+    std::size_t peak_threads_;
+    std::uint64_t spawned_;
+    std::uint64_t retired_;
+    /* Workers that returned, joined by the next spawn or the destructor */
+    std::vector<std::thread> workers_;
+    std::vector<std::thread::id> finished_;
+
+    /* True if a worker should take a queued job now */
+    bool runnable() const { return !jobs_.empty() && busy_ - blocked_ < parallelism_; }
+
+    /* Wakes an idle worker or spawns one for the queued jobs, under mutex_ */
+    void grow();
+    void reap();
+    void run();
+
+    void enterBlocking();
+    void leaveBlocking();
+};
+
+/**
+ * Marks the calling thread as blocked while in scope: a ThreadPool worker no longer counts as runnable
+ * and the pool makes up for it. Nested regions count once. No-op out of pool workers
+*/
+class BlockingRegion
+{
+public:
+    BlockingRegion();
+    ~BlockingRegion();
+
+    BlockingRegion(const BlockingRegion&) = delete;
+    BlockingRegion& operator= (const BlockingRegion&) = delete;
+
+private:
+    ThreadPool* pool_;
+};
+
+#endif
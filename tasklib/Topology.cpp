@@ -0,0 +1,171 @@
+#include "Topology.h"
+
+#include <dirent.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <sstream>
+
+#ifdef TASKLIB_HAVE_NUMA
+#include <numa.h>
+#endif
+
+namespace {
+
+    std::vector<int> allowedCpus() {
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set)) {
+                    cpus.push_back(cpu);
+                }
+            }
+        }
+        if (cpus.empty()) {
+            cpus.push_back(0);
+        }
+        return cpus;
+    }
+
+    /* Allocation header, keeps the payload 64-byte aligned */
+    struct alignas(64) NodeBlock {
+        std::size_t size;
+        bool numa;
+    };
+}
+
+const Topology& Topology::system() {
+    static const Topology instance("/sys/devices/system/node", allowedCpus());
+    return instance;
+}
+
+Topology::Topology(const std::string& node_dir, const std::vector<int>& allowed_cpus) {
+    if (DIR* dir = opendir(node_dir.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name.size() <= 4 || name.compare(0, 4, "node") != 0 ||
+                name.find_first_not_of("0123456789", 4) != std::string::npos) {
+                continue;
+            }
+
+            const std::size_t node = std::stoul(name.substr(4));
+            std::ifstream file(node_dir + "/" + name + "/cpulist");
+            std::string list;
+            std::getline(file, list);
+
+            std::vector<int> cpus;
+            for (int cpu : parseCpuList(list)) {
+                if (std::find(allowed_cpus.begin(), allowed_cpus.end(), cpu) != allowed_cpus.end()) {
+                    cpus.push_back(cpu);
+                }
+            }
+
+            if (nodes_.size() <= node) {
+                nodes_.resize(node + 1);
+            }
+            nodes_[node] = cpus;
+        }
+        closedir(dir);
+    }
+
+    bool any_cpu = false;
+    for (auto& node : nodes_) {
+        any_cpu = any_cpu || !node.empty();
+    }
+    if (!any_cpu) {
+        nodes_.assign(1, allowed_cpus);
+    }
+}
+
+const std::vector<int>& Topology::cpus(const int node) const {
+    static const std::vector<int> none;
+    if (node < 0 || static_cast<std::size_t>(node) >= nodes_.size()) {
+        return none;
+    }
+    return nodes_[static_cast<std::size_t>(node)];
+}
+
+int Topology::nodeOf(const int cpu) const {
+    for (std::size_t node = 0; node < nodes_.size(); ++node) {
+        if (std::find(nodes_[node].begin(), nodes_[node].end(), cpu) != nodes_[node].end()) {
+            return static_cast<int>(node);
+        }
+    }
+    return 0;
+}
+
+bool Topology::numaAvailable() {
+#ifdef TASKLIB_HAVE_NUMA
+    static const bool available = numa_available() >= 0;
+    return available;
+#else
+    return false;
+#endif
+}
+
+std::vector<int> Topology::parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::istringstream iss(list);
+    std::string range;
+    while (std::getline(iss, range, ',')) {
+        if (range.empty() || range.find_first_not_of(" \n") == std::string::npos) {
+            continue;
+        }
+        const std::size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+int& NodeMemory::threadNode() {
+    thread_local int node = -1;
+    return node;
+}
+
+void* NodeMemory::allocate(const std::size_t size, const int node) {
+    const std::size_t total = size + sizeof(NodeBlock);
+    void* ptr = nullptr;
+    bool numa = false;
+
+#ifdef TASKLIB_HAVE_NUMA
+    // numa_alloc_onnode works in pages, negligible next to the stack of the task's thread
+    if (node >= 0 && Topology::numaAvailable()) {
+        ptr = numa_alloc_onnode(total, node);
+        numa = ptr != nullptr;
+    }
+#else
+    (void)node;
+#endif
+
+    if (!ptr && posix_memalign(&ptr, alignof(NodeBlock), total) != 0) {
+        throw std::bad_alloc();
+    }
+
+    NodeBlock* block = new (ptr) NodeBlock{total, numa};
+    return block + 1;
+}
+
+void NodeMemory::release(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+
+    NodeBlock* block = static_cast<NodeBlock*>(ptr) - 1;
+#ifdef TASKLIB_HAVE_NUMA
+    if (block->numa) {
+        numa_free(block, block->size);
+        return;
+    }
+#endif
+    free(block);
+}
@@ -0,0 +1,62 @@
+#ifndef TOPOLOGY
+#define TOPOLOGY
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * CPU/NUMA layout of the machine.
+ *
+ * Read from sysfs (/sys/devices/system/node), restricted to the CPUs this process may run on.
+ * Machines without NUMA information are described as a single node holding every allowed CPU.
+*/
+class Topology
+{
+public:
+
+    /* Topology of the running machine, discovered once */
+    static const Topology& system();
+
+    /**
+     * Builds the topology from a sysfs node directory (node<N>/cpulist entries)
+     * Falls back to a single node if the directory has no nodes
+    */
+    explicit Topology(const std::string& node_dir, const std::vector<int>& allowed_cpus);
+
+    std::size_t nodeCount() const { return nodes_.size(); }
+
+    /* CPUs of the node, empty if the node does not exist */
+    const std::vector<int>& cpus(const int node) const;
+
+    /* Node owning the cpu, 0 if unknown */
+    int nodeOf(const int cpu) const;
+
+    /* True if libnuma is linked and reports NUMA support */
+    static bool numaAvailable();
+
+    /* Parses a sysfs cpu list such as "0-3,8,10-11" */
+    static std::vector<int> parseCpuList(const std::string& list);
+
+private:
+    std::vector<std::vector<int>> nodes_;
+};
+
+namespace NodeMemory {
+
+    /* Node used by allocations of the calling thread that do not name one, -1 for none */
+    int& threadNode();
+
+    /**
+     * Allocates memory on a NUMA node, aligned to 64 bytes
+     * Without libnuma or with node < 0 the memory comes from the regular heap
+     *
+     * @throw bad_alloc on failure
+    */
+    void* allocate(const std::size_t size, const int node);
+
+    /* Releases memory obtained from allocate() */
+    void release(void* ptr);
+}
+
+#endif
@@ -0,0 +1,239 @@
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+    std::size_t roundUpPow2(std::size_t value) {
+        std::size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    /* Owns every ring ever created, rings outlive their threads so they can be dumped later */
+    struct TraceRegistry {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<TraceBuffer>> buffers;
+        std::size_t capacity = 4096;
+        std::atomic<std::uint32_t> next_thread{0};
+    };
+
+    TraceRegistry& registry() {
+        static TraceRegistry instance;
+        return instance;
+    }
+
+    /* Returns the ring to the registry when its thread exits */
+    struct LocalTraceBuffer {
+        TraceBuffer* buffer = nullptr;
+        std::atomic<bool>* in_use = nullptr;
+
+        ~LocalTraceBuffer() {
+            if (in_use) {
+                in_use->store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    thread_local LocalTraceBuffer local_buffer;
+}
+
+std::atomic<bool> Trace::enabled_(true);
+
+TraceBuffer::TraceBuffer(std::size_t capacity)
+: slots_(new Slot[roundUpPow2(std::max<std::size_t>(capacity, 2))]),
+  mask_(roundUpPow2(std::max<std::size_t>(capacity, 2)) - 1),
+  head_(0), tail_(0), in_use_(false)
+{
+    for (std::size_t i = 0; i <= mask_; ++i) {
+        for (auto& word : slots_[i].words) {
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+void TraceBuffer::snapshot(std::vector<TraceRecord>& out) const {
+    const std::uint64_t head = head_.load(std::memory_order_acquire);
+    const std::uint64_t capacity = mask_ + 1;
+    std::uint64_t begin = std::max<std::uint64_t>(tail_.load(std::memory_order_acquire),
+                                                  head > capacity ? head - capacity : 0);
+
+    const std::size_t first = out.size();
+    for (std::uint64_t i = begin; i < head; ++i) {
+        const Slot& slot = slots_[i & mask_];
+        const std::uint64_t ids = slot.words[1].load(std::memory_order_relaxed);
+        const std::uint64_t kind = slot.words[2].load(std::memory_order_relaxed);
+
+        TraceRecord record;
+        record.timestamp = slot.words[0].load(std::memory_order_relaxed);
+        record.task_id = static_cast<int>(static_cast<std::uint32_t>(ids >> 32));
+        record.thread = static_cast<std::uint32_t>(ids);
+        record.event = static_cast<TraceEvent>(kind);
+        out.push_back(record);
+    }
+
+    // Writer may have lapped the reader while copying, drop slots that were overwritten. It writes
+    // slot head_after (the one of head_after - capacity) before publishing head_after + 1, so that one too
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const std::uint64_t head_after = head_.load(std::memory_order_relaxed);
+    if (head_after + 1 > capacity && head_after + 1 - capacity > begin) {
+        const std::uint64_t lost = std::min<std::uint64_t>(head_after + 1 - capacity - begin, head - begin);
+        out.erase(out.begin() + static_cast<std::ptrdiff_t>(first),
+                  out.begin() + static_cast<std::ptrdiff_t>(first + lost));
+    }
+}
+
+void Trace::setBufferCapacity(std::size_t capacity) {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.capacity = capacity;
+}
+
+std::uint64_t Trace::now() {
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+std::uint32_t Trace::threadIndex() {
+    thread_local const std::uint32_t index = registry().next_thread.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+TraceBuffer& Trace::localBuffer() {
+    if (local_buffer.buffer) {
+        return *local_buffer.buffer;
+    }
+
+    // Slow path, once per thread: reuse a released ring or create a new one
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    TraceBuffer* buffer = nullptr;
+    for (auto& candidate : reg.buffers) {
+        bool expected = false;
+        if (candidate->capacity() == roundUpPow2(std::max<std::size_t>(reg.capacity, 2)) &&
+            candidate->in_use_.compare_exchange_strong(expected, true)) {
+            buffer = candidate.get();
+            break;
+        }
+    }
+
+    if (!buffer) {
+        reg.buffers.push_back(std::make_unique<TraceBuffer>(reg.capacity));
+        buffer = reg.buffers.back().get();
+        buffer->in_use_.store(true);
+    }
+
+    local_buffer.buffer = buffer;
+    local_buffer.in_use = &buffer->in_use_;
+    return *buffer;
+}
+
+std::vector<TraceRecord> Trace::collect() {
+    std::vector<TraceRecord> records;
+    {
+        auto& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (auto& buffer : reg.buffers) {
+            buffer->snapshot(records);
+        }
+    }
+
+    std::stable_sort(records.begin(), records.end(), [](const TraceRecord& a, const TraceRecord& b) {
+        return a.timestamp < b.timestamp;
+    });
+    return records;
+}
+
+void Trace::clear() {
+    auto& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    for (auto& buffer : reg.buffers) {
+        buffer->clear();
+    }
+}
+
+const char* Trace::eventName(TraceEvent event) {
+    switch(event) {
+        case TraceEvent::start:         return "start";
+        case TraceEvent::run:           return "run";
+        case TraceEvent::pauseRequest:  return "pause request";
+        case TraceEvent::resumeRequest: return "resume request";
+        case TraceEvent::stopRequest:   return "stop request";
+        case TraceEvent::paused:        return "paused";
+        case TraceEvent::resumed:       return "resumed";
+        case TraceEvent::stopping:      return "stopping";
+        case TraceEvent::unwound:       return "StopException unwind";
+        case TraceEvent::completed:     return "completed";
+        case TraceEvent::stopped:       return "stopped";
+        case TraceEvent::failed:        return "failed";
+    }
+    return "unknown";
+}
+
+void Trace::dump(std::ostream& os) {
+    const std::vector<TraceRecord> records = collect();
+    const std::uint64_t origin = records.empty() ? 0 : records.front().timestamp;
+
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    os << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"tasklib\"}}";
+
+    for (const auto& record : records) {
+        // run/completed/stopped/failed and paused/resumed are emitted as slices on the worker track,
+        // everything else as thread-scoped instant events
+        const char* phase = "i";
+        std::string name = eventName(record.event);
+        switch(record.event) {
+            case TraceEvent::run:
+                phase = "B";
+                name = "task " + std::to_string(record.task_id);
+                break;
+            case TraceEvent::completed:
+            case TraceEvent::stopped:
+            case TraceEvent::failed:
+                phase = "E";
+                name = "task " + std::to_string(record.task_id);
+                break;
+            case TraceEvent::paused:
+                phase = "B";
+                break;
+            case TraceEvent::resumed:
+                phase = "E";
+                name = "paused";
+                break;
+            default:
+                break;
+        }
+
+        const std::uint64_t relative = record.timestamp - origin;
+        os << ",{\"name\":\"" << name << "\",\"cat\":\"task\",\"ph\":\"" << phase << "\""
+           << ",\"ts\":" << relative / 1000 << '.' << static_cast<char>('0' + relative / 100 % 10)
+           << static_cast<char>('0' + relative / 10 % 10) << static_cast<char>('0' + relative % 10)
+           << ",\"pid\":1,\"tid\":" << record.thread;
+        if (*phase == 'i') {
+            os << ",\"s\":\"t\"";
+        }
+        os << ",\"args\":{\"task\":" << record.task_id;
+        if (record.event == TraceEvent::completed || record.event == TraceEvent::stopped || record.event == TraceEvent::failed) {
+            os << ",\"result\":\"" << eventName(record.event) << "\"";
+        }
+        os << "}}";
+    }
+
+    os << "]}\n";
+}
+
+void Trace::dump(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        std::ostringstream msg;
+        msg << "Cannot write trace file '" << path << "'";
+        throw std::runtime_error(msg.str());
+    }
+    dump(file);
+}
@@ -0,0 +1,140 @@
+#ifndef TRACE
+#define TRACE
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * Lifecycle tracing of tasks.
+ *
+ * Every thread records into its own fixed-size ring buffer (single writer, no locks on the
+ * recording path), the oldest events are overwritten when the ring is full. Trace::dump()
+ * merges all rings into Chrome trace-event JSON that can be loaded in Perfetto or chrome://tracing.
+ *
+ * Task hooks go through TASK_TRACE, which compiles to nothing unless TASKLIB_TRACE is defined
+ * (cmake -DTASKLIB_TRACE=ON).
+*/
+
+enum class TraceEvent : std::uint8_t {
+    start,          // controller: Task::start()
+    run,            // worker: execute() entered
+    pauseRequest,   // controller: Task::pause()
+    resumeRequest,  // controller: Task::resume()
+    stopRequest,    // controller: Task::stop()
+    paused,         // worker: checkCommand() acknowledged pause
+    resumed,        // worker: checkCommand() acknowledged resume
+    stopping,       // worker: checkCommand() acknowledged stop, StopException about to be thrown
+    unwound,        // worker: StopException reached callbackFuntion()
+    completed,      // worker: task finished as completed
+    stopped,        // worker: task finished as stopped
+    failed,         // worker: task finished as failed, execute() threw
+};
+
+struct TraceRecord {
+    std::uint64_t timestamp;  // steady clock, ns
+    int task_id;
+    std::uint32_t thread;     // tracer-assigned thread index
+    TraceEvent event;
+};
+
+/* Ring of trace records owned by one thread at a time */
+class TraceBuffer
+{
+public:
+    explicit TraceBuffer(std::size_t capacity);
+
+    TraceBuffer(const TraceBuffer&) = delete;
+    TraceBuffer& operator= (const TraceBuffer&) = delete;
+
+    /* Owning thread only */
+    void push(const TraceRecord& record) {
+        const std::uint64_t head = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[head & mask_];
+        slot.words[0].store(record.timestamp, std::memory_order_relaxed);
+        slot.words[1].store((static_cast<std::uint64_t>(static_cast<std::uint32_t>(record.task_id)) << 32) | record.thread,
+                            std::memory_order_relaxed);
+        slot.words[2].store(static_cast<std::uint64_t>(record.event), std::memory_order_relaxed);
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    /* Any thread: appends the records still present in the ring, oldest first; once the ring is full the
+     * slot the writer overwrites next is left out */
+    void snapshot(std::vector<TraceRecord>& out) const;
+
+    void clear() { tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release); }
+
+    std::size_t capacity() const { return mask_ + 1; }
+
+private:
+    friend class Trace;
+
+    struct Slot {
+        std::atomic<std::uint64_t> words[3];
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    const std::size_t mask_;
+    std::atomic<std::uint64_t> head_;
+    std::atomic<std::uint64_t> tail_;
+
+    /* Set while a live thread writes into this ring, released buffers are reused by new threads */
+    std::atomic<bool> in_use_;
+};
+
+class Trace
+{
+public:
+
+    /* Events per thread ring, rounded up to a power of two. Applies to rings created afterwards */
+    static void setBufferCapacity(std::size_t capacity);
+
+    /* Runtime switch, recording is enabled by default */
+    static void enable(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+    static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+
+    static void record(TraceEvent event, int task_id) {
+        if (!enabled()) {
+            return;
+        }
+        TraceRecord record{now(), task_id, threadIndex(), event};
+        localBuffer().push(record);
+    }
+
+    /* All recorded events of all threads sorted by timestamp */
+    static std::vector<TraceRecord> collect();
+
+    /* Drops every recorded event */
+    static void clear();
+
+    /* Writes collected events as Chrome trace-event JSON */
+    static void dump(std::ostream& os);
+
+    /**
+     * Writes collected events as Chrome trace-event JSON into a file
+     *
+     * @throw runtime_error if file cannot be opened
+    */
+    static void dump(const std::string& path);
+
+    static const char* eventName(TraceEvent event);
+
+private:
+    static std::atomic<bool> enabled_;
+
+    static std::uint64_t now();
+    static std::uint32_t threadIndex();
+    static TraceBuffer& localBuffer();
+};
+
+#ifdef TASKLIB_TRACE
+#define TASK_TRACE(event, task_id) Trace::record(TraceEvent::event, task_id)
+#else
+#define TASK_TRACE(event, task_id) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,130 @@
+#include "Watchdog.h"
+
+#include <cstring>
+
+/* --- POLL HISTOGRAM --- */
+
+constexpr std::size_t PollHistogram::bucket_count;
+
+void PollHistogram::add(const std::chrono::nanoseconds interval, const std::uint64_t polls) {
+    std::size_t bucket = 0;
+    for (auto ns = static_cast<std::uint64_t>(std::max<std::chrono::nanoseconds::rep>(interval.count(), 0)); ns > 1; ns >>= 1) {
+        bucket++;
+    }
+    counts[std::min(bucket, bucket_count - 1)] += polls;
+}
+
+std::uint64_t PollHistogram::total() const {
+    std::uint64_t total = 0;
+    for (const std::uint64_t count : counts) {
+        total += count;
+    }
+    return total;
+}
+
+std::chrono::nanoseconds PollHistogram::percentile(const double fraction) const {
+    const std::uint64_t total = this->total();
+    if (!total) {
+        return std::chrono::nanoseconds(0);
+    }
+
+    const double target = fraction * static_cast<double>(total);
+    std::uint64_t seen = 0;
+    for (std::size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        seen += counts[bucket];
+        if (static_cast<double>(seen) >= target) {
+            return std::chrono::nanoseconds(2ll << bucket);
+        }
+    }
+    return std::chrono::nanoseconds(2ll << (bucket_count - 1));
+}
+
+/* --- WATCHDOG --- */
+
+Watchdog::Watchdog(Scan scan, const std::chrono::milliseconds threshold, const std::chrono::milliseconds interval)
+: scan_(std::move(scan)), threshold_(threshold), interval_(interval), closing_(false), generation_(1)
+{
+    // Tasks start at generation 0, never taken for visited at the first scan
+    thread_ = std::thread(&Watchdog::run, this);
+}
+
+Watchdog::~Watchdog() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closing_ = true;
+        condition_.notify_all();
+    }
+    thread_.join();
+}
+
+std::vector<std::pair<std::string, PollHistogram>> Watchdog::histograms() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return histograms_;
+}
+
+std::vector<int> Watchdog::unresponsive() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    return unresponsive_;
+}
+
+PollHistogram& Watchdog::histogram(const char* type) {
+    for (auto& item : histograms_) {
+        if (std::strcmp(item.first.c_str(), type) == 0) {
+            return item.second;
+        }
+    }
+    histograms_.emplace_back(type, PollHistogram());
+    return histograms_.back().second;
+}
+
+void Watchdog::scan() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const auto now = std::chrono::steady_clock::now();
+    const std::uint64_t generation = ++generation_;
+    stalled_.clear();
+
+    // Flags are not changed while visiting, the visit runs under the scheduler's index lock
+    scan_([&](Task& task) {
+        const std::uint64_t heartbeat = task.heartbeat_.load(std::memory_order_relaxed);
+        const bool visited = task.watch_generation_ + 1 == generation;
+        task.watch_generation_ = generation;
+
+        if (!visited || task.parked_.load(std::memory_order_relaxed)) {
+            // Just started, resumed or parked: the gap since the last visit says nothing
+            task.watch_heartbeat_ = heartbeat;
+            task.watch_since_ = now;
+            return;
+        }
+
+        if (heartbeat != task.watch_heartbeat_) {
+            histogram(task.type()).add((now - task.watch_since_) / (heartbeat - task.watch_heartbeat_), heartbeat - task.watch_heartbeat_);
+            task.watch_heartbeat_ = heartbeat;
+            task.watch_since_ = now;
+            return;
+        }
+
+        if (now - task.watch_since_ >= threshold_) {
+            stalled_.push_back(&task);
+        }
+    });
+
+    // Tasks no longer stalled clear their flag at their next poll
+    unresponsive_.clear();
+    for (Task* task : stalled_) {
+        task->setUnresponsive();
+        unresponsive_.push_back(task->id());
+    }
+}
+
+void Watchdog::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!closing_) {
+        condition_.wait_for(lock, interval_);
+        if (closing_) {
+            break;
+        }
+        lock.unlock();
+        scan();
+        lock.lock();
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef WATCHDOG
+#define WATCHDOG
+
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Task.h"
+
+/* Intervals between two checkCommand() of the tasks of one type, bucketed by power of two */
+struct PollHistogram {
+    static constexpr std::size_t bucket_count = 40;
+
+    /* counts[i]: polls with an interval in [2^i, 2^(i+1)) ns, the first bucket from 0 */
+    std::array<std::uint64_t, bucket_count> counts{};
+
+    void add(const std::chrono::nanoseconds interval, const std::uint64_t polls);
+
+    std::uint64_t total() const;
+
+    /* Upper bound of the bucket holding the given fraction of the polls, 0 without polls */
+    std::chrono::nanoseconds percentile(const double fraction) const;
+};
+
+/**
+ * Monitor of the heartbeat every task bumps at each checkCommand(), see Scheduler::enableWatchdog
+ *
+ * A single thread visits the running tasks every interval. A task whose heartbeat has not moved for
+ * threshold is flagged unresponsive, which makes pause(), resume() and stop() on it fail instead of
+ * waiting; the flag clears at its next poll. Paused tasks and tasks parked in park() are not polling
+ * on purpose and are left alone. The mean poll interval seen between two visits feeds a histogram
+ * per task type. Tasks only pay a relaxed increment per poll.
+*/
+class Watchdog
+{
+public:
+    /* Calls its argument for every running task */
+    using Scan = std::function<void(const std::function<void(Task&)>&)>;
+
+    Watchdog(Scan scan, const std::chrono::milliseconds threshold, const std::chrono::milliseconds interval);
+
+    /* Stops the monitor thread, flags already set stay */
+    ~Watchdog();
+
+    Watchdog(const Watchdog&) = delete;
+    Watchdog& operator= (const Watchdog&) = delete;
+
+    std::chrono::milliseconds threshold() const { return threshold_; }
+
+    /* Poll histogram of every task type seen so far, by type name */
+    std::vector<std::pair<std::string, PollHistogram>> histograms() const;
+
+    /* Ids of the tasks flagged at the last visit */
+    std::vector<int> unresponsive() const;
+
+    /* Visits the running tasks now, as the monitor thread does every interval */
+    void scan();
+
+private:
+    const Scan scan_;
+    const std::chrono::milliseconds threshold_;
+    const std::chrono::milliseconds interval_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    bool closing_;
+
+    /* Guarded by mutex_, few types looked up by name */
+    std::vector<std::pair<std::string, PollHistogram>> histograms_;
+    std::vector<int> unresponsive_;
+    std::uint64_t generation_;
+
+    /* Filled while visiting, flags are changed once the visit is over */
+    std::vector<Task*> stalled_;
+
+    std::thread thread_;
+
+    PollHistogram& histogram(const char* type);
+    void run();
+};
+
+#endif
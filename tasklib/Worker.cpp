@@ -0,0 +1,823 @@
+#include "Worker.h"
+
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+
+#include "Log.h"
+#include "StopException.h"
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "Workers share lock-free atomics");
+static_assert(sizeof(std::atomic<std::uint32_t>) == sizeof(std::uint32_t), "Futex words are plain 32-bit integers");
+
+constexpr std::chrono::milliseconds WorkerPool::progress_period;
+
+/* --- SHARED MEMORY --- */
+
+struct WorkerRequest {
+    enum class Kind : std::uint32_t { run, pause, resume, stop, exit };
+
+    Kind kind;
+    std::int32_t task;
+    std::uint32_t type;
+    std::int64_t argument;
+};
+
+/* State change of the task running on a worker */
+struct WorkerEvent {
+    std::uint32_t state;        // Task::StateType
+    std::int32_t task;
+    char message[120];          // failure, truncated
+};
+
+/* Single producer, single consumer ring living in shared memory: no pointer, fixed capacity */
+template<class T, std::size_t N>
+struct SharedRing {
+    static_assert((N & (N - 1)) == 0, "Ring capacity is a power of two");
+
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> head;
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> tail;
+    T items[N];
+
+    void reset() {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    /* Producer side */
+    bool tryPush(const T& value) {
+        const std::uint32_t position = tail.load(std::memory_order_relaxed);
+        if (position - head.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        items[position % N] = value;
+        tail.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* Consumer side */
+    bool tryPop(T& value) {
+        const std::uint32_t position = head.load(std::memory_order_relaxed);
+        if (position == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = items[position % N];
+        head.store(position + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+/* One per worker, reset when the worker is forked */
+struct WorkerChannel {
+    /* pool -> worker */
+    SharedRing<WorkerRequest, 16> requests;
+    /* futex the worker sleeps on, bumped after requests are pushed */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> requested;
+
+    /* worker -> pool */
+    SharedRing<WorkerEvent, 16> events;
+    /* progress of the running task, bits of a double */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint64_t> progress;
+
+    /* zygote -> pool: the worker's pid, then its wait status once reaped */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::int32_t> pid;
+    std::atomic<std::uint32_t> exited;
+    std::atomic<std::int32_t> status;
+
+    void reset() {
+        requests.reset();
+        requested.store(0, std::memory_order_relaxed);
+        events.reset();
+        progress.store(0, std::memory_order_relaxed);
+        pid.store(0, std::memory_order_relaxed);
+        exited.store(0, std::memory_order_relaxed);
+        status.store(0, std::memory_order_relaxed);
+    }
+};
+
+struct WorkerShared {
+    /* futex the monitor sleeps on, bumped by workers after events are pushed and by the zygote after reaping */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> reported;
+
+    /* pool -> zygote, one request at a time under the pool mutex: fork the worker of spawn_slot, or exit if closing */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> spawn_requested;
+    std::atomic<std::uint32_t> spawn_slot;
+    std::atomic<std::uint32_t> closing;
+    /* zygote -> pool: bumped once the request is handled, spawn_result is the pid or -errno */
+    alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> spawned;
+    std::atomic<std::int32_t> spawn_result;
+
+    WorkerChannel& channel(const std::size_t index) {
+        return reinterpret_cast<WorkerChannel*>(reinterpret_cast<char*>(this) + sizeof(WorkerShared))[index];
+    }
+};
+
+namespace {
+
+/* Process-shared: no FUTEX_PRIVATE_FLAG */
+void futexWait(std::atomic<std::uint32_t>& word, const std::uint32_t value, const timespec* timeout) {
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT, value, timeout, nullptr, 0);
+}
+
+void futexWake(std::atomic<std::uint32_t>& word) {
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+timespec toTimespec(const std::chrono::nanoseconds duration) {
+    return timespec{static_cast<time_t>(duration.count() / 1000000000), static_cast<long>(duration.count() % 1000000000)};
+}
+
+std::uint64_t encodeProgress(const double progress) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &progress, sizeof(bits));
+    return bits;
+}
+
+double decodeProgress(const std::uint64_t bits) {
+    double progress;
+    std::memcpy(&progress, &bits, sizeof(progress));
+    return progress;
+}
+
+/* Worker side, from the task's inner thread or the worker's main thread, never both at once */
+void report(WorkerShared& shared, WorkerChannel& channel, const int task, const Task::StateType state, const char* message = "") {
+    WorkerEvent event;
+    event.state = static_cast<std::uint32_t>(state);
+    event.task = task;
+    std::snprintf(event.message, sizeof(event.message), "%s", message);
+    while (!channel.events.tryPush(event)) {
+        std::this_thread::yield();
+    }
+    shared.reported.fetch_add(1, std::memory_order_release);
+    futexWake(shared.reported);
+}
+
+/* Body of a worker process: runs the tasks requested one after the other, never returns */
+[[noreturn]] void serve(WorkerShared& shared, WorkerChannel& channel, const TaskTypeInfo* types, const std::size_t type_count,
+                        const pid_t parent) {
+    // Failures are reported by the pool's process
+    Log::discardGlobal();
+
+    std::unique_ptr<Task> task;
+    const timespec period = toTimespec(WorkerPool::progress_period);
+    const timespec idle_period = toTimespec(std::chrono::milliseconds(100));
+    for (;;) {
+        // Dies with the pool's process. Not PR_SET_PDEATHSIG, which follows the forking thread
+        if (::getppid() != parent) {
+            ::_exit(EXIT_FAILURE);
+        }
+
+        const std::uint32_t requested = channel.requested.load(std::memory_order_acquire);
+
+        WorkerRequest request;
+        while (channel.requests.tryPop(request)) {
+            switch (request.kind) {
+                case WorkerRequest::Kind::run:
+                {
+                    if (task) {
+                        task->join();
+                        task.reset();
+                    }
+                    channel.progress.store(encodeProgress(0.0), std::memory_order_relaxed);
+                    if (request.type >= type_count) {
+                        report(shared, channel, request.task, Task::StateType::failed, "unknown task type");
+                        break;
+                    }
+                    try {
+                        task = types[request.type].construct(request.task, request.argument);
+                    }
+                    catch (const std::exception& e) {
+                        report(shared, channel, request.task, Task::StateType::failed, e.what());
+                        break;
+                    }
+
+                    // Both hooks run on the task's inner thread
+                    task->setStateHook([&shared, &channel](Task& source, Task::StateType state) {
+                        if (!Task::finished(state)) {
+                            report(shared, channel, source.id(), state);
+                        }
+                    });
+                    task->setFinishHook([&shared, &channel](Task& source, Task::StateType state) {
+                        channel.progress.store(encodeProgress(source.progress()), std::memory_order_relaxed);
+                        std::string message;
+                        if (state == Task::StateType::failed) {
+                            try {
+                                std::rethrow_exception(source.exception());
+                            }
+                            catch (const std::exception& e) {
+                                message = e.what();
+                            }
+                            catch (...) {
+                                message = "unknown exception";
+                            }
+                        }
+                        report(shared, channel, source.id(), state, message.c_str());
+                    });
+                    task->start();
+                    break;
+                }
+                case WorkerRequest::Kind::pause:
+                case WorkerRequest::Kind::resume:
+                case WorkerRequest::Kind::stop:
+                {
+                    // The task may have ended meanwhile, its final state is on its way
+                    if (!task) {
+                        break;
+                    }
+                    try {
+                        if (request.kind == WorkerRequest::Kind::pause) {
+                            task->requestPause();
+                        }
+                        else if (request.kind == WorkerRequest::Kind::resume) {
+                            task->resume();
+                        }
+                        else {
+                            task->requestStop();
+                        }
+                    }
+                    catch (const std::runtime_error&) {
+                    }
+                    break;
+                }
+                case WorkerRequest::Kind::exit:
+                {
+                    if (task) {
+                        try {
+                            task->requestStop();
+                        }
+                        catch (const std::runtime_error&) {
+                        }
+                        task->join();
+                    }
+                    ::_exit(EXIT_SUCCESS);
+                }
+            }
+        }
+
+        const bool running = task && !Task::finished(task->status());
+        if (running) {
+            channel.progress.store(encodeProgress(task->progress()), std::memory_order_relaxed);
+        }
+        futexWait(channel.requested, requested, running ? &period : &idle_period);
+    }
+}
+
+/* Publishes the exit of a worker reaped by the zygote and wakes the monitor */
+void reportExit(WorkerShared& shared, const std::size_t size, const pid_t pid, const int status) {
+    for (std::size_t i = 0; i < size; ++i) {
+        WorkerChannel& channel = shared.channel(i);
+        if (channel.pid.load(std::memory_order_relaxed) == pid && !channel.exited.load(std::memory_order_relaxed)) {
+            channel.status.store(status, std::memory_order_relaxed);
+            channel.exited.store(1, std::memory_order_release);
+        }
+    }
+    shared.reported.fetch_add(1, std::memory_order_release);
+    futexWake(shared.reported);
+}
+
+/* Zygote side, SIGKILL to every worker not reaped yet */
+void killWorkers(WorkerShared& shared, const std::size_t size) {
+    for (std::size_t i = 0; i < size; ++i) {
+        WorkerChannel& channel = shared.channel(i);
+        const pid_t pid = channel.pid.load(std::memory_order_relaxed);
+        if (pid > 0 && !channel.exited.load(std::memory_order_relaxed)) {
+            ::kill(pid, SIGKILL);
+        }
+    }
+}
+
+/* Waits for the workers, killing those left after a grace period */
+[[noreturn]] void closeZygote(WorkerShared& shared, const std::size_t size) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+    bool killed = false;
+    for (;;) {
+        int status;
+        const pid_t pid = ::waitpid(-1, &status, killed ? 0 : WNOHANG);
+        if (pid > 0) {
+            reportExit(shared, size, pid, status);
+            continue;
+        }
+        if (pid < 0 && errno != EINTR) {
+            ::_exit(EXIT_SUCCESS);
+        }
+        if (!killed && std::chrono::steady_clock::now() > deadline) {
+            killWorkers(shared, size);
+            killed = true;
+        }
+        if (!killed) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+/**
+ * Body of the zygote: forks the workers the pool asks for and reaps them, never returns
+ *
+ * It is forked once when the pool is created and stays single threaded, so that workers forked again
+ * later do not inherit locks held by the other threads of the pool's process.
+*/
+[[noreturn]] void zygote(WorkerShared& shared, const std::size_t size, const TaskTypeInfo* types, const std::size_t type_count,
+                         const pid_t parent) {
+    Log::discardGlobal();
+    const pid_t self = ::getpid();
+    const timespec period = toTimespec(std::chrono::milliseconds(10));
+    std::uint32_t handled = 0;
+    for (;;) {
+        // Takes its workers down with the pool's process
+        if (::getppid() != parent) {
+            killWorkers(shared, size);
+            ::_exit(EXIT_FAILURE);
+        }
+
+        const std::uint32_t requested = shared.spawn_requested.load(std::memory_order_acquire);
+
+        int status;
+        pid_t pid;
+        while ((pid = ::waitpid(-1, &status, WNOHANG)) > 0) {
+            reportExit(shared, size, pid, status);
+        }
+
+        if (requested == handled) {
+            futexWait(shared.spawn_requested, requested, &period);
+            continue;
+        }
+        handled = requested;
+        if (shared.closing.load(std::memory_order_relaxed)) {
+            closeZygote(shared, size);
+        }
+
+        WorkerChannel& channel = shared.channel(shared.spawn_slot.load(std::memory_order_relaxed));
+        pid = ::fork();
+        if (pid == 0) {
+            serve(shared, channel, types, type_count, self);
+        }
+        // Set before the next waitpid(), which may find the worker dead already
+        channel.pid.store(pid > 0 ? pid : 0, std::memory_order_relaxed);
+        shared.spawn_result.store(pid > 0 ? pid : -errno, std::memory_order_relaxed);
+        shared.spawned.fetch_add(1, std::memory_order_release);
+        futexWake(shared.spawned);
+    }
+}
+
+std::string describeExit(const char* process, const pid_t pid, const int status) {
+    std::ostringstream msg;
+    msg << process << " " << pid;
+    if (WIFSIGNALED(status)) {
+        msg << " crashed, signal " << WTERMSIG(status) << " (" << strsignal(WTERMSIG(status)) << ")";
+    }
+    else {
+        msg << " exited, status " << WEXITSTATUS(status);
+    }
+    return msg.str();
+}
+
+}
+
+/* --- WORKER POOL --- */
+
+WorkerPool::WorkerPool(const TaskTypeInfo* types, const std::size_t type_count, const std::size_t size)
+: types_(types), type_count_(type_count), shared_(nullptr), shared_size_(sizeof(WorkerShared) + size * sizeof(WorkerChannel)),
+  respawns_(0), closing_(false), waking_(0), zygote_(-1), zygote_exited_(false), zygote_status_(0)
+{
+    if (size == 0) {
+        throw std::invalid_argument("Cannot create worker pool, no worker");
+    }
+
+    void* memory = ::mmap(nullptr, shared_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error(std::string("Cannot create worker pool, ") + std::strerror(errno));
+    }
+    shared_ = new (memory) WorkerShared();
+    shared_->reported.store(0, std::memory_order_relaxed);
+    shared_->spawn_requested.store(0, std::memory_order_relaxed);
+    shared_->spawn_slot.store(0, std::memory_order_relaxed);
+    shared_->closing.store(0, std::memory_order_relaxed);
+    shared_->spawned.store(0, std::memory_order_relaxed);
+    shared_->spawn_result.store(0, std::memory_order_relaxed);
+
+    slots_.resize(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        slots_[i] = Slot{new (&shared_->channel(i)) WorkerChannel(), 0, nullptr, Task::StateType::idle, std::string(), true};
+        slots_[i].channel->reset();
+    }
+
+    // The only fork of this process, workers are forked by the zygote
+    const pid_t parent = ::getpid();
+    zygote_ = ::fork();
+    if (zygote_ < 0) {
+        const std::string reason = std::strerror(errno);
+        ::munmap(shared_, shared_size_);
+        throw std::runtime_error("Cannot fork worker zygote, " + reason);
+    }
+    if (zygote_ == 0) {
+        zygote(*shared_, size, types_, type_count_, parent);
+    }
+
+    try {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (std::size_t i = 0; i < size; ++i) {
+            spawn(i);
+        }
+    }
+    catch (...) {
+        // Its workers exit once they see it gone
+        ::kill(zygote_, SIGKILL);
+        ::waitpid(zygote_, nullptr, 0);
+        ::munmap(shared_, shared_size_);
+        throw;
+    }
+
+    monitor_ = std::thread(&WorkerPool::monitor, this);
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    shared_->reported.fetch_add(1, std::memory_order_release);
+    futexWake(shared_->reported);
+    monitor_.join();
+
+    for (std::size_t i = 0; i < slots_.size(); ++i) {
+        if (!slots_[i].crashed) {
+            WorkerChannel& channel = *slots_[i].channel;
+            if (channel.requests.tryPush(WorkerRequest{WorkerRequest::Kind::exit, 0, 0, 0})) {
+                channel.requested.fetch_add(1, std::memory_order_release);
+                futexWake(channel.requested);
+            }
+        }
+    }
+
+    // The zygote waits for the workers, killing those whose task does not acknowledge stop in time
+    if (!zygote_exited_) {
+        shared_->closing.store(1, std::memory_order_relaxed);
+        shared_->spawn_requested.fetch_add(1, std::memory_order_release);
+        futexWake(shared_->spawn_requested);
+        ::waitpid(zygote_, nullptr, 0);
+    }
+
+    ::munmap(shared_, shared_size_);
+}
+
+void WorkerPool::spawn(const std::size_t slot) {
+    if (zygote_exited_) {
+        throw std::runtime_error("Cannot fork worker, zygote exited");
+    }
+    Slot& worker = slots_[slot];
+    worker.channel->reset();
+
+    const std::uint32_t spawned = shared_->spawned.load(std::memory_order_acquire);
+    shared_->spawn_slot.store(static_cast<std::uint32_t>(slot), std::memory_order_relaxed);
+    shared_->spawn_requested.fetch_add(1, std::memory_order_release);
+    futexWake(shared_->spawn_requested);
+
+    const timespec period = toTimespec(std::chrono::milliseconds(10));
+    while (shared_->spawned.load(std::memory_order_acquire) == spawned) {
+        // Not reaped here, the monitor reports the zygote's exit
+        siginfo_t info;
+        info.si_pid = 0;
+        if (::waitid(P_PID, static_cast<id_t>(zygote_), &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == zygote_) {
+            throw std::runtime_error("Cannot fork worker, zygote exited");
+        }
+        futexWait(shared_->spawned, spawned, &period);
+    }
+
+    const std::int32_t pid = shared_->spawn_result.load(std::memory_order_relaxed);
+    if (pid < 0) {
+        throw std::runtime_error(std::string("Cannot fork worker, ") + std::strerror(-pid));
+    }
+    worker.pid = pid;
+    worker.crashed = false;
+}
+
+const TaskTypeInfo& WorkerPool::type(const std::string& name) const {
+    for (std::size_t i = 0; i < type_count_; ++i) {
+        if (name == types_[i].name) {
+            return types_[i];
+        }
+    }
+    std::size_t index = 0;
+    for (const char digit : name) {
+        index = digit >= '0' && digit <= '9' && index < type_count_ ? index * 10 + static_cast<std::size_t>(digit - '0') : type_count_;
+    }
+    if (!name.empty() && index < type_count_) {
+        return types_[index];
+    }
+    std::ostringstream msg;
+    msg << "Cannot find task type, '" << name << "', not registered";
+    throw std::runtime_error(msg.str());
+}
+
+RemoteTask& WorkerPool::addTask(Scheduler& scheduler, const std::string& name, const std::string& argument) {
+    const TaskTypeInfo& info = type(name);
+    const RemoteTaskInput input{this, static_cast<std::size_t>(&info - types_), parseTaskArgument(info, argument)};
+    return scheduler.addTask<RemoteTask>(input);
+}
+
+std::vector<pid_t> WorkerPool::pids() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::vector<pid_t> pids;
+    for (const Slot& slot : slots_) {
+        pids.push_back(slot.pid);
+    }
+    return pids;
+}
+
+int WorkerPool::acquire(Task& task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < slots_.size(); ++i) {
+        Slot& slot = slots_[i];
+        if (!slot.owner && !slot.crashed) {
+            slot.owner = &task;
+            slot.state = Task::StateType::running;
+            slot.message.clear();
+            waiting_.erase(std::remove(waiting_.begin(), waiting_.end(), &task), waiting_.end());
+            return static_cast<int>(i);
+        }
+    }
+    if (std::find(waiting_.begin(), waiting_.end(), &task) == waiting_.end()) {
+        waiting_.push_back(&task);
+    }
+    return -1;
+}
+
+void WorkerPool::abandon(Task& task) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiting_.erase(std::remove(waiting_.begin(), waiting_.end(), &task), waiting_.end());
+    waitWoken(lock);
+}
+
+void WorkerPool::release(const int slot) {
+    std::vector<Task*> waiting;
+    std::unique_lock<std::mutex> lock(mutex_);
+    Slot& worker = slots_[static_cast<std::size_t>(slot)];
+    worker.owner = nullptr;
+    worker.state = Task::StateType::idle;
+    if (worker.crashed && !closing_) {
+        try {
+            spawn(static_cast<std::size_t>(slot));
+            respawns_++;
+        }
+        catch (const std::runtime_error& e) {
+            Log::global().write(e.what());
+        }
+    }
+    // The monitor may be waking the releasing task
+    waitWoken(lock);
+    waiting.swap(waiting_);
+    wakeAll(lock, waiting);
+}
+
+void WorkerPool::wakeAll(std::unique_lock<std::mutex>& lock, const std::vector<Task*>& tasks) {
+    if (tasks.empty()) {
+        return;
+    }
+    waking_++;
+    lock.unlock();
+    for (Task* task : tasks) {
+        task->wake();
+    }
+    lock.lock();
+    if (--waking_ == 0) {
+        woken_condition_.notify_all();
+    }
+}
+
+void WorkerPool::waitWoken(std::unique_lock<std::mutex>& lock) {
+    woken_condition_.wait(lock, [&]() {
+        return waking_ == 0;
+    });
+}
+
+void WorkerPool::send(const int slot, const WorkerRequest& request) {
+    WorkerChannel& channel = *slots_[static_cast<std::size_t>(slot)].channel;
+    while (!channel.requests.tryPush(request)) {
+        // A dead worker never drains its ring
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (slots_[static_cast<std::size_t>(slot)].crashed) {
+                return;
+            }
+        }
+        std::this_thread::yield();
+    }
+    channel.requested.fetch_add(1, std::memory_order_release);
+    futexWake(channel.requested);
+}
+
+bool WorkerPool::finished(const int slot, Task::StateType& state, std::string& message) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const Slot& worker = slots_[static_cast<std::size_t>(slot)];
+    if (!Task::finished(worker.state)) {
+        return false;
+    }
+    state = worker.state;
+    message = worker.message;
+    return true;
+}
+
+void WorkerPool::waitFinished(const int slot) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_condition_.wait(lock, [&]() {
+        return Task::finished(slots_[static_cast<std::size_t>(slot)].state);
+    });
+}
+
+bool WorkerPool::applied(const int slot, const Task::CommandType command) const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    const Task::StateType state = slots_[static_cast<std::size_t>(slot)].state;
+    return Task::finished(state) || (state == Task::StateType::paused) == (command == Task::CommandType::pause);
+}
+
+double WorkerPool::progress(const int slot) const {
+    return decodeProgress(slots_[static_cast<std::size_t>(slot)].channel->progress.load(std::memory_order_relaxed));
+}
+
+void WorkerPool::monitor() {
+    // The zygote is looked for at least this often
+    const timespec period = toTimespec(std::chrono::milliseconds(10));
+    std::vector<Task*> woken;
+    for (;;) {
+        const std::uint32_t reported = shared_->reported.load(std::memory_order_acquire);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (closing_) {
+                return;
+            }
+            // Its workers exit once they see it gone, without anyone to report it
+            if (!zygote_exited_ && ::waitpid(zygote_, &zygote_status_, WNOHANG) == zygote_) {
+                zygote_exited_ = true;
+                Log::global().write(describeExit("worker zygote", zygote_, zygote_status_));
+            }
+            for (std::size_t i = 0; i < slots_.size(); ++i) {
+                Slot& slot = slots_[i];
+                // Read before the events: every event of a worker seen dead is drained below
+                const bool reaped = slot.channel->exited.load(std::memory_order_acquire);
+                WorkerEvent event;
+                while (slot.channel->events.tryPop(event)) {
+                    if (!slot.owner || event.task != slot.owner->id() || Task::finished(slot.state)) {
+                        continue;
+                    }
+                    slot.state = static_cast<Task::StateType>(event.state);
+                    if (Task::finished(slot.state)) {
+                        slot.message = event.message;
+                    }
+                    // Paused and running acknowledge a forwarded command
+                    if (std::find(woken.begin(), woken.end(), slot.owner) == woken.end()) {
+                        woken.push_back(slot.owner);
+                    }
+                }
+
+                if (slot.crashed || !(reaped || zygote_exited_)) {
+                    continue;
+                }
+                slot.crashed = true;
+                if (slot.owner && !Task::finished(slot.state)) {
+                    slot.state = Task::StateType::failed;
+                    slot.message = reaped ? describeExit("worker", slot.pid, slot.channel->status.load(std::memory_order_relaxed))
+                                          : describeExit("worker zygote", zygote_, zygote_status_);
+                    woken.push_back(slot.owner);
+                }
+                else if (!slot.owner) {
+                    // Idle worker, forked again right away
+                    try {
+                        spawn(i);
+                        respawns_++;
+                    }
+                    catch (const std::runtime_error& e) {
+                        Log::global().write(e.what());
+                    }
+                }
+            }
+            if (!woken.empty()) {
+                finished_condition_.notify_all();
+                wakeAll(lock, woken);
+                woken.clear();
+            }
+        }
+        futexWait(shared_->reported, reported, &period);
+    }
+}
+
+/* --- REMOTE TASK --- */
+
+RemoteTask::RemoteTask(const int id, const RemoteTaskInput& input)
+: Task(id), input_(input), slot_(-1), progress_(0.0), forwarded_(CommandType::run)
+{
+    setType(input_.pool->types_[input_.type].name);
+}
+
+double RemoteTask::progress() {
+    const int slot = slot_;
+    return slot >= 0 ? input_.pool->progress(slot) : progress_.load();
+}
+
+pid_t RemoteTask::worker() const {
+    const int slot = slot_;
+    if (slot < 0) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(input_.pool->mutex_);
+    return input_.pool->slots_[static_cast<std::size_t>(slot)].pid;
+}
+
+void RemoteTask::onRearm() {
+    progress_ = 0.0;
+}
+
+bool RemoteTask::commandApplied(const CommandType command) {
+    // Waiting for a worker, or done with it: nothing else to follow
+    const int slot = slot_;
+    if (slot < 0) {
+        return true;
+    }
+    forward(slot);
+    return input_.pool->applied(slot, command);
+}
+
+void RemoteTask::forward(const int slot) {
+    const CommandType command = effectiveCommand();
+    if (command == forwarded_) {
+        return;
+    }
+    forwarded_ = command;
+    const WorkerRequest::Kind kind = command == CommandType::pause ? WorkerRequest::Kind::pause
+                                   : command == CommandType::run ? WorkerRequest::Kind::resume
+                                   : WorkerRequest::Kind::stop;
+    input_.pool->send(slot, WorkerRequest{kind, id(), 0, 0});
+}
+
+void RemoteTask::execute() {
+    WorkerPool& pool = *input_.pool;
+    int slot = -1;
+    bool sent = false;
+    try {
+        // Waiting for a free worker, pause and stop apply meanwhile
+        while (slot < 0) {
+            park([&]() {
+                slot = pool.acquire(*this);
+                return slot >= 0;
+            });
+        }
+        slot_ = slot;
+        forwarded_ = CommandType::run;
+        pool.send(slot, WorkerRequest{WorkerRequest::Kind::run, id(), static_cast<std::uint32_t>(input_.type), input_.argument});
+        sent = true;
+
+        // Commands are forwarded as soon as they are seen, the task pauses here once the worker paused, see commandApplied
+        StateType state;
+        std::string message;
+        bool done = false;
+        while (!done) {
+            park([&]() {
+                forward(slot);
+                done = pool.finished(slot, state, message);
+                return done;
+            });
+        }
+
+        progress_ = pool.progress(slot);
+        slot_ = -1;
+        pool.release(slot);
+        slot = -1;
+        if (state == StateType::stopped) {
+            throw StopException();
+        }
+        if (state == StateType::failed) {
+            throw std::runtime_error(message);
+        }
+    }
+    catch (const StopException&) {
+        if (slot >= 0 && !sent) {
+            // Stopped as a worker freed, nothing runs on it
+            pool.release(slot);
+        }
+        else if (slot >= 0) {
+            if (forwarded_ != CommandType::stop) {
+                forwarded_ = CommandType::stop;
+                pool.send(slot, WorkerRequest{WorkerRequest::Kind::stop, id(), 0, 0});
+            }
+            pool.waitFinished(slot);
+            progress_ = pool.progress(slot);
+            slot_ = -1;
+            pool.release(slot);
+        }
+        else {
+            pool.abandon(*this);
+        }
+        throw;
+    }
+}
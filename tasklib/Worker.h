@@ -0,0 +1,202 @@
+#ifndef WORKER
+#define WORKER
+
+#include <sys/types.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Registry.h"
+
+struct WorkerShared;
+struct WorkerChannel;
+struct WorkerRequest;
+class RemoteTask;
+
+/**
+ * Pre-forked worker processes running registered task types out of the scheduler's process, so that a
+ * task crashing (segfault, abort, runaway allocation killed by the OOM killer) takes down its worker only.
+ *
+ * Every worker runs one task at a time. A task started through the pool is a RemoteTask in the scheduler:
+ * it waits for a free worker, sends it the type and argument and mirrors what it reports. Commands and
+ * state changes go through a pair of single producer rings per worker in memory shared before forking,
+ * both sides sleep on futex words in that memory, there is no pipe nor socket on the control path.
+ * Progress is published by the worker in the same memory every progress_period.
+ *
+ * One monitor thread drains the state changes of every worker and wakes the tasks parked on them, as
+ * the Reactor does for descriptors. A RemoteTask switches to paused or back to running only once its
+ * worker reported the task did. A worker that dies is reported to the monitor: its task fails with
+ * "worker crashed" and the worker is forked again.
+ *
+ * Workers are forked by a zygote, a single threaded process forked from the calling process once when
+ * the pool is created: respawning a worker never forks the multithreaded pool process. The zygote
+ * reaps the workers and reports their exit through the shared memory. Create the pool before starting
+ * threads that could hold locks the workers need (allocator aside). The pool must outlive the tasks
+ * started through it.
+*/
+class WorkerPool
+{
+public:
+    /* Period at which a worker publishes the progress of its task */
+    static constexpr std::chrono::milliseconds progress_period{10};
+
+    /**
+     * Forks size workers able to run the types of Registry (a TaskRegistry)
+     *
+     * @throw runtime_error if the shared memory or a worker cannot be created
+    */
+    template<class Registry>
+    WorkerPool(Registry, const std::size_t size)
+    : WorkerPool(&Registry::at(0), Registry::size(), size)
+    {}
+
+    WorkerPool(const TaskTypeInfo* types, const std::size_t type_count, const std::size_t size);
+
+    /* Asks the workers to exit, killing those still running a task after a grace period */
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator= (const WorkerPool&) = delete;
+
+    /**
+     * Starts through scheduler a task of the type named name (or with the numeric id name) with argument,
+     * its default if empty, running in a worker
+     *
+     * @throw runtime_error if the type is unknown or the argument invalid, or as Scheduler::addTask
+    */
+    RemoteTask& addTask(Scheduler& scheduler, const std::string& name, const std::string& argument = std::string());
+
+    std::size_t size() const { return slots_.size(); }
+
+    /* Process ids of the workers, a respawned worker gets a new one */
+    std::vector<pid_t> pids() const;
+
+    /* Workers forked again after dying */
+    std::size_t respawns() const { return respawns_; }
+
+private:
+    friend class RemoteTask;
+
+    struct Slot {
+        WorkerChannel* channel;
+        pid_t pid;
+        Task* owner;                // task running on the worker, nullptr if free
+        Task::StateType state;      // last state reported for owner
+        std::string message;        // failure reported for owner
+        bool crashed;
+    };
+
+    const TaskTypeInfo* types_;
+    const std::size_t type_count_;
+    WorkerShared* shared_;
+    std::size_t shared_size_;
+
+    /* Guards slots_, waiting_, waking_ and closing_, taken under a task's control mutex by RemoteTask */
+    mutable std::mutex mutex_;
+    std::condition_variable finished_condition_;
+    std::vector<Slot> slots_;
+    std::vector<Task*> waiting_;
+    std::atomic<std::size_t> respawns_;
+    bool closing_;
+
+    /**
+     * Threads waking tasks out of mutex_, which they cannot do under it: wake() takes the task's control
+     * mutex. A task leaving the pool waits for none to be left before it can be destroyed
+    */
+    std::size_t waking_;
+    std::condition_variable woken_condition_;
+
+    /* Forks the workers, see zygote() in Worker.cpp; exit status set once reaped by the monitor */
+    pid_t zygote_;
+    bool zygote_exited_;
+    int zygote_status_;
+
+    std::thread monitor_;
+
+    const TaskTypeInfo& type(const std::string& name) const;
+
+    /* Has the zygote fork the worker of slot and waits for its pid, mutex_ held */
+    void spawn(const std::size_t slot);
+
+    /* Index of a free worker now owned by task, -1 if all are busy: task is woken when one frees */
+    int acquire(Task& task);
+
+    /* Forgets task waiting for a worker */
+    void abandon(Task& task);
+
+    /* Frees slot, forking its worker again if it died */
+    void release(const int slot);
+
+    /* Queues request to the worker of slot, owner's inner thread only */
+    void send(const int slot, const WorkerRequest& request);
+
+    /* True once the owner's run has ended on the worker, with the state and failure it ended with */
+    bool finished(const int slot, Task::StateType& state, std::string& message);
+
+    /* Locks calling thread till finished(slot) holds */
+    void waitFinished(const int slot);
+
+    /* True once the worker of slot reported its task paused (command pause) or running again, or ended */
+    bool applied(const int slot, const Task::CommandType command) const;
+
+    /* Wakes tasks collected under lock, mutex_ held on entry and on return */
+    void wakeAll(std::unique_lock<std::mutex>& lock, const std::vector<Task*>& tasks);
+
+    /* Waits till no thread is waking tasks, mutex_ held */
+    void waitWoken(std::unique_lock<std::mutex>& lock);
+
+    double progress(const int slot) const;
+
+    void monitor();
+};
+
+/* Input of a RemoteTask, see WorkerPool::addTask */
+struct RemoteTaskInput {
+    WorkerPool* pool;
+    std::size_t type;
+    long long argument;
+};
+
+/**
+ * Stand-in of a task running in a worker: parked till the worker reports, it forwards its commands to
+ * the worker and ends as the remote task did. type() is the name of the remote type
+*/
+class RemoteTask : public Task
+{
+public:
+    RemoteTask(const int id, const RemoteTaskInput& input);
+
+    double progress() override;
+
+    /* Process id of the worker running the task, 0 if it has none */
+    pid_t worker() const;
+
+protected:
+    void onRearm() override;
+
+    /* Forwards the command, true once the worker applied it */
+    bool commandApplied(const CommandType command) override;
+
+private:
+    const RemoteTaskInput input_;
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int> slot_;
+    std::atomic<double> progress_;
+    /* Last command sent to the worker, inner thread only */
+    CommandType forwarded_;
+
+    /* Sends the current command to the worker if it changed, under the control mutex */
+    void forward(const int slot);
+
+    void execute() override;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef TEST_UTILS
+#define TEST_UTILS
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "Counter.h"
+
+/* Unique path for a journal or checkpoint file, the file itself does not exist */
+inline std::string journalPath() {
+    char path[] = "/tmp/tasklib_journalXXXXXX";
+    close(mkstemp(path));
+    unlink(path);
+    return path;
+}
+
+/* Polls predicate till it holds, false if it does not within timeout */
+template<class Predicate>
+bool waitFor(Predicate&& predicate, const std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!predicate()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+/* Counter stopped when destroyed, like a service shutting down with work in progress */
+class LongCounter : public Counter
+{
+public:
+    using Counter::Counter;
+
+    ~LongCounter() {
+        StateType state = status();
+        if (state == StateType::running || state == StateType::paused) {
+            stop();
+        }
+        join();
+    }
+};
+
+#endif
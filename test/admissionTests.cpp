@@ -0,0 +1,173 @@
+#include <atomic>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "Counter.h"
+#include "TestTask.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Same behaviour as TestTask, distinct type for per-type limits */
+class OtherTask : public TestTask
+{
+public:
+    using TestTask::TestTask;
+};
+
+}
+
+/**
+ * Test: global concurrency limit
+ * - Step 1: limit to 1 task, start 2 tasks
+ * - Step 2: stop the first one
+ * Expected: second task waits queued and starts once the first one is stopped
+*/
+TEST(AdmissionTest, Global_Limit_Queues)
+{
+    Scheduler scheduler;
+    scheduler.setConcurrencyLimit(1);
+
+    TestTask& first = scheduler.addTask<TestTask>(10ns);
+    TestTask& second = scheduler.addTask<TestTask>(10ns);
+
+    ASSERT_EQ(first.status(), Task::StateType::running);
+    ASSERT_EQ(second.status(), Task::StateType::queued);
+    ASSERT_EQ(scheduler.runningCount(), 1u);
+    ASSERT_EQ(scheduler.queuedCount(), 1u);
+
+    first.stop();
+
+    ASSERT_EQ(second.status(), Task::StateType::running);
+    ASSERT_EQ(scheduler.runningCount(), 1u);
+    ASSERT_EQ(scheduler.queuedCount(), 0u);
+}
+
+/**
+ * Test: per-type concurrency limit
+ * - Step 1: limit TestTask to 1, start 2 TestTask and 1 OtherTask
+ * Expected: only the second TestTask is queued
+*/
+TEST(AdmissionTest, Type_Limit_Queues)
+{
+    Scheduler scheduler;
+    scheduler.setConcurrencyLimit<TestTask>(1);
+
+    TestTask& first = scheduler.addTask<TestTask>(10ns);
+    TestTask& second = scheduler.addTask<TestTask>(10ns);
+    OtherTask& other = scheduler.addTask<OtherTask>(10ns);
+
+    ASSERT_EQ(first.status(), Task::StateType::running);
+    ASSERT_EQ(second.status(), Task::StateType::queued);
+    ASSERT_EQ(other.status(), Task::StateType::running);
+
+    scheduler.setConcurrencyLimit<TestTask>(2);
+    ASSERT_EQ(second.status(), Task::StateType::running);
+}
+
+/**
+ * Test: queued task is stopped
+ * - Step 1: limit to 1 task, start 2 tasks
+ * - Step 2: stop the queued task
+ * Expected: task stops without running and leaves the queue
+*/
+TEST(AdmissionTest, Stop_if_Queued)
+{
+    Scheduler scheduler;
+    scheduler.setConcurrencyLimit(1);
+
+    scheduler.addTask<TestTask>(10ns);
+    TestTask& queued = scheduler.addTask<TestTask>(10ns);
+    ASSERT_EQ(queued.status(), Task::StateType::queued);
+
+    try {
+        queued.start();
+        FAIL() << "Expected std::runtime_error";
+    }
+    catch(const std::runtime_error& e) {
+        const std::string exp_e = "Cannot start task, '" + std::to_string(queued.id()) + "', it's queued";
+        ASSERT_EQ(std::string(e.what()), exp_e);
+    }
+
+    queued.stop();
+    ASSERT_EQ(queued.status(), Task::StateType::stopped);
+    ASSERT_EQ(scheduler.queuedCount(), 0u);
+}
+
+/**
+ * Test: full admission queue with reject policy
+ * - Step 1: limit to 1 task and 1 queued task
+ * - Step 2: start 3 tasks
+ * Expected: third task is rejected
+*/
+TEST(AdmissionTest, Reject_if_Full)
+{
+    Scheduler scheduler;
+    scheduler.setConcurrencyLimit(1);
+    scheduler.setAdmissionQueue(1, AdmissionPolicy::reject);
+
+    scheduler.addTask<TestTask>(10ns);
+    scheduler.addTask<TestTask>(10ns);
+
+    try {
+        scheduler.addTask<TestTask>(10ns);
+        FAIL() << "Expected std::runtime_error";
+    }
+    catch(const std::runtime_error& e) {
+        ASSERT_EQ(std::string(e.what()), "Cannot admit task, admission queue full (1 waiting)");
+    }
+    ASSERT_EQ(scheduler.getTaskIds().size(), 2u);
+}
+
+/**
+ * Test: full admission queue with caller-runs policy
+ * - Step 1: limit to 1 task and no queue
+ * - Step 2: start a task and a short counter
+ * Expected: counter completes on the caller's thread before addTask returns
+*/
+TEST(AdmissionTest, Caller_Runs_if_Full)
+{
+    Scheduler scheduler;
+    scheduler.setConcurrencyLimit(1);
+    scheduler.setAdmissionQueue(0, AdmissionPolicy::callerRuns);
+
+    scheduler.addTask<TestTask>(10ns);
+    Counter& counter = scheduler.addTask<Counter>(3);
+
+    ASSERT_EQ(counter.status(), Task::StateType::completed);
+    ASSERT_EQ(scheduler.runningCount(), 1u);
+}
+
+/**
+ * Test: full admission queue with block policy
+ * - Step 1: limit to 1 task and no queue
+ * - Step 2: start a task, start a second one from another thread
+ * - Step 3: stop the first task
+ * Expected: second addTask blocks until the first task is stopped
+*/
+TEST(AdmissionTest, Block_if_Full)
+{
+    Scheduler scheduler;
+    scheduler.setConcurrencyLimit(1);
+    scheduler.setAdmissionQueue(0, AdmissionPolicy::block);
+
+    TestTask& first = scheduler.addTask<TestTask>(10ns);
+
+    std::atomic<bool> admitted(false);
+    std::thread submitter([&]() {
+        scheduler.addTask<TestTask>(10ns);
+        admitted = true;
+    });
+
+    std::this_thread::sleep_for(20ms);
+    ASSERT_FALSE(admitted);
+
+    first.stop();
+    submitter.join();
+
+    ASSERT_TRUE(admitted);
+    ASSERT_EQ(scheduler.runningCount(), 1u);
+}
@@ -0,0 +1,134 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <experimental/memory_resource>
+#include <experimental/string>
+#include <experimental/vector>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "Arena.h"
+#include "Scheduler.h"
+#include "Status.h"
+#include "TestUtils.h"
+
+namespace pmr = std::experimental::pmr;
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Allocates a 1KiB buffer from its arena per step, keeping them all, for steps steps */
+class ScratchTask : public Task
+{
+public:
+    ScratchTask(const int id, int steps)
+    : Task(id), steps_(steps)
+    {}
+
+    double progress() override { return 0.0; }
+
+    std::atomic<int> done{0};
+
+private:
+    const int steps_;
+
+    void execute() override {
+        pmr::vector<pmr::string> buffers(&arena());
+        for (int i = 0; i < steps_; ++i) {
+            buffers.emplace_back(1024, 'x');
+            done = i + 1;
+            checkCommand();
+        }
+    }
+};
+}
+
+/**
+ * Test: arena used directly
+ * - Step 1: small, over-aligned and large allocations
+ * - Step 2: release, then allocate again from another arena
+ * Expected: aligned memory, used() counts every allocation, release keeps the peak and caches the
+ * blocks, which the next arena reuses
+*/
+TEST(ArenaTest, Allocate_And_Release)
+{
+    TaskArena arena;
+    pmr::vector<std::uint64_t> values(&arena);
+    for (std::uint64_t i = 0; i < 100000; ++i) {
+        values.push_back(i);
+    }
+    ASSERT_EQ(values[99999], 99999u);
+
+    void* aligned = arena.allocate(100, 256);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(aligned) % 256, 0u);
+    void* large = arena.allocate(1 << 20, 64);
+    ASSERT_EQ(reinterpret_cast<std::uintptr_t>(large) % 64, 0u);
+    static_cast<char*>(large)[(1 << 20) - 1] = 1;
+    ASSERT_GE(arena.used(), (1u << 20) + 100000 * sizeof(std::uint64_t));
+    ASSERT_EQ(arena.peak(), arena.used());
+
+    values = pmr::vector<std::uint64_t>(&arena);
+    const std::size_t peak = arena.peak();
+    const std::size_t cached = TaskArena::cachedBlocks();
+    arena.release();
+    ASSERT_EQ(arena.used(), 0u);
+    ASSERT_EQ(arena.peak(), peak);
+    ASSERT_GT(TaskArena::cachedBlocks(), cached);
+
+    TaskArena next;
+    const std::size_t before = TaskArena::cachedBlocks();
+    ASSERT_NE(next.allocate(1000, 8), nullptr);
+    ASSERT_EQ(TaskArena::cachedBlocks(), before - 1);
+}
+
+/**
+ * Test: task keeping 200 buffers of 1KiB from its arena
+ * - Step 1: pause it once it has them all but before it returns
+ * - Step 2: resume it to its end
+ * Expected: usage and peak reported in status while paused, nothing left used once completed, peak kept
+*/
+TEST(ArenaTest, Task_Scratch)
+{
+    Scheduler scheduler;
+    ScratchTask& task = scheduler.addTask<ScratchTask>(1000000);
+    ASSERT_TRUE(waitFor([&]() { return task.done >= 200; }, 2000ms));
+    task.pause();
+    ASSERT_GE(task.arena().used(), 200u * 1024);
+
+    StatusWriter writer(StatusFormat::ndjson);
+    writer.append(task);
+    const std::string expected = ",\"memory\":" + std::to_string(task.arena().used()) + ",\"memory_peak\":" + std::to_string(task.arena().peak());
+    ASSERT_NE(writer.data().find(expected), std::string::npos);
+
+    task.stop();
+    ASSERT_EQ(task.status(), Task::StateType::stopped);
+    ASSERT_EQ(task.arena().used(), 0u);
+    ASSERT_GE(task.arena().peak(), 200u * 1024);
+    ASSERT_FALSE(task.arena().limitExceeded());
+
+    ScratchTask& complete = scheduler.addTask<ScratchTask>(50);
+    complete.joinTask();
+    ASSERT_EQ(complete.status(), Task::StateType::completed);
+    ASSERT_EQ(complete.arena().used(), 0u);
+    ASSERT_GE(complete.arena().peak(), 50u * 1024);
+}
+
+/**
+ * Test: task over a memory limit of 256KiB
+ * Expected: stopped at the allocation crossing the limit, the limit flagged, its memory released
+*/
+TEST(ArenaTest, Memory_Limit)
+{
+    Scheduler scheduler;
+    ScratchTask& task = scheduler.prepareTask<ScratchTask>(1000);
+    task.arena().setLimit(256 << 10);
+    scheduler.restartTask(task);
+    task.joinTask();
+
+    ASSERT_EQ(task.status(), Task::StateType::stopped);
+    ASSERT_TRUE(task.arena().limitExceeded());
+    ASSERT_LT(task.done.load(), 256);
+    ASSERT_LE(task.arena().peak(), 256u << 10);
+    ASSERT_EQ(task.arena().used(), 0u);
+}
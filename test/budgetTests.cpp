@@ -0,0 +1,196 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <time.h>
+
+#include "gtest/gtest.h"
+
+#include "Budget.h"
+#include "Scheduler.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Cpu time of the calling thread */
+std::chrono::nanoseconds threadCpu() {
+    timespec time;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+/* Burns spin iterations of cpu between two polls till stopped, publishes its polls and cpu time */
+class SpinningTask : public Task
+{
+public:
+    SpinningTask(const int id, int spin)
+    : Task(id), spin_(spin)
+    {}
+
+    double progress() override { return 0.0; }
+
+    std::atomic<long long> polls{0};
+    std::atomic<long long> cpu{0};
+
+private:
+    const int spin_;
+    volatile unsigned sink_ = 0;
+
+    void execute() override {
+        while (true) {
+            for (int i = 0; i < spin_; ++i) {
+                sink_ = sink_ + static_cast<unsigned>(i);
+            }
+            cpu = threadCpu().count();
+            ++polls;
+            checkCommand();
+        }
+    }
+};
+
+double seconds(const long long ns) {
+    return static_cast<double>(ns) / 1e9;
+}
+
+}
+
+/**
+ * Test: token bucket of 10 tokens per second holding 5
+ * Expected: full at first, a debt of one token is paid in 100ms, refills up to its capacity only
+*/
+TEST(BudgetTest, Token_Bucket)
+{
+    const auto start = TokenBucket::Clock::now();
+    TokenBucket bucket;
+    bucket.configure(10.0, 5.0, start);
+
+    ASSERT_EQ(bucket.take(5.0, start), 0ns);
+    ASSERT_EQ(bucket.take(1.0, start), 100ms);
+    ASSERT_EQ(bucket.take(0.0, start + 1s), 0ns);
+    ASSERT_DOUBLE_EQ(bucket.tokens(), 5.0);
+    ASSERT_EQ(bucket.take(6.0, start + 1s), 100ms);
+
+    TokenBucket unlimited;
+    unlimited.configure(0.0, 0.0, start);
+    ASSERT_EQ(unlimited.take(1000.0, start), 0ns);
+}
+
+/**
+ * Test: busy task limited to 20% of a core
+ * - Step 1: let it spin for 1s
+ * - Step 2: remove the limit
+ * Expected: about 0.2s of cpu used, most of the second spent throttled, the task spins freely afterwards
+*/
+TEST(BudgetTest, Cpu_Share)
+{
+    Scheduler scheduler;
+    SpinningTask& task = scheduler.addTask<SpinningTask>(20000);
+    BudgetLimits limits;
+    limits.cpu = 0.2;
+    limits.burst = 50ms;
+    scheduler.setBudget(task, limits);
+
+    std::this_thread::sleep_for(50ms);
+    const long long from = task.cpu;
+    std::this_thread::sleep_for(1s);
+    const double used = seconds(task.cpu - from);
+    EXPECT_GT(used, 0.1);
+    EXPECT_LT(used, 0.35);
+    EXPECT_GT(task.throttledTime(), 500ms);
+    ASSERT_EQ(task.status(), Task::StateType::running);
+
+    scheduler.setBudget(task, BudgetLimits());
+    std::this_thread::sleep_for(300ms);
+    const long long polls = task.polls;
+    const auto throttled = task.throttledTime();
+    std::this_thread::sleep_for(200ms);
+    ASSERT_GT(task.polls, polls);
+    ASSERT_EQ(task.throttledTime(), throttled);
+    task.stop();
+}
+
+/**
+ * Test: task limited to 200 polls per second with a burst of 50ms
+ * Expected: about 100 polls in 500ms, plus the burst
+*/
+TEST(BudgetTest, Poll_Rate)
+{
+    Scheduler scheduler;
+    SpinningTask& task = scheduler.addTask<SpinningTask>(0);
+    BudgetLimits limits;
+    limits.rate = 200.0;
+    limits.burst = 50ms;
+    scheduler.setBudget(task, limits);
+
+    const long long from = task.polls;
+    std::this_thread::sleep_for(500ms);
+    const long long polls = task.polls - from;
+    task.stop();
+    EXPECT_GT(polls, 60);
+    EXPECT_LT(polls, 170);
+}
+
+/**
+ * Test: budget of 30% of a core shared by the tasks of a type
+ * - Step 1: one task started before the type budget is set, one after
+ * Expected: both tasks run, together they use about 0.3s of cpu per second
+*/
+TEST(BudgetTest, Type_Budget)
+{
+    Scheduler scheduler;
+    SpinningTask& before = scheduler.addTask<SpinningTask>(20000);
+    BudgetLimits limits;
+    limits.cpu = 0.3;
+    limits.burst = 50ms;
+    scheduler.setBudget<SpinningTask>(limits);
+    SpinningTask& after = scheduler.addTask<SpinningTask>(20000);
+
+    std::this_thread::sleep_for(50ms);
+    const long long from = before.cpu + after.cpu;
+    std::this_thread::sleep_for(1s);
+    const double used = seconds(before.cpu + after.cpu - from);
+    EXPECT_GT(used, 0.15);
+    EXPECT_LT(used, 0.5);
+    EXPECT_GT(before.throttledTime(), 0ns);
+    EXPECT_GT(after.throttledTime(), 0ns);
+    before.stop();
+    after.stop();
+}
+
+/**
+ * Test: commands sent to a throttled task
+ * - Step 1: task limited to 1 poll per second, watchdog flagging tasks 100ms away from their poll
+ * - Step 2: pause, resume then stop it while it waits for its budget
+ * Expected: every command is served within 200ms, the task is not flagged unresponsive
+*/
+TEST(BudgetTest, Commands_While_Throttled)
+{
+    Scheduler scheduler;
+    scheduler.enableWatchdog(100ms, 20ms);
+    SpinningTask& task = scheduler.addTask<SpinningTask>(0);
+    BudgetLimits limits;
+    limits.rate = 1.0;
+    limits.burst = 1ms;
+    scheduler.setBudget(task, limits);
+
+    std::this_thread::sleep_for(300ms);
+    ASSERT_FALSE(task.unresponsive());
+
+    auto start = std::chrono::steady_clock::now();
+    task.pause();
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 200ms);
+    ASSERT_EQ(task.status(), Task::StateType::paused);
+
+    task.resume();
+    std::this_thread::sleep_for(50ms);
+    start = std::chrono::steady_clock::now();
+    task.stop();
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 200ms);
+    ASSERT_EQ(task.status(), Task::StateType::stopped);
+
+    Scheduler other;
+    SpinningTask& foreign = other.addTask<SpinningTask>(0);
+    ASSERT_THROW(scheduler.setBudget(foreign, limits), std::runtime_error);
+    foreign.stop();
+}
@@ -0,0 +1,301 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "Channel.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Pushes 1..count into out, then closes it */
+class SourceTask : public Task
+{
+public:
+    struct Input {
+        SpscChannel<long>* out;
+        long count;
+    };
+
+    SourceTask(const int id, const Input& input)
+    : Task(id), input_(input), sent_(0)
+    {}
+
+    double progress() override { return static_cast<double>(sent_) / static_cast<double>(input_.count); }
+
+private:
+    const Input input_;
+    std::atomic<long> sent_;
+
+    void execute() override {
+        for (long value = 1; value <= input_.count; ++value) {
+            input_.out->push(*this, value);
+            sent_++;
+        }
+        input_.out->close();
+    }
+};
+
+/* Doubles every value from in into out */
+class DoubleTask : public Task
+{
+public:
+    struct Input {
+        SpscChannel<long>* in;
+        SpscChannel<long>* out;
+    };
+
+    DoubleTask(const int id, const Input& input)
+    : Task(id), input_(input)
+    {}
+
+    double progress() override { return 0.0; }
+
+private:
+    const Input input_;
+
+    void execute() override {
+        long values[16];
+        std::size_t n;
+        while ((n = input_.in->popBatch(*this, values, 16)) > 0) {
+            for (std::size_t i = 0; i < n; ++i) {
+                values[i] *= 2;
+            }
+            input_.out->pushBatch(*this, values, n);
+        }
+        input_.out->close();
+    }
+};
+
+/* Sums every value from in */
+class SinkTask : public Task
+{
+public:
+    SinkTask(const int id, SpscChannel<long>* in)
+    : Task(id), in_(in), sum_(0)
+    {}
+
+    double progress() override { return 0.0; }
+
+    long sum() const { return sum_; }
+
+private:
+    SpscChannel<long>* in_;
+    std::atomic<long> sum_;
+
+    void execute() override {
+        long value;
+        while (in_->pop(*this, value)) {
+            sum_ += value;
+        }
+    }
+};
+
+}
+
+/**
+ * Test: ring capacity and wrap around
+ * - Step 1: fill a ring of 4, pop 2, push 2 more
+ * Expected: pushes fail when full, values come out in order
+*/
+TEST(ChannelTest, Spsc_Ring_Wraps)
+{
+    SpscRing<int> ring(3);
+    ASSERT_EQ(ring.capacity(), 4u);
+
+    int values[] = {1, 2, 3, 4, 5};
+    ASSERT_EQ(ring.tryPushBatch(values, 5), 4u);
+    ASSERT_TRUE(ring.full());
+
+    int out[2];
+    ASSERT_EQ(ring.tryPopBatch(out, 2), 2u);
+    ASSERT_EQ(out[0], 1);
+    ASSERT_EQ(out[1], 2);
+
+    int more[] = {5, 6};
+    ASSERT_EQ(ring.tryPushBatch(more, 2), 2u);
+
+    int value;
+    for (int expected = 3; expected <= 6; ++expected) {
+        ASSERT_TRUE(ring.tryPop(value));
+        ASSERT_EQ(value, expected);
+    }
+    ASSERT_FALSE(ring.tryPop(value));
+    ASSERT_TRUE(ring.empty());
+}
+
+/**
+ * Test: multiple producers and consumers
+ * - Step 1: 4 threads push 1..N each into a small channel, 4 threads pop until closed
+ * Expected: every value is received exactly once
+*/
+TEST(ChannelTest, Mpmc_Threads)
+{
+    MpmcChannel<long> channel(8);
+    const long count = 20000;
+
+    std::atomic<long> sum(0);
+    std::atomic<long> received(0);
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 4; ++i) {
+        consumers.emplace_back([&]() {
+            long value;
+            while (channel.pop(value)) {
+                sum += value;
+                received++;
+            }
+        });
+    }
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; ++i) {
+        producers.emplace_back([&]() {
+            for (long value = 1; value <= count; ++value) {
+                channel.push(value);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    channel.close();
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+
+    ASSERT_EQ(received, 4 * count);
+    ASSERT_EQ(sum, 4 * count * (count + 1) / 2);
+    ASSERT_THROW(channel.push(1), std::runtime_error);
+}
+
+/**
+ * Test: multiple producers and consumers moving batches
+ * - Step 1: 4 threads push 1..N each in batches of 7 into a small channel, 4 threads pop batches of
+ *   up to 5 until closed
+ * Expected: every value is received exactly once
+*/
+TEST(ChannelTest, Mpmc_Batch_Threads)
+{
+    MpmcChannel<long> channel(16);
+    const long count = 20000;
+
+    std::atomic<long> sum(0);
+    std::atomic<long> received(0);
+    std::vector<std::thread> consumers;
+    for (int i = 0; i < 4; ++i) {
+        consumers.emplace_back([&]() {
+            long values[5];
+            std::size_t n;
+            while ((n = channel.popBatch(values, 5)) > 0) {
+                for (std::size_t j = 0; j < n; ++j) {
+                    sum += values[j];
+                }
+                received += static_cast<long>(n);
+            }
+        });
+    }
+
+    std::vector<std::thread> producers;
+    for (int i = 0; i < 4; ++i) {
+        producers.emplace_back([&]() {
+            long values[7];
+            long value = 1;
+            while (value <= count) {
+                std::size_t n = 0;
+                while (n < 7 && value <= count) {
+                    values[n++] = value++;
+                }
+                channel.pushBatch(values, n);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    channel.close();
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+
+    ASSERT_EQ(received, 4 * count);
+    ASSERT_EQ(sum, 4 * count * (count + 1) / 2);
+}
+
+/**
+ * Test: three stage pipeline of tasks
+ * - Step 1: source -> double -> sink over channels smaller than the stream
+ * Expected: sink receives every doubled value, every task completes
+*/
+TEST(ChannelTest, Task_Pipeline)
+{
+    Scheduler scheduler;
+    SpscChannel<long> first(4);
+    SpscChannel<long> second(4);
+    const long count = 10000;
+
+    SinkTask& sink = scheduler.addTask<SinkTask>(&second);
+    DoubleTask& transform = scheduler.addTask<DoubleTask>(DoubleTask::Input{&first, &second});
+    SourceTask& source = scheduler.addTask<SourceTask>(SourceTask::Input{&first, count});
+
+    sink.joinTask();
+    ASSERT_EQ(sink.sum(), count * (count + 1));
+    // The sink may finish before the other stages have set their final state
+    source.joinTask();
+    transform.joinTask();
+    ASSERT_EQ(source.status(), Task::StateType::completed);
+    ASSERT_EQ(transform.status(), Task::StateType::completed);
+
+    source.join();
+    transform.join();
+    sink.join();
+}
+
+/**
+ * Test: task blocked on an empty channel
+ * - Step 1: start a sink with nothing to read
+ * - Step 2: pause it, resume it, stop it
+ * Expected: blocked task acknowledges every command without receiving a value
+*/
+TEST(ChannelTest, Blocked_Task_Honours_Commands)
+{
+    Scheduler scheduler;
+    SpscChannel<long> channel(4);
+
+    SinkTask& sink = scheduler.addTask<SinkTask>(&channel);
+    std::this_thread::sleep_for(10ms);
+    ASSERT_EQ(sink.status(), Task::StateType::running);
+
+    sink.pause();
+    ASSERT_EQ(sink.status(), Task::StateType::paused);
+
+    sink.resume();
+    ASSERT_EQ(sink.status(), Task::StateType::running);
+
+    channel.push(5);
+    sink.stop();
+    ASSERT_EQ(sink.status(), Task::StateType::stopped);
+    sink.join();
+}
+
+/**
+ * Test: task blocked on a full channel
+ * - Step 1: start a source with a channel nobody reads
+ * - Step 2: stop it
+ * Expected: source fills the channel, then stops while blocked
+*/
+TEST(ChannelTest, Blocked_Producer_Stops)
+{
+    Scheduler scheduler;
+    SpscChannel<long> channel(4);
+
+    SourceTask& source = scheduler.addTask<SourceTask>(SourceTask::Input{&channel, 100});
+    std::this_thread::sleep_for(10ms);
+    ASSERT_EQ(source.progress(), 0.04);
+
+    source.stop();
+    ASSERT_EQ(source.status(), Task::StateType::stopped);
+    source.join();
+}
@@ -0,0 +1,161 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "Checkpoint.h"
+#include "Counter.h"
+#include "TestUtils.h"
+#include "TestTask.h"
+
+using namespace std::chrono_literals;
+
+/**
+ * Test: binary records
+ * Expected: values come back in order, reading past the end throws
+*/
+TEST(CheckpointTest, Record_Round_Trip)
+{
+    CheckpointWriter writer;
+    writer.put(42);
+    writer.putString("state");
+    writer.put(2.5);
+
+    CheckpointReader reader(writer.data());
+    ASSERT_EQ(reader.get<int>(), 42);
+    ASSERT_EQ(reader.getString(), "state");
+    ASSERT_EQ(reader.get<double>(), 2.5);
+    ASSERT_THROW(reader.get<int>(), std::runtime_error);
+}
+
+/**
+ * Test: journal reopened after records, removals and a torn write
+ * - Step 1: write records of 3 tasks, forget one of them
+ * - Step 2: corrupt the bytes after the last record
+ * Expected: last record of each live task is recovered
+*/
+TEST(CheckpointTest, Journal_Recovery)
+{
+    const std::string path = journalPath();
+    {
+        CheckpointJournal journal(path);
+        journal.append(1, "counter", "a");
+        journal.append(2, "counter", "b");
+        journal.append(1, "counter", "c");
+        journal.append(3, "counter", "d");
+        journal.forget(2);
+        journal.flush();
+        ASSERT_EQ(journal.records().size(), 2u);
+    }
+    {
+        // Half-written header after the last record
+        const int fd = open(path.c_str(), O_RDWR);
+        const std::uint32_t magic = 0x54434b50;
+        off_t end = 0;
+        {
+            CheckpointJournal journal(path);
+            end = static_cast<off_t>(journal.size());
+        }
+        ASSERT_EQ(pwrite(fd, &magic, sizeof(magic), end), static_cast<ssize_t>(sizeof(magic)));
+        close(fd);
+    }
+
+    CheckpointJournal journal(path);
+    auto records = journal.records();
+    ASSERT_EQ(records.size(), 2u);
+    ASSERT_EQ(records[1].data, "c");
+    ASSERT_EQ(records[3].data, "d");
+    ASSERT_EQ(records.count(2), 0u);
+    unlink(path.c_str());
+}
+
+/**
+ * Test: journal compaction
+ * - Step 1: write many records of 2 tasks into a small journal
+ * Expected: journal is rewritten with the last record of each task and stays small
+*/
+TEST(CheckpointTest, Journal_Compaction)
+{
+    const std::string path = journalPath();
+    {
+        CheckpointJournal journal(path, 4096);
+        for (int i = 0; i < 1000; ++i) {
+            journal.append(1 + i % 2, "counter", std::to_string(i));
+        }
+        journal.flush();
+        ASSERT_GT(journal.compactions(), 0u);
+        ASSERT_LT(journal.size(), 4096u);
+    }
+
+    CheckpointJournal journal(path);
+    auto records = journal.records();
+    ASSERT_EQ(records.size(), 2u);
+    ASSERT_EQ(records[1].data, "998");
+    ASSERT_EQ(records[2].data, "999");
+    unlink(path.c_str());
+}
+
+/**
+ * Test: restart with a counter in progress
+ * - Step 1: run a long counter with checkpoints, destroy the scheduler
+ * - Step 2: restore counters in a new scheduler
+ * Expected: the counter resumes from its last checkpoint instead of starting over
+*/
+TEST(CheckpointTest, Restore_After_Restart)
+{
+    const std::string path = journalPath();
+    double progress_before = 0.0;
+    {
+        Scheduler scheduler;
+        scheduler.enableCheckpoints(path, 5ms);
+        LongCounter& counter = scheduler.addTask<LongCounter>(1000);
+        std::this_thread::sleep_for(200ms);
+        progress_before = counter.progress();
+        scheduler.checkpointJournal()->flush();
+        ASSERT_GT(progress_before, 0.0);
+    }
+
+    Scheduler scheduler;
+    scheduler.enableCheckpoints(path, 5ms);
+    auto restored = scheduler.restoreCheckpoints<LongCounter>();
+    ASSERT_EQ(restored.size(), 1u);
+
+    LongCounter& counter = restored[0];
+    ASSERT_GT(counter.progress(), 0.0);
+    ASSERT_GE(counter.progress() + 1.0, progress_before);
+
+    scheduler.checkpointJournal()->flush();
+    auto records = scheduler.checkpointJournal()->records();
+    ASSERT_EQ(records.size(), 1u);
+    ASSERT_EQ(records.begin()->first, counter.id());
+    unlink(path.c_str());
+}
+
+/**
+ * Test: finished and non checkpointable tasks
+ * - Step 1: run a short counter to completion and a TestTask with checkpoints
+ * Expected: nothing is left to restore
+*/
+TEST(CheckpointTest, Finished_Tasks_Not_Restored)
+{
+    const std::string path = journalPath();
+    {
+        Scheduler scheduler;
+        scheduler.enableCheckpoints(path, 1ms);
+        Counter& counter = scheduler.addTask<Counter>(10);
+        scheduler.addTask<TestTask>(1ms);
+        counter.joinTask();
+        counter.join();
+        scheduler.checkpointJournal()->flush();
+        ASSERT_TRUE(scheduler.checkpointJournal()->records().empty());
+    }
+
+    CheckpointJournal journal(path);
+    ASSERT_TRUE(journal.records().empty());
+    unlink(path.c_str());
+}
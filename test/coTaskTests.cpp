@@ -0,0 +1,232 @@
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Channel.h"
+#include "CoTask.h"
+#include "TestUtils.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Yields steps times, then sleeps for pause_time */
+CoTask stepper(std::atomic<int>& steps, const int count, const std::chrono::milliseconds pause_time) {
+    for (int i = 0; i < count; ++i) {
+        steps++;
+        co_await coYield();
+    }
+    co_await coSleep(pause_time);
+}
+
+/* Adds every value received to total */
+CoTask summer(MpmcChannel<long>& input, std::atomic<long>& total, std::atomic<int>& values) {
+    long value;
+    while (co_await coReceive(input, value)) {
+        total += value;
+        values++;
+    }
+}
+
+/* Yields forever, counting */
+CoTask spinner(std::atomic<long>& steps) {
+    while (true) {
+        steps++;
+        co_await coYield();
+    }
+}
+
+CoTask sleeper(const std::chrono::milliseconds time) {
+    co_await coSleep(time);
+}
+
+CoTask failing() {
+    co_await coYield();
+    throw std::logic_error("child failed");
+}
+
+/* Spawns children on its runtime, joins them */
+CoTask parent(std::atomic<int>& steps, std::vector<CoHandle>& children) {
+    CoRuntime& runtime = *CoRuntime::current();
+    for (int i = 0; i < 8; ++i) {
+        children.push_back(runtime.spawn(stepper, std::ref(steps), 10, 5ms));
+    }
+    children.push_back(runtime.spawn(failing));
+    for (const CoHandle& child : children) {
+        co_await child;
+    }
+    steps += 1000;
+}
+}
+
+/**
+ * Test: coroutine task yielding 100 times then sleeping 20ms, 50 of them on 2 threads
+ * Expected: every step done, each task sleeps at least 20ms, all completed and gone from the runtime
+*/
+TEST(CoTaskTest, Yield_And_Sleep)
+{
+    CoRuntime runtime(2);
+    ASSERT_EQ(runtime.threads(), 2u);
+    std::atomic<int> steps(0);
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<CoHandle> tasks;
+    for (int i = 0; i < 50; ++i) {
+        tasks.push_back(runtime.spawn(stepper, std::ref(steps), 100, 20ms));
+    }
+    for (const CoHandle& task : tasks) {
+        ASSERT_TRUE(task.joinUntil(std::chrono::steady_clock::now() + 2s));
+        ASSERT_EQ(task.status(), Task::StateType::completed);
+    }
+    ASSERT_GE(std::chrono::steady_clock::now() - start, 20ms);
+    ASSERT_EQ(steps.load(), 5000);
+    ASSERT_EQ(runtime.size(), 0u);
+}
+
+/**
+ * Test: commands on a task yielding forever and on a task sleeping an hour
+ * - Step 1: pause the yielding one, then resume it
+ * - Step 2: pause the sleeping one, then stop both
+ * Expected: no step while paused, commands applied at the suspension point, stop ends the sleep at
+ * once, commands on finished tasks refused
+*/
+TEST(CoTaskTest, Pause_Resume_Stop)
+{
+    CoRuntime runtime;
+    std::atomic<long> steps(0);
+    CoHandle spinning = runtime.spawn(spinner, std::ref(steps));
+    CoHandle sleeping = runtime.spawn(sleeper, 1h);
+    ASSERT_TRUE(waitFor([&]() { return steps > 100; }, 1000ms));
+
+    spinning.pause();
+    ASSERT_THROW(spinning.pause(), std::runtime_error);
+    ASSERT_TRUE(waitFor([&]() { return spinning.status() == Task::StateType::paused; }, 1000ms));
+    const long paused_at = steps;
+    std::this_thread::sleep_for(20ms);
+    ASSERT_EQ(steps.load(), paused_at);
+
+    spinning.resume();
+    ASSERT_THROW(spinning.resume(), std::runtime_error);
+    ASSERT_TRUE(waitFor([&]() { return steps > paused_at + 100; }, 1000ms));
+
+    sleeping.pause();
+    ASSERT_TRUE(waitFor([&]() { return sleeping.status() == Task::StateType::paused; }, 1000ms));
+    const auto start = std::chrono::steady_clock::now();
+    sleeping.stop();
+    spinning.stop();
+    ASSERT_TRUE(sleeping.joinUntil(std::chrono::steady_clock::now() + 1s));
+    ASSERT_TRUE(spinning.joinUntil(std::chrono::steady_clock::now() + 1s));
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 500ms);
+    ASSERT_EQ(sleeping.status(), Task::StateType::stopped);
+    ASSERT_EQ(spinning.status(), Task::StateType::stopped);
+    ASSERT_THROW(spinning.stop(), std::runtime_error);
+    ASSERT_THROW(spinning.pause(), std::runtime_error);
+}
+
+/**
+ * Test: 4 coroutine tasks receiving from a channel fed 1..10000 by a thread
+ * - Step 1: pause one of them while it waits for a value
+ * - Step 2: resume it, feed the channel, then close it
+ * Expected: a paused task takes nothing, every value received once, all completed
+*/
+TEST(CoTaskTest, Channel_Receive)
+{
+    CoRuntime runtime(2);
+    MpmcChannel<long> channel(64);
+    std::atomic<long> total(0);
+    std::atomic<int> values(0);
+    std::vector<CoHandle> receivers;
+    for (int i = 0; i < 4; ++i) {
+        receivers.push_back(runtime.spawn(summer, std::ref(channel), std::ref(total), std::ref(values)));
+    }
+    receivers[0].pause();
+    ASSERT_TRUE(waitFor([&]() { return receivers[0].status() == Task::StateType::paused; }, 1000ms));
+    for (CoHandle& receiver : receivers) {
+        if (receiver.status() != Task::StateType::paused) {
+            receiver.pause();
+        }
+    }
+    channel.push(1);
+    std::this_thread::sleep_for(20ms);
+    ASSERT_EQ(values.load(), 0);
+
+    for (CoHandle& receiver : receivers) {
+        receiver.resume();
+    }
+    std::thread producer([&]() {
+        for (long value = 2; value <= 10000; ++value) {
+            channel.push(value);
+        }
+        channel.close();
+    });
+    producer.join();
+    for (const CoHandle& receiver : receivers) {
+        ASSERT_TRUE(receiver.joinUntil(std::chrono::steady_clock::now() + 2s));
+        ASSERT_EQ(receiver.status(), Task::StateType::completed);
+    }
+    ASSERT_EQ(values.load(), 10000);
+    ASSERT_EQ(total.load(), 10000L * 10001 / 2);
+}
+
+/**
+ * Test: task spawning 8 children and a failing one, co_awaiting each
+ * Expected: the parent goes on once all finished; the failing child failed with its exception
+*/
+TEST(CoTaskTest, Join_Children)
+{
+    CoRuntime runtime(2);
+    std::atomic<int> steps(0);
+    std::vector<CoHandle> children;
+    CoHandle task = runtime.spawn(parent, std::ref(steps), std::ref(children));
+    ASSERT_TRUE(task.joinUntil(std::chrono::steady_clock::now() + 2s));
+    ASSERT_EQ(task.status(), Task::StateType::completed);
+    ASSERT_EQ(steps.load(), 8 * 10 + 1000);
+
+    ASSERT_EQ(children.size(), 9u);
+    ASSERT_EQ(children.back().status(), Task::StateType::failed);
+    ASSERT_THROW(std::rethrow_exception(children.back().exception()), std::logic_error);
+    ASSERT_EQ(children.front().status(), Task::StateType::completed);
+    ASSERT_EQ(children.front().exception(), nullptr);
+}
+
+/**
+ * Test: 100000 tasks waiting on one empty channel, then 100000 sleeping an hour
+ * - Step 1: close the channel
+ * - Step 2: destroy the runtime with the sleepers
+ * Expected: all suspended without a thread each, completed on close; the sleepers stopped promptly
+*/
+TEST(CoTaskTest, Many_Idle_Tasks)
+{
+    constexpr int count = 100000;
+    std::atomic<long> total(0);
+    std::atomic<int> values(0);
+    MpmcChannel<long> channel(16);
+    std::vector<CoHandle> sleepers;
+    const auto start = std::chrono::steady_clock::now();
+    {
+        CoRuntime runtime(2);
+        std::vector<CoHandle> receivers;
+        for (int i = 0; i < count; ++i) {
+            receivers.push_back(runtime.spawn(summer, std::ref(channel), std::ref(total), std::ref(values)));
+        }
+        ASSERT_EQ(runtime.size(), static_cast<std::size_t>(count));
+        channel.close();
+        for (const CoHandle& receiver : receivers) {
+            receiver.join();
+            ASSERT_EQ(receiver.status(), Task::StateType::completed);
+        }
+        ASSERT_EQ(runtime.size(), 0u);
+
+        for (int i = 0; i < count; ++i) {
+            sleepers.push_back(runtime.spawn(sleeper, 1h));
+        }
+        ASSERT_EQ(runtime.size(), static_cast<std::size_t>(count));
+    }
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 30s);
+    ASSERT_EQ(sleepers.front().status(), Task::StateType::stopped);
+    ASSERT_EQ(sleepers.back().status(), Task::StateType::stopped);
+    ASSERT_EQ(values.load(), 0);
+}
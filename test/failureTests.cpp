@@ -0,0 +1,220 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Log.h"
+#include "Scheduler.h"
+#include "TaskPool.h"
+
+using std::string;
+using std::vector;
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Throws input iterations in, a negative input throws an int */
+class ThrowingTask : public Task
+{
+public:
+    using ResultType = int;
+
+    ThrowingTask(const int id, const int iterations)
+    : Task(id), iterations_(iterations)
+    {}
+
+    static std::string memoKey(const int input) { return std::to_string(input); }
+
+    double progress() override { return 0.0; }
+
+    int result() const { return 0; }
+
+private:
+    const int iterations_;
+
+    void execute() override {
+        if (iterations_ < 0) {
+            throw 42;
+        }
+        for (int i = 0; i < iterations_; ++i) {
+            checkCommand();
+            std::this_thread::sleep_for(1ms);
+        }
+        throw std::invalid_argument("boom");
+    }
+};
+
+/* Reads what is left in a pipe after closing its write end */
+string drain(const int fds[2]) {
+    ::close(fds[1]);
+    string text;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = ::read(fds[0], buffer, sizeof(buffer))) > 0) {
+        text.append(buffer, static_cast<std::size_t>(n));
+    }
+    ::close(fds[0]);
+    return text;
+}
+
+}
+
+/**
+ * Test: task throwing from execute
+ * - Step 1: start a task throwing std::invalid_argument after a few polls
+ * - Step 2: join it
+ * Expected: status failed, not completed, exception() rethrows the original exception
+*/
+TEST(FailureTest, Exception_Captured)
+{
+    Scheduler scheduler;
+    Task& task = scheduler.addTask<ThrowingTask>(5);
+    task.joinTask();
+
+    ASSERT_EQ(task.status(), Task::StateType::failed);
+    ASSERT_TRUE(Task::finished(task.status()));
+    ASSERT_EQ(task.runs(), 1u);
+    ASSERT_TRUE(task.exception());
+    try {
+        std::rethrow_exception(task.exception());
+        FAIL();
+    } catch (const std::invalid_argument& e) {
+        ASSERT_EQ(string(e.what()), "boom");
+    }
+}
+
+/**
+ * Test: task throwing something else than an std::exception
+ * - Step 1: start a task throwing an int
+ * Expected: status failed, exception() rethrows the int
+*/
+TEST(FailureTest, Unknown_Exception_Captured)
+{
+    Scheduler scheduler;
+    Task& task = scheduler.addTask<ThrowingTask>(-1);
+    task.joinTask();
+
+    ASSERT_EQ(task.status(), Task::StateType::failed);
+    try {
+        std::rethrow_exception(task.exception());
+        FAIL();
+    } catch (const int value) {
+        ASSERT_EQ(value, 42);
+    }
+}
+
+/**
+ * Test: shared computation failing
+ * - Step 1: submit the same throwing computation twice
+ * Expected: both subscribers get the original exception from get(), nothing is cached
+*/
+TEST(FailureTest, Shared_Result_Rethrows)
+{
+    Scheduler scheduler;
+    auto first = scheduler.submitShared<ThrowingTask>(20);
+    auto second = scheduler.submitShared<ThrowingTask>(20);
+
+    ASSERT_THROW(first.get(), std::invalid_argument);
+    ASSERT_THROW(second.get(), std::invalid_argument);
+
+    auto third = scheduler.submitShared<ThrowingTask>(20);
+    ASSERT_FALSE(third.cached());
+    ASSERT_THROW(third.get(), std::invalid_argument);
+}
+
+/**
+ * Test: failed task run again
+ * - Step 1: pool of one throwing task, run it and wait for the failure
+ * - Step 2: run the pool again
+ * Expected: the failed task is ready, rearming clears its exception
+*/
+TEST(FailureTest, Failed_Task_Rearmed)
+{
+    Scheduler scheduler;
+    TaskPool<ThrowingTask> pool(scheduler, 1, 50);
+
+    ThrowingTask* task = pool.run();
+    ASSERT_NE(task, nullptr);
+    task->joinTask();
+    ASSERT_EQ(task->status(), Task::StateType::failed);
+    ASSERT_EQ(pool.available(), 1u);
+
+    ASSERT_EQ(pool.run(), task);
+    ASSERT_FALSE(task->exception());
+    task->joinTask();
+    ASSERT_EQ(task->status(), Task::StateType::failed);
+    ASSERT_TRUE(task->exception());
+    ASSERT_EQ(task->runs(), 2u);
+}
+
+/**
+ * Test: log written from many threads
+ * - Step 1: 4 threads write 500 numbered lines each to a log on a pipe
+ * - Step 2: flush and destroy the log
+ * Expected: every line is in the output once, whole, none dropped
+*/
+TEST(FailureTest, Log_Concurrent_Writes)
+{
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+
+    vector<std::thread> threads;
+    {
+        Log log(fds[1], 4096);
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&log, t]() {
+                char line[32];
+                for (int i = 0; i < 500; ++i) {
+                    const int size = std::snprintf(line, sizeof(line), "line %d %d", t, i);
+                    while (!log.write(line, static_cast<std::size_t>(size))) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        log.flush();
+        ASSERT_EQ(log.dropped(), 0u);
+    }
+
+    const string text = drain(fds);
+    ASSERT_EQ(std::count(text.begin(), text.end(), '\n'), 2000);
+    for (int t = 0; t < 4; ++t) {
+        ASSERT_NE(text.find("line " + std::to_string(t) + " 499\n"), string::npos);
+    }
+}
+
+/**
+ * Test: failure reported to the library log
+ * - Step 1: redirect the global log to a pipe, start a throwing task and join it
+ * Expected: the failure is logged with the task id and the exception message
+*/
+TEST(FailureTest, Failure_Logged)
+{
+    int fds[2];
+    ASSERT_EQ(::pipe(fds), 0);
+    Log::global().flush();
+    Log::global().setOutput(fds[1]);
+
+    int id;
+    {
+        Scheduler scheduler;
+        Task& task = scheduler.addTask<ThrowingTask>(1);
+        id = task.id();
+        task.joinTask();
+    }
+    Log::global().flush();
+    Log::global().setOutput(STDERR_FILENO);
+
+    const string text = drain(fds);
+    ASSERT_NE(text.find("Task id: '" + std::to_string(id) + "' failed: boom"), string::npos);
+}
@@ -0,0 +1,254 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "BigInt.h"
+#include "Fibonacci.h"
+#include "Scheduler.h"
+#include "ThreadPool.h"
+
+using std::string;
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Pseudo-random value of limbs 32-bit limbs, seeded */
+BigInt randomBigInt(const std::size_t limbs, std::uint64_t seed) {
+    BigInt value;
+    for (std::size_t i = 0; i < limbs; ++i) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        value <<= 32;
+        value += BigInt(seed >> 32);
+    }
+    return value;
+}
+
+/* 2^bits - 1 */
+BigInt ones(const std::size_t bits) {
+    BigInt value(1);
+    value <<= bits;
+    return value - BigInt(1);
+}
+
+}
+
+/**
+ * Test: BigInt arithmetic and conversions on small values
+ * Expected: sums carry across limbs, shifts drop low bits, subtraction below zero throws, decimal and binary
+ *           output are exact
+*/
+TEST(FibonacciTest, BigInt_Arithmetic)
+{
+    BigInt max(0xffffffffffffffffull);
+    BigInt sum = max + BigInt(1);
+    ASSERT_EQ(sum.bits(), 65u);
+    ASSERT_EQ(sum.toDecimal(), "18446744073709551616");
+    ASSERT_EQ(sum - BigInt(1), max);
+    BigInt shifted = sum;
+    ASSERT_EQ(shifted >>= 33, BigInt(1u << 31));
+    ASSERT_TRUE((shifted >>= 32).isZero());
+    ASSERT_TRUE(max < sum);
+
+    ASSERT_THROW(max - sum, std::invalid_argument);
+    BigInt left(5);
+    ASSERT_THROW(left -= BigInt(6), std::invalid_argument);
+    ASSERT_EQ(left, BigInt(5));
+
+    ASSERT_EQ((max * max).toDecimal(), "340282366920938463426481119284349108225");
+    ASSERT_EQ(BigInt().toDecimal(), "0");
+    ASSERT_EQ(BigInt(1000000000).toDecimal(), "1000000000");
+    ASSERT_EQ(BigInt().toBinary(), string(1, '\0'));
+    ASSERT_EQ(BigInt(0x1234).toBinary(), string("\x12\x34"));
+    ASSERT_EQ(sum.toBinary(), string("\x01\0\0\0\0\0\0\0\0", 9));
+}
+
+/**
+ * Test: decimal conversion of values split by the divide and conquer
+ * - Step 1: 10^k and 10^k - 1 for k around the powers the conversion splits by
+ * - Step 2: random value against its two parts around 10^20736 converted apart
+ * Expected: exact digits, no leading zeros
+*/
+TEST(FibonacciTest, Decimal_Large)
+{
+    BigInt power(1);
+    for (std::size_t k = 1; k <= 9 * 512 + 1; ++k) {
+        power = power * BigInt(10);
+        if (k % 576 > 2 && k % 576 < 574) {
+            continue;
+        }
+        ASSERT_EQ(power.toDecimal(), "1" + string(k, '0'));
+        ASSERT_EQ((power - BigInt(1)).toDecimal(), string(k, '9'));
+    }
+
+    BigInt shift(1);
+    for (int i = 0; i < 2304; ++i) {
+        shift = shift * BigInt(1000000000);
+    }
+    const BigInt high = randomBigInt(4000, 6);
+    const BigInt low = randomBigInt(2000, 7);
+    const string low_digits = low.toDecimal();
+    ASSERT_NE(low_digits[0], '0');
+    ASSERT_EQ((high * shift + low).toDecimal(), high.toDecimal() + string(9 * 2304 - low_digits.size(), '0') + low_digits);
+}
+
+/**
+ * Test: Karatsuba products against known results
+ * - Step 1: (2^k - 1)^2 for a size well above the Karatsuba threshold
+ * - Step 2: distributivity over random operands of very different sizes
+ * Expected: exact results in both cases
+*/
+TEST(FibonacciTest, Multiply_Large)
+{
+    const std::size_t bits = 200000;
+    BigInt expected(1);
+    expected <<= 2 * bits;
+    BigInt middle(1);
+    middle <<= bits + 1;
+    expected -= middle;
+    expected += BigInt(1);
+    ASSERT_EQ(ones(bits) * ones(bits), expected);
+
+    BigInt a = randomBigInt(6000, 1);
+    BigInt b = randomBigInt(5000, 2);
+    BigInt c = randomBigInt(300, 3);
+    ASSERT_EQ(a * (b + c), a * b + a * c);
+    ASSERT_EQ(c * (a + b), b * c + c * a);
+}
+
+/**
+ * Test: product split across threads
+ * - Step 1: multiply operands large enough to be split with 1 then 4 threads
+ * - Step 2: multiply again with a poll throwing on its first call
+ * Expected: same result both ways, the poll runs on the calling thread and its exception stops the product
+*/
+TEST(FibonacciTest, Parallel_Multiply)
+{
+    BigInt a = randomBigInt(20000, 4);
+    BigInt b = randomBigInt(18000, 5);
+
+    const std::thread::id caller = std::this_thread::get_id();
+    std::atomic<int> polls(0);
+    MultiplyOptions options;
+    options.threads = 4;
+    options.poll = [&]() {
+        ASSERT_EQ(std::this_thread::get_id(), caller);
+        ++polls;
+    };
+    ASSERT_EQ(BigInt::multiply(a, b, options), a * b);
+    ASSERT_GT(polls.load(), 0);
+
+    options.poll = []() { throw std::runtime_error("stop"); };
+    ASSERT_THROW(BigInt::multiply(a, b, options), std::runtime_error);
+}
+
+/**
+ * Test: product split across the jobs of a thread pool
+ * - Step 1: multiply operands large enough to be split with 4 threads on a pool of parallelism 1
+ * - Step 2: multiply again with a hold throwing on its first call
+ * Expected: same result as unsplit, the helpers run on the pool and hold there, its exception stops the product
+*/
+TEST(FibonacciTest, Pool_Multiply)
+{
+    BigInt a = randomBigInt(20000, 6);
+    BigInt b = randomBigInt(18000, 7);
+
+    ThreadPoolOptions pool_options;
+    pool_options.parallelism = 1;
+    ThreadPool pool(pool_options);
+    std::atomic<int> holds(0);
+    std::atomic<int> outside(0);
+    MultiplyOptions options;
+    options.threads = 4;
+    options.pool = &pool;
+    options.hold = [&]() {
+        ++holds;
+        if (ThreadPool::current() != &pool) {
+            ++outside;
+        }
+    };
+    ASSERT_EQ(BigInt::multiply(a, b, options), a * b);
+    ASSERT_GT(holds.load(), 0);
+    ASSERT_EQ(outside.load(), 0);
+
+    options.hold = []() { throw std::runtime_error("stop"); };
+    ASSERT_THROW(BigInt::multiply(a, b, options), std::runtime_error);
+}
+
+/**
+ * Test: fibonacci tasks on known values
+ * Expected: F(0), F(1), F(100), F(1000) exact, F(100000) has the expected digits at both ends
+*/
+TEST(FibonacciTest, Known_Values)
+{
+    Scheduler scheduler;
+    Fibonacci& zero = scheduler.addTask<Fibonacci>(0);
+    Fibonacci& one = scheduler.addTask<Fibonacci>(1);
+    Fibonacci& hundred = scheduler.addTask<Fibonacci>(100);
+    Fibonacci& thousand = scheduler.addTask<Fibonacci>(1000);
+    Fibonacci& large = scheduler.addTask<Fibonacci>(100000);
+    for (Fibonacci* task : {&zero, &one, &hundred, &thousand, &large}) {
+        task->joinTask();
+        ASSERT_EQ(task->status(), Task::StateType::completed);
+        ASSERT_EQ(task->progress(), 100.0);
+    }
+
+    ASSERT_EQ(zero.getResult(), 0);
+    ASSERT_EQ(one.getResult(), 1);
+    ASSERT_EQ(hundred.getResult().toDecimal(), "354224848179261915075");
+    ASSERT_EQ(hundred.getResult().toBinary(), string("\x13\x33\xdb\x76\xa7\xc5\x94\xbf\xc3"));
+    ASSERT_EQ(thousand.getResult().toDecimal(),
+              "4346655768693745643568852767504062580256466051737178040248172908953655541794905189040387984007925516929592"
+              "2593080322634775209689623239873322471161642996440906533187938298969649928516003704476137795166849228875");
+
+    const string digits = large.getResult().toDecimal();
+    ASSERT_EQ(digits.size(), 20899u);
+    ASSERT_EQ(digits.substr(0, 20), "25974069347221724166");
+    ASSERT_EQ(digits.substr(digits.size() - 20), "49895374653428746875");
+}
+
+/**
+ * Test: long fibonacci watched then stopped
+ * - Step 1: start fibonacci of 10^8, read its progress a few times
+ * - Step 2: stop it
+ * Expected: progress strictly between 0 and 100 and never decreasing, the stop is served within a second
+*/
+TEST(FibonacciTest, Progress_And_Stop)
+{
+    Scheduler scheduler;
+    Fibonacci& task = scheduler.addTask<Fibonacci>(100000000);
+
+    double last = 0.0;
+    for (int i = 0; i < 20; ++i) {
+        std::this_thread::sleep_for(20ms);
+        const double progress = task.progress();
+        ASSERT_GE(progress, last);
+        ASSERT_LT(progress, 100.0);
+        last = progress;
+    }
+    ASSERT_GT(last, 0.0);
+
+    const auto start = std::chrono::steady_clock::now();
+    task.stop();
+    task.joinTask();
+    ASSERT_LT(std::chrono::steady_clock::now() - start, 1s);
+    ASSERT_EQ(task.status(), Task::StateType::stopped);
+}
+
+/**
+ * Test: fibonacci of a negative number
+ * Expected: task fails with std::invalid_argument
+*/
+TEST(FibonacciTest, Negative_Fails)
+{
+    Scheduler scheduler;
+    Fibonacci& task = scheduler.addTask<Fibonacci>(-1);
+    task.joinTask();
+    ASSERT_EQ(task.status(), Task::StateType::failed);
+    ASSERT_THROW(task.getResult(), std::invalid_argument);
+}
@@ -0,0 +1,182 @@
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "TestTask.h"
+
+using std::vector;
+using namespace std::chrono_literals;
+
+/**
+ * Test: group-wide commands
+ * - Step 1: start 50 tasks in a group
+ * - Step 2: pause, resume and stop the group
+ * Expected: every member follows each group command
+*/
+TEST(GroupTest, Pause_Resume_Stop)
+{
+    Scheduler scheduler;
+    TaskGroup& group = scheduler.createGroup();
+
+    vector<TestTask*> tasks;
+    for (int i = 0; i < 50; ++i) {
+        tasks.push_back(&scheduler.addTask<TestTask>(group, 10ns));
+    }
+    ASSERT_EQ(group.size(), 50u);
+
+    group.pause();
+    ASSERT_EQ(group.status().paused, 50u);
+
+    group.resume();
+    ASSERT_EQ(group.status().running, 50u);
+
+    group.stop();
+    ASSERT_EQ(group.status().stopped, 50u);
+    for (auto task : tasks) {
+        ASSERT_EQ(task->status(), Task::StateType::stopped);
+    }
+}
+
+/**
+ * Test: nested groups
+ * - Step 1: start a task in an outer group and one in an inner group
+ * - Step 2: pause the inner group, then stop the outer group
+ * Expected: pause only reaches the inner group, stop reaches both
+*/
+TEST(GroupTest, Nested_Groups)
+{
+    Scheduler scheduler;
+    TaskGroup& outer = scheduler.createGroup();
+    TaskGroup& inner = scheduler.createGroup(&outer);
+
+    TestTask& outer_task = scheduler.addTask<TestTask>(outer, 10ns);
+    TestTask& inner_task = scheduler.addTask<TestTask>(inner, 10ns);
+    ASSERT_EQ(outer.size(), 2u);
+
+    inner.pause();
+    ASSERT_EQ(inner_task.status(), Task::StateType::paused);
+    ASSERT_EQ(outer_task.status(), Task::StateType::running);
+
+    outer.stop();
+    ASSERT_EQ(inner_task.status(), Task::StateType::stopped);
+    ASSERT_EQ(outer_task.status(), Task::StateType::stopped);
+}
+
+/**
+ * Test: member paused on its own
+ * - Step 1: pause a member task, then pause and resume the group
+ * Expected: the member stays paused, the others run again
+*/
+TEST(GroupTest, Resume_Keeps_Task_Pause)
+{
+    Scheduler scheduler;
+    TaskGroup& group = scheduler.createGroup();
+
+    TestTask& paused = scheduler.addTask<TestTask>(group, 10ns);
+    TestTask& running = scheduler.addTask<TestTask>(group, 10ns);
+
+    paused.pause();
+    group.pause();
+    group.resume();
+
+    ASSERT_EQ(paused.status(), Task::StateType::paused);
+    ASSERT_EQ(running.status(), Task::StateType::running);
+
+    try {
+        group.resume();
+        FAIL() << "Expected std::runtime_error";
+    }
+    catch(const std::runtime_error& e) {
+        const std::string exp_e = "Cannot resume group, '" + std::to_string(group.id()) + "', not paused";
+        ASSERT_EQ(std::string(e.what()), exp_e);
+    }
+
+    paused.resume();
+    ASSERT_EQ(group.status().running, 2u);
+}
+
+/**
+ * Test: member resumed while its group is paused
+ * - Step 1: pause a member task, then pause the group and resume the member
+ * - Step 2: resume the group
+ * Expected: resuming the member returns while the group holds it, it runs again with the group
+*/
+TEST(GroupTest, Resume_Task_In_Paused_Group)
+{
+    Scheduler scheduler;
+    TaskGroup& group = scheduler.createGroup();
+
+    TestTask& task = scheduler.addTask<TestTask>(group, 10ns);
+
+    task.pause();
+    group.pause();
+    task.resume();
+    ASSERT_EQ(task.status(), Task::StateType::paused);
+
+    group.resume();
+    ASSERT_EQ(task.status(), Task::StateType::running);
+    ASSERT_EQ(group.status().running, 1u);
+}
+
+/**
+ * Test: group aggregation and queued members
+ * - Step 1: limit concurrency to 2, start 3 tasks in a group, complete one
+ * - Step 2: stop the group
+ * Expected: status counts follow members, the queued member is stopped without running
+*/
+TEST(GroupTest, Status_And_Queued_Members)
+{
+    Scheduler scheduler;
+    scheduler.setConcurrencyLimit(2);
+    TaskGroup& group = scheduler.createGroup();
+
+    TestTask& first = scheduler.addTask<TestTask>(group, 10ns);
+    scheduler.addTask<TestTask>(group, 10ns);
+    TestTask& third = scheduler.addTask<TestTask>(group, 10ns);
+
+    GroupStatus status = group.status();
+    ASSERT_EQ(status.running, 2u);
+    ASSERT_EQ(status.queued, 1u);
+    ASSERT_EQ(status.total(), 3u);
+
+    first.run_ = false;
+    first.joinTask();
+    ASSERT_EQ(third.status(), Task::StateType::running);
+    ASSERT_NEAR(group.progress(), 100.0 / 3, 1e-9);
+
+    group.stop();
+    status = group.status();
+    ASSERT_EQ(status.completed, 1u);
+    ASSERT_EQ(status.stopped, 2u);
+}
+
+/**
+ * Test: commands on an outer group of 4 inner groups of 25 tasks each
+ * - Step 1: pause, resume, then stop the outer group
+ * Expected: every member of every inner group follows, the inner groups count their own members
+*/
+TEST(GroupTest, Nested_Group_Commands)
+{
+    Scheduler scheduler;
+    TaskGroup& outer = scheduler.createGroup();
+    vector<TaskGroup*> inners;
+    for (int i = 0; i < 4; ++i) {
+        inners.push_back(&scheduler.createGroup(&outer));
+        for (int j = 0; j < 25; ++j) {
+            scheduler.addTask<TestTask>(*inners.back(), 10ns);
+        }
+    }
+    ASSERT_EQ(outer.size(), 100u);
+
+    outer.pause();
+    ASSERT_EQ(outer.status().paused, 100u);
+    ASSERT_EQ(inners.back()->status().paused, 25u);
+
+    outer.resume();
+    ASSERT_EQ(outer.status().running, 100u);
+
+    outer.stop();
+    ASSERT_EQ(outer.status().stopped, 100u);
+    inners.front()->joinGroup();
+}
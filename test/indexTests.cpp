@@ -0,0 +1,139 @@
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "Status.h"
+#include "Fibonacci.h"
+#include "TestTask.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr unsigned bit(const Task::StateType state) { return StatusFilter::bit(state); }
+
+}
+
+/**
+ * Test: counts by state and type
+ * - Step 1: run a fibonacci to its end, start 3 test tasks, pause one and stop another
+ * Expected: counts by state, by type and by both match the tasks
+*/
+TEST(IndexTest, Counts_Follow_Transitions)
+{
+    Scheduler scheduler;
+    scheduler.addTask<Fibonacci>(10).joinTask();
+    TestTask& first = scheduler.addTask<TestTask>(1ms);
+    TestTask& second = scheduler.addTask<TestTask>(1ms);
+    scheduler.addTask<TestTask>(1ms);
+
+    ASSERT_EQ(scheduler.countTasks(TaskIndex::all_states), 4u);
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::running)), 3u);
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::completed), "fibonacci"), 1u);
+
+    first.pause();
+    second.stop();
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::running)), 1u);
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::paused), "test"), 1u);
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::stopped) | bit(Task::StateType::completed)), 2u);
+    ASSERT_EQ(scheduler.countTasks(TaskIndex::all_states, "test"), 3u);
+    ASSERT_EQ(scheduler.countTasks(TaskIndex::all_states, "counter"), 0u);
+
+    first.resume();
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::running)), 2u);
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::paused)), 0u);
+}
+
+/**
+ * Test: filtered iteration
+ * - Step 1: start 100 test tasks and pause them, start 3 more
+ * Expected: the running filter visits exactly the 3 running tasks, the type filter only fibonacci tasks
+*/
+TEST(IndexTest, Filtered_Iteration)
+{
+    Scheduler scheduler;
+    for (int i = 0; i < 100; ++i) {
+        scheduler.addTask<TestTask>(1ms).pause();
+    }
+    std::set<int> running;
+    for (int i = 0; i < 3; ++i) {
+        running.insert(scheduler.addTask<TestTask>(1ms).id());
+    }
+    Fibonacci& fibonacci = scheduler.addTask<Fibonacci>(5);
+    fibonacci.joinTask();
+
+    std::set<int> visited;
+    scheduler.forEachTask(bit(Task::StateType::running), nullptr, [&](Task& task) {
+        visited.insert(task.id());
+    });
+    ASSERT_EQ(visited, running);
+
+    visited.clear();
+    scheduler.forEachTask(TaskIndex::all_states, "fibonacci", [&](Task& task) {
+        visited.insert(task.id());
+    });
+    ASSERT_EQ(visited, std::set<int>{fibonacci.id()});
+}
+
+/**
+ * Test: states set by the scheduler
+ * - Step 1: limit to 1 task, start 2 test tasks, prepare a fibonacci
+ * - Step 2: stop the running task, then the other one, and run the fibonacci
+ * Expected: queued and idle tasks are counted, and counted again as they run
+*/
+TEST(IndexTest, Queued_And_Idle)
+{
+    Scheduler scheduler;
+    scheduler.setConcurrencyLimit(1);
+    TestTask& first = scheduler.addTask<TestTask>(1ms);
+    TestTask& second = scheduler.addTask<TestTask>(1ms);
+    Fibonacci& fibonacci = scheduler.prepareTask<Fibonacci>(10);
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::queued)), 1u);
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::idle), "fibonacci"), 1u);
+
+    first.stop();
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::queued)), 0u);
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::running)), 1u);
+
+    second.stop();
+    scheduler.restartTask(fibonacci);
+    fibonacci.joinTask();
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::idle)), 0u);
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::completed)), 1u);
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::stopped)), 2u);
+}
+
+/**
+ * Test: concurrent transitions
+ * - Step 1: start 40 test tasks, 4 threads pause, resume and stop 10 of them each
+ * Expected: every task counted once, as stopped
+*/
+TEST(IndexTest, Concurrent_Transitions)
+{
+    Scheduler scheduler;
+    std::vector<std::reference_wrapper<TestTask>> tasks;
+    for (int i = 0; i < 40; ++i) {
+        tasks.push_back(scheduler.addTask<TestTask>(100us));
+    }
+
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            for (std::size_t i = t * 10; i < (t + 1) * 10; ++i) {
+                TestTask& task = tasks[i];
+                task.pause();
+                task.resume();
+                task.stop();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(scheduler.countTasks(TaskIndex::all_states), 40u);
+    ASSERT_EQ(scheduler.countTasks(bit(Task::StateType::stopped)), 40u);
+}
@@ -0,0 +1,193 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "Journal.h"
+#include "Counter.h"
+#include "TestUtils.h"
+
+using namespace std::chrono_literals;
+
+/**
+ * Test: log reopened after a torn write
+ * - Step 1: append 3 records, then a half-written header after them
+ * Expected: the 3 records are replayed in order, appends continue after them
+*/
+TEST(JournalTest, Log_Torn_Tail)
+{
+    const std::string path = journalPath();
+    std::size_t end = 0;
+    {
+        MappedLog log(path, 4096);
+        log.replay([](const MappedLog::Record&) {});
+        log.append(1, 1, "a", "x");
+        log.append(1, 2, "b", "y");
+        log.append(2, 1, "", "z");
+        log.sync(true);
+        end = log.size();
+    }
+    {
+        const int fd = open(path.c_str(), O_RDWR);
+        const std::uint32_t magic = 0x474f4c4d;
+        ASSERT_EQ(pwrite(fd, &magic, sizeof(magic), static_cast<off_t>(end)), static_cast<ssize_t>(sizeof(magic)));
+        close(fd);
+    }
+
+    MappedLog log(path, 4096);
+    std::vector<MappedLog::Record> records;
+    log.replay([&](const MappedLog::Record& record) {
+        records.push_back(record);
+    });
+    ASSERT_EQ(records.size(), 3u);
+    ASSERT_EQ(records[1].key, 2);
+    ASSERT_EQ(records[1].label, "b");
+    ASSERT_EQ(records[2].data, "z");
+    ASSERT_EQ(log.size(), end);
+    unlink(path.c_str());
+}
+
+/**
+ * Test: rewrite that cannot replace the log
+ * - Step 1: append 2 records, put a non-empty directory in place of the log file
+ * - Step 2: rewrite the log with a single record
+ * Expected: rewrite throws and removes its temporary file, the log keeps its records and takes appends
+*/
+TEST(JournalTest, Log_Rewrite_Failure)
+{
+    const std::string path = journalPath();
+    MappedLog log(path, 4096);
+    log.replay([](const MappedLog::Record&) {});
+    log.append(1, 1, "a", "x");
+    log.append(1, 2, "b", "y");
+    const std::size_t end = log.size();
+
+    unlink(path.c_str());
+    ASSERT_EQ(mkdir(path.c_str(), 0700), 0);
+    close(open((path + "/file").c_str(), O_CREAT | O_WRONLY, 0600));
+
+    ASSERT_THROW(log.rewrite({MappedLog::Record{1, 2, "b", "y"}}, 0), std::runtime_error);
+    ASSERT_EQ(access((path + ".compact").c_str(), F_OK), -1);
+    ASSERT_EQ(log.size(), end);
+    ASSERT_EQ(log.rewrites(), 0u);
+
+    log.append(2, 1, "", "z");
+    log.sync(true);
+    ASSERT_GT(log.size(), end);
+
+    unlink((path + "/file").c_str());
+    rmdir(path.c_str());
+}
+
+/**
+ * Test: restart with tasks in progress
+ * - Step 1: run two long counters with the journal enabled, pause one, destroy the scheduler
+ * - Step 2: recover counters in a new scheduler
+ * Expected: both come back with their ids, the paused one paused, new ids continue after them
+*/
+TEST(JournalTest, Recover_After_Restart)
+{
+    const std::string path = journalPath();
+    int running_id = 0;
+    int paused_id = 0;
+    {
+        Scheduler scheduler;
+        scheduler.enableJournal(path);
+        running_id = scheduler.addTask<LongCounter>(1000).id();
+        LongCounter& paused = scheduler.addTask<LongCounter>(1000);
+        paused_id = paused.id();
+        paused.pause();
+        scheduler.schedulerJournal()->commit();
+    }
+
+    Scheduler scheduler;
+    scheduler.enableJournal(path);
+    auto recovered = scheduler.recoverTasks<LongCounter>();
+    ASSERT_EQ(recovered.size(), 2u);
+
+    LongCounter& running = recovered[0];
+    LongCounter& paused = recovered[1];
+    ASSERT_EQ(running.id(), running_id);
+    ASSERT_EQ(paused.id(), paused_id);
+    ASSERT_EQ(running.status(), Task::StateType::running);
+    ASSERT_EQ(paused.status(), Task::StateType::paused);
+
+    Counter& fresh = scheduler.addTask<Counter>(2);
+    ASSERT_GT(fresh.id(), paused_id);
+    fresh.joinTask();
+    fresh.join();
+    unlink(path.c_str());
+}
+
+/**
+ * Test: finished tasks
+ * - Step 1: run a short counter to completion, stop a long one
+ * Expected: nothing is left to recover
+*/
+TEST(JournalTest, Finished_Tasks_Not_Recovered)
+{
+    const std::string path = journalPath();
+    {
+        Scheduler scheduler;
+        scheduler.enableJournal(path);
+        Counter& counter = scheduler.addTask<Counter>(10);
+        LongCounter& stopped = scheduler.addTask<LongCounter>(1000);
+        counter.joinTask();
+        counter.join();
+        stopped.stop();
+        scheduler.schedulerJournal()->commit();
+        ASSERT_TRUE(scheduler.schedulerJournal()->live().empty());
+    }
+
+    Scheduler scheduler;
+    scheduler.enableJournal(path);
+    ASSERT_TRUE(scheduler.recoverTasks<LongCounter>().empty());
+    unlink(path.c_str());
+}
+
+/**
+ * Test: many short tasks journaled into a small log
+ * Expected: finished tasks are compacted away, the log stays small
+*/
+TEST(JournalTest, Compaction)
+{
+    const std::string path = journalPath();
+    {
+        SchedulerJournal journal(path, 1ms, 4096);
+        const std::string input(sizeof(int), '\0');
+        for (int id = 1; id <= 2000; ++id) {
+            journal.submitted(id, "counter", input);
+            journal.transition(id, Task::StateType::running);
+            if (id != 7) {
+                journal.transition(id, Task::StateType::completed);
+            }
+        }
+        journal.commit();
+        ASSERT_GT(journal.compactions(), 0u);
+        ASSERT_LT(journal.size(), 4096u);
+        ASSERT_EQ(journal.live().size(), 1u);
+    }
+
+    SchedulerJournal journal(path);
+    ASSERT_EQ(journal.live().size(), 1u);
+    ASSERT_EQ(journal.live().count(7), 1u);
+    ASSERT_EQ(journal.lastId(), 2000);
+    unlink(path.c_str());
+}
+
+/**
+ * Test: recovery without a journal
+ * Expected: recoverTasks throws
+*/
+TEST(JournalTest, Not_Enabled)
+{
+    Scheduler scheduler;
+    ASSERT_EQ(scheduler.schedulerJournal(), nullptr);
+    ASSERT_THROW(scheduler.recoverTasks<Counter>(), std::runtime_error);
+}
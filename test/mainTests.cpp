@@ -486,6 +486,32 @@ TEST(AsyncTaskLibTest, Pause_if_Paused)
     }
 }
 
+/* --- REQUESTS WITHOUT WAITING --- */
+
+/**
+ * Test: pause and stop requested without waiting
+ * - Step 1: request pause, wait till acknowledged
+ * - Step 2: request stop, wait till acknowledged
+ * Expected: task.status() == paused, then stopped
+*/
+TEST(AsyncTaskLibTest, Request_Pause_Stop)
+{
+    Scheduler scheduler;
+    TestTask& task = scheduler.addTask<TestTask>(1ms);
+
+    task.requestPause();
+    while (task.status() == Task::StateType::running) {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_EQ(task.status(), Task::StateType::paused);
+    ASSERT_THROW(task.requestPause(), std::runtime_error);
+
+    task.requestStop();
+    task.joinTask();
+    ASSERT_EQ(task.status(), Task::StateType::stopped);
+    ASSERT_THROW(task.requestStop(), std::runtime_error);
+}
+
 int main(int ac, char* av[])
 {
         testing::InitGoogleTest(&ac, av);
@@ -0,0 +1,146 @@
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "Fibonacci.h"
+
+using std::vector;
+using namespace std::chrono_literals;
+
+/**
+ * Test: identical submissions share one computation
+ * - Step 1: submit fibonacci of 30 three times
+ * Expected: a single task computes the result for every subscriber
+*/
+TEST(MemoTest, Single_Flight)
+{
+    Scheduler scheduler;
+
+    vector<SharedResult<BigInt>> results;
+    for (int i = 0; i < 3; ++i) {
+        results.push_back(scheduler.submitShared<Fibonacci>(30));
+    }
+
+    for (auto& result : results) {
+        ASSERT_FALSE(result.cached());
+        ASSERT_EQ(result.taskId(), results.front().taskId());
+        ASSERT_EQ(result.get(), 832040);
+    }
+    ASSERT_EQ(scheduler.getTaskIds().size(), 1u);
+
+    scheduler.getTask(results.front().taskId()).join();
+}
+
+/**
+ * Test: completed results are served from the cache
+ * - Step 1: submit fibonacci of 20 and wait for it
+ * - Step 2: submit it again
+ * Expected: second submission is a cache hit without a new task
+*/
+TEST(MemoTest, Result_Cache)
+{
+    Scheduler scheduler;
+
+    auto first = scheduler.submitShared<Fibonacci>(20);
+    ASSERT_EQ(first.get(), 6765);
+    scheduler.getTask(first.taskId()).join();
+
+    auto second = scheduler.submitShared<Fibonacci>(20);
+    ASSERT_TRUE(second.cached());
+    ASSERT_TRUE(second.ready());
+    ASSERT_EQ(second.get(), 6765);
+    ASSERT_EQ(scheduler.getTaskIds().size(), 1u);
+}
+
+/**
+ * Test: cache evicts least recently used results
+ * - Step 1: cache of 2 results, compute 3 different values, 10 used again before 12
+ * Expected: 11 is evicted, 10 and 12 stay cached
+*/
+TEST(MemoTest, Result_Cache_Eviction)
+{
+    Scheduler scheduler;
+    scheduler.setResultCacheCapacity(2);
+
+    for (int n : {10, 11}) {
+        auto result = scheduler.submitShared<Fibonacci>(n);
+        result.get();
+        scheduler.getTask(result.taskId()).join();
+    }
+    ASSERT_TRUE(scheduler.submitShared<Fibonacci>(10).cached());
+
+    auto result = scheduler.submitShared<Fibonacci>(12);
+    result.get();
+    scheduler.getTask(result.taskId()).join();
+
+    ASSERT_TRUE(scheduler.submitShared<Fibonacci>(10).cached());
+    ASSERT_TRUE(scheduler.submitShared<Fibonacci>(12).cached());
+    auto evicted = scheduler.submitShared<Fibonacci>(11);
+    ASSERT_FALSE(evicted.cached());
+    evicted.get();
+    scheduler.getTask(evicted.taskId()).join();
+}
+
+/**
+ * Test: stopping a subscriber
+ * - Step 1: submit a long fibonacci twice
+ * - Step 2: stop first subscription
+ * - Step 3: stop second subscription
+ * Expected: computation keeps running after step 2, it is stopped after step 3
+*/
+TEST(MemoTest, Stop_Last_Subscriber)
+{
+    Scheduler scheduler;
+
+    auto first = scheduler.submitShared<Fibonacci>(100000000);
+    auto second = scheduler.submitShared<Fibonacci>(100000000);
+    Task& task = scheduler.getTask(first.taskId());
+
+    first.stop();
+    std::this_thread::sleep_for(10ms);
+    ASSERT_EQ(task.status(), Task::StateType::running);
+
+    second.stop();
+    ASSERT_EQ(task.status(), Task::StateType::stopped);
+    ASSERT_THROW(second.get(), std::runtime_error);
+    task.join();
+
+    // A stopped computation is not cached
+    auto third = scheduler.submitShared<Fibonacci>(100000000);
+    ASSERT_FALSE(third.cached());
+    ASSERT_NE(third.taskId(), task.id());
+    third.stop();
+    scheduler.getTask(third.taskId()).join();
+}
+
+/**
+ * Test: every subscription dropped while the computation runs
+ * - Step 1: submit a long fibonacci, drop the result
+ * - Step 2: submit it again, twice
+ * Expected: both attach to the first computation, still running for the cache
+*/
+TEST(MemoTest, Resubmit_After_Drop)
+{
+    Scheduler scheduler;
+
+    int id;
+    {
+        auto dropped = scheduler.submitShared<Fibonacci>(100000000);
+        id = dropped.taskId();
+    }
+    Task& task = scheduler.getTask(id);
+    ASSERT_EQ(task.status(), Task::StateType::running);
+
+    auto again = scheduler.submitShared<Fibonacci>(100000000);
+    auto other = scheduler.submitShared<Fibonacci>(100000000);
+    ASSERT_EQ(again.taskId(), id);
+    ASSERT_EQ(other.taskId(), id);
+    ASSERT_EQ(scheduler.getTaskIds().size(), 1u);
+
+    again.stop();
+    other.stop();
+    ASSERT_EQ(task.status(), Task::StateType::stopped);
+    task.join();
+}
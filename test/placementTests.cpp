@@ -0,0 +1,215 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "Executor.h"
+#include "Topology.h"
+
+using std::vector;
+
+namespace {
+
+/* Builds a fake sysfs node directory: one entry per node with its cpulist */
+std::string fakeNodeDir(const vector<std::string>& cpulists) {
+    char dir_template[] = "/tmp/tasklib_nodesXXXXXX";
+    std::string dir = mkdtemp(dir_template);
+    for (std::size_t node = 0; node < cpulists.size(); ++node) {
+        const std::string node_dir = dir + "/node" + std::to_string(node);
+        mkdir(node_dir.c_str(), 0700);
+        std::ofstream(node_dir + "/cpulist") << cpulists[node] << "\n";
+    }
+    return dir;
+}
+
+/* Records where it ran, optionally spawns a child from its own thread */
+class ProbeTask : public Task
+{
+public:
+    struct Input {
+        Scheduler* scheduler;
+        bool spawn_child;
+    };
+
+    ProbeTask(const int id, const Input& input)
+    : Task(id), input_(input), cpu_(-1), child_(nullptr)
+    {}
+
+    double progress() override { return 0.0; }
+
+    int cpu() const { return cpu_; }
+    Placement seen() const { return seen_; }
+    ProbeTask* child() const { return child_; }
+
+private:
+    const Input input_;
+    int cpu_;
+    Placement seen_;
+    ProbeTask* child_;
+
+    void execute() override {
+        cpu_ = sched_getcpu();
+        seen_ = Placement::current();
+        if (input_.spawn_child) {
+            child_ = &input_.scheduler->addTask<ProbeTask>(Input{input_.scheduler, false});
+            child_->joinTask();
+        }
+    }
+};
+
+}
+
+/**
+ * Test: cpu lists in sysfs format are expanded
+ * Expected: ranges and single cpus are listed in order
+*/
+TEST(PlacementTest, Parse_Cpu_List)
+{
+    ASSERT_EQ(Topology::parseCpuList("0-3,8,10-11\n"), (vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    ASSERT_TRUE(Topology::parseCpuList("").empty());
+}
+
+/**
+ * Test: topology of a two-node machine
+ * - Step 1: read a fake sysfs node directory with two nodes
+ * Expected: cpus are grouped per node, cpus outside the allowed set are dropped
+*/
+TEST(PlacementTest, Topology_Two_Nodes)
+{
+    Topology topology(fakeNodeDir({"0-3", "4-7"}), {0, 1, 2, 3, 4, 5, 6});
+
+    ASSERT_EQ(topology.nodeCount(), 2u);
+    ASSERT_EQ(topology.cpus(0), (vector<int>{0, 1, 2, 3}));
+    ASSERT_EQ(topology.cpus(1), (vector<int>{4, 5, 6}));
+    ASSERT_EQ(topology.nodeOf(5), 1);
+    ASSERT_TRUE(topology.cpus(2).empty());
+}
+
+/**
+ * Test: machine without NUMA information
+ * Expected: a single node with every allowed cpu
+*/
+TEST(PlacementTest, Topology_Without_Nodes)
+{
+    Topology topology("/nonexistent", {0, 1});
+
+    ASSERT_EQ(topology.nodeCount(), 1u);
+    ASSERT_EQ(topology.cpus(0), (vector<int>{0, 1}));
+}
+
+/**
+ * Test: placement policies on a two-node machine
+ * Expected: node policy spreads tasks across nodes, core policy also assigns cpus within the node,
+ *           explicit nodes are honoured and unknown nodes fall back to an existing one
+*/
+TEST(PlacementTest, Executor_Policies)
+{
+    Topology topology(fakeNodeDir({"0-1", "2-3"}), {0, 1, 2, 3});
+
+    Executor floating(topology, AffinityPolicy::none);
+    ASSERT_EQ(floating.place(Placement()).node, -1);
+    ASSERT_EQ(floating.place(Placement(1)).node, 1);
+    ASSERT_EQ(floating.place(Placement(1)).cpu, -1);
+
+    Executor per_node(topology, AffinityPolicy::node);
+    ASSERT_EQ(per_node.place(Placement()).node, 0);
+    ASSERT_EQ(per_node.place(Placement()).node, 1);
+    ASSERT_EQ(per_node.place(Placement()).node, 0);
+    ASSERT_EQ(per_node.place(Placement(5)).node, 1);
+
+    Executor per_core(topology, AffinityPolicy::core);
+    ASSERT_EQ(per_core.place(Placement(1)).cpu, 2);
+    ASSERT_EQ(per_core.place(Placement(1)).cpu, 3);
+    ASSERT_EQ(per_core.place(Placement(1)).cpu, 2);
+
+    Placement pinned = per_core.place(Placement(-1, 3));
+    ASSERT_EQ(pinned.node, 1);
+    ASSERT_EQ(pinned.cpu, 3);
+    ASSERT_THROW(per_core.place(Placement(-1, 9)), std::invalid_argument);
+}
+
+/**
+ * Test: placement on a topology other than the system one
+ * - Step 1: place on node 1 of a fake topology whose node 1 holds only the current cpu
+ * - Step 2: bind a fresh thread to that placement
+ * Expected: the thread is pinned to the cpus of node 1 in the executor's topology
+*/
+TEST(PlacementTest, Bind_Uses_Executor_Topology)
+{
+    const int current_cpu = sched_getcpu();
+    Topology topology(fakeNodeDir({"", std::to_string(current_cpu)}), {current_cpu});
+    Executor executor(topology, AffinityPolicy::node);
+
+    const Placement placement = executor.place(Placement(1));
+    ASSERT_EQ(placement.node, 1);
+    ASSERT_EQ(placement.topology, &topology);
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    std::thread([&] {
+        Executor::bind(placement);
+        pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+    }).join();
+
+    ASSERT_EQ(CPU_COUNT(&set), 1);
+    ASSERT_TRUE(CPU_ISSET(current_cpu, &set));
+}
+
+/**
+ * Test: task pinned to a core
+ * - Step 1: start a task with core policy on the current machine
+ * Expected: the task runs on the cpu chosen by the executor
+*/
+TEST(PlacementTest, Task_Pinned_To_Core)
+{
+    Scheduler scheduler(AffinityPolicy::core);
+    ProbeTask& task = scheduler.addTask<ProbeTask>(ProbeTask::Input{&scheduler, false});
+    task.joinTask();
+    task.join();
+
+    ASSERT_GE(task.placement().cpu, 0);
+    ASSERT_EQ(task.cpu(), task.placement().cpu);
+    ASSERT_EQ(task.seen().cpu, task.placement().cpu);
+}
+
+/**
+ * Test: children stay on the node of their parent
+ * - Step 1: start a task on node 0 that spawns a child
+ * Expected: child placement inherits node 0
+*/
+TEST(PlacementTest, Child_Inherits_Node)
+{
+    Scheduler scheduler;
+    ProbeTask& task = scheduler.addTask<ProbeTask>(ProbeTask::Input{&scheduler, true}, Placement(0));
+    task.joinTask();
+    task.join();
+
+    ASSERT_EQ(task.seen().node, 0);
+    ASSERT_NE(task.child(), nullptr);
+    ASSERT_EQ(task.child()->placement().node, 0);
+    task.child()->join();
+}
+
+/**
+ * Test: node-local memory
+ * Expected: memory is 64-byte aligned and usable with or without libnuma
+*/
+TEST(PlacementTest, Node_Memory)
+{
+    for (int node : {-1, 0}) {
+        void* ptr = NodeMemory::allocate(1000, node);
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(ptr) % 64, 0u);
+        std::fill(static_cast<char*>(ptr), static_cast<char*>(ptr) + 1000, 1);
+        NodeMemory::release(ptr);
+    }
+}
@@ -0,0 +1,157 @@
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "TaskPool.h"
+#include "Counter.h"
+#include "Fibonacci.h"
+#include "TestTask.h"
+
+using namespace std::chrono_literals;
+
+/**
+ * Test: restart a completed task
+ * - Step 1: run fibonacci of 15 to its end
+ * - Step 2: restart it and wait for it again
+ * Expected: same object and id, same result, two runs, no new task in the scheduler
+*/
+TEST(PoolTest, Restart_In_Place)
+{
+    Scheduler scheduler;
+    Fibonacci& fibonacci = scheduler.addTask<Fibonacci>(15);
+    fibonacci.joinTask();
+    ASSERT_EQ(fibonacci.getResult(), 610);
+    ASSERT_EQ(fibonacci.runs(), 1u);
+
+    scheduler.restartTask(fibonacci);
+    fibonacci.joinTask();
+
+    ASSERT_EQ(&scheduler.getTask(fibonacci.id()), &fibonacci);
+    ASSERT_EQ(fibonacci.getResult(), 610);
+    ASSERT_EQ(fibonacci.runs(), 2u);
+    ASSERT_EQ(scheduler.getTaskIds().size(), 1u);
+}
+
+/**
+ * Test: restart a task still running
+ * Expected: restart and rearm refused, the task keeps running
+*/
+TEST(PoolTest, Restart_Not_Finished)
+{
+    Scheduler scheduler;
+    TestTask& task = scheduler.addTask<TestTask>(1ms);
+
+    try {
+        scheduler.restartTask(task);
+        FAIL() << "Expected std::runtime_error";
+    }
+    catch(const std::runtime_error& e) {
+        ASSERT_EQ(std::string(e.what()), "Cannot restart task, '" + std::to_string(task.id()) + "', not finished");
+    }
+    ASSERT_THROW(task.rearm(), std::runtime_error);
+    ASSERT_EQ(task.status(), Task::StateType::running);
+    task.stop();
+}
+
+/**
+ * Test: restart a stopped counter
+ * - Step 1: let a counter make progress and stop it
+ * - Step 2: restart it
+ * Expected: progress starts over, the task runs again and can be stopped again
+*/
+TEST(PoolTest, Restart_Stopped_Resets_Progress)
+{
+    Scheduler scheduler;
+    Counter& counter = scheduler.addTask<Counter>(1000);
+    while (counter.progress() < 1.0) {
+        std::this_thread::sleep_for(5ms);
+    }
+    counter.stop();
+
+    scheduler.restartTask(counter);
+    ASSERT_LT(counter.progress(), 1.0);
+    ASSERT_EQ(counter.status(), Task::StateType::running);
+
+    counter.stop();
+    ASSERT_EQ(counter.status(), Task::StateType::stopped);
+    ASSERT_EQ(counter.runs(), 2u);
+}
+
+/**
+ * Test: restarted task under a concurrency limit
+ * - Step 1: limit to 1 task, run a fibonacci to its end, start a test task
+ * - Step 2: restart the fibonacci, stop the test task
+ * Expected: the fibonacci waits queued, then completes
+*/
+TEST(PoolTest, Restart_Admission)
+{
+    Scheduler scheduler;
+    scheduler.setConcurrencyLimit(1);
+    Fibonacci& fibonacci = scheduler.addTask<Fibonacci>(10);
+    fibonacci.joinTask();
+    TestTask& blocker = scheduler.addTask<TestTask>(1ms);
+
+    scheduler.restartTask(fibonacci);
+    ASSERT_EQ(fibonacci.status(), Task::StateType::queued);
+
+    blocker.stop();
+    fibonacci.joinTask();
+    ASSERT_EQ(fibonacci.status(), Task::StateType::completed);
+    ASSERT_EQ(fibonacci.getResult(), 55);
+}
+
+/**
+ * Test: recurring job on a pool
+ * - Step 1: create a pool of 2 fibonacci tasks
+ * - Step 2: run 10 jobs on it, one after the other
+ * Expected: tasks created idle, the 10 runs share the 2 tasks and their ids
+*/
+TEST(PoolTest, Pool_Reuses_Tasks)
+{
+    Scheduler scheduler;
+    TaskPool<Fibonacci> pool(scheduler, 2, 15);
+    ASSERT_EQ(pool.available(), 2u);
+    for (Fibonacci& task : pool.tasks()) {
+        ASSERT_EQ(task.status(), Task::StateType::idle);
+    }
+
+    for (int i = 0; i < 10; ++i) {
+        Fibonacci* task = pool.run();
+        ASSERT_NE(task, nullptr);
+        task->joinTask();
+        ASSERT_EQ(task->getResult(), 610);
+    }
+
+    ASSERT_EQ(scheduler.getTaskIds().size(), 2u);
+    unsigned runs = 0;
+    for (Fibonacci& task : pool.tasks()) {
+        runs += task.runs();
+    }
+    ASSERT_EQ(runs, 10u);
+}
+
+/**
+ * Test: pool with every task busy
+ * - Step 1: pool of 2 test tasks, run one
+ * - Step 2: run a second one, then a third
+ * Expected: nullptr once both are running, a stopped task is run again, tasks never run do not delay destruction
+*/
+TEST(PoolTest, Pool_Exhausted)
+{
+    Scheduler scheduler;
+    TaskPool<TestTask> pool(scheduler, 2, 1ms);
+    TaskPool<Counter> unused(scheduler, 1, 10);
+
+    TestTask* first = pool.run();
+    TestTask* second = pool.run();
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    ASSERT_NE(first, second);
+    ASSERT_EQ(pool.run(), nullptr);
+
+    first->stop();
+    ASSERT_EQ(pool.run(), first);
+    ASSERT_EQ(first->status(), Task::StateType::running);
+    second->stop();
+}
@@ -0,0 +1,225 @@
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "Reactor.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Reads fd through the reactor until size bytes or end of file */
+class ReadTask : public Task
+{
+public:
+    struct Input {
+        Reactor* reactor;
+        int fd;
+        std::size_t size;
+    };
+
+    ReadTask(const int id, const Input& input)
+    : Task(id), input_(input)
+    {}
+
+    double progress() override { return 0.0; }
+
+    const std::string& data() const { return data_; }
+
+private:
+    const Input input_;
+    std::string data_;
+
+    void execute() override {
+        char buffer[256];
+        while (data_.size() < input_.size) {
+            const std::size_t n = input_.reactor->read(*this, input_.fd, buffer, sizeof(buffer));
+            if (n == 0) {
+                break;
+            }
+            data_.append(buffer, n);
+        }
+    }
+};
+
+/* Writes input data through the reactor */
+class WriteTask : public Task
+{
+public:
+    struct Input {
+        Reactor* reactor;
+        int fd;
+        std::string data;
+    };
+
+    WriteTask(const int id, const Input& input)
+    : Task(id), input_(input)
+    {}
+
+    double progress() override { return 0.0; }
+
+private:
+    const Input input_;
+
+    void execute() override {
+        input_.reactor->write(*this, input_.fd, input_.data.data(), input_.data.size());
+    }
+};
+
+/* Reactors for every backend available on this machine */
+std::vector<ReactorBackend> backends() {
+    std::vector<ReactorBackend> available{ReactorBackend::epoll};
+    if (Reactor(ReactorBackend::ioUring).backend() == ReactorBackend::ioUring) {
+        available.push_back(ReactorBackend::ioUring);
+    }
+    return available;
+}
+
+struct Pipe {
+    int fds[2];
+
+    Pipe() { EXPECT_EQ(pipe(fds), 0); }
+    ~Pipe() { close(fds[0]); close(fds[1]); }
+
+    int in() const { return fds[0]; }
+    int out() const { return fds[1]; }
+};
+
+}
+
+/**
+ * Test: task reads from an empty pipe
+ * - Step 1: start a reader, write to the pipe after a while
+ * Expected: reader waits without data, then completes with what was written
+*/
+TEST(ReactorTest, Pipe_Read)
+{
+    for (ReactorBackend backend : backends()) {
+        Scheduler scheduler;
+        Reactor reactor(backend);
+        Pipe pipe;
+
+        ReadTask& reader = scheduler.addTask<ReadTask>(ReadTask::Input{&reactor, pipe.in(), 5});
+        std::this_thread::sleep_for(10ms);
+        ASSERT_EQ(reader.status(), Task::StateType::running);
+        ASSERT_EQ(reactor.pending(), 1u);
+
+        ASSERT_EQ(write(pipe.out(), "hello", 5), 5);
+        reader.joinTask();
+        ASSERT_EQ(reader.status(), Task::StateType::completed);
+        ASSERT_EQ(reader.data(), "hello");
+        ASSERT_EQ(reactor.pending(), 0u);
+        reader.join();
+    }
+}
+
+/**
+ * Test: tasks on both ends of a socketpair
+ * - Step 1: start a reader on one end, then a writer on the other end with more than a socket buffer
+ * Expected: reader receives every byte
+*/
+TEST(ReactorTest, Socketpair_Stream)
+{
+    for (ReactorBackend backend : backends()) {
+        Scheduler scheduler;
+        Reactor reactor(backend);
+        int fds[2];
+        ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+
+        const std::string data(1 << 20, 'x');
+        ReadTask& reader = scheduler.addTask<ReadTask>(ReadTask::Input{&reactor, fds[0], data.size()});
+        WriteTask& writer = scheduler.addTask<WriteTask>(WriteTask::Input{&reactor, fds[1], data});
+
+        reader.joinTask();
+        writer.joinTask();
+        ASSERT_EQ(writer.status(), Task::StateType::completed);
+        ASSERT_EQ(reader.data().size(), data.size());
+        ASSERT_EQ(reader.data(), data);
+
+        reader.join();
+        writer.join();
+        close(fds[0]);
+        close(fds[1]);
+    }
+}
+
+/**
+ * Test: task reads a local file
+ * Expected: file content up to end of file
+*/
+TEST(ReactorTest, File_Read)
+{
+    char path[] = "/tmp/tasklib_reactorXXXXXX";
+    const int file = mkstemp(path);
+    const std::string content(1000, 'f');
+    ASSERT_EQ(write(file, content.data(), content.size()), static_cast<ssize_t>(content.size()));
+    close(file);
+
+    for (ReactorBackend backend : backends()) {
+        Scheduler scheduler;
+        Reactor reactor(backend);
+        const int fd = open(path, O_RDONLY);
+
+        ReadTask& reader = scheduler.addTask<ReadTask>(ReadTask::Input{&reactor, fd, 4096});
+        reader.joinTask();
+        ASSERT_EQ(reader.data(), content);
+        reader.join();
+        close(fd);
+    }
+    unlink(path);
+}
+
+/**
+ * Test: task waiting on a descriptor
+ * - Step 1: start a reader on an empty pipe
+ * - Step 2: pause it, resume it, stop it
+ * Expected: every command is acknowledged while waiting, the operation is cancelled on stop
+*/
+TEST(ReactorTest, Wait_Honours_Commands)
+{
+    for (ReactorBackend backend : backends()) {
+        Scheduler scheduler;
+        Reactor reactor(backend);
+        Pipe pipe;
+
+        ReadTask& reader = scheduler.addTask<ReadTask>(ReadTask::Input{&reactor, pipe.in(), 5});
+        std::this_thread::sleep_for(10ms);
+
+        reader.pause();
+        ASSERT_EQ(reader.status(), Task::StateType::paused);
+        reader.resume();
+        ASSERT_EQ(reader.status(), Task::StateType::running);
+
+        reader.stop();
+        ASSERT_EQ(reader.status(), Task::StateType::stopped);
+        ASSERT_EQ(reactor.pending(), 0u);
+        reader.join();
+    }
+}
+
+/**
+ * Test: reactor shared through the scheduler
+ * Expected: the same reactor is returned on every call
+*/
+TEST(ReactorTest, Scheduler_Reactor)
+{
+    Scheduler scheduler;
+    Reactor& reactor = scheduler.reactor();
+    ASSERT_EQ(&scheduler.reactor(), &reactor);
+
+    Pipe pipe;
+    ASSERT_EQ(write(pipe.out(), "x", 1), 1);
+    ReadTask& reader = scheduler.addTask<ReadTask>(ReadTask::Input{&reactor, pipe.in(), 1});
+    reader.joinTask();
+    ASSERT_EQ(reader.data(), "x");
+    reader.join();
+}
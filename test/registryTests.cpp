@@ -0,0 +1,90 @@
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "Registry.h"
+#include "Counter.h"
+#include "Fibonacci.h"
+#include "TestTask.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+using Tasks = TaskRegistry<TestTask, Counter, Fibonacci>;
+
+// Built at compile time
+static_assert(Tasks::size() == 3, "three registered types");
+static_assert(Tasks::indexOf<Fibonacci>() == 2, "types are indexed in order");
+static_assert(Tasks::find("counter") == &Tasks::at(1), "lookup by name");
+static_assert(Tasks::find("unknown") == nullptr, "unknown name");
+static_assert(Tasks::at(2).argument.max == 100000000, "argument schema");
+
+}
+
+/**
+ * Test: task started by name with an argument
+ * - Step 1: start fibonacci 25 through the registry
+ * Expected: task computes fibonacci of 25 and records its type
+*/
+TEST(RegistryTest, Create_By_Name)
+{
+    Scheduler scheduler;
+    Task& task = Tasks::create(scheduler, "fibonacci", "25");
+    task.joinTask();
+    task.join();
+
+    Fibonacci* fibonacci = dynamic_cast<Fibonacci*>(&task);
+    ASSERT_NE(fibonacci, nullptr);
+    ASSERT_EQ(fibonacci->getResult(), 75025);
+    ASSERT_STREQ(task.type(), "fibonacci");
+}
+
+/**
+ * Test: task started by numeric id without argument
+ * Expected: type at that index with its default argument
+*/
+TEST(RegistryTest, Create_By_Id_With_Default)
+{
+    Scheduler scheduler;
+    Task& task = Tasks::create(scheduler, "2");
+    task.joinTask();
+    task.join();
+    ASSERT_EQ(dynamic_cast<Fibonacci&>(task).getResult(), 6765);
+    ASSERT_STREQ(task.type(), "fibonacci");
+
+    Task& test = Tasks::create(scheduler, "test", "1");
+    ASSERT_STREQ(test.type(), "test");
+    test.stop();
+}
+
+/**
+ * Test: invalid starts
+ * Expected: unknown types, ids out of range, non numeric and out of bounds arguments throw, nothing is started
+*/
+TEST(RegistryTest, Invalid_Arguments)
+{
+    Scheduler scheduler;
+    ASSERT_THROW(Tasks::create(scheduler, "unknown"), std::runtime_error);
+    ASSERT_THROW(Tasks::create(scheduler, "3"), std::runtime_error);
+    ASSERT_THROW(Tasks::create(scheduler, "fibonacci", "35x"), std::runtime_error);
+    ASSERT_THROW(Tasks::create(scheduler, "fibonacci", "100000001"), std::runtime_error);
+    ASSERT_THROW(Tasks::create(scheduler, "counter", "0"), std::runtime_error);
+    ASSERT_TRUE(scheduler.getTasks().empty());
+}
+
+/**
+ * Test: concurrency limit set through the registry
+ * Expected: second task of the type is queued
+*/
+TEST(RegistryTest, Concurrency_Limit)
+{
+    Scheduler scheduler;
+    Tasks::get("test").setConcurrencyLimit(scheduler, 1);
+    Task& first = Tasks::create(scheduler, "test", "1");
+    Task& second = Tasks::create(scheduler, "test", "1");
+    ASSERT_EQ(second.status(), Task::StateType::queued);
+
+    first.stop();
+    second.stop();
+}
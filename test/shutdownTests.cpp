@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "Counter.h"
+#include "Fibonacci.h"
+#include "TestTask.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Checks its commands every interval, the last time after interval */
+class SlowTask : public Task
+{
+public:
+    SlowTask(const int id, std::chrono::milliseconds interval)
+    : Task(id), interval_(interval)
+    {}
+
+    double progress() override { return 0.0; }
+
+private:
+    const std::chrono::milliseconds interval_;
+
+    void execute() override {
+        while (true) {
+            std::this_thread::sleep_for(interval_);
+            checkCommand();
+        }
+    }
+};
+
+}
+
+/**
+ * Test: shutdown with many slow-polling tasks
+ * - Step 1: start 50 tasks checking their commands every 100ms
+ * - Step 2: shut down
+ * Expected: all stop within about one poll interval, not one interval per task
+*/
+TEST(ShutdownTest, Parallel_Stop)
+{
+    Scheduler scheduler;
+    for (int i = 0; i < 50; ++i) {
+        scheduler.addTask<SlowTask>(100ms);
+    }
+
+    const ShutdownReport report = scheduler.shutdown(5s);
+    ASSERT_EQ(report.stopped, 50u);
+    ASSERT_TRUE(report.stragglers.empty());
+    ASSERT_LT(report.elapsed, 1s);
+    for (Task& task : scheduler.getTasks()) {
+        ASSERT_EQ(task.status(), Task::StateType::stopped);
+    }
+}
+
+/**
+ * Test: task slower than the drain deadline
+ * - Step 1: start a task checking its commands every 300ms and a fast one
+ * - Step 2: shut down with a 20ms deadline
+ * Expected: slow task reported as straggler, fast one stopped, the destructor waits for the straggler
+*/
+TEST(ShutdownTest, Straggler_Reported)
+{
+    Scheduler scheduler;
+    SlowTask& slow = scheduler.addTask<SlowTask>(300ms);
+    TestTask& fast = scheduler.addTask<TestTask>(1ms);
+
+    const ShutdownReport report = scheduler.shutdown(20ms);
+    ASSERT_EQ(report.stopped, 2u);
+    ASSERT_EQ(report.stragglers, std::vector<int>{slow.id()});
+    ASSERT_EQ(fast.status(), Task::StateType::stopped);
+}
+
+/**
+ * Test: queued tasks and submissions during shutdown
+ * - Step 1: limit to one running task, start two
+ * - Step 2: shut down, add a task
+ * Expected: queued task stopped without running, new tasks rejected
+*/
+TEST(ShutdownTest, Queued_And_New_Tasks)
+{
+    Scheduler scheduler;
+    scheduler.setConcurrencyLimit(1);
+    TestTask& running = scheduler.addTask<TestTask>(1ms);
+    TestTask& queued = scheduler.addTask<TestTask>(1ms);
+    ASSERT_EQ(queued.status(), Task::StateType::queued);
+
+    const ShutdownReport report = scheduler.shutdown(1s);
+    ASSERT_EQ(report.stopped, 2u);
+    ASSERT_EQ(running.status(), Task::StateType::stopped);
+    ASSERT_EQ(queued.status(), Task::StateType::stopped);
+
+    try {
+        scheduler.addTask<TestTask>(1ms);
+        FAIL() << "Expected std::runtime_error";
+    }
+    catch(const std::runtime_error& e) {
+        ASSERT_EQ(std::string(e.what()), "Cannot add task, scheduler shutting down");
+    }
+}
+
+/**
+ * Test: scheduler destroyed with tasks never joined
+ * Expected: counters and fibonacci tasks are stopped and joined by the scheduler
+*/
+TEST(ShutdownTest, Destructor_Joins)
+{
+    Scheduler scheduler;
+    scheduler.addTask<Counter>(1000000);
+    scheduler.addTask<Fibonacci>(100000000);
+    Fibonacci& done = scheduler.addTask<Fibonacci>(5);
+    done.joinTask();
+}
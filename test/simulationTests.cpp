@@ -0,0 +1,226 @@
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Simulation.h"
+
+using std::vector;
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Polls steps times without charging virtual time itself, records the simulation's clock at every step */
+class PollingTask : public Task
+{
+public:
+    PollingTask(const int id, Simulation* simulation, const int steps)
+    : Task(id), simulation_(simulation), steps_(steps)
+    {}
+
+    double progress() override { return 0.0; }
+
+    vector<std::chrono::nanoseconds> clocks;
+
+private:
+    Simulation* simulation_;
+    const int steps_;
+
+    void execute() override {
+        for (int i = 0; i < steps_; ++i) {
+            checkCommand();
+            clocks.push_back(simulation_->now());
+        }
+    }
+};
+
+/* Adds count tasks of pseudo-random arrival, length and priority */
+vector<Task*> addWorkload(Simulation& simulation, const int count) {
+    vector<Task*> tasks;
+    std::uint64_t state = 42;
+    auto next = [&state]() {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        return static_cast<std::uint32_t>(state >> 33);
+    };
+
+    std::chrono::nanoseconds arrival(0);
+    for (int i = 0; i < count; ++i) {
+        arrival += std::chrono::microseconds(next() % 200);
+        const SimulatedWork work{1 + next() % 20, std::chrono::microseconds(10 + next() % 90)};
+        tasks.push_back(&simulation.addTask<SimulatedTask>(arrival, static_cast<int>(next() % 4), work));
+    }
+    return tasks;
+}
+
+}
+
+/**
+ * Test: tasks of 1s steps on one FIFO worker
+ * - Step 1: two tasks of 3 and 2 steps arriving at 0, one of 1 step arriving at 10s
+ * - Step 2: run
+ * Expected: exact finish times and report in virtual time, the run takes far less than a second
+*/
+TEST(SimulationTest, Virtual_Clock)
+{
+    SimulationOptions options;
+    options.workers = 1;
+    Simulation simulation(options);
+    SimulatedTask& first = simulation.addTask<SimulatedTask>(0s, 0, SimulatedWork{3, 1s});
+    SimulatedTask& second = simulation.addTask<SimulatedTask>(0s, 0, SimulatedWork{2, 1s});
+    SimulatedTask& late = simulation.addTask<SimulatedTask>(10s, 0, SimulatedWork{1, 1s});
+
+    const auto begin = std::chrono::steady_clock::now();
+    const SimulationReport report = simulation.run();
+    ASSERT_LT(std::chrono::steady_clock::now() - begin, 1s);
+
+    ASSERT_EQ(simulation.finishTime(first), 3s);
+    ASSERT_EQ(simulation.finishTime(second), 5s);
+    ASSERT_EQ(simulation.finishTime(late), 11s);
+    ASSERT_EQ(first.status(), Task::StateType::completed);
+    ASSERT_EQ(first.progress(), 100.0);
+
+    ASSERT_EQ(report.tasks, 3u);
+    ASSERT_EQ(report.completed, 3u);
+    ASSERT_EQ(report.makespan, 11s);
+    ASSERT_EQ(report.mean_wait, 1s);
+    ASSERT_EQ(report.p50_latency, 3s);
+    ASSERT_EQ(report.max_latency, 5s);
+    ASSERT_DOUBLE_EQ(report.utilization, 6.0 / 11.0);
+    ASSERT_THROW(simulation.run(), std::runtime_error);
+}
+
+/**
+ * Test: task not charging virtual time itself
+ * Expected: every poll costs options.step, now() in the task is its own clock
+*/
+TEST(SimulationTest, Default_Step)
+{
+    SimulationOptions options;
+    options.workers = 2;
+    options.step = 1ms;
+    Simulation simulation(options);
+    PollingTask& task = simulation.addTask<PollingTask>(5ms, 0, &simulation, 4);
+    simulation.run();
+
+    ASSERT_EQ(task.clocks, (vector<std::chrono::nanoseconds>{6ms, 7ms, 8ms, 9ms}));
+    ASSERT_EQ(simulation.finishTime(task), 9ms);
+}
+
+/**
+ * Test: priority policy with a 1s quantum on one worker
+ * - Step 1: low priority task of 5 steps of 1s at 0, high priority task of 2 steps at 1.5s
+ * Expected: the high priority task takes the worker at the end of the quantum running then, at 2s
+*/
+TEST(SimulationTest, Priority_Preemption)
+{
+    SimulationOptions options;
+    options.workers = 1;
+    options.policy = DispatchPolicy::priority;
+    options.quantum = 1s;
+    Simulation simulation(options);
+    SimulatedTask& low = simulation.addTask<SimulatedTask>(0s, 0, SimulatedWork{5, 1s});
+    SimulatedTask& high = simulation.addTask<SimulatedTask>(1500ms, 5, SimulatedWork{2, 1s});
+
+    const SimulationReport report = simulation.run();
+    ASSERT_EQ(simulation.finishTime(high), 4s);
+    ASSERT_EQ(simulation.finishTime(low), 7s);
+    ASSERT_EQ(report.preemptions, 1u);
+}
+
+/**
+ * Test: commands in virtual time on one worker
+ * - Step 1: pause a task of 10 steps of 1s at 2.5s, resume it at 6s, a task of 2 steps waits behind it
+ * - Step 2: stop a task of 50 steps arriving at 100s at 105s
+ * Expected: the pause is applied at the 3s poll and lets the other task run, the paused task ends 3s
+ * later than alone, the stopped task ends at 105s
+*/
+TEST(SimulationTest, Commands)
+{
+    SimulationOptions options;
+    options.workers = 1;
+    Simulation simulation(options);
+    SimulatedTask& paused = simulation.addTask<SimulatedTask>(0s, 0, SimulatedWork{10, 1s});
+    SimulatedTask& other = simulation.addTask<SimulatedTask>(0s, 0, SimulatedWork{2, 1s});
+    SimulatedTask& stopped = simulation.addTask<SimulatedTask>(100s, 0, SimulatedWork{50, 1s});
+    simulation.command(2500ms, paused, Task::CommandType::pause);
+    simulation.command(6s, paused, Task::CommandType::run);
+    simulation.command(105s, stopped, Task::CommandType::stop);
+
+    SimulatedTask outsider(99, SimulatedWork{1, 1s});
+    ASSERT_THROW(simulation.command(1s, outsider, Task::CommandType::stop), std::invalid_argument);
+
+    const SimulationReport report = simulation.run();
+    ASSERT_EQ(simulation.finishTime(other), 5s);
+    ASSERT_EQ(simulation.finishTime(paused), 13s);
+    ASSERT_EQ(simulation.finishTime(stopped), 105s);
+    ASSERT_EQ(stopped.status(), Task::StateType::stopped);
+    ASSERT_EQ(report.completed, 2u);
+    ASSERT_EQ(report.stopped, 1u);
+}
+
+/**
+ * Test: same seeded workload run twice under each policy
+ * Expected: identical reports and finish times, work stealing steals
+*/
+TEST(SimulationTest, Deterministic)
+{
+    for (const DispatchPolicy policy : {DispatchPolicy::fifo, DispatchPolicy::priority, DispatchPolicy::workStealing}) {
+        SimulationOptions options;
+        options.policy = policy;
+        options.quantum = 100us;
+        options.seed = 7;
+
+        vector<std::chrono::nanoseconds> finishes[2];
+        SimulationReport reports[2];
+        for (int run = 0; run < 2; ++run) {
+            Simulation simulation(options);
+            const vector<Task*> tasks = addWorkload(simulation, 300);
+            reports[run] = simulation.run();
+            for (Task* task : tasks) {
+                finishes[run].push_back(simulation.finishTime(*task));
+            }
+            ASSERT_EQ(reports[run].completed, 300u);
+        }
+        ASSERT_EQ(finishes[0], finishes[1]);
+        ASSERT_EQ(reports[0].makespan, reports[1].makespan);
+        ASSERT_EQ(reports[0].mean_latency, reports[1].mean_latency);
+        ASSERT_EQ(reports[0].p99_latency, reports[1].p99_latency);
+        ASSERT_EQ(reports[0].mean_wait, reports[1].mean_wait);
+        ASSERT_EQ(reports[0].preemptions, reports[1].preemptions);
+        ASSERT_EQ(reports[0].steals, reports[1].steals);
+        if (policy == DispatchPolicy::workStealing) {
+            ASSERT_GT(reports[0].steals, 0u);
+        }
+    }
+}
+
+/**
+ * Test: replay of a lifecycle trace on one worker with 1ms steps
+ * - Step 1: task 1 started at 1ms running 3ms, task 2 started at 2ms running 2ms around a pause
+ * Expected: 2 tasks added, task 2 waits for task 1, makespan 5ms
+*/
+TEST(SimulationTest, Trace_Replay)
+{
+    auto at = [](const int ms, const int id, const TraceEvent event) {
+        return TraceRecord{static_cast<std::uint64_t>(ms) * 1000000, id, 0, event};
+    };
+    const vector<TraceRecord> records = {
+        at(1, 1, TraceEvent::start), at(1, 1, TraceEvent::run),
+        at(2, 2, TraceEvent::start), at(4, 1, TraceEvent::completed),
+        at(5, 2, TraceEvent::run), at(6, 2, TraceEvent::paused),
+        at(8, 2, TraceEvent::resumed), at(9, 2, TraceEvent::completed),
+    };
+
+    SimulationOptions options;
+    options.workers = 1;
+    options.step = 1ms;
+    Simulation simulation(options);
+    ASSERT_EQ(simulation.addTrace(records), 2u);
+
+    const SimulationReport report = simulation.run();
+    ASSERT_EQ(report.completed, 2u);
+    ASSERT_EQ(report.makespan, 5ms);
+    ASSERT_EQ(report.max_latency, 4ms);
+}
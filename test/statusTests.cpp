@@ -0,0 +1,136 @@
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "Status.h"
+#include "Counter.h"
+#include "TestTask.h"
+
+using namespace std::chrono_literals;
+
+/**
+ * Test: text output
+ * - Step 1: start a task, pause it
+ * Expected: same line as operator<< followed by the type
+*/
+TEST(StatusTest, Text_Matches_Operator)
+{
+    Scheduler scheduler;
+    TestTask& task = scheduler.addTask<TestTask>(1ms);
+    task.pause();
+
+    std::ostringstream expected;
+    expected << " -> " << task << " task_type: test\n";
+
+    StatusWriter writer;
+    ASSERT_TRUE(writer.append(task));
+    ASSERT_EQ(writer.data(), expected.str());
+    task.stop();
+}
+
+/**
+ * Test: NDJSON output with filters
+ * - Step 1: start two test tasks and a counter, pause one test task
+ * Expected: one line per matching task, filtered by state and type
+*/
+TEST(StatusTest, Json_Filters)
+{
+    Scheduler scheduler;
+    TestTask& paused = scheduler.addTask<TestTask>(1ms);
+    TestTask& running = scheduler.addTask<TestTask>(1ms);
+    Counter& counter = scheduler.addTask<Counter>(1000000);
+    paused.pause();
+
+    StatusWriter writer(StatusFormat::ndjson);
+    StatusFilter filter;
+    filter.states = StatusFilter::bit(Task::StateType::paused);
+    ASSERT_EQ(writer.appendAll(scheduler, filter), 1u);
+    ASSERT_EQ(writer.data(), "{\"id\":" + std::to_string(paused.id()) + ",\"state\":\"paused\",\"progress\":0,\"memory\":0,\"memory_peak\":0,\"type\":\"test\"}\n");
+
+    writer.clear();
+    filter = StatusFilter();
+    filter.type = "counter";
+    ASSERT_EQ(writer.appendAll(scheduler, filter), 1u);
+    ASSERT_EQ(writer.data().find("{\"id\":" + std::to_string(counter.id()) + ","), 0u);
+    ASSERT_NE(writer.data().find("\"type\":\"counter\"}\n"), std::string::npos);
+
+    writer.clear();
+    ASSERT_EQ(writer.appendAll(scheduler), 3u);
+
+    paused.stop();
+    running.stop();
+    counter.stop();
+    counter.join();
+}
+
+/**
+ * Test: binary output
+ * Expected: header with the task count, then fixed records with the arena usage and zeroed reserved bytes,
+ *           followed by the type name
+*/
+TEST(StatusTest, Binary_Records)
+{
+    Scheduler scheduler;
+    TestTask& first = scheduler.addTask<TestTask>(1ms);
+    TestTask& second = scheduler.addTask<TestTask>(1ms);
+    second.stop();
+    // TestTask does not use its arena, the bytes are accounted to it all the same
+    first.arena().allocate(1000);
+    const std::size_t used = first.arena().used();
+
+    StatusWriter writer(StatusFormat::binary);
+    ASSERT_EQ(writer.appendAll(scheduler), 2u);
+
+    const std::string& data = writer.data();
+    StatusHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    ASSERT_EQ(header.magic, StatusWriter::binary_magic);
+    ASSERT_EQ(header.count, 2u);
+
+    std::size_t offset = sizeof(header);
+    StatusRecord record;
+    std::memcpy(&record, data.data() + offset, sizeof(record));
+    ASSERT_EQ(record.id, first.id());
+    ASSERT_EQ(record.state, static_cast<std::uint8_t>(Task::StateType::running));
+    ASSERT_GE(used, 1000u);
+    ASSERT_EQ(record.memory, used);
+    ASSERT_EQ(record.memory_peak, first.arena().peak());
+    ASSERT_EQ(std::string(data.data() + offset + offsetof(StatusRecord, reserved), sizeof(record.reserved)),
+              std::string(sizeof(record.reserved), '\0'));
+    ASSERT_EQ(std::string(data.data() + offset + sizeof(record), record.type_size), "test");
+
+    offset += sizeof(record) + record.type_size;
+    std::memcpy(&record, data.data() + offset, sizeof(record));
+    ASSERT_EQ(record.id, second.id());
+    ASSERT_EQ(record.state, static_cast<std::uint8_t>(Task::StateType::stopped));
+    ASSERT_EQ(record.progress, 10000u);
+    ASSERT_EQ(record.memory, 0u);
+    ASSERT_EQ(record.memory_peak, 0u);
+    ASSERT_EQ(offset + sizeof(record) + record.type_size, data.size());
+    first.stop();
+}
+
+/**
+ * Test: buffer reuse
+ * Expected: repeated dumps of the same tasks keep the buffer, no new allocation
+*/
+TEST(StatusTest, Buffer_Reused)
+{
+    Scheduler scheduler;
+    for (int i = 0; i < 100; ++i) {
+        scheduler.addTask<TestTask>(1ms);
+    }
+
+    StatusWriter writer(StatusFormat::ndjson, 1024);
+    writer.appendAll(scheduler);
+    const char* buffer = writer.data().data();
+    for (int i = 0; i < 10; ++i) {
+        writer.clear();
+        writer.appendAll(scheduler);
+        ASSERT_EQ(writer.data().data(), buffer);
+    }
+}
@@ -0,0 +1,255 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "TestTask.h"
+#include "TestUtils.h"
+#include "ThreadPool.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Released once for every thread waiting on it */
+class Gate
+{
+public:
+    /* Waits in a blocking region till open */
+    void wait() {
+        BlockingRegion blocking;
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiting_++;
+        condition_.wait(lock, [&]() { return open_; });
+    }
+
+    void open() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        open_ = true;
+        condition_.notify_all();
+    }
+
+    int waiting() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        return waiting_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool open_ = false;
+    int waiting_ = 0;
+};
+
+/* Waits for another task to finish */
+class JoiningTask : public Task
+{
+public:
+    JoiningTask(const int id, Task* target)
+    : Task(id), target_(target)
+    {}
+
+    double progress() override { return 0.0; }
+
+private:
+    Task* target_;
+
+    void execute() override {
+        checkCommand();
+        target_->joinTask();
+    }
+};
+
+/* Completes at once */
+class QuickTask : public Task
+{
+public:
+    QuickTask(const int id, int)
+    : Task(id)
+    {}
+
+    double progress() override { return 0.0; }
+
+private:
+    void execute() override {
+        checkCommand();
+    }
+};
+}
+
+/**
+ * Test: many short jobs on a pool of parallelism 2
+ * Expected: every job runs on a pool worker, never more than 2 workers, options below the parallelism are refused
+*/
+TEST(ThreadPoolTest, Runs_Jobs)
+{
+    std::atomic<int> done(0);
+    std::atomic<int> outside(0);
+    ThreadPoolOptions options;
+    options.parallelism = 2;
+    {
+        ThreadPool pool(options);
+        ASSERT_EQ(ThreadPool::current(), nullptr);
+        for (int i = 0; i < 1000; ++i) {
+            pool.submit([&]() {
+                if (ThreadPool::current() != &pool) {
+                    outside++;
+                }
+                done++;
+            });
+        }
+        ASSERT_TRUE(waitFor([&]() { return done == 1000; }, 2000ms));
+        ASSERT_LE(pool.stats().peak_threads, 2u);
+    }
+    ASSERT_EQ(outside.load(), 0);
+
+    options.max_threads = 1;
+    ASSERT_THROW(ThreadPool pool(options), std::invalid_argument);
+}
+
+/**
+ * Test: jobs blocked waiting for jobs queued behind them
+ * - Step 1: parallelism 2, submit 4 jobs waiting on a gate in a blocking region
+ * - Step 2: submit a job opening the gate
+ * Expected: workers are spawned for the queued jobs instead of deadlocking, at most max_threads of them
+*/
+TEST(ThreadPoolTest, Compensates_Blocked_Workers)
+{
+    ThreadPoolOptions options;
+    options.parallelism = 2;
+    options.max_threads = 6;
+    ThreadPool pool(options);
+
+    Gate gate;
+    std::atomic<int> done(0);
+    for (int i = 0; i < 4; ++i) {
+        pool.submit([&]() {
+            gate.wait();
+            done++;
+        });
+    }
+    ASSERT_TRUE(waitFor([&]() { return gate.waiting() == 4; }, 1000ms));
+    ThreadPoolStats stats = pool.stats();
+    ASSERT_EQ(stats.blocked, 4u);
+    ASSERT_EQ(stats.threads, 4u);
+
+    pool.submit([&]() {
+        gate.open();
+        done++;
+    });
+    ASSERT_TRUE(waitFor([&]() { return done == 5; }, 1000ms));
+    ASSERT_LE(pool.stats().peak_threads, 6u);
+}
+
+/**
+ * Test: more blocked jobs than max_threads
+ * - Step 1: parallelism 1, max 3, submit 5 jobs waiting on a gate
+ * - Step 2: open the gate
+ * Expected: 3 workers blocked and 2 jobs queued, then every job runs
+*/
+TEST(ThreadPoolTest, Thread_Cap)
+{
+    ThreadPoolOptions options;
+    options.parallelism = 1;
+    options.max_threads = 3;
+    ThreadPool pool(options);
+
+    Gate gate;
+    std::atomic<int> done(0);
+    for (int i = 0; i < 5; ++i) {
+        pool.submit([&]() {
+            gate.wait();
+            done++;
+        });
+    }
+    ASSERT_TRUE(waitFor([&]() { return gate.waiting() == 3; }, 1000ms));
+    std::this_thread::sleep_for(50ms);
+    ThreadPoolStats stats = pool.stats();
+    ASSERT_EQ(stats.threads, 3u);
+    ASSERT_EQ(stats.queued, 2u);
+
+    gate.open();
+    ASSERT_TRUE(waitFor([&]() { return done == 5; }, 1000ms));
+    ASSERT_EQ(pool.stats().peak_threads, 3u);
+}
+
+/**
+ * Test: workers spawned for blocked jobs, left idle
+ * Expected: they exit after keep_alive, the pool keeps its parallelism
+*/
+TEST(ThreadPoolTest, Retires_Idle_Workers)
+{
+    ThreadPoolOptions options;
+    options.parallelism = 1;
+    options.max_threads = 4;
+    options.keep_alive = 50ms;
+    ThreadPool pool(options);
+
+    Gate gate;
+    std::atomic<int> done(0);
+    for (int i = 0; i < 4; ++i) {
+        pool.submit([&]() {
+            gate.wait();
+            done++;
+        });
+    }
+    ASSERT_TRUE(waitFor([&]() { return gate.waiting() == 4; }, 1000ms));
+    gate.open();
+    ASSERT_TRUE(waitFor([&]() { return done == 4; }, 1000ms));
+
+    ASSERT_TRUE(waitFor([&]() { return pool.stats().threads == 1; }, 2000ms));
+    ASSERT_EQ(pool.stats().retired, 3u);
+
+    // Still serving
+    pool.submit([&]() { done++; });
+    ASSERT_TRUE(waitFor([&]() { return done == 5; }, 1000ms));
+}
+
+/**
+ * Test: scheduler tasks on a pool of parallelism 2
+ * - Step 1: 6 tasks joining tasks prepared idle, then run the prepared tasks
+ * - Step 2: pause, resume and stop a sleeping task
+ * Expected: joinTask() frees its worker, every task completes; commands work on pooled tasks
+*/
+TEST(ThreadPoolTest, Scheduler_Tasks)
+{
+    Scheduler scheduler;
+    ThreadPoolOptions options;
+    options.parallelism = 2;
+    options.max_threads = 32;
+    scheduler.enableThreadPool(options);
+    ASSERT_THROW(scheduler.enableThreadPool(options), std::runtime_error);
+    ThreadPool* pool = scheduler.threadPool();
+    ASSERT_NE(pool, nullptr);
+
+    std::vector<QuickTask*> targets;
+    std::vector<JoiningTask*> joiners;
+    for (int i = 0; i < 6; ++i) {
+        targets.push_back(&scheduler.prepareTask<QuickTask>(0));
+        joiners.push_back(&scheduler.addTask<JoiningTask>(static_cast<Task*>(targets.back())));
+    }
+    ASSERT_TRUE(waitFor([&]() { return pool->stats().blocked == 6; }, 1000ms));
+
+    for (QuickTask* target : targets) {
+        scheduler.restartTask(*target);
+    }
+    for (JoiningTask* joiner : joiners) {
+        ASSERT_TRUE(joiner->joinTaskUntil(std::chrono::steady_clock::now() + 2s));
+        ASSERT_EQ(joiner->status(), Task::StateType::completed);
+    }
+
+    TestTask& sleeper = scheduler.addTask<TestTask>(std::chrono::nanoseconds(5ms));
+    ASSERT_EQ(sleeper.pool(), pool);
+    sleeper.pause();
+    ASSERT_EQ(sleeper.status(), Task::StateType::paused);
+    sleeper.resume();
+    sleeper.stop();
+    ASSERT_EQ(sleeper.status(), Task::StateType::stopped);
+    ASSERT_LE(pool->stats().peak_threads, 32u);
+}
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "TestTask.h"
+#include "Trace.h"
+
+using std::vector;
+using namespace std::chrono_literals;
+
+/**
+ * Test: ring keeps only the newest events once full
+ * - Step 1: push 10 records into a ring of 4
+ * Expected: snapshot returns the last 3 records, oldest first; the slot the writer overwrites next is
+ * never reported
+*/
+TEST(TraceTest, Ring_Overwrites_Oldest)
+{
+    TraceBuffer buffer(4);
+    for (int i = 0; i < 10; ++i) {
+        buffer.push(TraceRecord{static_cast<std::uint64_t>(i), i, 0, TraceEvent::run});
+    }
+
+    vector<TraceRecord> records;
+    buffer.snapshot(records);
+
+    ASSERT_EQ(records.size(), 3u);
+    for (int i = 0; i < 3; ++i) {
+        ASSERT_EQ(records[i].task_id, 7 + i);
+        ASSERT_EQ(records[i].event, TraceEvent::run);
+    }
+
+    buffer.clear();
+    records.clear();
+    buffer.snapshot(records);
+    ASSERT_TRUE(records.empty());
+}
+
+/**
+ * Test: events recorded by several threads are merged
+ * - Step 1: record events from 4 threads
+ * - Step 2: collect and dump
+ * Expected: every event is collected sorted by time, dump is a trace-event document
+*/
+TEST(TraceTest, Collect_From_Threads)
+{
+    Trace::clear();
+
+    vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < 100; ++i) {
+                Trace::record(TraceEvent::paused, t);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    auto records = Trace::collect();
+    ASSERT_EQ(records.size(), 400u);
+    ASSERT_TRUE(std::is_sorted(records.begin(), records.end(), [](const TraceRecord& a, const TraceRecord& b) {
+        return a.timestamp < b.timestamp;
+    }));
+
+    std::ostringstream os;
+    Trace::dump(os);
+    const std::string json = os.str();
+    ASSERT_EQ(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+    ASSERT_NE(json.find("\"name\":\"paused\""), std::string::npos);
+
+    Trace::clear();
+    ASSERT_TRUE(Trace::collect().empty());
+}
+
+#ifdef TASKLIB_TRACE
+/**
+ * Test: task lifecycle is recorded
+ * - Step 1: start task
+ * - Step 2: pause, resume and stop task
+ * Expected: controller requests and worker acknowledgements are recorded in order on their own threads
+*/
+TEST(TraceTest, Task_Lifecycle)
+{
+    Trace::clear();
+    {
+        Scheduler scheduler;
+        TestTask& task = scheduler.addTask<TestTask>(10ns);
+        task.pause();
+        task.resume();
+        task.stop();
+    }
+
+    auto records = Trace::collect();
+    ASSERT_FALSE(records.empty());
+    const std::uint32_t controller = records.front().thread;
+
+    vector<TraceEvent> controller_events;
+    vector<TraceEvent> worker_events;
+    for (auto& record : records) {
+        (record.thread == controller ? controller_events : worker_events).push_back(record.event);
+    }
+
+    const vector<TraceEvent> expected_controller = {
+        TraceEvent::start, TraceEvent::pauseRequest, TraceEvent::resumeRequest, TraceEvent::stopRequest,
+    };
+    const vector<TraceEvent> expected_worker = {
+        TraceEvent::run, TraceEvent::paused, TraceEvent::resumed,
+        TraceEvent::stopping, TraceEvent::unwound, TraceEvent::stopped,
+    };
+    ASSERT_EQ(controller_events, expected_controller);
+    ASSERT_EQ(worker_events, expected_worker);
+
+    // Every acknowledgement follows its request
+    auto position = [&](TraceEvent event) {
+        return std::find_if(records.begin(), records.end(), [&](const TraceRecord& r) { return r.event == event; }) - records.begin();
+    };
+    ASSERT_LT(position(TraceEvent::pauseRequest), position(TraceEvent::paused));
+    ASSERT_LT(position(TraceEvent::resumeRequest), position(TraceEvent::resumed));
+    ASSERT_LT(position(TraceEvent::stopRequest), position(TraceEvent::stopping));
+}
+#endif
@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "Scheduler.h"
+#include "TestTask.h"
+#include "TestUtils.h"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Polls, then stays away from checkCommand for stall at every iteration */
+class StallingTask : public Task
+{
+public:
+    StallingTask(const int id, std::chrono::milliseconds stall)
+    : Task(id), stall_(stall)
+    {}
+
+    double progress() override { return 0.0; }
+
+private:
+    const std::chrono::milliseconds stall_;
+
+    void execute() override {
+        while (true) {
+            checkCommand();
+            std::this_thread::sleep_for(stall_);
+        }
+    }
+};
+
+/* Parked till released */
+class ParkedTask : public Task
+{
+public:
+    ParkedTask(const int id, int)
+    : Task(id)
+    {}
+
+    double progress() override { return 0.0; }
+
+    void release() {
+        released_ = true;
+        wake();
+    }
+
+private:
+    std::atomic<bool> released_{false};
+
+    void execute() override {
+        park([&]() { return released_.load(); });
+    }
+};
+}
+
+/**
+ * Test: task not polling
+ * - Step 1: watchdog with a 50ms threshold, start a task polling every 600ms
+ * - Step 2: stop it once flagged
+ * Expected: task flagged unresponsive, stop fails fast, the task stops at its next poll
+*/
+TEST(WatchdogTest, Stop_Unresponsive_Fails_Fast)
+{
+    Scheduler scheduler;
+    scheduler.enableWatchdog(50ms, 5ms);
+    StallingTask& task = scheduler.addTask<StallingTask>(600ms);
+
+    ASSERT_TRUE(waitFor([&]() { return task.unresponsive(); }, 2000ms));
+    ASSERT_EQ(scheduler.watchdog()->unresponsive(), std::vector<int>{task.id()});
+
+    const auto begin = std::chrono::steady_clock::now();
+    try {
+        task.stop();
+        FAIL() << "Expected std::runtime_error";
+    }
+    catch(const std::runtime_error& e) {
+        ASSERT_EQ(std::string(e.what()), "Cannot stop task, '" + std::to_string(task.id()) + "', task unresponsive");
+    }
+    ASSERT_LT(std::chrono::steady_clock::now() - begin, 100ms);
+
+    task.joinTask();
+    ASSERT_EQ(task.status(), Task::StateType::stopped);
+}
+
+/**
+ * Test: flag set while a control call waits
+ * - Step 1: watchdog with a 100ms threshold, start a task polling every second
+ * - Step 2: pause it once it has polled, before it is flagged
+ * Expected: pause gives up once the task is flagged, well before its next poll, which pauses it
+*/
+TEST(WatchdogTest, Waiting_Pause_Gives_Up)
+{
+    Scheduler scheduler;
+    scheduler.enableWatchdog(100ms, 10ms);
+    StallingTask& task = scheduler.addTask<StallingTask>(1000ms);
+    std::this_thread::sleep_for(20ms);
+    ASSERT_FALSE(task.unresponsive());
+
+    const auto begin = std::chrono::steady_clock::now();
+    ASSERT_THROW(task.pause(), std::runtime_error);
+    ASSERT_LT(std::chrono::steady_clock::now() - begin, 500ms);
+    ASSERT_TRUE(task.unresponsive());
+
+    ASSERT_TRUE(waitFor([&]() { return task.status() == Task::StateType::paused; }, 2000ms));
+    ASSERT_FALSE(task.unresponsive());
+}
+
+/**
+ * Test: responsive, paused and parked tasks
+ * - Step 1: watchdog with a 50ms threshold, start a test task polling every 1ms, a paused one and a parked one
+ * - Step 2: wait 200ms, resume the paused one and release the parked one
+ * Expected: none flagged, poll intervals of the test type recorded around 1ms
+*/
+TEST(WatchdogTest, Responsive_Tasks_Not_Flagged)
+{
+    Scheduler scheduler;
+    scheduler.enableWatchdog(50ms, 5ms);
+    TestTask& polling = scheduler.addTask<TestTask>(1ms);
+    TestTask& paused = scheduler.addTask<TestTask>(1ms);
+    paused.pause();
+    ParkedTask& parked = scheduler.addTask<ParkedTask>(0);
+
+    std::this_thread::sleep_for(200ms);
+    ASSERT_TRUE(scheduler.watchdog()->unresponsive().empty());
+    ASSERT_FALSE(polling.unresponsive());
+    ASSERT_FALSE(parked.unresponsive());
+
+    paused.resume();
+    parked.release();
+    parked.joinTask();
+    std::this_thread::sleep_for(20ms);
+    ASSERT_TRUE(scheduler.watchdog()->unresponsive().empty());
+
+    const auto histograms = scheduler.watchdog()->histograms();
+    auto test = std::find_if(histograms.begin(), histograms.end(), [](const std::pair<std::string, PollHistogram>& item) {
+        return item.first == "test";
+    });
+    ASSERT_NE(test, histograms.end());
+    ASSERT_GT(test->second.total(), 50u);
+    ASSERT_GE(test->second.percentile(0.5), 500us);
+    ASSERT_LE(test->second.percentile(0.5), 50ms);
+    ASSERT_LE(test->second.percentile(0.99), 100ms);
+}
+
+/**
+ * Test: poll histogram buckets
+ * Expected: intervals land in their power of two bucket, percentiles return the bucket bound
+*/
+TEST(WatchdogTest, Poll_Histogram)
+{
+    PollHistogram histogram;
+    ASSERT_EQ(histogram.percentile(0.5), 0ns);
+
+    histogram.add(1000ns, 90);        // [512, 1024)
+    histogram.add(1ms, 10);           // [2^19, 2^20)
+    ASSERT_EQ(histogram.total(), 100u);
+    ASSERT_EQ(histogram.counts[9], 90u);
+    ASSERT_EQ(histogram.counts[19], 10u);
+    ASSERT_EQ(histogram.percentile(0.5), 1024ns);
+    ASSERT_EQ(histogram.percentile(0.99), std::chrono::nanoseconds(1 << 20));
+}
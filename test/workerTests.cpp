@@ -0,0 +1,265 @@
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "Fibonacci.h"
+#include "Log.h"
+#include "TestTask.h"
+#include "Status.h"
+#include "Worker.h"
+
+using std::string;
+using std::vector;
+using namespace std::chrono_literals;
+
+namespace {
+
+/* Aborts its worker after polling for delay_ms */
+class CrashingTask : public Task
+{
+public:
+    using InputType = int;
+
+    static constexpr const char* typeName() { return "crash"; }
+
+    static constexpr TaskArgument taskArgument() {
+        return {"delay_ms", "aborts its process", 0, 0, 1000};
+    }
+
+    CrashingTask(const int id, const int delay_ms)
+    : Task(id), delay_(delay_ms)
+    {}
+
+    double progress() override { return 0.0; }
+
+private:
+    const std::chrono::milliseconds delay_;
+
+    void execute() override {
+        const auto deadline = std::chrono::steady_clock::now() + delay_;
+        while (std::chrono::steady_clock::now() < deadline) {
+            checkCommand();
+            std::this_thread::sleep_for(1ms);
+        }
+        std::abort();
+    }
+};
+
+/* Throws from its worker */
+class ThrowingTask : public Task
+{
+public:
+    using InputType = int;
+
+    static constexpr const char* typeName() { return "throw"; }
+
+    static constexpr TaskArgument taskArgument() {
+        return {"unused", "throws std::invalid_argument", 0, 0, 0};
+    }
+
+    ThrowingTask(const int id, int)
+    : Task(id)
+    {}
+
+    double progress() override { return 0.0; }
+
+private:
+    void execute() override {
+        throw std::invalid_argument("boom");
+    }
+};
+
+using Tasks = TaskRegistry<TestTask, Fibonacci, CrashingTask, ThrowingTask>;
+
+string failure(Task& task) {
+    try {
+        std::rethrow_exception(task.exception());
+    }
+    catch (const std::exception& e) {
+        return e.what();
+    }
+}
+
+/* Field of /proc/<pid>/status, empty if the process is gone */
+string procStatus(const pid_t pid, const string& field) {
+    std::ifstream file("/proc/" + std::to_string(pid) + "/status");
+    string line;
+    while (std::getline(file, line)) {
+        if (line.compare(0, field.size() + 1, field + ":") == 0) {
+            return line.substr(line.find_first_not_of(" \t", field.size() + 1));
+        }
+    }
+    return string();
+}
+
+}
+
+/**
+ * Test: tasks run in workers
+ * - Step 1: pool of 2 workers, start 4 fibonacci tasks of 25 through it
+ * Expected: every task completes with a full progress, under its remote type name, tasks waiting for a free worker meanwhile
+*/
+TEST(WorkerTest, Remote_Completes)
+{
+    WorkerPool pool(Tasks(), 2);
+    Scheduler scheduler;
+
+    vector<RemoteTask*> tasks;
+    for (int i = 0; i < 4; ++i) {
+        tasks.push_back(&pool.addTask(scheduler, "fibonacci", "25"));
+    }
+    for (RemoteTask* task : tasks) {
+        task->joinTask();
+        ASSERT_EQ(task->status(), Task::StateType::completed);
+        ASSERT_DOUBLE_EQ(task->progress(), 100.0);
+        ASSERT_STREQ(task->type(), "fibonacci");
+        ASSERT_EQ(task->worker(), 0);
+    }
+    ASSERT_EQ(pool.respawns(), 0u);
+}
+
+/**
+ * Test: commands forwarded to a worker
+ * - Step 1: start a test task in a worker
+ * - Step 2: pause, resume, then stop it
+ * Expected: it runs in another process, each command is acknowledged, the task ends stopped
+*/
+TEST(WorkerTest, Remote_Control)
+{
+    WorkerPool pool(Tasks(), 1);
+    Scheduler scheduler;
+
+    RemoteTask& task = pool.addTask(scheduler, "test", "1");
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (task.worker() == 0 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    ASSERT_EQ(task.worker(), pool.pids()[0]);
+    ASSERT_NE(task.worker(), ::getpid());
+
+    task.pause();
+    ASSERT_EQ(task.status(), Task::StateType::paused);
+    task.resume();
+    ASSERT_EQ(task.status(), Task::StateType::running);
+    task.stop();
+    ASSERT_EQ(task.status(), Task::StateType::stopped);
+}
+
+/**
+ * Test: worker crashing
+ * - Step 1: pool of 1 worker, start a task aborting its worker after 20ms
+ * - Step 2: start a fibonacci task once it failed
+ * Expected: the task fails with the signal, the worker is forked again and runs the next task
+*/
+TEST(WorkerTest, Crash_Respawns)
+{
+    WorkerPool pool(Tasks(), 1);
+    Scheduler scheduler;
+    const pid_t pid = pool.pids()[0];
+
+    RemoteTask& crashing = pool.addTask(scheduler, "crash", "20");
+    crashing.joinTask();
+    ASSERT_EQ(crashing.status(), Task::StateType::failed);
+    ASSERT_NE(failure(crashing).find("crashed, signal"), string::npos);
+    ASSERT_EQ(pool.respawns(), 1u);
+    ASSERT_NE(pool.pids()[0], pid);
+
+    RemoteTask& next = pool.addTask(scheduler, "fibonacci", "10");
+    next.joinTask();
+    ASSERT_EQ(next.status(), Task::StateType::completed);
+}
+
+/**
+ * Test: task throwing in a worker
+ * - Step 1: start a task throwing std::invalid_argument in a worker
+ * Expected: the task fails with the message, the worker survives
+*/
+TEST(WorkerTest, Remote_Exception)
+{
+    WorkerPool pool(Tasks(), 1);
+    Scheduler scheduler;
+
+    RemoteTask& task = pool.addTask(scheduler, "throw");
+    task.joinTask();
+    ASSERT_EQ(task.status(), Task::StateType::failed);
+    ASSERT_EQ(failure(task), "boom");
+    ASSERT_EQ(pool.respawns(), 0u);
+}
+
+/**
+ * Test: tasks stopped before running in a worker
+ * - Step 1: pool of 1 worker, start two test tasks, the second waits for the worker
+ * - Step 2: stop the second, then stop the first right after starting a third
+ * Expected: every task stops, none is left running on the worker
+*/
+TEST(WorkerTest, Stop_Before_Running)
+{
+    WorkerPool pool(Tasks(), 1);
+    Scheduler scheduler;
+
+    RemoteTask& first = pool.addTask(scheduler, "test", "1");
+    RemoteTask& second = pool.addTask(scheduler, "test", "1");
+    second.stop();
+    ASSERT_EQ(second.status(), Task::StateType::stopped);
+
+    RemoteTask& third = pool.addTask(scheduler, "test", "1");
+    first.stop();
+    third.stop();
+    ASSERT_EQ(first.status(), Task::StateType::stopped);
+    ASSERT_EQ(third.status(), Task::StateType::stopped);
+    ASSERT_EQ(scheduler.countTasks(StatusFilter::bit(Task::StateType::running)), 0u);
+}
+
+/**
+ * Test: workers of a destroyed pool
+ * - Step 1: pool of 2 workers, one running a test task, the other idle
+ * - Step 2: destroy the pool
+ * Expected: the workers are forked by another process than this one, none is left once the pool is gone
+*/
+TEST(WorkerTest, Workers_Exit_With_Pool)
+{
+    vector<pid_t> pids;
+    {
+        WorkerPool pool(Tasks(), 2);
+        Scheduler scheduler;
+        pids = pool.pids();
+
+        RemoteTask& task = pool.addTask(scheduler, "test", "1");
+        const auto deadline = std::chrono::steady_clock::now() + 1s;
+        while (task.worker() == 0 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(1ms);
+        }
+        ASSERT_NE(task.worker(), 0);
+        for (const pid_t pid : pids) {
+            ASSERT_EQ(::waitpid(pid, nullptr, WNOHANG), -1);
+        }
+        task.stop();
+    }
+    for (const pid_t pid : pids) {
+        ASSERT_EQ(::kill(pid, 0), -1);
+    }
+}
+
+/**
+ * Test: zygote of a pool created once the library log is running
+ * Expected: the zygote forking the workers has a single thread
+*/
+TEST(WorkerTest, Zygote_Single_Threaded)
+{
+    Log::global().flush();
+    WorkerPool pool(Tasks(), 1);
+
+    const pid_t zygote = std::stoi(procStatus(pool.pids().at(0), "PPid"));
+    ASSERT_NE(zygote, ::getpid());
+    ASSERT_EQ(procStatus(zygote, "Threads"), "1");
+}